@@ -1,11 +1,22 @@
 #include "ArchiveHandler.hpp"
+#include "Tar.hpp"
+#include "../Utils/Instrumentation.hpp"
+#include "../Utils/BoundedQueue.hpp"
+#include "../Utils/Utils.hpp"
+#include <atomic>
+#include <cerrno>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <chrono>
 #include <random>
-#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -36,24 +47,17 @@ namespace ArchiveHandler {
         }
     }
 
-    // Gets the size of a folder (recursive)
+    // Gets the size of a folder (recursive) using the parallel scanner
     size_t getFolderSize(const std::string& folderPath) {
-        try {
-            if (!isValidFolder(folderPath)) {
-                return 0;
-            }
-
-            size_t totalSize = 0;
-            for (const auto& entry : fs::recursive_directory_iterator(folderPath)) {
-                if (entry.is_regular_file()) {
-                    totalSize += entry.file_size();
-                }
-            }
-            return totalSize;
-        } catch (const fs::filesystem_error& e) {
-            std::cerr << "Error calculating folder size: " << e.what() << std::endl;
+        if (!isValidFolder(folderPath)) {
             return 0;
         }
+        
+        FolderManifest manifest;
+        if (!scanFolder(folderPath, manifest)) {
+            return 0;
+        }
+        return manifest.totalSize;
     }
 
     // Creates a unique temporary filename for archives
@@ -74,7 +78,370 @@ namespace ArchiveHandler {
         return ss.str();
     }
 
-    // Creates a temporary archive from a folder using tar command
+    // Returns the name used for a folder inside archives, tolerating a trailing separator
+    static std::string folderBaseName(const std::string& folderPath) {
+        fs::path folder(folderPath);
+        std::string name = folder.filename().string();
+        if (name.empty()) {
+            name = folder.parent_path().filename().string();
+        }
+        return name;
+    }
+
+    void applyAttributes(const std::string& path, uint32_t mode, int64_t mtime, int64_t mtimeNanoseconds,
+                         bool isSymlink) {
+        if (!isSymlink) {
+            chmod(path.c_str(), static_cast<mode_t>(mode & 07777));
+        }
+        struct timespec times[2];
+        times[0].tv_sec = static_cast<time_t>(mtime);
+        times[0].tv_nsec = static_cast<long>(mtimeNanoseconds);
+        times[1] = times[0];
+        utimensat(AT_FDCWD, path.c_str(), times, AT_SYMLINK_NOFOLLOW);
+    }
+
+    // Rebuilds the lstat fields the tar writer needs from a manifest entry
+    static struct stat toStat(const ManifestEntry& entry) {
+        struct stat info = {};
+        info.st_mode = static_cast<mode_t>(entry.mode);
+        info.st_size = static_cast<off_t>(entry.size);
+        info.st_mtime = static_cast<time_t>(entry.mtime);
+        info.st_dev = static_cast<dev_t>(entry.device);
+        info.st_ino = static_cast<ino_t>(entry.inode);
+        info.st_nlink = static_cast<nlink_t>(entry.linkCount);
+        return info;
+    }
+
+    // Scans the folder, then writes it into a tar stream
+    bool writeArchiveStream(const std::string& folderPath, std::ostream& output) {
+        FolderManifest manifest;
+        if (!scanFolder(folderPath, manifest)) {
+            return false;
+        }
+        return writeArchiveStream(manifest, output);
+    }
+
+    // Serializes every manifest entry in order, reusing the scanned file information
+    bool writeArchiveStream(const FolderManifest& manifest, std::ostream& output,
+                            const ProgressCallback& progress) {
+        uint64_t estimatedSize = estimateArchiveSize(manifest);
+        TarWriter writer(output);
+        
+        for (const auto& entry : manifest.entries) {
+            std::string sourcePath = entry.path.empty() ? manifest.rootPath : manifest.rootPath + "/" + entry.path;
+            std::string archiveName = entry.path.empty() ? manifest.folderName : manifest.folderName + "/" + entry.path;
+            
+            if (!writer.addPath(sourcePath, archiveName, toStat(entry))) {
+                return false;
+            }
+            if (progress) {
+                progress(std::min(writer.size(), estimatedSize), estimatedSize);
+            }
+        }
+        
+        if (!writer.finish()) {
+            return false;
+        }
+        if (progress) {
+            progress(estimatedSize, estimatedSize);
+        }
+        return true;
+    }
+
+    // Files whose data fits in one block are created and written by a single task
+    static const size_t EXTRACT_BLOCK_SIZE = 1024 * 1024;
+
+    // Blocks queued per worker thread while extracting
+    static const size_t EXTRACT_QUEUE_DEPTH = 4;
+
+    // A file being extracted; the descriptor is closed once its last block is written
+    class ExtractedFile {
+    public:
+        fs::path path;
+        int fd = -1;
+        std::atomic<bool>& failed;
+
+        ExtractedFile(fs::path path, std::atomic<bool>& failed) : path(std::move(path)), failed(failed) {}
+
+        ~ExtractedFile() {
+            if (fd >= 0 && close(fd) != 0) {
+                failed = true;
+            }
+        }
+
+        // Creates or truncates the file for writing, never through a symlink
+        bool open() {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, 0600);
+            return fd >= 0;
+        }
+    };
+
+    // One block of file data for the writer threads; offset is where it goes in the file
+    struct ExtractTask {
+        std::shared_ptr<ExtractedFile> file;
+        uint64_t offset = 0;
+        std::vector<char> data;
+        bool create = false;   // Open the file first (single-block files)
+    };
+
+    // Writes one task's block, creating the file first if the task owns it
+    static bool writeExtractTask(ExtractTask& task) {
+        if (task.create && !task.file->open()) {
+            return false;
+        }
+        Utils::StageTimer timer(Utils::Stage::Extract, task.data.size());
+        for (size_t written = 0; written < task.data.size(); ) {
+            ssize_t count = pwrite(task.file->fd, task.data.data() + written, task.data.size() - written,
+                                   static_cast<off_t>(task.offset + written));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            written += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    // Returns true if an existing component of name below root is a symlink (the last component
+    // only with includeLast), so writing there could leave root
+    static bool passesThroughSymlink(const fs::path& root, const std::string& name, bool includeLast) {
+        std::vector<std::string> components;
+        std::stringstream ss(name);
+        std::string component;
+        while (std::getline(ss, component, '/')) {
+            if (!component.empty() && component != ".") {
+                components.push_back(component);
+            }
+        }
+        fs::path path = root;
+        for (size_t i = 0; i < components.size(); ++i) {
+            if (i + 1 == components.size() && !includeLast) {
+                break;
+            }
+            path /= components[i];
+            struct stat info;
+            if (lstat(path.c_str(), &info) != 0) {
+                return false;  // Nothing deeper exists yet
+            }
+            if (S_ISLNK(info.st_mode)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Extracts every entry of a tar stream below the target folder
+    // Worker 0 parses the stream, creating directories itself and queueing file data for the
+    // other workers: a file of one block is created and written by one task, larger files are
+    // created and preallocated here and their blocks written in parallel. Hard links, file
+    // attributes and then symlinks follow in a final pass once every file is complete, so no entry
+    // is ever written through a symlink from the archive; directory attributes come last, since
+    // creating their contents changes their mtime. Entries below a symlink already in the target
+    // folder are refused
+    bool extractArchiveStream(std::istream& input, const std::string& targetFolderPath, unsigned threadCount) {
+        fs::path targetPath(targetFolderPath);
+        try {
+            fs::create_directories(targetPath);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error extracting archive: " << e.what() << std::endl;
+            return false;
+        }
+        
+        if (threadCount == 0) {
+            threadCount = Utils::getDefaultThreadCount();
+        }
+        Utils::BoundedQueue<ExtractTask> tasks(EXTRACT_QUEUE_DEPTH * threadCount);
+        std::atomic<bool> failed(false);
+        std::mutex errorMutex;
+        std::vector<std::pair<fs::path, TarEntry>> attributes;  // Files
+        std::vector<std::pair<fs::path, TarEntry>> symlinks;
+        std::vector<std::pair<fs::path, TarEntry>> directories;
+        std::vector<std::pair<fs::path, fs::path>> hardlinks;   // (link, existing file)
+        
+        auto reportError = [&](const std::string& message) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            std::cerr << "Error: " << message << std::endl;
+        };
+        
+        auto parse = [&]() {
+            TarReader reader(input);
+            TarEntry entry;
+            fs::path createdParent;
+            auto createParent = [&](const fs::path& destination) {
+                if (destination.parent_path() != createdParent) {
+                    createdParent = destination.parent_path();
+                    fs::create_directories(createdParent);
+                }
+            };
+            
+            while (reader.next(entry)) {
+                if (!isSafeEntryName(entry.name)) {
+                    reportError("Unsafe path in archive: " + entry.name);
+                    return false;
+                }
+                
+                fs::path destination = targetPath / entry.name;
+                if (passesThroughSymlink(targetPath, entry.name, entry.type == TarEntryType::Directory)) {
+                    reportError("Refusing to extract through a symlink: " + entry.name);
+                    return false;
+                }
+                
+                switch (entry.type) {
+                    case TarEntryType::Directory:
+                        fs::create_directories(destination);
+                        directories.emplace_back(destination, entry);
+                        break;
+                        
+                    case TarEntryType::File: {
+                        createParent(destination);
+                        auto file = std::make_shared<ExtractedFile>(destination, failed);
+                        bool single = entry.size <= EXTRACT_BLOCK_SIZE;
+                        if (!single) {
+                            if (!file->open()) {
+                                reportError("Could not create file " + destination.string());
+                                return false;
+                            }
+                            // Reserving the space up front reports a full disk before any data is queued
+#ifdef __linux__
+                            bool reserved = posix_fallocate(file->fd, 0, static_cast<off_t>(entry.size)) == 0;
+#else
+                            bool reserved = ftruncate(file->fd, static_cast<off_t>(entry.size)) == 0;
+#endif
+                            if (!reserved) {
+                                reportError("Could not allocate " + std::to_string(entry.size) +
+                                            " bytes for " + destination.string());
+                                return false;
+                            }
+                        }
+                        uint64_t offset = 0;
+                        do {
+                            ExtractTask task;
+                            task.file = file;
+                            task.offset = offset;
+                            task.create = single;
+                            task.data.resize(static_cast<size_t>(std::min<uint64_t>(EXTRACT_BLOCK_SIZE,
+                                                                                     entry.size - offset)));
+                            for (size_t filled = 0; filled < task.data.size(); ) {
+                                size_t count = reader.read(task.data.data() + filled, task.data.size() - filled);
+                                if (count == 0) {
+                                    reportError("Archive is truncated or corrupted");
+                                    return false;
+                                }
+                                filled += count;
+                            }
+                            offset += task.data.size();
+                            if (!tasks.push(std::move(task))) {
+                                return false;
+                            }
+                        } while (offset < entry.size);
+                        attributes.emplace_back(destination, entry);
+                        break;
+                    }
+                    
+                    case TarEntryType::Symlink:
+                        createParent(destination);
+                        symlinks.emplace_back(destination, entry);
+                        break;
+                        
+                    case TarEntryType::Hardlink:
+                        if (!isSafeEntryName(entry.linkName) || passesThroughSymlink(targetPath, entry.linkName, false)) {
+                            reportError("Unsafe link target in archive: " + entry.linkName);
+                            return false;
+                        }
+                        createParent(destination);
+                        hardlinks.emplace_back(destination, targetPath / entry.linkName);
+                        break;
+                        
+                    case TarEntryType::Other:
+                        std::cerr << "Warning: Skipping unsupported archive entry: " << entry.name << std::endl;
+                        break;
+                }
+            }
+            
+            if (reader.failed()) {
+                reportError("Archive is truncated or corrupted");
+                return false;
+            }
+            return true;
+        };
+        
+        Utils::runParallel(threadCount + 1, [&](unsigned worker) {
+            if (worker == 0) {
+                bool parsed = false;
+                try {
+                    parsed = parse();
+                } catch (const std::exception& e) {
+                    reportError(std::string("Extracting archive: ") + e.what());
+                }
+                if (parsed) {
+                    tasks.close();
+                } else {
+                    failed = true;
+                    tasks.abort();
+                }
+                return;
+            }
+            ExtractTask task;
+            while (tasks.pop(task)) {
+                if (!writeExtractTask(task)) {
+                    reportError("Failed to write file " + task.file->path.string());
+                    failed = true;
+                    tasks.abort();
+                }
+                task.file.reset();
+            }
+        });
+        if (failed) {
+            return false;
+        }
+        
+        // Final pass: links to the completed files and file attributes, then symlinks, which
+        // replace files but never directories, so nothing is reached through them afterwards
+        try {
+            for (const auto& link : hardlinks) {
+                fs::remove(link.first);
+                fs::create_hard_link(link.second, link.first);
+            }
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error extracting archive: " << e.what() << std::endl;
+            return false;
+        }
+        std::atomic<size_t> next(0);
+        Utils::runParallel(static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, attributes.size()))),
+                           [&](unsigned) {
+            for (size_t i = next.fetch_add(1); i < attributes.size(); i = next.fetch_add(1)) {
+                const TarEntry& entry = attributes[i].second;
+                applyAttributes(attributes[i].first, entry.mode, entry.mtime, 0, false);
+            }
+        });
+        try {
+            for (const auto& link : symlinks) {
+                const TarEntry& entry = link.second;
+                if (passesThroughSymlink(targetPath, entry.name, false)) {
+                    reportError("Refusing to extract through a symlink: " + entry.name);
+                    return false;
+                }
+                if (fs::is_directory(fs::symlink_status(link.first))) {
+                    reportError("Refusing to replace directory " + link.first.string() + " with a symlink");
+                    return false;
+                }
+                fs::remove(link.first);
+                fs::create_symlink(entry.linkName, link.first);
+                applyAttributes(link.first, entry.mode, entry.mtime, 0, true);
+            }
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error extracting archive: " << e.what() << std::endl;
+            return false;
+        }
+        for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+            applyAttributes(it->first, it->second.mode, it->second.mtime, 0, false);
+        }
+        return true;
+    }
+
+    // Creates a temporary archive from a folder using the in-process tar writer
     std::string createArchiveFromFolder(const std::string& folderPath) {
         try {
             // Validate folder path
@@ -90,29 +457,26 @@ namespace ArchiveHandler {
             }
 
             // Get folder name for archive naming
-            fs::path folder(folderPath);
-            std::string folderName = folder.filename().string();
+            std::string folderName = folderBaseName(folderPath);
             
             // Generate unique temporary archive name
             std::string archiveName = generateTempArchiveName(folderName);
             std::string tempDir = fs::temp_directory_path().string();
             std::string archivePath = tempDir + "/" + archiveName;
 
-            // Create tar command
-            std::string command = "tar -cf \"" + archivePath + "\" -C \"" + 
-                                folder.parent_path().string() + "\" \"" + folderName + "\"";
-
-            // Execute tar command
-            int result = std::system(command.c_str());
-            
-            if (result != 0) {
-                std::cerr << "Error: Failed to create archive using tar command" << std::endl;
+            // Stream the folder into the archive file
+            std::ofstream archive(archivePath, std::ios::binary);
+            if (!archive.is_open()) {
+                std::cerr << "Error: Could not create archive file " << archivePath << std::endl;
                 return "";
             }
-
-            // Verify archive was created
-            if (!fs::exists(archivePath)) {
-                std::cerr << "Error: Archive file was not created" << std::endl;
+            
+            bool success = writeArchiveStream(folderPath, archive);
+            archive.close();
+            
+            if (!success || archive.fail()) {
+                std::cerr << "Error: Failed to create archive" << std::endl;
+                fs::remove(archivePath);
                 return "";
             }
 
@@ -125,7 +489,7 @@ namespace ArchiveHandler {
         }
     }
 
-    // Extracts an archive back to a folder
+    // Extracts an archive back to a folder using the in-process tar reader
     bool extractArchiveToFolder(const std::string& archivePath, const std::string& targetFolderPath) {
         try {
             // Validate archive file exists
@@ -134,20 +498,14 @@ namespace ArchiveHandler {
                 return false;
             }
 
-            // Create target directory if it doesn't exist
-            fs::path targetPath(targetFolderPath);
-            if (!fs::exists(targetPath)) {
-                fs::create_directories(targetPath);
+            std::ifstream archive(archivePath, std::ios::binary);
+            if (!archive.is_open()) {
+                std::cerr << "Error: Could not open archive " << archivePath << std::endl;
+                return false;
             }
 
-            // Create tar extraction command
-            std::string command = "tar -xf \"" + archivePath + "\" -C \"" + targetFolderPath + "\"";
-
-            // Execute tar command
-            int result = std::system(command.c_str());
-            
-            if (result != 0) {
-                std::cerr << "Error: Failed to extract archive using tar command" << std::endl;
+            if (!extractArchiveStream(archive, targetFolderPath)) {
+                std::cerr << "Error: Failed to extract archive" << std::endl;
                 return false;
             }
 
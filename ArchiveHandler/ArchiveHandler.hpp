@@ -3,9 +3,14 @@
 
 #include <string>
 #include <vector>
+#include <iosfwd>
+#include <functional>
+#include <cstdint>
+#include "FolderScanner.hpp"
 
 // ArchiveHandler namespace - provides folder archiving operations for the encryption tool
 // Creates temporary archives from folders and extracts archives back to folders
+// Archives are tar streams produced and consumed in-process (see Tar.hpp), no external tar needed
 namespace ArchiveHandler {
 
     // Creates a temporary archive from a folder
@@ -18,6 +23,29 @@ namespace ArchiveHandler {
     // Returns true if extraction was successful
     bool extractArchiveToFolder(const std::string& archivePath, const std::string& targetFolderPath);
 
+    // Called with (bytes written, estimated total bytes) as an archive is produced
+    using ProgressCallback = std::function<void(uint64_t, uint64_t)>;
+
+    // Writes a folder as a tar stream, with the folder itself as the top-level entry
+    // Returns true if every entry was archived successfully
+    bool writeArchiveStream(const std::string& folderPath, std::ostream& output);
+
+    // Writes the entries of a scanned folder as a tar stream without walking the tree again
+    // progress, if given, is called after each entry
+    bool writeArchiveStream(const FolderManifest& manifest, std::ostream& output,
+                            const ProgressCallback& progress = nullptr);
+
+    // Extracts a tar stream into the target folder, restoring permissions and modification times
+    // The stream is parsed on the calling thread while threadCount workers (0 = all hardware
+    // threads) create and write the files, so many small files do not wait on each other
+    // Entries that would escape the target folder are rejected
+    bool extractArchiveStream(std::istream& input, const std::string& targetFolderPath, unsigned threadCount = 0);
+
+    // Restores the permission bits of mode and the modification time on an extracted entry,
+    // without following symlinks (a symlink keeps its permissions); failures are ignored
+    void applyAttributes(const std::string& path, uint32_t mode, int64_t mtime, int64_t mtimeNanoseconds,
+                         bool isSymlink);
+
     // Validates that a path is a directory (not a file)
     // Returns true if the path exists and is a directory
     bool isValidFolder(const std::string& folderPath);
@@ -28,6 +56,7 @@ namespace ArchiveHandler {
 
     // Gets the size of a folder (recursive)
     // Returns the total size in bytes of all files in the folder
+    // Prefer scanFolder when the tree is needed for more than one purpose
     size_t getFolderSize(const std::string& folderPath);
 
     // Creates a unique temporary filename for archives
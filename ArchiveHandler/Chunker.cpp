@@ -0,0 +1,53 @@
+#include "Chunker.hpp"
+#include <algorithm>
+#include <array>
+
+namespace ArchiveHandler {
+
+    // Boundary masks test the high bits of the gear hash, which depend on the last 64 bytes
+    // Before the average size a boundary needs two more zero bits than after it, which keeps
+    // chunk sizes close to the average (normalized chunking)
+    static const uint64_t SMALL_CHUNK_MASK = ~0ULL << (64 - 18);
+    static const uint64_t LARGE_CHUNK_MASK = ~0ULL << (64 - 14);
+
+    // Random value per byte value for the gear hash, generated with splitmix64 so the table is
+    // fixed across builds (chunk boundaries must not change between versions)
+    static constexpr std::array<uint64_t, 256> makeGearTable() {
+        std::array<uint64_t, 256> table{};
+        uint64_t seed = 0x46696c6543727970ULL;
+        for (size_t i = 0; i < table.size(); ++i) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t value = seed;
+            value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+            table[i] = value ^ (value >> 31);
+        }
+        return table;
+    }
+
+    static constexpr std::array<uint64_t, 256> GEAR_TABLE = makeGearTable();
+
+    size_t findChunkBoundary(const char* data, size_t length) {
+        if (length <= MIN_CHUNK_SIZE) {
+            return length;
+        }
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        size_t limit = std::min(length, MAX_CHUNK_SIZE);
+        size_t normal = std::min(limit, AVERAGE_CHUNK_SIZE);
+        uint64_t hash = 0;
+        size_t i = MIN_CHUNK_SIZE;
+        for (; i < normal; ++i) {
+            hash = (hash << 1) + GEAR_TABLE[bytes[i]];
+            if ((hash & SMALL_CHUNK_MASK) == 0) {
+                return i + 1;
+            }
+        }
+        for (; i < limit; ++i) {
+            hash = (hash << 1) + GEAR_TABLE[bytes[i]];
+            if ((hash & LARGE_CHUNK_MASK) == 0) {
+                return i + 1;
+            }
+        }
+        return limit;
+    }
+}
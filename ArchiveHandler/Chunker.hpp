@@ -0,0 +1,25 @@
+#ifndef CHUNKER_HPP
+#define CHUNKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Content-defined chunking for deduplicated folder containers
+// Chunk boundaries are chosen by a rolling gear hash of the content itself (FastCDC with
+// normalized chunking), so an insertion only moves the boundaries next to it and identical
+// runs of data in different files, or at different offsets, split into identical chunks
+namespace ArchiveHandler {
+
+    // No boundary is placed before MIN_CHUNK_SIZE bytes or after MAX_CHUNK_SIZE bytes;
+    // chunks are AVERAGE_CHUNK_SIZE bytes long on average
+    const size_t MIN_CHUNK_SIZE = 16 * 1024;
+    const size_t AVERAGE_CHUNK_SIZE = 64 * 1024;
+    const size_t MAX_CHUNK_SIZE = 256 * 1024;
+
+    // Returns the length of the chunk starting at data, at most length bytes
+    // A result equal to length below MAX_CHUNK_SIZE means no boundary was found: at the end of
+    // the content that is the last chunk, otherwise more data is needed to place the boundary
+    size_t findChunkBoundary(const char* data, size_t length);
+}
+
+#endif
@@ -0,0 +1,1105 @@
+#include "FolderContainer.hpp"
+#include "Tar.hpp"
+#include "Chunker.hpp"
+#include "../Encryption/Crypto.hpp"
+#include "../Utils/Utils.hpp"
+#include "../Utils/Instrumentation.hpp"
+#include "../Utils/Serialization.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ArchiveHandler {
+
+    // Magic number at the end of a container trailer ("FCIX")
+    static const uint32_t CONTAINER_TRAILER_MAGIC = 0x58494346;
+
+    // Current version of the container index format, and the version used by deduplicated containers
+    static const uint32_t CONTAINER_INDEX_VERSION = 1;
+    static const uint32_t DEDUP_CONTAINER_INDEX_VERSION = 2;
+
+    // The same formats with the hard link of every regular file recorded
+    static const uint32_t HARDLINK_CONTAINER_INDEX_VERSION = 3;
+    static const uint32_t HARDLINK_DEDUP_CONTAINER_INDEX_VERSION = 4;
+
+    // Version 3 with the extent map of every regular file recorded (never deduplicated)
+    static const uint32_t SPARSE_CONTAINER_INDEX_VERSION = 5;
+
+    // Size of the trailer: [index offset][index size][magic]
+    static const size_t CONTAINER_TRAILER_SIZE = sizeof(uint64_t) * 2 + sizeof(uint32_t);
+
+    // Longest path or symlink target accepted when reading an index
+    static const uint32_t MAX_CONTAINER_PATH_LENGTH = 65536;
+
+    // Largest sealed index accepted when reading a container (1 GiB)
+    static const uint64_t MAX_CONTAINER_INDEX_SIZE = 1ULL << 30;
+
+    // Size of the blocks entries are read and written in (a whole number of segments)
+    static const size_t CONTAINER_BLOCK_SIZE = 8 * Encryption::SEGMENT_SIZE;
+
+    // Smallest total hole size worth storing a file sparse for
+    static const uint64_t MIN_SPARSE_HOLE_BYTES = Encryption::SEGMENT_SIZE;
+
+    bool ContainerEntry::isDirectory() const {
+        return S_ISDIR(mode);
+    }
+
+    bool ContainerEntry::isRegularFile() const {
+        return S_ISREG(mode);
+    }
+
+    bool ContainerEntry::isSymlink() const {
+        return S_ISLNK(mode);
+    }
+
+    uint64_t ContainerEntry::storedSize() const {
+        if (extents.empty()) {
+            return size;
+        }
+        uint64_t total = 0;
+        for (const auto& extent : extents) {
+            total += extent.length;
+        }
+        return total;
+    }
+
+    // Transforms one block of an entry at the given entry offset (a multiple of SEGMENT_SIZE)
+    // Segments are spread over threadCount workers; tags holds the tags of the block's segments
+    static bool transformSegments(const Encryption::CipherEngine& engine, bool encrypt, char* data,
+                                  size_t length, uint64_t offset, char* tags, unsigned threadCount) {
+        size_t segmentCount = (length + Encryption::SEGMENT_SIZE - 1) / Encryption::SEGMENT_SIZE;
+        threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, segmentCount)));
+        std::atomic<size_t> nextSegment(0);
+        std::atomic<bool> failed(false);
+
+        Utils::runParallel(threadCount, [&](unsigned) {
+            while (true) {
+                size_t segment = nextSegment.fetch_add(1);
+                if (segment >= segmentCount) {
+                    break;
+                }
+                size_t start = segment * Encryption::SEGMENT_SIZE;
+                size_t segmentLength = std::min(Encryption::SEGMENT_SIZE, length - start);
+                char* tag = tags + segment * engine.tagSize();
+                Utils::StageTimer timer(Utils::Stage::Cipher, segmentLength);
+                if (encrypt) {
+                    engine.encryptSegment(data + start, data + start, segmentLength, offset + start, tag);
+                } else if (!engine.decryptSegment(data + start, data + start, segmentLength, offset + start, tag)) {
+                    failed = true;
+                }
+            }
+        });
+        return !failed;
+    }
+
+    // Runs work(i) for every i below count, spread over threadCount workers
+    static void forEachParallel(size_t count, unsigned threadCount, const std::function<void(size_t)>& work) {
+        threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, count)));
+        std::atomic<size_t> next(0);
+        Utils::runParallel(threadCount, [&](unsigned) {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                work(i);
+            }
+        });
+    }
+
+    // Returns the engine for one entry, or for the chunks of a deduplicated container: the container
+    // header's key derivation with that nonce
+    static std::unique_ptr<Encryption::CipherEngine> entryEngine(
+        Encryption::Encryptor& encryptor, const Encryption::FileHeader& header,
+        const std::array<uint8_t, Encryption::NONCE_SIZE>& nonce) {
+        Encryption::FileHeader entryHeader = header;
+        entryHeader.nonce = nonce;
+        return encryptor.createEngine(entryHeader);
+    }
+
+    // Chunks share one key; each is a single segment at its own offset, so every chunk has its own IV
+    static uint64_t chunkSegmentOffset(uint32_t chunkId) {
+        return static_cast<uint64_t>(chunkId) * Encryption::SEGMENT_SIZE;
+    }
+
+    // Entry format: [path][mode][size][mtime][mtime_ns], then [offset][nonce] for regular files
+    // ([chunk count][chunk ids] when deduplicated) or [link target] for symlinks
+    // Regular files continue with [extent count][[offset][length]...] in version 5,
+    // then [hard link path] in versions 3 to 5
+    // Chunk format: [offset][size][SHA-256]
+    std::vector<char> serializeContainerIndex(const ContainerIndex& index) {
+        bool sparse = !index.deduplicated &&
+                      std::any_of(index.entries.begin(), index.entries.end(),
+                                  [](const ContainerEntry& entry) { return !entry.extents.empty(); });
+        bool hardLinks = sparse ||
+                         std::any_of(index.entries.begin(), index.entries.end(),
+                                     [](const ContainerEntry& entry) { return !entry.hardLinkPath.empty(); });
+        uint32_t version = index.deduplicated ? DEDUP_CONTAINER_INDEX_VERSION : CONTAINER_INDEX_VERSION;
+        if (sparse) {
+            version = SPARSE_CONTAINER_INDEX_VERSION;
+        } else if (hardLinks) {
+            version = index.deduplicated ? HARDLINK_DEDUP_CONTAINER_INDEX_VERSION : HARDLINK_CONTAINER_INDEX_VERSION;
+        }
+
+        std::vector<char> result;
+        Utils::appendValue(result, version);
+        Utils::appendString(result, index.folderName);
+        if (index.deduplicated) {
+            result.insert(result.end(), index.chunkNonce.begin(), index.chunkNonce.end());
+            Utils::appendValue(result, static_cast<uint64_t>(index.chunks.size()));
+            for (const auto& chunk : index.chunks) {
+                Utils::appendValue(result, chunk.offset);
+                Utils::appendValue(result, chunk.size);
+                result.insert(result.end(), chunk.hash.begin(), chunk.hash.end());
+            }
+        }
+
+        Utils::appendValue(result, static_cast<uint64_t>(index.entries.size()));
+        for (const auto& entry : index.entries) {
+            Utils::appendString(result, entry.path);
+            Utils::appendValue(result, entry.mode);
+            Utils::appendValue(result, entry.size);
+            Utils::appendValue(result, entry.mtime);
+            Utils::appendValue(result, entry.mtimeNanoseconds);
+            if (entry.isRegularFile() && index.deduplicated) {
+                Utils::appendValue(result, static_cast<uint64_t>(entry.chunks.size()));
+                for (uint32_t chunk : entry.chunks) {
+                    Utils::appendValue(result, chunk);
+                }
+            } else if (entry.isRegularFile()) {
+                Utils::appendValue(result, entry.offset);
+                result.insert(result.end(), entry.nonce.begin(), entry.nonce.end());
+            } else if (entry.isSymlink()) {
+                Utils::appendString(result, entry.linkTarget);
+            }
+            if (entry.isRegularFile() && sparse) {
+                Utils::appendValue(result, static_cast<uint64_t>(entry.extents.size()));
+                for (const auto& extent : entry.extents) {
+                    Utils::appendValue(result, extent.offset);
+                    Utils::appendValue(result, extent.length);
+                }
+            }
+            if (entry.isRegularFile() && hardLinks) {
+                Utils::appendString(result, entry.hardLinkPath);
+            }
+        }
+        return result;
+    }
+
+    ContainerIndex deserializeContainerIndex(const std::vector<char>& data) {
+        Utils::ByteReader reader(data, "container index");
+        uint32_t version = reader.value<uint32_t>();
+        if (version < CONTAINER_INDEX_VERSION || version > SPARSE_CONTAINER_INDEX_VERSION) {
+            throw std::runtime_error("Unsupported container index version " + std::to_string(version));
+        }
+        bool sparse = version == SPARSE_CONTAINER_INDEX_VERSION;
+        bool hardLinks = version == HARDLINK_CONTAINER_INDEX_VERSION ||
+                         version == HARDLINK_DEDUP_CONTAINER_INDEX_VERSION || sparse;
+
+        ContainerIndex index;
+        index.deduplicated = version == DEDUP_CONTAINER_INDEX_VERSION ||
+                             version == HARDLINK_DEDUP_CONTAINER_INDEX_VERSION;
+        index.folderName = reader.string(MAX_CONTAINER_PATH_LENGTH);
+        if (index.folderName.empty() || index.folderName.find('/') != std::string::npos ||
+            index.folderName == "." || index.folderName == "..") {
+            throw std::runtime_error("Invalid folder name in container index");
+        }
+        if (index.deduplicated) {
+            reader.read(index.chunkNonce.data(), index.chunkNonce.size());
+            uint64_t chunkCount = reader.value<uint64_t>();
+            if (chunkCount > reader.remaining() || chunkCount > UINT32_MAX) {
+                throw std::runtime_error("Invalid chunk count in container index");
+            }
+            index.chunks.resize(static_cast<size_t>(chunkCount));
+            for (auto& chunk : index.chunks) {
+                chunk.offset = reader.value<uint64_t>();
+                chunk.size = reader.value<uint32_t>();
+                reader.read(chunk.hash.data(), chunk.hash.size());
+                if (chunk.size == 0 || chunk.size > MAX_CHUNK_SIZE) {
+                    throw std::runtime_error("Invalid chunk size in container index");
+                }
+            }
+        }
+        uint64_t entryCount = reader.value<uint64_t>();
+        if (entryCount > reader.remaining()) {
+            throw std::runtime_error("Invalid entry count in container index");
+        }
+        index.entries.reserve(static_cast<size_t>(entryCount));
+        std::map<std::string, size_t> linkableFiles; // Path -> entry, for files that are not links themselves
+        for (uint64_t i = 0; i < entryCount; ++i) {
+            ContainerEntry entry;
+            entry.path = reader.string(MAX_CONTAINER_PATH_LENGTH);
+            entry.mode = reader.value<uint32_t>();
+            entry.size = reader.value<uint64_t>();
+            entry.mtime = reader.value<int64_t>();
+            entry.mtimeNanoseconds = reader.value<int64_t>();
+            if (entry.isRegularFile() && index.deduplicated) {
+                uint64_t chunkCount = reader.value<uint64_t>();
+                if (chunkCount > reader.remaining()) {
+                    throw std::runtime_error("Invalid chunk list in container index");
+                }
+                entry.chunks.resize(static_cast<size_t>(chunkCount));
+                uint64_t size = 0;
+                for (uint32_t& chunk : entry.chunks) {
+                    chunk = reader.value<uint32_t>();
+                    if (chunk >= index.chunks.size()) {
+                        throw std::runtime_error("Invalid chunk reference in container index");
+                    }
+                    size += index.chunks[chunk].size;
+                }
+                if (size != entry.size) {
+                    throw std::runtime_error("Chunk sizes do not match the file size in container index: " +
+                                             entry.path);
+                }
+            } else if (entry.isRegularFile()) {
+                entry.offset = reader.value<uint64_t>();
+                reader.read(entry.nonce.data(), entry.nonce.size());
+            } else if (entry.isSymlink()) {
+                entry.linkTarget = reader.string(MAX_CONTAINER_PATH_LENGTH);
+            } else if (!entry.isDirectory()) {
+                throw std::runtime_error("Unsupported entry type in container index");
+            }
+            // Extents are in order, do not overlap and lie inside the file
+            if (entry.isRegularFile() && sparse) {
+                uint64_t extentCount = reader.value<uint64_t>();
+                if (extentCount > reader.remaining()) {
+                    throw std::runtime_error("Invalid extent map in container index: " + entry.path);
+                }
+                entry.extents.resize(static_cast<size_t>(extentCount));
+                uint64_t end = 0;
+                for (auto& extent : entry.extents) {
+                    extent.offset = reader.value<uint64_t>();
+                    extent.length = reader.value<uint64_t>();
+                    if (extent.length == 0 || extent.offset < end || extent.offset > entry.size ||
+                        extent.length > entry.size - extent.offset) {
+                        throw std::runtime_error("Invalid extent map in container index: " + entry.path);
+                    }
+                    end = extent.offset + extent.length;
+                }
+            }
+            if (entry.path.empty() ? !entry.isDirectory() : !isSafeEntryName(entry.path)) {
+                throw std::runtime_error("Unsafe path in container index: " + entry.path);
+            }
+            // A link names an earlier file of the same size, so links never chain or loop
+            if (entry.isRegularFile() && hardLinks) {
+                entry.hardLinkPath = reader.string(MAX_CONTAINER_PATH_LENGTH);
+                if (entry.hardLinkPath.empty()) {
+                    linkableFiles[entry.path] = index.entries.size();
+                } else {
+                    auto first = linkableFiles.find(entry.hardLinkPath);
+                    if (first == linkableFiles.end() || index.entries[first->second].size != entry.size) {
+                        throw std::runtime_error("Invalid hard link in container index: " + entry.path);
+                    }
+                }
+            }
+            index.entries.push_back(std::move(entry));
+        }
+
+        if (!reader.atEnd()) {
+            throw std::runtime_error("Unexpected data after container index");
+        }
+        return index;
+    }
+
+    // Reads the serialized file header at the start of a container
+    // Throws std::runtime_error if the file is not a versioned encrypted file
+    static std::vector<char> readHeaderBytes(std::istream& input) {
+        std::vector<char> header(Encryption::FILE_HEADER_SIZE);
+        input.read(header.data(), header.size());
+        if (!input) {
+            throw std::runtime_error("Not an encrypted folder container");
+        }
+        uint16_t flags;
+        std::memcpy(&flags, header.data() + 6, sizeof(flags));
+        header.resize(Encryption::serializedHeaderSize(flags));
+        input.read(header.data() + Encryption::FILE_HEADER_SIZE, header.size() - Encryption::FILE_HEADER_SIZE);
+        if (!input) {
+            throw std::runtime_error("Truncated container header");
+        }
+        return header;
+    }
+
+    bool isFolderContainer(const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input.is_open()) {
+            return false;
+        }
+        try {
+            Encryption::FileHeader header = Encryption::deserializeHeader(readHeaderBytes(input));
+            return (header.flags & Encryption::HEADER_FLAG_CONTAINER) != 0;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Validates the header and password, then locates the index through the trailer and opens it
+    // Every entry's data range is checked against the area before the index
+    static ContainerIndex openContainer(std::istream& input, uint64_t fileSize, Encryption::Encryptor& encryptor,
+                                        Encryption::FileHeader& header) {
+        Utils::StageTimer timer(Utils::Stage::Metadata);
+        std::vector<char> headerBytes = readHeaderBytes(input);
+        header = Encryption::deserializeHeader(headerBytes);
+        if (!(header.flags & Encryption::HEADER_FLAG_CONTAINER)) {
+            throw std::runtime_error("Not an encrypted folder container");
+        }
+        if (!encryptor.verifyPassword(header)) {
+            throw std::runtime_error("Invalid password");
+        }
+        std::unique_ptr<Encryption::CipherEngine> engine = encryptor.createEngine(header);
+        if (!engine) {
+            throw std::runtime_error("Invalid password or corrupted container header");
+        }
+
+        // Trailer: [index offset][index size][magic]
+        if (fileSize < headerBytes.size() + CONTAINER_TRAILER_SIZE) {
+            throw std::runtime_error("Truncated container");
+        }
+        char trailer[CONTAINER_TRAILER_SIZE];
+        input.seekg(static_cast<std::streamoff>(fileSize - CONTAINER_TRAILER_SIZE));
+        input.read(trailer, sizeof(trailer));
+        uint64_t indexOffset;
+        uint64_t indexSize;
+        uint32_t magic;
+        std::memcpy(&indexOffset, trailer, sizeof(indexOffset));
+        std::memcpy(&indexSize, trailer + sizeof(uint64_t), sizeof(indexSize));
+        std::memcpy(&magic, trailer + sizeof(uint64_t) * 2, sizeof(magic));
+        uint64_t indexArea = fileSize - CONTAINER_TRAILER_SIZE;
+        if (!input || magic != CONTAINER_TRAILER_MAGIC || indexOffset < headerBytes.size() ||
+            indexOffset > indexArea || indexSize != indexArea - indexOffset ||
+            indexSize < engine->tagSize() || indexSize > MAX_CONTAINER_INDEX_SIZE) {
+            throw std::runtime_error("Invalid container trailer");
+        }
+
+        std::vector<char> sealed(static_cast<size_t>(indexSize));
+        input.seekg(static_cast<std::streamoff>(indexOffset));
+        input.read(sealed.data(), sealed.size());
+        if (!input) {
+            throw std::runtime_error("Truncated container index");
+        }
+        size_t plainSize = sealed.size() - engine->tagSize();
+        std::vector<char> plain(plainSize);
+        std::vector<char> aad = Encryption::authenticatedHeader(headerBytes);
+        if (!engine->openMessage(plain.data(), sealed.data(), plainSize, aad.data(), aad.size(),
+                                 sealed.data() + plainSize)) {
+            throw std::runtime_error("Invalid password or corrupted container index");
+        }
+        timer.addBytes(sealed.size());
+
+        ContainerIndex index = deserializeContainerIndex(plain);
+        for (const auto& chunk : index.chunks) {
+            if (chunk.offset < headerBytes.size() || chunk.offset > indexOffset ||
+                chunk.size + engine->tagSize() > indexOffset - chunk.offset) {
+                throw std::runtime_error("Invalid chunk range in container index");
+            }
+        }
+        for (const auto& entry : index.entries) {
+            uint64_t storedSize = entry.storedSize();
+            if (entry.isRegularFile() && !index.deduplicated &&
+                (entry.offset < headerBytes.size() || entry.offset > indexOffset ||
+                 storedSize > indexOffset - entry.offset ||
+                 engine->tagBytes(storedSize) > indexOffset - entry.offset - storedSize)) {
+                throw std::runtime_error("Invalid data range in container index: " + entry.path);
+            }
+        }
+        return index;
+    }
+
+    ContainerIndex readContainerIndex(const std::string& containerPath, Encryption::Encryptor& encryptor) {
+        std::ifstream input(containerPath, std::ios::binary);
+        if (!input.is_open()) {
+            throw std::runtime_error("Could not open " + containerPath);
+        }
+        std::error_code error;
+        uint64_t fileSize = fs::file_size(containerPath, error);
+        if (error) {
+            throw std::runtime_error("Could not read " + containerPath);
+        }
+        Encryption::FileHeader header;
+        return openContainer(input, fileSize, encryptor, header);
+    }
+
+    // Records the data extents of a file with enough holes to be worth storing sparse
+    // A file that is one big hole keeps its last byte, so a sparse entry always stores some data
+    static void findSparseExtents(const std::string& sourcePath, ContainerEntry& entry) {
+        std::vector<FileHandler::DataExtent> extents;
+        if (entry.size <= MIN_SPARSE_HOLE_BYTES || !FileHandler::findDataExtents(sourcePath, entry.size, extents)) {
+            return;
+        }
+        uint64_t dataBytes = 0;
+        for (const auto& extent : extents) {
+            dataBytes += extent.length;
+        }
+        if (entry.size - dataBytes < MIN_SPARSE_HOLE_BYTES) {
+            return;
+        }
+        if (extents.empty()) {
+            extents.push_back({entry.size - 1, 1});
+        }
+        entry.extents = std::move(extents);
+    }
+
+    // Encrypts one file's stored content followed by its tags; done is advanced as blocks are written
+    // The data extents of a sparse file are read one after another into the block buffer, so
+    // the holes are never read
+    static bool writeEntryData(const std::string& sourcePath, const ContainerEntry& entry,
+                               const Encryption::CipherEngine& engine, std::ostream& output,
+                               std::vector<char>& buffer, unsigned threadCount,
+                               uint64_t& done, uint64_t total, const ProgressCallback& progress) {
+        std::ifstream file(sourcePath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open file " << sourcePath << std::endl;
+            return false;
+        }
+
+        std::vector<FileHandler::DataExtent> extents = entry.extents;
+        if (extents.empty() && entry.size > 0) {
+            extents.push_back({0, entry.size});
+        }
+        uint64_t storedSize = entry.storedSize();
+        std::vector<char> tags(static_cast<size_t>(engine.tagBytes(storedSize)));
+        uint64_t position = 0;
+        size_t filled = 0;
+        auto flush = [&]() {
+            transformSegments(engine, true, buffer.data(), filled, position,
+                              tags.data() + position / Encryption::SEGMENT_SIZE * engine.tagSize(), threadCount);
+            {
+                Utils::StageTimer timer(Utils::Stage::Write, filled);
+                output.write(buffer.data(), filled);
+            }
+            position += filled;
+            done += filled;
+            filled = 0;
+            if (progress) {
+                progress(done, total);
+            }
+        };
+
+        for (const auto& extent : extents) {
+            file.seekg(static_cast<std::streamoff>(extent.offset));
+            for (uint64_t extentDone = 0; extentDone < extent.length; ) {
+                size_t length = static_cast<size_t>(std::min<uint64_t>(buffer.size() - filled,
+                                                                       extent.length - extentDone));
+                {
+                    Utils::StageTimer timer(Utils::Stage::Read, length);
+                    file.read(buffer.data() + filled, length);
+                }
+                if (file.gcount() != static_cast<std::streamsize>(length)) {
+                    std::cerr << "Error: File changed while being encrypted: " << sourcePath << std::endl;
+                    return false;
+                }
+                filled += length;
+                extentDone += length;
+                if (filled == buffer.size()) {
+                    flush();
+                }
+            }
+        }
+        if (filled > 0) {
+            flush();
+        }
+        done += entry.size - storedSize;
+        output.write(tags.data(), tags.size());
+        return !output.fail();
+    }
+
+    // Unique chunks of a deduplicated container as they are written
+    struct ChunkStore {
+        const Encryption::CipherEngine& engine;
+        std::vector<ContainerChunk>& chunks;
+        std::map<Encryption::Sha256Digest, uint32_t> chunkIds; // Plaintext hash -> chunk id
+        uint64_t& position;                                    // Where the next chunk is written
+    };
+
+    // Splits one file into content-defined chunks and writes the chunks not stored yet
+    // Each block is chunked, then the chunks are hashed in parallel, looked up in order and the
+    // new ones encrypted in parallel and written; a block's unfinished last chunk moves to the
+    // front of the buffer for the next block
+    static bool writeChunkedEntryData(const std::string& sourcePath, ContainerEntry& entry, ChunkStore& store,
+                                      std::ostream& output, std::vector<char>& buffer, unsigned threadCount,
+                                      uint64_t& done, uint64_t total, const ProgressCallback& progress) {
+        std::ifstream file(sourcePath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open file " << sourcePath << std::endl;
+            return false;
+        }
+
+        size_t tagSize = store.engine.tagSize();
+        std::vector<std::pair<size_t, size_t>> spans;   // (buffer offset, length) of each complete chunk
+        std::vector<Encryption::Sha256Digest> hashes;
+        std::vector<std::pair<size_t, uint32_t>> added; // (span, chunk id) of chunks not stored before
+        std::vector<char> tags;
+        uint64_t unread = entry.size;
+        size_t filled = 0;
+        while (unread > 0 || filled > 0) {
+            size_t readSize = static_cast<size_t>(std::min<uint64_t>(buffer.size() - filled, unread));
+            {
+                Utils::StageTimer timer(Utils::Stage::Read, readSize);
+                file.read(buffer.data() + filled, readSize);
+            }
+            if (file.gcount() != static_cast<std::streamsize>(readSize)) {
+                std::cerr << "Error: File changed while being encrypted: " << sourcePath << std::endl;
+                return false;
+            }
+            filled += readSize;
+            unread -= readSize;
+
+            spans.clear();
+            size_t consumed = 0;
+            {
+                Utils::StageTimer timer(Utils::Stage::Chunk, filled);
+                while (consumed < filled) {
+                    size_t length = findChunkBoundary(buffer.data() + consumed, filled - consumed);
+                    if (consumed + length == filled && unread > 0 && length < MAX_CHUNK_SIZE) {
+                        break;
+                    }
+                    spans.emplace_back(consumed, length);
+                    consumed += length;
+                }
+            }
+
+            hashes.resize(spans.size());
+            forEachParallel(spans.size(), threadCount, [&](size_t i) {
+                Utils::StageTimer timer(Utils::Stage::Hash, spans[i].second);
+                hashes[i] = Encryption::Sha256::hash(buffer.data() + spans[i].first, spans[i].second);
+            });
+
+            added.clear();
+            for (size_t i = 0; i < spans.size(); ++i) {
+                auto inserted = store.chunkIds.emplace(hashes[i], static_cast<uint32_t>(store.chunks.size()));
+                if (inserted.second) {
+                    if (store.chunks.size() == UINT32_MAX) {
+                        std::cerr << "Error: Too many chunks for one container" << std::endl;
+                        return false;
+                    }
+                    ContainerChunk chunk;
+                    chunk.offset = store.position;
+                    chunk.size = static_cast<uint32_t>(spans[i].second);
+                    chunk.hash = hashes[i];
+                    store.chunks.push_back(chunk);
+                    store.position += chunk.size + tagSize;
+                    added.emplace_back(i, inserted.first->second);
+                }
+                entry.chunks.push_back(inserted.first->second);
+            }
+
+            tags.resize(added.size() * tagSize);
+            forEachParallel(added.size(), threadCount, [&](size_t i) {
+                char* data = buffer.data() + spans[added[i].first].first;
+                size_t length = spans[added[i].first].second;
+                Utils::StageTimer timer(Utils::Stage::Cipher, length);
+                store.engine.encryptSegment(data, data, length, chunkSegmentOffset(added[i].second),
+                                            tags.data() + i * tagSize);
+            });
+            for (size_t i = 0; i < added.size(); ++i) {
+                const auto& span = spans[added[i].first];
+                Utils::StageTimer timer(Utils::Stage::Write, span.second);
+                output.write(buffer.data() + span.first, span.second);
+                output.write(tags.data() + i * tagSize, tagSize);
+            }
+
+            std::memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+            filled -= consumed;
+            done += consumed;
+            if (progress) {
+                progress(done, total);
+            }
+        }
+        return !output.fail();
+    }
+
+    // Entries are written in manifest order; the index is sealed with the container header's key
+    // Deduplicated containers write chunks in the order they are first seen, all under one chunk key
+    static bool writeContainerContent(const FolderManifest& manifest, std::ostream& output,
+                                      Encryption::Encryptor& encryptor, const ProgressCallback& progress,
+                                      bool deduplicate, ContainerStats& stats) {
+        std::vector<char> headerBytes;
+        std::unique_ptr<Encryption::CipherEngine> indexEngine =
+            encryptor.createEncryptionEngine(headerBytes, Encryption::HEADER_FLAG_CONTAINER);
+        Encryption::FileHeader header = Encryption::deserializeHeader(headerBytes);
+        output.write(headerBytes.data(), headerBytes.size());
+
+        ContainerIndex index;
+        index.folderName = manifest.folderName;
+        index.entries.reserve(manifest.entries.size());
+        std::map<std::pair<uint64_t, uint64_t>, size_t> hardLinks; // (device, inode) -> first entry
+        std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(CONTAINER_BLOCK_SIZE,
+                                                                        std::max<uint64_t>(manifest.totalSize, 1))));
+        uint64_t position = headerBytes.size();
+        uint64_t done = 0;
+
+        index.deduplicated = deduplicate;
+        std::unique_ptr<Encryption::CipherEngine> chunkEngine;
+        std::unique_ptr<ChunkStore> chunkStore;
+        if (deduplicate) {
+            Encryption::secureRandom(index.chunkNonce.data(), index.chunkNonce.size());
+            chunkEngine = entryEngine(encryptor, header, index.chunkNonce);
+            chunkStore.reset(new ChunkStore{*chunkEngine, index.chunks, {}, position});
+        }
+
+        for (const auto& scanned : manifest.entries) {
+            std::string sourcePath = scanned.path.empty() ? manifest.rootPath : manifest.rootPath + "/" + scanned.path;
+            ContainerEntry entry;
+            entry.path = scanned.path;
+            entry.mode = scanned.mode;
+            entry.mtime = scanned.mtime;
+            entry.mtimeNanoseconds = scanned.mtimeNanoseconds;
+
+            if (scanned.isRegularFile()) {
+                entry.size = scanned.size;
+                auto link = hardLinks.end();
+                if (scanned.linkCount > 1) {
+                    link = hardLinks.find(std::make_pair(scanned.device, scanned.inode));
+                }
+                if (link != hardLinks.end()) {
+                    const ContainerEntry& first = index.entries[link->second];
+                    entry.hardLinkPath = first.path;
+                    entry.size = first.size;
+                    entry.offset = first.offset;
+                    entry.nonce = first.nonce;
+                    entry.chunks = first.chunks;
+                    entry.extents = first.extents;
+                } else if (deduplicate) {
+                    if (!writeChunkedEntryData(sourcePath, entry, *chunkStore, output, buffer,
+                                               encryptor.getThreadCount(), done, manifest.totalSize, progress)) {
+                        return false;
+                    }
+                    stats.contentBytes += entry.size;
+                    if (scanned.linkCount > 1) {
+                        hardLinks[std::make_pair(scanned.device, scanned.inode)] = index.entries.size();
+                    }
+                } else {
+                    entry.offset = position;
+                    findSparseExtents(sourcePath, entry);
+                    Encryption::secureRandom(entry.nonce.data(), entry.nonce.size());
+                    std::unique_ptr<Encryption::CipherEngine> engine = entryEngine(encryptor, header, entry.nonce);
+                    if (!writeEntryData(sourcePath, entry, *engine, output, buffer, encryptor.getThreadCount(),
+                                        done, manifest.totalSize, progress)) {
+                        return false;
+                    }
+                    uint64_t storedSize = entry.storedSize();
+                    position += storedSize + engine->tagBytes(storedSize);
+                    stats.contentBytes += entry.size;
+                    stats.storedBytes += storedSize;
+                    if (scanned.linkCount > 1) {
+                        hardLinks[std::make_pair(scanned.device, scanned.inode)] = index.entries.size();
+                    }
+                }
+            } else if (S_ISLNK(scanned.mode)) {
+                std::error_code error;
+                entry.linkTarget = fs::read_symlink(sourcePath, error).string();
+                if (error) {
+                    std::cerr << "Error: Cannot read symlink " << sourcePath << std::endl;
+                    return false;
+                }
+            } else if (!scanned.isDirectory()) {
+                std::cerr << "Warning: Skipping unsupported file type: " << sourcePath << std::endl;
+                continue;
+            }
+            index.entries.push_back(std::move(entry));
+        }
+
+        if (deduplicate) {
+            stats.storedBytes = 0;
+            for (const auto& chunk : index.chunks) {
+                stats.storedBytes += chunk.size;
+            }
+            stats.uniqueChunks = index.chunks.size();
+            for (const auto& entry : index.entries) {
+                stats.chunkCount += entry.chunks.size();
+            }
+        }
+
+        // [sealed index][tag][trailer]
+        std::vector<char> sealed;
+        {
+            Utils::StageTimer timer(Utils::Stage::Metadata);
+            std::vector<char> plain = serializeContainerIndex(index);
+            sealed.resize(plain.size() + indexEngine->tagSize());
+            std::vector<char> aad = Encryption::authenticatedHeader(headerBytes);
+            indexEngine->sealMessage(sealed.data(), plain.data(), plain.size(), aad.data(), aad.size(),
+                                     sealed.data() + plain.size());
+            timer.addBytes(sealed.size());
+        }
+        std::vector<char> trailer;
+        Utils::appendValue(trailer, position);
+        Utils::appendValue(trailer, static_cast<uint64_t>(sealed.size()));
+        Utils::appendValue(trailer, CONTAINER_TRAILER_MAGIC);
+        output.write(sealed.data(), sealed.size());
+        output.write(trailer.data(), trailer.size());
+        if (progress) {
+            progress(manifest.totalSize, manifest.totalSize);
+        }
+        return !output.fail();
+    }
+
+    bool writeFolderContainer(const FolderManifest& manifest, const std::string& outputPath,
+                              Encryption::Encryptor& encryptor, const ProgressCallback& progress,
+                              bool deduplicate, ContainerStats* stats) {
+        if (encryptor.getEngine() == Encryption::EngineType::LegacyXor) {
+            std::cerr << "Error: Folder containers require the aes-256-gcm cipher" << std::endl;
+            return false;
+        }
+
+        std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+        if (!output.is_open()) {
+            std::cerr << "Error: Could not create file " << outputPath << std::endl;
+            return false;
+        }
+
+        bool success = false;
+        ContainerStats written;
+        try {
+            success = writeContainerContent(manifest, output, encryptor, progress, deduplicate, written);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        output.close();
+        if (!success || output.fail()) {
+            std::cerr << "Error: Failed to write container " << outputPath << std::endl;
+            std::error_code error;
+            fs::remove(outputPath, error);
+            return false;
+        }
+        if (stats) {
+            *stats = written;
+        }
+        return true;
+    }
+
+    // Tries the pattern against the path and each of its parent directories
+    bool matchesContainerPattern(const std::string& path, const std::string& pattern) {
+        if (path.empty()) {
+            return false;
+        }
+        for (size_t end = path.find('/'); ; end = path.find('/', end + 1)) {
+            std::string prefix = path.substr(0, end);
+            if (fnmatch(pattern.c_str(), prefix.c_str(), 0) == 0) {
+                return true;
+            }
+            if (end == std::string::npos) {
+                return false;
+            }
+        }
+    }
+
+    // Decrypts one entry's data into destination, reading its tags first and then its content
+    // The file is sized first and each block is scattered over the extents it covers with
+    // positioned writes, so the holes of a sparse file stay unallocated
+    static bool extractEntryData(std::istream& input, const Encryption::CipherEngine& engine,
+                                 const ContainerEntry& entry, const fs::path& destination,
+                                 std::vector<char>& buffer, unsigned threadCount) {
+        uint64_t storedSize = entry.storedSize();
+        std::vector<char> tags(static_cast<size_t>(engine.tagBytes(storedSize)));
+        {
+            Utils::StageTimer timer(Utils::Stage::Read, tags.size());
+            input.seekg(static_cast<std::streamoff>(entry.offset + storedSize));
+            input.read(tags.data(), tags.size());
+            input.seekg(static_cast<std::streamoff>(entry.offset));
+        }
+        if (!input) {
+            std::cerr << "Error: Truncated container entry " << entry.path << std::endl;
+            return false;
+        }
+
+        int fd = ::open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            std::cerr << "Error: Could not create file " << destination.string() << std::endl;
+            return false;
+        }
+        bool success = ::ftruncate(fd, static_cast<off_t>(entry.size)) == 0;
+        if (!success) {
+            std::cerr << "Error: Failed to write file " << destination.string() << std::endl;
+        }
+
+        std::vector<FileHandler::DataExtent> extents = entry.extents;
+        if (extents.empty() && entry.size > 0) {
+            extents.push_back({0, entry.size});
+        }
+        size_t extent = 0;
+        uint64_t extentDone = 0;
+        for (uint64_t position = 0; success && position < storedSize; ) {
+            size_t blockSize = static_cast<size_t>(std::min<uint64_t>(buffer.size(), storedSize - position));
+            {
+                Utils::StageTimer timer(Utils::Stage::Read, blockSize);
+                input.read(buffer.data(), blockSize);
+            }
+            if (input.gcount() != static_cast<std::streamsize>(blockSize)) {
+                std::cerr << "Error: Truncated container entry " << entry.path << std::endl;
+                success = false;
+                break;
+            }
+            if (!transformSegments(engine, false, buffer.data(), blockSize, position,
+                                   tags.data() + position / Encryption::SEGMENT_SIZE * engine.tagSize(), threadCount)) {
+                std::cerr << "Error: Invalid password or corrupted container - authentication failed for "
+                          << entry.path << std::endl;
+                success = false;
+                break;
+            }
+
+            Utils::StageTimer timer(Utils::Stage::Write, blockSize);
+            for (size_t used = 0; used < blockSize; ) {
+                const FileHandler::DataExtent& current = extents[extent];
+                size_t length = static_cast<size_t>(std::min<uint64_t>(blockSize - used, current.length - extentDone));
+                if (!FileHandler::writeAt(fd, buffer.data() + used, length, current.offset + extentDone)) {
+                    std::cerr << "Error: Failed to write file " << destination.string() << std::endl;
+                    success = false;
+                    break;
+                }
+                used += length;
+                extentDone += length;
+                if (extentDone == current.length) {
+                    ++extent;
+                    extentDone = 0;
+                }
+            }
+            position += blockSize;
+        }
+
+        if (::close(fd) != 0 && success) {
+            std::cerr << "Error: Failed to write file " << destination.string() << std::endl;
+            success = false;
+        }
+        return success;
+    }
+
+    // Decrypts a deduplicated entry chunk by chunk into destination
+    // Chunks are read in batches filling the buffer, and each batch is decrypted in parallel
+    static bool extractChunkedEntryData(std::istream& input, const Encryption::CipherEngine& engine,
+                                        const ContainerIndex& index, const ContainerEntry& entry,
+                                        const fs::path& destination, std::vector<char>& buffer,
+                                        unsigned threadCount) {
+        std::ofstream file(destination, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not create file " << destination.string() << std::endl;
+            return false;
+        }
+
+        size_t tagSize = engine.tagSize();
+        std::vector<char> tags;
+        std::vector<size_t> starts; // Where each chunk of the batch is in the buffer
+        for (size_t first = 0; first < entry.chunks.size(); ) {
+            size_t last = first;
+            size_t batchSize = 0;
+            while (last < entry.chunks.size() && batchSize + index.chunks[entry.chunks[last]].size <= buffer.size()) {
+                batchSize += index.chunks[entry.chunks[last]].size;
+                ++last;
+            }
+
+            tags.resize((last - first) * tagSize);
+            starts.resize(last - first);
+            size_t position = 0;
+            for (size_t i = first; i < last; ++i) {
+                const ContainerChunk& chunk = index.chunks[entry.chunks[i]];
+                starts[i - first] = position;
+                Utils::StageTimer timer(Utils::Stage::Read, chunk.size + tagSize);
+                input.seekg(static_cast<std::streamoff>(chunk.offset));
+                input.read(buffer.data() + position, chunk.size);
+                input.read(tags.data() + (i - first) * tagSize, tagSize);
+                position += chunk.size;
+            }
+            if (!input) {
+                std::cerr << "Error: Truncated container chunk in " << entry.path << std::endl;
+                return false;
+            }
+
+            std::atomic<bool> failed(false);
+            forEachParallel(last - first, threadCount, [&](size_t i) {
+                uint32_t id = entry.chunks[first + i];
+                char* data = buffer.data() + starts[i];
+                Utils::StageTimer timer(Utils::Stage::Cipher, index.chunks[id].size);
+                if (!engine.decryptSegment(data, data, index.chunks[id].size, chunkSegmentOffset(id),
+                                           tags.data() + i * tagSize)) {
+                    failed = true;
+                }
+            });
+            if (failed) {
+                std::cerr << "Error: Invalid password or corrupted container - authentication failed for "
+                          << entry.path << std::endl;
+                return false;
+            }
+            {
+                Utils::StageTimer timer(Utils::Stage::Write, batchSize);
+                file.write(buffer.data(), batchSize);
+            }
+            first = last;
+        }
+        file.close();
+        if (file.fail()) {
+            std::cerr << "Error: Failed to write file " << destination.string() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Directories come first so files have somewhere to go; files are decrypted in parallel,
+    // then hard links and symlinks are created and directory attributes applied deepest-first
+    bool extractFromContainer(const std::string& containerPath, const std::string& targetPath,
+                              Encryption::Encryptor& encryptor, const std::vector<std::string>& patterns,
+                              unsigned threadCount) {
+        std::ifstream input(containerPath, std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "Error: Could not open file " << containerPath << std::endl;
+            return false;
+        }
+
+        Encryption::FileHeader header;
+        ContainerIndex index;
+        try {
+            std::error_code error;
+            uint64_t fileSize = fs::file_size(containerPath, error);
+            if (error) {
+                throw std::runtime_error("Could not read " + containerPath);
+            }
+            index = openContainer(input, fileSize, encryptor, header);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+        input.close();
+
+        std::vector<const ContainerEntry*> selected;
+        for (const auto& entry : index.entries) {
+            bool match = patterns.empty();
+            for (size_t i = 0; i < patterns.size() && !match; ++i) {
+                match = matchesContainerPattern(entry.path, patterns[i]);
+            }
+            if (match) {
+                selected.push_back(&entry);
+            }
+        }
+        if (selected.empty()) {
+            std::cerr << "Error: No entries in " << containerPath << " match the given patterns" << std::endl;
+            return false;
+        }
+
+        // A hard link is extracted as a file of its own only when its first file is not selected
+        std::set<std::string> selectedPaths;
+        for (const ContainerEntry* entry : selected) {
+            selectedPaths.insert(entry->path);
+        }
+
+        fs::path target(targetPath);
+        std::vector<const ContainerEntry*> files;
+        std::vector<const ContainerEntry*> hardLinks;
+        try {
+            fs::create_directories(target);
+            for (const ContainerEntry* entry : selected) {
+                if (entry->isDirectory()) {
+                    fs::create_directories(target / entry->path);
+                } else {
+                    fs::create_directories((target / entry->path).parent_path());
+                    if (entry->isRegularFile() && !entry->hardLinkPath.empty() &&
+                        selectedPaths.count(entry->hardLinkPath) != 0) {
+                        hardLinks.push_back(entry);
+                    } else if (entry->isRegularFile()) {
+                        files.push_back(entry);
+                    }
+                }
+            }
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        // Files are spread over the workers; threads left over go to the segments of each file
+        if (threadCount == 0) {
+            threadCount = Utils::getDefaultThreadCount();
+        }
+        unsigned workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, files.size())));
+        unsigned segmentThreads = std::max(1u, threadCount / workers);
+        std::unique_ptr<Encryption::CipherEngine> chunkEngine;
+        if (index.deduplicated) {
+            chunkEngine = entryEngine(encryptor, header, index.chunkNonce);
+        }
+        std::atomic<size_t> nextFile(0);
+        std::atomic<bool> failed(false);
+        std::mutex outputMutex;
+
+        Utils::runParallel(workers, [&](unsigned) {
+            std::ifstream workerInput(containerPath, std::ios::binary);
+            std::vector<char> buffer;
+            while (true) {
+                size_t fileIndex = nextFile.fetch_add(1);
+                if (fileIndex >= files.size()) {
+                    break;
+                }
+                const ContainerEntry& entry = *files[fileIndex];
+                fs::path destination = target / entry.path;
+                bool success = false;
+                try {
+                    buffer.resize(static_cast<size_t>(std::min<uint64_t>(CONTAINER_BLOCK_SIZE,
+                                                                         std::max<uint64_t>(entry.size, 1))));
+                    workerInput.clear();
+                    if (!workerInput.is_open()) {
+                        success = false;
+                    } else if (index.deduplicated) {
+                        success = extractChunkedEntryData(workerInput, *chunkEngine, index, entry, destination,
+                                                          buffer, segmentThreads);
+                    } else {
+                        std::unique_ptr<Encryption::CipherEngine> engine = entryEngine(encryptor, header, entry.nonce);
+                        success = extractEntryData(workerInput, *engine, entry, destination, buffer, segmentThreads);
+                    }
+                    if (success) {
+                        applyAttributes(destination, entry.mode, entry.mtime, entry.mtimeNanoseconds, false);
+                    }
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+                if (!success) {
+                    failed = true;
+                    std::error_code error;
+                    fs::remove(destination, error);
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: Could not extract " << destination.string() << std::endl;
+                }
+            }
+        });
+
+        // A first file that failed has been removed, so its links fail too and are reported
+        for (const ContainerEntry* entry : hardLinks) {
+            fs::path destination = target / entry->path;
+            std::error_code error;
+            fs::remove(destination, error);
+            fs::create_hard_link(target / entry->hardLinkPath, destination, error);
+            if (error) {
+                failed = true;
+                std::cerr << "Error: Could not link " << destination.string() << " to "
+                          << (target / entry->hardLinkPath).string() << ": " << error.message() << std::endl;
+            }
+        }
+
+        try {
+            for (const ContainerEntry* entry : selected) {
+                if (entry->isSymlink()) {
+                    fs::path destination = target / entry->path;
+                    fs::remove(destination);
+                    fs::create_symlink(entry->linkTarget, destination);
+                    applyAttributes(destination, entry->mode, entry->mtime, entry->mtimeNanoseconds, true);
+                }
+            }
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        for (auto it = selected.rbegin(); it != selected.rend(); ++it) {
+            if ((*it)->isDirectory()) {
+                applyAttributes((*it)->path.empty() ? target : target / (*it)->path, (*it)->mode, (*it)->mtime,
+                                (*it)->mtimeNanoseconds, false);
+            }
+        }
+        return !failed;
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef FOLDERCONTAINER_HPP
+#define FOLDERCONTAINER_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "ArchiveHandler.hpp"
+#include "FolderScanner.hpp"
+#include "../Encryption/Encryption.hpp"
+#include "../Encryption/Crypto.hpp"
+
+// Seekable encrypted folder containers
+// Every file is stored as its own encrypted entry and an encrypted index of names, offsets and
+// sizes sits at the end, so listing or extracting a few files reads only the index and those entries
+// Layout: [file header (HEADER_FLAG_CONTAINER)][entry data...][sealed index][index tag][trailer]
+// Entry data: [ciphertext][segment tags], keyed from the header with the entry's own nonce
+// Trailer: [index offset][index size][trailer magic], so readers find the index from the end
+// Sparse files store only their data extents as the entry data, and extraction recreates the holes
+// Deduplicated containers store content-defined chunks instead: each unique chunk is stored once
+// as [ciphertext][tag] and files list the chunks they are made of; holes are read and stored as zeros
+namespace ArchiveHandler {
+
+    // One folder entry recorded in a container index
+    struct ContainerEntry {
+        std::string path;              // Path relative to the folder, '/' separated ("" = the folder itself)
+        uint32_t mode = 0;             // Full st_mode (file type and permission bits)
+        uint64_t size = 0;             // File size in bytes (0 for directories and symlinks)
+        int64_t mtime = 0;             // Modification time (seconds since epoch)
+        int64_t mtimeNanoseconds = 0;  // Sub-second part of the modification time
+        uint64_t offset = 0;           // Where the entry's data starts in the container (regular files only)
+        std::array<uint8_t, Encryption::NONCE_SIZE> nonce{}; // Makes the entry's key unique (regular files only)
+        std::vector<uint32_t> chunks;  // Chunks making up the content, in order (deduplicated containers only)
+        std::vector<FileHandler::DataExtent> extents; // Data runs of a sparse file, stored one after
+                                                      // another (empty = stored in full)
+        std::string linkTarget;        // Target of a symlink
+        std::string hardLinkPath;      // Earlier file entry this one is a hard link to ("" if none)
+
+        bool isDirectory() const;
+        bool isRegularFile() const;
+        bool isSymlink() const;
+
+        // Returns the number of content bytes stored for the entry (size, less any holes)
+        uint64_t storedSize() const;
+    };
+
+    // One unique chunk of a deduplicated container
+    struct ContainerChunk {
+        uint64_t offset = 0;                 // Where the chunk's ciphertext starts; its tag follows it
+        uint32_t size = 0;                   // Plaintext size in bytes
+        Encryption::Sha256Digest hash{};     // SHA-256 of the plaintext, which identifies the chunk
+    };
+
+    // Decrypted index of a container
+    struct ContainerIndex {
+        std::string folderName;              // Name of the folder the container was made from
+        std::vector<ContainerEntry> entries; // Sorted by path, so parents precede their children
+        bool deduplicated = false;           // Files are stored as shared chunks rather than entry data
+        std::array<uint8_t, Encryption::NONCE_SIZE> chunkNonce{}; // Key of all chunks (deduplicated only)
+        std::vector<ContainerChunk> chunks;  // Unique chunks (deduplicated only)
+    };
+
+    // Sizes reported after writing a container
+    struct ContainerStats {
+        uint64_t contentBytes = 0;  // File content stored (hard links counted once)
+        uint64_t storedBytes = 0;   // Content bytes actually written, after deduplication or leaving out holes
+        uint64_t chunkCount = 0;    // Chunks referenced by files (deduplicated only)
+        uint64_t uniqueChunks = 0;  // Chunks stored (deduplicated only)
+
+        // Returns content bytes per stored byte (1 without deduplication or sparse files)
+        double dedupRatio() const { return storedBytes == 0 ? 1.0 : double(contentBytes) / double(storedBytes); }
+    };
+
+    // Returns true if path is an encrypted folder container (checks the header flag only)
+    bool isFolderContainer(const std::string& path);
+
+    // Writes the entries of a scanned folder into a new container at outputPath
+    // Files are encrypted one after another, with the segments of each block spread over the
+    // encryptor's threads; hard links to one file share its stored data, and files with at least
+    // 1 MiB of holes store only their data extents (without deduplication)
+    // progress, if given, is called with (content bytes written, total content bytes)
+    // With deduplicate set, file contents are split into content-defined chunks and each distinct
+    // chunk (by SHA-256) is stored once; stats, if given, receives the content and stored sizes
+    // Requires an authenticated engine. Returns false (after removing the output) on any failure
+    bool writeFolderContainer(const FolderManifest& manifest, const std::string& outputPath,
+                              Encryption::Encryptor& encryptor, const ProgressCallback& progress = nullptr,
+                              bool deduplicate = false, ContainerStats* stats = nullptr);
+
+    // Reads and decrypts a container's index; nothing else in the container is read
+    // Throws std::runtime_error if the file is not a container, is corrupted or the password is wrong
+    ContainerIndex readContainerIndex(const std::string& containerPath, Encryption::Encryptor& encryptor);
+
+    // Returns true if a container path is selected by a glob pattern (fnmatch syntax, '*' also
+    // matches '/'); a pattern selecting a directory selects everything below it
+    bool matchesContainerPattern(const std::string& path, const std::string& pattern);
+
+    // Extracts the entries selected by patterns (all entries if empty) into targetPath, which
+    // stands for the container's folder; parent directories of selected entries are created
+    // Only the index and the selected entries are read. Files are decrypted in parallel on
+    // threadCount workers (0 = all hardware threads), leaving the holes of sparse files unwritten;
+    // hard links whose first file is also selected are recreated as links to it, others are
+    // extracted as files of their own
+    // Returns false if the index or any selected entry cannot be decrypted, or nothing matched
+    bool extractFromContainer(const std::string& containerPath, const std::string& targetPath,
+                              Encryption::Encryptor& encryptor, const std::vector<std::string>& patterns = {},
+                              unsigned threadCount = 0);
+
+    // Serializes a container index to its binary form
+    // Format: [version][folder name][entry count][entries]
+    // Deduplicated (version 2): [version][folder name][chunk nonce][chunk count][chunks][entry count][entries]
+    // Versions 3 and 4 are versions 1 and 2 with hard links recorded; they are only written when
+    // the folder has hard links, so other containers remain readable by earlier versions
+    // Version 5 is version 3 with the extent map of every file, written only when a file is sparse
+    std::vector<char> serializeContainerIndex(const ContainerIndex& index);
+
+    // Deserializes a container index, validating every length against the data
+    // Throws std::runtime_error for malformed data
+    ContainerIndex deserializeContainerIndex(const std::vector<char>& data);
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "FolderScanner.hpp"
+#include "Tar.hpp"
+#include "../Utils/Utils.hpp"
+#include "../Utils/Instrumentation.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace ArchiveHandler {
+
+    // Minimum scanner threads - directory listing is dominated by I/O latency, not CPU
+    static const unsigned MIN_SCAN_THREADS = 8;
+
+    bool ManifestEntry::isDirectory() const {
+        return S_ISDIR(mode);
+    }
+
+    bool ManifestEntry::isRegularFile() const {
+        return S_ISREG(mode);
+    }
+
+    // Converts lstat information into a manifest entry
+    static ManifestEntry makeEntry(const std::string& path, const struct stat& info) {
+        ManifestEntry entry;
+        entry.path = path;
+        entry.mode = static_cast<uint32_t>(info.st_mode);
+        entry.size = S_ISDIR(info.st_mode) ? 0 : static_cast<uint64_t>(info.st_size);
+        entry.mtime = static_cast<int64_t>(info.st_mtime);
+#ifdef __APPLE__
+        entry.mtimeNanoseconds = static_cast<int64_t>(info.st_mtimespec.tv_nsec);
+#else
+        entry.mtimeNanoseconds = static_cast<int64_t>(info.st_mtim.tv_nsec);
+#endif
+        entry.device = static_cast<uint64_t>(info.st_dev);
+        entry.inode = static_cast<uint64_t>(info.st_ino);
+        entry.linkCount = static_cast<uint64_t>(info.st_nlink);
+        return entry;
+    }
+
+    // Scans directories from a shared work list until no directory is pending or being listed
+    // Each worker collects entries locally and merges them once, keeping lock traffic low
+    bool scanFolder(const std::string& folderPath, FolderManifest& manifest, unsigned threadCount) {
+        Utils::StageTimer timer(Utils::Stage::Scan);
+        manifest = FolderManifest();
+        manifest.rootPath = folderPath;
+        fs::path folder(folderPath);
+        manifest.folderName = folder.filename().string();
+        if (manifest.folderName.empty()) {
+            manifest.folderName = folder.parent_path().filename().string();
+        }
+
+        struct stat rootInfo;
+        if (lstat(folderPath.c_str(), &rootInfo) != 0 || !S_ISDIR(rootInfo.st_mode)) {
+            std::cerr << "Error: Invalid folder path: " << folderPath << std::endl;
+            return false;
+        }
+        manifest.entries.push_back(makeEntry("", rootInfo));
+
+        if (threadCount == 0) {
+            threadCount = std::max(MIN_SCAN_THREADS, Utils::getDefaultThreadCount());
+        }
+
+        std::mutex mutex;
+        std::condition_variable workAvailable;
+        std::deque<std::string> pending{""};
+        unsigned active = 0;
+        bool failed = false;
+
+        Utils::runParallel(threadCount, [&](unsigned) {
+            std::vector<ManifestEntry> found;
+            std::vector<std::string> subdirectories;
+
+            while (true) {
+                std::string directory;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    workAvailable.wait(lock, [&] { return !pending.empty() || active == 0 || failed; });
+                    if (pending.empty() || failed) {
+                        break;
+                    }
+                    directory = std::move(pending.front());
+                    pending.pop_front();
+                    ++active;
+                }
+
+                std::string directoryPath = directory.empty() ? folderPath : folderPath + "/" + directory;
+                DIR* handle = opendir(directoryPath.c_str());
+                bool ok = handle != nullptr;
+
+                if (ok) {
+                    int directoryFd = dirfd(handle);
+                    while (struct dirent* item = readdir(handle)) {
+                        std::string name = item->d_name;
+                        if (name == "." || name == "..") {
+                            continue;
+                        }
+                        struct stat info;
+                        if (fstatat(directoryFd, item->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+                            continue; // Entry vanished while scanning
+                        }
+                        std::string relativePath = directory.empty() ? name : directory + "/" + name;
+                        if (S_ISDIR(info.st_mode)) {
+                            subdirectories.push_back(relativePath);
+                        }
+                        found.push_back(makeEntry(relativePath, info));
+                    }
+                    closedir(handle);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok) {
+                    std::cerr << "Error: Cannot read directory " << directoryPath << std::endl;
+                    failed = true;
+                }
+                for (auto& subdirectory : subdirectories) {
+                    pending.push_back(std::move(subdirectory));
+                }
+                subdirectories.clear();
+                --active;
+                workAvailable.notify_all();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            manifest.entries.insert(manifest.entries.end(),
+                                    std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+            workAvailable.notify_all();
+        });
+
+        if (failed) {
+            return false;
+        }
+
+        std::sort(manifest.entries.begin(), manifest.entries.end(),
+                  [](const ManifestEntry& a, const ManifestEntry& b) { return a.path < b.path; });
+
+        for (const auto& entry : manifest.entries) {
+            if (entry.isRegularFile()) {
+                manifest.totalSize += entry.size;
+                ++manifest.fileCount;
+            } else if (entry.isDirectory() && !entry.path.empty()) {
+                ++manifest.directoryCount;
+            }
+        }
+        return true;
+    }
+
+    // One header per entry plus block-padded file data and the end-of-archive marker
+    // pax headers for very long names are not counted, so this is a close lower bound
+    uint64_t estimateArchiveSize(const FolderManifest& manifest) {
+        uint64_t size = 2 * TAR_BLOCK_SIZE;
+        for (const auto& entry : manifest.entries) {
+            size += TAR_BLOCK_SIZE;
+            if (entry.isRegularFile()) {
+                size += (entry.size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+            }
+        }
+        return size;
+    }
+}
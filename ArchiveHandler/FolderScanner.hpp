@@ -0,0 +1,51 @@
+#ifndef FOLDERSCANNER_HPP
+#define FOLDERSCANNER_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Single-pass, multi-threaded folder scanner
+// Builds an in-memory manifest of every entry below a folder, which is then used for sizing,
+// emptiness checks, archiving and progress estimation instead of walking the tree repeatedly
+namespace ArchiveHandler {
+
+    // One filesystem entry found by the scanner (information from lstat)
+    struct ManifestEntry {
+        std::string path;       // Path relative to the scanned folder, '/' separated ("" = the folder itself)
+        uint32_t mode = 0;      // Full st_mode (file type and permission bits)
+        uint64_t size = 0;      // Size in bytes (target length for symlinks, 0 for directories)
+        int64_t mtime = 0;      // Modification time (seconds since epoch)
+        int64_t mtimeNanoseconds = 0; // Sub-second part of the modification time
+        uint64_t device = 0;    // Device and inode identify hard links to the same file
+        uint64_t inode = 0;
+        uint64_t linkCount = 1; // Number of hard links
+
+        bool isDirectory() const;
+        bool isRegularFile() const;
+    };
+
+    // Result of scanning a folder
+    // Entries are sorted by path, so parents always precede their children
+    struct FolderManifest {
+        std::string rootPath;               // Folder that was scanned
+        std::string folderName;             // Name of the folder itself, used as the archive's top level
+        std::vector<ManifestEntry> entries; // The folder itself first, then everything below it
+        uint64_t totalSize = 0;             // Total size of all regular files
+        size_t fileCount = 0;               // Number of regular files
+        size_t directoryCount = 0;          // Number of subdirectories (excluding the folder itself)
+
+        // Returns true if the folder contains no entries
+        bool isEmpty() const { return entries.size() <= 1; }
+    };
+
+    // Scans a folder tree with several threads pulling directories from a shared work list
+    // threadCount = 0 picks a default suited to latency-bound (e.g. network) storage
+    // Returns false if the folder or any directory below it cannot be read
+    bool scanFolder(const std::string& folderPath, FolderManifest& manifest, unsigned threadCount = 0);
+
+    // Estimates the size of the tar stream produced for a manifest, for progress reporting
+    uint64_t estimateArchiveSize(const FolderManifest& manifest);
+}
+
+#endif
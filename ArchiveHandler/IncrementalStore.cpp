@@ -0,0 +1,571 @@
+#include "IncrementalStore.hpp"
+#include "FolderScanner.hpp"
+#include "Tar.hpp"
+#include "ArchiveHandler.hpp"
+#include "../Utils/Utils.hpp"
+#include "../Utils/Instrumentation.hpp"
+#include "../Utils/Serialization.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace ArchiveHandler {
+
+    // Magic number at the start of a serialized store manifest ("FCIM")
+    static const uint32_t STORE_MANIFEST_MAGIC = 0x4d494346;
+
+    // Current version of the store manifest format
+    static const uint32_t STORE_MANIFEST_VERSION = 1;
+
+    // Longest path or symlink target accepted when reading a manifest
+    static const uint32_t MAX_STORE_PATH_LENGTH = 65536;
+
+    // Size of the buffer used to hash files
+    static const size_t HASH_BUFFER_SIZE = 1024 * 1024;
+
+    static const char MANIFEST_FILE[] = "manifest.enc";
+    static const char OBJECTS_DIRECTORY[] = "objects";
+    static const char OBJECT_EXTENSION[] = ".enc";
+
+    bool StoreEntry::isDirectory() const {
+        return S_ISDIR(mode);
+    }
+
+    bool StoreEntry::isRegularFile() const {
+        return S_ISREG(mode);
+    }
+
+    bool StoreEntry::isSymlink() const {
+        return S_ISLNK(mode);
+    }
+
+    // Object files are named by their identifier in lowercase hex
+    static std::string objectName(const std::array<uint8_t, OBJECT_ID_SIZE>& object) {
+        static const char digits[] = "0123456789abcdef";
+        std::string name;
+        name.reserve(OBJECT_ID_SIZE * 2 + sizeof(OBJECT_EXTENSION) - 1);
+        for (uint8_t byte : object) {
+            name += digits[byte >> 4];
+            name += digits[byte & 15];
+        }
+        return name + OBJECT_EXTENSION;
+    }
+
+    static std::string objectPath(const std::string& storePath, const std::array<uint8_t, OBJECT_ID_SIZE>& object) {
+        return (fs::path(storePath) / OBJECTS_DIRECTORY / objectName(object)).string();
+    }
+
+    // Returns true for names this module gives to objects, so cleanup never touches anything else
+    static bool isObjectName(const std::string& name) {
+        size_t extensionLength = sizeof(OBJECT_EXTENSION) - 1;
+        if (name.size() != OBJECT_ID_SIZE * 2 + extensionLength ||
+            name.compare(OBJECT_ID_SIZE * 2, extensionLength, OBJECT_EXTENSION) != 0) {
+            return false;
+        }
+        return std::all_of(name.begin(), name.begin() + OBJECT_ID_SIZE * 2,
+                           [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+    }
+
+    // Hashes a file's content; bytes receives the number of bytes read
+    static bool hashFile(const std::string& path, Encryption::Sha256Digest& digest, uint64_t& bytes) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input.is_open()) {
+            return false;
+        }
+        Utils::StageTimer timer(Utils::Stage::Hash);
+        Encryption::Sha256 hasher;
+        std::vector<char> buffer(HASH_BUFFER_SIZE);
+        bytes = 0;
+        while (input) {
+            input.read(buffer.data(), buffer.size());
+            hasher.update(buffer.data(), static_cast<size_t>(input.gcount()));
+            bytes += static_cast<uint64_t>(input.gcount());
+        }
+        if (!input.eof()) {
+            return false;
+        }
+        timer.addBytes(bytes);
+        digest = hasher.finish();
+        return true;
+    }
+
+    // Entry format: [path][mode][size][mtime][mtime_ns], then [hash][object] for regular files
+    // or [link target] for symlinks
+    std::vector<char> serializeStoreManifest(const StoreManifest& manifest) {
+        std::vector<char> result;
+        Utils::appendValue(result, STORE_MANIFEST_MAGIC);
+        Utils::appendValue(result, STORE_MANIFEST_VERSION);
+        Utils::appendValue(result, manifest.generation);
+
+        Utils::appendValue(result, static_cast<uint64_t>(manifest.entries.size()));
+        for (const auto& entry : manifest.entries) {
+            Utils::appendString(result, entry.path);
+            Utils::appendValue(result, entry.mode);
+            Utils::appendValue(result, entry.size);
+            Utils::appendValue(result, entry.mtime);
+            Utils::appendValue(result, entry.mtimeNanoseconds);
+            if (entry.isRegularFile()) {
+                result.insert(result.end(), entry.hash.begin(), entry.hash.end());
+                result.insert(result.end(), entry.object.begin(), entry.object.end());
+            } else if (entry.isSymlink()) {
+                Utils::appendString(result, entry.linkTarget);
+            }
+        }
+
+        Utils::appendValue(result, static_cast<uint64_t>(manifest.deletions.size()));
+        for (const auto& deletion : manifest.deletions) {
+            Utils::appendString(result, deletion.path);
+            Utils::appendValue(result, deletion.generation);
+        }
+        return result;
+    }
+
+    StoreManifest deserializeStoreManifest(const std::vector<char>& data) {
+        Utils::ByteReader reader(data, "store manifest");
+        if (reader.value<uint32_t>() != STORE_MANIFEST_MAGIC) {
+            throw std::runtime_error("Not a store manifest");
+        }
+        uint32_t version = reader.value<uint32_t>();
+        if (version != STORE_MANIFEST_VERSION) {
+            throw std::runtime_error("Unsupported store manifest version " + std::to_string(version));
+        }
+
+        StoreManifest manifest;
+        manifest.generation = reader.value<uint64_t>();
+
+        // Every entry takes at least its fixed fields, which bounds the count before reserving
+        const size_t minimumEntrySize = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 3;
+        uint64_t entryCount = reader.value<uint64_t>();
+        if (entryCount > data.size() / minimumEntrySize) {
+            throw std::runtime_error("Invalid entry count in store manifest");
+        }
+        manifest.entries.reserve(static_cast<size_t>(entryCount));
+        for (uint64_t i = 0; i < entryCount; ++i) {
+            StoreEntry entry;
+            entry.path = reader.string(MAX_STORE_PATH_LENGTH);
+            entry.mode = reader.value<uint32_t>();
+            entry.size = reader.value<uint64_t>();
+            entry.mtime = reader.value<int64_t>();
+            entry.mtimeNanoseconds = reader.value<int64_t>();
+            if (entry.isRegularFile()) {
+                reader.read(entry.hash.data(), entry.hash.size());
+                reader.read(entry.object.data(), entry.object.size());
+            } else if (entry.isSymlink()) {
+                entry.linkTarget = reader.string(MAX_STORE_PATH_LENGTH);
+            } else if (!entry.isDirectory()) {
+                throw std::runtime_error("Unsupported entry type in store manifest");
+            }
+            if (!entry.path.empty() && !isSafeEntryName(entry.path)) {
+                throw std::runtime_error("Unsafe path in store manifest: " + entry.path);
+            }
+            manifest.entries.push_back(std::move(entry));
+        }
+
+        uint64_t deletionCount = reader.value<uint64_t>();
+        if (deletionCount > data.size() / (sizeof(uint32_t) + sizeof(uint64_t))) {
+            throw std::runtime_error("Invalid deletion count in store manifest");
+        }
+        for (uint64_t i = 0; i < deletionCount; ++i) {
+            StoreDeletion deletion;
+            deletion.path = reader.string(MAX_STORE_PATH_LENGTH);
+            deletion.generation = reader.value<uint64_t>();
+            manifest.deletions.push_back(std::move(deletion));
+        }
+
+        if (!reader.atEnd()) {
+            throw std::runtime_error("Unexpected data after store manifest");
+        }
+        return manifest;
+    }
+
+    // The manifest is sealed with encryptData, so the header's password check rejects a wrong
+    // password and the tag covers every byte; header receives the manifest's file header
+    static StoreManifest readStoreManifest(const std::string& storePath, Encryption::Encryptor& encryptor,
+                                           Encryption::FileHeader& header) {
+        if (encryptor.getEngine() == Encryption::EngineType::LegacyXor) {
+            throw std::runtime_error("Incremental stores require the aes-256-gcm cipher");
+        }
+        std::string manifestPath = (fs::path(storePath) / MANIFEST_FILE).string();
+        std::ifstream input(manifestPath, std::ios::binary);
+        if (!input.is_open()) {
+            throw std::runtime_error("No store manifest at " + manifestPath);
+        }
+        std::vector<char> encrypted((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        if (input.bad()) {
+            throw std::runtime_error("Could not read " + manifestPath);
+        }
+        std::vector<char> decrypted = encryptor.decryptData(encrypted);
+        header = Encryption::deserializeHeader(encrypted);
+        Utils::StageTimer timer(Utils::Stage::Metadata, decrypted.size());
+        return deserializeStoreManifest(decrypted);
+    }
+
+    StoreManifest loadStoreManifest(const std::string& storePath, Encryption::Encryptor& encryptor) {
+        Encryption::FileHeader header;
+        return readStoreManifest(storePath, encryptor, header);
+    }
+
+    // Writes the manifest beside the old one and renames it into place, so a store always
+    // holds either the previous manifest or the complete new one
+    static bool writeStoreManifest(const std::string& storePath, const StoreManifest& manifest,
+                                   Encryption::Encryptor& encryptor) {
+        fs::path manifestPath = fs::path(storePath) / MANIFEST_FILE;
+        fs::path temporaryPath = manifestPath;
+        temporaryPath += ".tmp";
+
+        std::vector<char> encrypted;
+        {
+            Utils::StageTimer timer(Utils::Stage::Metadata);
+            encrypted = encryptor.encryptData(serializeStoreManifest(manifest));
+            timer.addBytes(encrypted.size());
+        }
+
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        bool success = output.is_open();
+        if (success) {
+            output.write(encrypted.data(), encrypted.size());
+            output.close();
+            success = !output.fail();
+        }
+        std::error_code error;
+        if (success) {
+            fs::rename(temporaryPath, manifestPath, error);
+            success = !error;
+        }
+        if (!success) {
+            std::cerr << "Error: Could not write " << manifestPath.string() << std::endl;
+            fs::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+    // Removes every object file the manifest does not reference, including leftovers of
+    // interrupted syncs whose manifest was never committed
+    static void removeUnreferencedObjects(const std::string& storePath, const StoreManifest& manifest) {
+        std::unordered_set<std::string> referenced;
+        for (const auto& entry : manifest.entries) {
+            if (entry.isRegularFile()) {
+                referenced.insert(objectName(entry.object));
+            }
+        }
+
+        std::error_code error;
+        for (const auto& item : fs::directory_iterator(fs::path(storePath) / OBJECTS_DIRECTORY, error)) {
+            std::string name = item.path().filename().string();
+            if (isObjectName(name) && referenced.count(name) == 0) {
+                std::error_code removeError;
+                fs::remove(item.path(), removeError);
+            }
+        }
+    }
+
+    std::string defaultStorePath(const std::string& folderPath) {
+        fs::path folder(folderPath);
+        if (folder.filename().empty()) {
+            folder = folder.parent_path();
+        }
+        return folder.string() + ".encstore";
+    }
+
+    // Compares the scanned folder with the previous manifest; only files whose size or
+    // modification time differ are read, and only those whose hash differs are encrypted
+    bool syncFolder(const std::string& folderPath, const std::string& storePath,
+                    Encryption::Encryptor& encryptor, SyncStats& stats, unsigned threadCount) {
+        stats = SyncStats();
+        if (encryptor.getEngine() == Encryption::EngineType::LegacyXor) {
+            std::cerr << "Error: Incremental stores require the aes-256-gcm cipher" << std::endl;
+            return false;
+        }
+
+        FolderManifest folder;
+        if (!scanFolder(folderPath, folder)) {
+            return false;
+        }
+
+        // Later syncs reuse the store's salt, so restoring derives the master key only once
+        StoreManifest previous;
+        if (fs::exists(fs::path(storePath) / MANIFEST_FILE)) {
+            try {
+                Encryption::FileHeader header;
+                previous = readStoreManifest(storePath, encryptor, header);
+                encryptor.setSalt(header.salt);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return false;
+            }
+        }
+        std::error_code error;
+        fs::create_directories(fs::path(storePath) / OBJECTS_DIRECTORY, error);
+        if (error) {
+            std::cerr << "Error: Could not create store " << storePath << std::endl;
+            return false;
+        }
+
+        std::unordered_map<std::string, const StoreEntry*> previousEntries;
+        for (const auto& entry : previous.entries) {
+            previousEntries[entry.path] = &entry;
+        }
+        auto findPrevious = [&previousEntries](const std::string& path) -> const StoreEntry* {
+            auto found = previousEntries.find(path);
+            return found == previousEntries.end() ? nullptr : found->second;
+        };
+
+        // Build the new entry list; regular files that may have changed are queued for hashing
+        StoreManifest next;
+        next.generation = previous.generation + 1;
+        std::vector<size_t> pending;
+        for (const auto& scanned : folder.entries) {
+            std::string sourcePath = scanned.path.empty() ? folder.rootPath : folder.rootPath + "/" + scanned.path;
+            StoreEntry entry;
+            entry.path = scanned.path;
+            entry.mode = scanned.mode;
+            entry.mtime = scanned.mtime;
+            entry.mtimeNanoseconds = scanned.mtimeNanoseconds;
+
+            if (scanned.isRegularFile()) {
+                entry.size = scanned.size;
+                const StoreEntry* old = findPrevious(scanned.path);
+                if (old != nullptr && old->isRegularFile() && old->size == entry.size &&
+                    old->mtime == entry.mtime && old->mtimeNanoseconds == entry.mtimeNanoseconds) {
+                    entry.hash = old->hash;
+                    entry.object = old->object;
+                    ++stats.unchanged;
+                } else {
+                    pending.push_back(next.entries.size());
+                }
+            } else if (S_ISLNK(scanned.mode)) {
+                entry.linkTarget = fs::read_symlink(sourcePath, error).string();
+                if (error) {
+                    std::cerr << "Error: Cannot read symlink " << sourcePath << std::endl;
+                    ++stats.failed;
+                    continue;
+                }
+            } else if (!scanned.isDirectory()) {
+                std::cerr << "Warning: Skipping unsupported file type: " << sourcePath << std::endl;
+                continue;
+            }
+            next.entries.push_back(std::move(entry));
+        }
+
+        // Hash and encrypt the queued files; failures fall back to the previous version
+        std::atomic<size_t> nextPending(0);
+        std::atomic<size_t> touched(0), changed(0), added(0), failed(0);
+        std::atomic<uint64_t> bytesHashed(0), bytesEncrypted(0);
+        std::vector<char> dropped(next.entries.size(), 0);
+        std::mutex outputMutex;
+        if (threadCount == 0) {
+            threadCount = Utils::getDefaultThreadCount();
+        }
+        threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, pending.size())));
+
+        Utils::runParallel(threadCount, [&](unsigned) {
+            while (true) {
+                size_t index = nextPending.fetch_add(1);
+                if (index >= pending.size()) {
+                    break;
+                }
+                StoreEntry& entry = next.entries[pending[index]];
+                std::string sourcePath = folder.rootPath + "/" + entry.path;
+                const StoreEntry* old = findPrevious(entry.path);
+                if (old != nullptr && !old->isRegularFile()) {
+                    old = nullptr;
+                }
+
+                bool success = false;
+                try {
+                    uint64_t bytes = 0;
+                    if (hashFile(sourcePath, entry.hash, bytes)) {
+                        bytesHashed += bytes;
+                        entry.size = bytes;
+                        if (old != nullptr && old->hash == entry.hash) {
+                            entry.object = old->object;
+                            ++touched;
+                            success = true;
+                        } else {
+                            Encryption::secureRandom(entry.object.data(), entry.object.size());
+                            success = encryptor.encryptFile(sourcePath, objectPath(storePath, entry.object));
+                            if (success) {
+                                bytesEncrypted += bytes;
+                                if (old != nullptr) {
+                                    ++changed;
+                                } else {
+                                    ++added;
+                                }
+                            }
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+
+                if (!success) {
+                    ++failed;
+                    if (old != nullptr) {
+                        entry = *old;
+                    } else {
+                        dropped[pending[index]] = 1;
+                    }
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: Could not store " << sourcePath << std::endl;
+                }
+            }
+        });
+
+        if (failed > 0) {
+            std::vector<StoreEntry> kept;
+            kept.reserve(next.entries.size());
+            for (size_t i = 0; i < next.entries.size(); ++i) {
+                if (!dropped[i]) {
+                    kept.push_back(std::move(next.entries[i]));
+                }
+            }
+            next.entries = std::move(kept);
+        }
+
+        // Record everything that disappeared; earlier deletions are kept unless the path is back
+        std::unordered_set<std::string> present;
+        for (const auto& entry : next.entries) {
+            present.insert(entry.path);
+        }
+        for (const auto& deletion : previous.deletions) {
+            if (present.count(deletion.path) == 0) {
+                next.deletions.push_back(deletion);
+            }
+        }
+        for (const auto& entry : previous.entries) {
+            if (present.count(entry.path) == 0) {
+                next.deletions.push_back({entry.path, next.generation});
+                ++stats.deleted;
+            }
+        }
+
+        stats.touched = touched;
+        stats.changed = changed;
+        stats.added = added;
+        stats.failed += failed;
+        stats.bytesHashed = bytesHashed;
+        stats.bytesEncrypted = bytesEncrypted;
+
+        try {
+            if (!writeStoreManifest(storePath, next, encryptor)) {
+                return false;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+        removeUnreferencedObjects(storePath, next);
+        return stats.failed == 0;
+    }
+
+    // The directory tree is created up front and each object is decrypted straight to its path,
+    // then hashed again before its attributes are set; symlinks only appear once every file is in place, and directories get their times last,
+    // since writing into a directory would change its modification time
+    bool restoreFolder(const std::string& storePath, const std::string& targetPath,
+                       Encryption::Encryptor& encryptor, unsigned threadCount) {
+        StoreManifest manifest;
+        try {
+            manifest = loadStoreManifest(storePath, encryptor);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        fs::path target(targetPath);
+        std::vector<const StoreEntry*> files;
+        try {
+            fs::create_directories(target);
+            for (const auto& entry : manifest.entries) {
+                if (entry.isDirectory()) {
+                    fs::create_directories(target / entry.path);
+                } else if (entry.isRegularFile()) {
+                    files.push_back(&entry);
+                }
+            }
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        std::atomic<size_t> nextFile(0);
+        std::atomic<bool> failed(false);
+        std::mutex outputMutex;
+        if (threadCount == 0) {
+            threadCount = Utils::getDefaultThreadCount();
+        }
+        threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, files.size())));
+
+        Utils::runParallel(threadCount, [&](unsigned) {
+            while (true) {
+                size_t index = nextFile.fetch_add(1);
+                if (index >= files.size()) {
+                    break;
+                }
+                const StoreEntry& entry = *files[index];
+                fs::path destination = target / entry.path;
+                bool success = false;
+                try {
+                    // Objects are authenticated one by one, so only the manifest hash shows that the
+                    // right object was restored (a swapped or stale object decrypts just as well)
+                    Encryption::Sha256Digest digest;
+                    uint64_t bytes = 0;
+                    success = encryptor.decryptFile(objectPath(storePath, entry.object), destination.string()) &&
+                              hashFile(destination.string(), digest, bytes);
+                    if (success && (bytes != entry.size || digest != entry.hash)) {
+                        success = false;
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        std::cerr << "Error: Restored content does not match the manifest: "
+                                  << destination.string() << std::endl;
+                    }
+                    if (success) {
+                        applyAttributes(destination, entry.mode, entry.mtime, entry.mtimeNanoseconds, false);
+                    }
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+                if (!success) {
+                    failed = true;
+                    std::error_code error;
+                    fs::remove(destination, error);
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: Could not restore " << destination.string() << std::endl;
+                }
+            }
+        });
+
+        try {
+            for (const auto& entry : manifest.entries) {
+                if (entry.isSymlink()) {
+                    fs::path destination = target / entry.path;
+                    fs::remove(destination);
+                    fs::create_symlink(entry.linkTarget, destination);
+                    applyAttributes(destination, entry.mode, entry.mtime, entry.mtimeNanoseconds, true);
+                }
+            }
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        for (auto it = manifest.entries.rbegin(); it != manifest.entries.rend(); ++it) {
+            if (it->isDirectory()) {
+                applyAttributes(it->path.empty() ? target : target / it->path, it->mode, it->mtime,
+                                it->mtimeNanoseconds, false);
+            }
+        }
+        return !failed;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef INCREMENTALSTORE_HPP
+#define INCREMENTALSTORE_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../Encryption/Encryption.hpp"
+#include "../Encryption/Crypto.hpp"
+
+// Incremental folder encryption
+// A store is a directory holding one encrypted object per file plus an encrypted manifest
+// describing the folder. Each sync re-encrypts only files that are new or changed since the
+// previous one, so repeated runs over a mostly unchanged folder cost time in proportion to the changes
+// Layout: <store>/manifest.enc and <store>/objects/<random id>.enc (one encryptFile output per file)
+namespace ArchiveHandler {
+
+    // Size of the random identifier naming a stored object
+    const size_t OBJECT_ID_SIZE = 16;
+
+    // One folder entry recorded in a store manifest
+    struct StoreEntry {
+        std::string path;              // Path relative to the folder, '/' separated ("" = the folder itself)
+        uint32_t mode = 0;             // Full st_mode (file type and permission bits)
+        uint64_t size = 0;             // File size in bytes (0 for directories and symlinks)
+        int64_t mtime = 0;             // Modification time (seconds since epoch)
+        int64_t mtimeNanoseconds = 0;  // Sub-second part of the modification time
+        Encryption::Sha256Digest hash{}; // SHA-256 of the file content (regular files only)
+        std::array<uint8_t, OBJECT_ID_SIZE> object{}; // Object holding the encrypted content (regular files only)
+        std::string linkTarget;        // Target of a symlink
+
+        bool isDirectory() const;
+        bool isRegularFile() const;
+        bool isSymlink() const;
+    };
+
+    // A path removed from the folder, kept so the store records what disappeared and when
+    struct StoreDeletion {
+        std::string path;
+        uint64_t generation = 0;  // Sync that noticed the deletion
+    };
+
+    // Decrypted contents of manifest.enc
+    struct StoreManifest {
+        uint64_t generation = 0;             // Number of syncs so far
+        std::vector<StoreEntry> entries;     // Sorted by path, so parents precede their children
+        std::vector<StoreDeletion> deletions; // Paths deleted since they were first stored
+    };
+
+    // What a sync did
+    struct SyncStats {
+        size_t unchanged = 0;      // Files skipped because size and modification time matched
+        size_t touched = 0;        // Files with a new modification time but identical content (not re-encrypted)
+        size_t changed = 0;        // Files re-encrypted because their content changed
+        size_t added = 0;          // New files encrypted
+        size_t deleted = 0;        // Entries recorded as deleted
+        size_t failed = 0;         // Files that could not be read or encrypted
+        uint64_t bytesHashed = 0;  // Content hashed to detect changes
+        uint64_t bytesEncrypted = 0; // Content encrypted into new objects
+    };
+
+    // Returns the default store path for a folder: "<folder>.encstore" beside it
+    std::string defaultStorePath(const std::string& folderPath);
+
+    // Brings the store at storePath up to date with the folder, creating it on first use
+    // Files whose size and modification time match the manifest are skipped without being read;
+    // the others are hashed, and only those whose content differs are encrypted into new objects
+    // Hashing and encryption run on threadCount workers (0 = all hardware threads)
+    // The new manifest replaces the old one atomically; objects it no longer references are then removed
+    // Requires an authenticated engine. Returns false if the folder cannot be scanned or the existing
+    // manifest cannot be decrypted (wrong password), leaving the store untouched, and also if any file
+    // fails - those keep their previously stored version (new files are left out) and the rest is committed
+    bool syncFolder(const std::string& folderPath, const std::string& storePath,
+                    Encryption::Encryptor& encryptor, SyncStats& stats, unsigned threadCount = 0);
+
+    // Recreates the folder recorded in a store at targetPath, restoring permissions and
+    // modification times. Files are decrypted in parallel on threadCount workers (0 = all hardware threads)
+    // and each is checked against the SHA-256 in the manifest; files that fail are removed
+    // Returns false if the manifest or any object cannot be decrypted or does not match its hash
+    bool restoreFolder(const std::string& storePath, const std::string& targetPath,
+                       Encryption::Encryptor& encryptor, unsigned threadCount = 0);
+
+    // Reads and decrypts a store's manifest
+    // Throws std::runtime_error if it is missing, corrupted or the password is wrong
+    StoreManifest loadStoreManifest(const std::string& storePath, Encryption::Encryptor& encryptor);
+
+    // Serializes a store manifest to its binary form
+    // Format: [magic][version][generation][entry count][entries][deletion count][deletions]
+    std::vector<char> serializeStoreManifest(const StoreManifest& manifest);
+
+    // Deserializes a store manifest, validating every length against the data
+    // Throws std::runtime_error for malformed data
+    StoreManifest deserializeStoreManifest(const std::vector<char>& data);
+}
+
+#endif
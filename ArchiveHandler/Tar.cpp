@@ -0,0 +1,497 @@
+#include "Tar.hpp"
+#include "../Utils/Instrumentation.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ArchiveHandler {
+
+    // Size of the buffer used to copy file data into the archive
+    static const size_t COPY_BUFFER_SIZE = 1024 * 1024;
+
+    // Limit on pax/GNU extension data kept in memory
+    static const uint64_t MAX_EXTENSION_SIZE = 1024 * 1024;
+
+    // Largest value that fits in an 11-digit octal size field
+    static const uint64_t MAX_OCTAL_SIZE = 077777777777ULL;
+
+    // Copies a string into a fixed-width header field (truncating if needed)
+    static void writeField(char* field, size_t width, const std::string& value) {
+        std::memcpy(field, value.data(), std::min(width, value.size()));
+    }
+
+    // Writes a number into a header field as NUL-terminated octal
+    // Values that do not fit use the base-256 encoding understood by GNU tar and bsdtar
+    static void writeNumber(char* field, size_t width, uint64_t value) {
+        uint64_t limit = 1ULL << (3 * (width - 1));
+        if (value < limit) {
+            std::string digits(width - 1, '0');
+            for (size_t i = width - 1; i > 0 && value != 0; --i) {
+                digits[i - 1] = static_cast<char>('0' + (value & 7));
+                value >>= 3;
+            }
+            std::memcpy(field, digits.data(), width - 1);
+            field[width - 1] = '\0';
+        } else {
+            field[0] = static_cast<char>(0x80);
+            for (size_t i = width - 1; i > 0; --i) {
+                field[i] = static_cast<char>(value & 0xFF);
+                value >>= 8;
+            }
+        }
+    }
+
+    // Parses an octal or base-256 numeric header field
+    static uint64_t parseNumber(const char* field, size_t width) {
+        uint64_t value = 0;
+
+        if (static_cast<unsigned char>(field[0]) & 0x80) {
+            for (size_t i = 1; i < width; ++i) {
+                value = (value << 8) | static_cast<unsigned char>(field[i]);
+            }
+            return value;
+        }
+
+        size_t i = 0;
+        while (i < width && (field[i] == ' ' || field[i] == '\0')) {
+            ++i;
+        }
+        while (i < width && field[i] >= '0' && field[i] <= '7') {
+            value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+            ++i;
+        }
+        return value;
+    }
+
+    // Reads a NUL-terminated string from a fixed-width header field
+    static std::string readField(const char* field, size_t width) {
+        return std::string(field, strnlen(field, width));
+    }
+
+    // Computes the header checksum with the checksum field treated as spaces
+    static uint64_t headerChecksum(const char* header) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < TAR_BLOCK_SIZE; ++i) {
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+        }
+        return sum;
+    }
+
+    // Formats one pax record: "<length> <key>=<value>\n", where length counts the whole record
+    static std::string paxRecord(const std::string& key, const std::string& value) {
+        size_t payload = key.size() + value.size() + 3;
+        size_t length = payload + std::to_string(payload).size();
+        if (std::to_string(length).size() != std::to_string(payload).size()) {
+            ++length;
+        }
+        return std::to_string(length) + " " + key + "=" + value + "\n";
+    }
+
+    // Splits a long name into ustar prefix and name fields at a '/' boundary
+    // Returns false if no split makes both parts fit
+    static bool splitName(const std::string& fullName, std::string& prefix, std::string& name) {
+        if (fullName.size() <= 100) {
+            prefix.clear();
+            name = fullName;
+            return true;
+        }
+
+        size_t position = fullName.rfind('/', std::min<size_t>(155, fullName.size() - 1));
+        while (position != std::string::npos && position > 0) {
+            if (fullName.size() - position - 1 <= 100 && fullName.size() - position - 1 > 0) {
+                prefix = fullName.substr(0, position);
+                name = fullName.substr(position + 1);
+                return true;
+            }
+            position = fullName.rfind('/', position - 1);
+        }
+        return false;
+    }
+
+    TarWriter::TarWriter(std::ostream& output) : output(output), bytesWritten(0) {}
+
+    // Writes an 'x' header followed by the pax records as its data
+    bool TarWriter::writePaxHeader(const std::string& name,
+                                   const std::vector<std::pair<std::string, std::string>>& records) {
+        std::string data;
+        for (const auto& record : records) {
+            data += paxRecord(record.first, record.second);
+        }
+
+        std::string baseName = name.substr(name.find_last_of('/', name.size() - 2) + 1);
+        char header[TAR_BLOCK_SIZE] = {};
+        writeField(header, 100, "PaxHeaders/" + baseName);
+        writeNumber(header + 100, 8, 0644);
+        writeNumber(header + 108, 8, 0);
+        writeNumber(header + 116, 8, 0);
+        writeNumber(header + 124, 12, data.size());
+        writeNumber(header + 136, 12, 0);
+        header[156] = 'x';
+        std::memcpy(header + 257, "ustar", 6);
+        std::memcpy(header + 263, "00", 2);
+        writeNumber(header + 148, 7, headerChecksum(header));
+        header[155] = ' ';
+
+        output.write(header, TAR_BLOCK_SIZE);
+        output.write(data.data(), data.size());
+        bytesWritten += TAR_BLOCK_SIZE + data.size();
+        return writePadding(data.size());
+    }
+
+    // Writes the ustar header for an entry, preceded by a pax header when fields overflow
+    bool TarWriter::writeHeader(const TarEntry& entry) {
+        std::vector<std::pair<std::string, std::string>> records;
+        std::string prefix, name;
+
+        if (!splitName(entry.name, prefix, name)) {
+            records.emplace_back("path", entry.name);
+            prefix.clear();
+            name = entry.name.substr(0, 100);
+        }
+        if (entry.linkName.size() > 100) {
+            records.emplace_back("linkpath", entry.linkName);
+        }
+        if (entry.size > MAX_OCTAL_SIZE) {
+            records.emplace_back("size", std::to_string(entry.size));
+        }
+        if (!records.empty() && !writePaxHeader(entry.name, records)) {
+            return false;
+        }
+
+        char header[TAR_BLOCK_SIZE] = {};
+        writeField(header, 100, name);
+        writeNumber(header + 100, 8, entry.mode & 07777);
+        writeNumber(header + 108, 8, 0);
+        writeNumber(header + 116, 8, 0);
+        writeNumber(header + 124, 12, entry.size);
+        writeNumber(header + 136, 12, static_cast<uint64_t>(std::max<int64_t>(entry.mtime, 0)));
+
+        switch (entry.type) {
+            case TarEntryType::Directory: header[156] = '5'; break;
+            case TarEntryType::Symlink:   header[156] = '2'; break;
+            case TarEntryType::Hardlink:  header[156] = '1'; break;
+            default:                      header[156] = '0'; break;
+        }
+
+        writeField(header + 157, 100, entry.linkName);
+        std::memcpy(header + 257, "ustar", 6);
+        std::memcpy(header + 263, "00", 2);
+        writeField(header + 345, 155, prefix);
+        writeNumber(header + 148, 7, headerChecksum(header));
+        header[155] = ' ';
+
+        output.write(header, TAR_BLOCK_SIZE);
+        bytesWritten += TAR_BLOCK_SIZE;
+        return !output.fail();
+    }
+
+    // Pads the data just written to a whole number of blocks
+    bool TarWriter::writePadding(uint64_t size) {
+        size_t padding = static_cast<size_t>((TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE);
+        if (padding > 0) {
+            char zeros[TAR_BLOCK_SIZE] = {};
+            output.write(zeros, padding);
+            bytesWritten += padding;
+        }
+        return !output.fail();
+    }
+
+    // Adds one filesystem entry, streaming file data in fixed-size pieces
+    bool TarWriter::addPath(const std::string& sourcePath, const std::string& archiveName) {
+        struct stat info;
+        if (lstat(sourcePath.c_str(), &info) != 0) {
+            std::cerr << "Error: Cannot access " << sourcePath << std::endl;
+            return false;
+        }
+        return addPath(sourcePath, archiveName, info);
+    }
+
+    // Adds one entry described by known lstat information
+    bool TarWriter::addPath(const std::string& sourcePath, const std::string& archiveName, const struct stat& info) {
+        TarEntry entry;
+        entry.name = archiveName;
+        entry.mode = info.st_mode & 07777;
+        entry.mtime = static_cast<int64_t>(info.st_mtime);
+
+        if (S_ISDIR(info.st_mode)) {
+            entry.type = TarEntryType::Directory;
+            if (entry.name.empty() || entry.name.back() != '/') {
+                entry.name += '/';
+            }
+            return writeHeader(entry);
+        }
+
+        if (S_ISLNK(info.st_mode)) {
+            std::vector<char> target(std::max<size_t>(static_cast<size_t>(info.st_size), 4096) + 1);
+            ssize_t length = readlink(sourcePath.c_str(), target.data(), target.size());
+            if (length < 0) {
+                std::cerr << "Error: Cannot read symlink " << sourcePath << std::endl;
+                return false;
+            }
+            entry.type = TarEntryType::Symlink;
+            entry.linkName.assign(target.data(), static_cast<size_t>(length));
+            return writeHeader(entry);
+        }
+
+        if (!S_ISREG(info.st_mode)) {
+            std::cerr << "Warning: Skipping unsupported file type: " << sourcePath << std::endl;
+            return true;
+        }
+
+        // Later links to an already archived inode are stored as hard links
+        if (info.st_nlink > 1) {
+            auto key = std::make_pair(static_cast<uint64_t>(info.st_dev), static_cast<uint64_t>(info.st_ino));
+            auto existing = hardlinks.find(key);
+            if (existing != hardlinks.end()) {
+                entry.type = TarEntryType::Hardlink;
+                entry.linkName = existing->second;
+                return writeHeader(entry);
+            }
+            hardlinks.emplace(key, archiveName);
+        }
+
+        std::ifstream file(sourcePath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open file " << sourcePath << std::endl;
+            return false;
+        }
+
+        entry.type = TarEntryType::File;
+        entry.size = static_cast<uint64_t>(info.st_size);
+        if (!writeHeader(entry)) {
+            return false;
+        }
+
+        // Copy exactly the size recorded in the header
+        std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(COPY_BUFFER_SIZE, entry.size)));
+        uint64_t copied = 0;
+        while (copied < entry.size) {
+            size_t blockSize = static_cast<size_t>(std::min<uint64_t>(buffer.size(), entry.size - copied));
+            {
+                Utils::StageTimer timer(Utils::Stage::Archive, blockSize);
+                file.read(buffer.data(), blockSize);
+            }
+            if (file.gcount() != static_cast<std::streamsize>(blockSize)) {
+                std::cerr << "Error: File changed while archiving: " << sourcePath << std::endl;
+                return false;
+            }
+            output.write(buffer.data(), blockSize);
+            if (output.fail()) {
+                return false;
+            }
+            copied += blockSize;
+        }
+        bytesWritten += entry.size;
+
+        return writePadding(entry.size);
+    }
+
+    // Terminates the archive with two zero blocks
+    bool TarWriter::finish() {
+        char zeros[TAR_BLOCK_SIZE * 2] = {};
+        output.write(zeros, sizeof(zeros));
+        bytesWritten += sizeof(zeros);
+        output.flush();
+        return !output.fail();
+    }
+
+    TarReader::TarReader(std::istream& input) : input(input), remaining(0), padding(0), error(false) {}
+
+    // Reads exactly size bytes from the archive
+    bool TarReader::readExact(char* buffer, size_t size) {
+        input.read(buffer, size);
+        if (input.gcount() != static_cast<std::streamsize>(size)) {
+            error = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Reads the data of an extension header, including its padding
+    bool TarReader::readExtensionData(uint64_t size, std::string& data) {
+        if (size > MAX_EXTENSION_SIZE) {
+            error = true;
+            return false;
+        }
+        data.resize(static_cast<size_t>(size));
+        if (!readExact(&data[0], data.size())) {
+            return false;
+        }
+        remaining = 0;
+        padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+        return skip();
+    }
+
+    // Parses headers until the next real entry, applying pax and GNU long-name extensions
+    bool TarReader::next(TarEntry& entry) {
+        if (error || !skip()) {
+            return false;
+        }
+
+        std::string longName, longLink;
+        bool hasSize = false;
+        uint64_t paxSize = 0;
+
+        while (true) {
+            char header[TAR_BLOCK_SIZE];
+            input.read(header, TAR_BLOCK_SIZE);
+            if (input.gcount() == 0) {
+                return false; // Archive ended without end-of-archive marker
+            }
+            if (input.gcount() != static_cast<std::streamsize>(TAR_BLOCK_SIZE)) {
+                error = true;
+                return false;
+            }
+
+            // A zero block marks the end of the archive
+            if (std::all_of(header, header + TAR_BLOCK_SIZE, [](char c) { return c == 0; })) {
+                return false;
+            }
+
+            if (parseNumber(header + 148, 8) != headerChecksum(header)) {
+                std::cerr << "Error: Corrupted archive - header checksum mismatch" << std::endl;
+                error = true;
+                return false;
+            }
+
+            char typeFlag = header[156];
+            uint64_t size = parseNumber(header + 124, 12);
+
+            // pax extended header for the next entry
+            if (typeFlag == 'x') {
+                std::string data;
+                if (!readExtensionData(size, data)) {
+                    return false;
+                }
+                size_t position = 0;
+                while (position < data.size()) {
+                    size_t space = data.find(' ', position);
+                    if (space == std::string::npos) {
+                        break;
+                    }
+                    size_t length = std::strtoull(data.c_str() + position, nullptr, 10);
+                    if (length == 0 || position + length > data.size()) {
+                        break;
+                    }
+                    std::string record = data.substr(space + 1, position + length - space - 2);
+                    size_t equals = record.find('=');
+                    if (equals != std::string::npos) {
+                        std::string key = record.substr(0, equals);
+                        std::string value = record.substr(equals + 1);
+                        if (key == "path") {
+                            longName = value;
+                        } else if (key == "linkpath") {
+                            longLink = value;
+                        } else if (key == "size") {
+                            paxSize = std::strtoull(value.c_str(), nullptr, 10);
+                            hasSize = true;
+                        }
+                    }
+                    position += length;
+                }
+                continue;
+            }
+
+            // GNU long name / long link
+            if (typeFlag == 'L' || typeFlag == 'K') {
+                std::string data;
+                if (!readExtensionData(size, data)) {
+                    return false;
+                }
+                data = data.substr(0, strnlen(data.c_str(), data.size()));
+                (typeFlag == 'L' ? longName : longLink) = data;
+                continue;
+            }
+
+            // pax global header - nothing we need, skip it
+            if (typeFlag == 'g') {
+                remaining = size;
+                padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+                if (!skip()) {
+                    return false;
+                }
+                continue;
+            }
+
+            entry = TarEntry();
+            entry.name = readField(header, 100);
+            if (std::memcmp(header + 257, "ustar", 6) == 0) {
+                std::string prefix = readField(header + 345, 155);
+                if (!prefix.empty()) {
+                    entry.name = prefix + "/" + entry.name;
+                }
+            }
+            if (!longName.empty()) {
+                entry.name = longName;
+            }
+            entry.linkName = longLink.empty() ? readField(header + 157, 100) : longLink;
+            entry.mode = static_cast<uint32_t>(parseNumber(header + 100, 8) & 07777);
+            entry.mtime = static_cast<int64_t>(parseNumber(header + 136, 12));
+            entry.size = hasSize ? paxSize : size;
+
+            switch (typeFlag) {
+                case '0': case '\0': case '7': entry.type = TarEntryType::File; break;
+                case '5': entry.type = TarEntryType::Directory; break;
+                case '2': entry.type = TarEntryType::Symlink; break;
+                case '1': entry.type = TarEntryType::Hardlink; break;
+                default:  entry.type = TarEntryType::Other; break;
+            }
+
+            // Old-style archives mark directories only by a trailing slash
+            if (entry.type == TarEntryType::File && !entry.name.empty() && entry.name.back() == '/') {
+                entry.type = TarEntryType::Directory;
+            }
+
+            remaining = entry.type == TarEntryType::Directory ? 0 : entry.size;
+            padding = (TAR_BLOCK_SIZE - remaining % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+            return true;
+        }
+    }
+
+    // Reads data from the current entry
+    size_t TarReader::read(char* buffer, size_t size) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(size, remaining));
+        if (count == 0 || !readExact(buffer, count)) {
+            return 0;
+        }
+        remaining -= count;
+        return count;
+    }
+
+    // Discards remaining data and padding of the current entry
+    bool TarReader::skip() {
+        uint64_t toSkip = remaining + padding;
+        char buffer[4096];
+        while (toSkip > 0) {
+            size_t count = static_cast<size_t>(std::min<uint64_t>(sizeof(buffer), toSkip));
+            if (!readExact(buffer, count)) {
+                return false;
+            }
+            toSkip -= count;
+        }
+        remaining = 0;
+        padding = 0;
+        return true;
+    }
+
+    // Checks that a name stays inside the extraction folder
+    bool isSafeEntryName(const std::string& name) {
+        if (name.empty() || name[0] == '/') {
+            return false;
+        }
+
+        std::stringstream ss(name);
+        std::string component;
+        while (std::getline(ss, component, '/')) {
+            if (component == "..") {
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef TAR_HPP
+#define TAR_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <iosfwd>
+#include <cstdint>
+#include <sys/stat.h>
+
+// In-process tar support for folder archiving
+// Writes POSIX ustar archives, using pax extended headers for long paths and large sizes,
+// and reads ustar, pax and GNU long-name archives (as produced by the system tar command)
+namespace ArchiveHandler {
+
+    // Size of a tar header or data block
+    const size_t TAR_BLOCK_SIZE = 512;
+
+    // Entry types supported by the reader and writer
+    enum class TarEntryType {
+        File,       // Regular file with data
+        Directory,  // Directory (no data)
+        Symlink,    // Symbolic link to linkName
+        Hardlink,   // Hard link to a previously archived entry named linkName
+        Other       // Anything else - data is skipped on extraction
+    };
+
+    // Description of one archive entry
+    struct TarEntry {
+        std::string name;      // Relative path inside the archive (directories end with '/')
+        TarEntryType type = TarEntryType::File;
+        uint32_t mode = 0644;  // Permission bits
+        uint64_t size = 0;     // Size of the entry's data in bytes
+        int64_t mtime = 0;     // Modification time (seconds since epoch)
+        std::string linkName;  // Target for symlinks and hard links
+    };
+
+    // Streaming tar writer - serializes entries straight into an output stream
+    // Nothing is buffered beyond one copy block, so archives of any size can be produced
+    class TarWriter {
+    private:
+        std::ostream& output;
+        uint64_t bytesWritten;
+        std::map<std::pair<uint64_t, uint64_t>, std::string> hardlinks; // (device, inode) -> first archived name
+
+        // Writes a pax extended header carrying records that do not fit the ustar header
+        bool writePaxHeader(const std::string& name, const std::vector<std::pair<std::string, std::string>>& records);
+
+        // Writes a single 512-byte ustar header (with pax header first if needed)
+        bool writeHeader(const TarEntry& entry);
+
+        // Writes zero padding up to the next block boundary
+        bool writePadding(uint64_t size);
+
+    public:
+        explicit TarWriter(std::ostream& output);
+
+        // Adds a file, directory or symlink from disk under the given archive name
+        // Repeated hard links to one file are stored as hard link entries
+        // Returns false on I/O errors; unsupported file types are skipped with a warning
+        bool addPath(const std::string& sourcePath, const std::string& archiveName);
+
+        // Same as above, using lstat information the caller already has (e.g. from a folder scan)
+        bool addPath(const std::string& sourcePath, const std::string& archiveName, const struct stat& info);
+
+        // Writes the end-of-archive marker (two zero blocks)
+        bool finish();
+
+        // Returns the number of archive bytes written so far
+        uint64_t size() const { return bytesWritten; }
+    };
+
+    // Streaming tar reader - parses entries sequentially from an input stream
+    class TarReader {
+    private:
+        std::istream& input;
+        uint64_t remaining;  // Data bytes left in the current entry
+        uint64_t padding;    // Padding bytes after the current entry's data
+        bool error;
+
+        // Reads exactly size bytes, setting the error flag on short reads
+        bool readExact(char* buffer, size_t size);
+
+        // Reads an extension entry's data (pax records or GNU long names) into memory
+        bool readExtensionData(uint64_t size, std::string& data);
+
+    public:
+        explicit TarReader(std::istream& input);
+
+        // Advances to the next entry, skipping any unread data of the current one
+        // Returns false at the end of the archive or on error (see failed())
+        bool next(TarEntry& entry);
+
+        // Reads up to size bytes of the current entry's data
+        // Returns the number of bytes read (0 once the entry's data is exhausted)
+        size_t read(char* buffer, size_t size);
+
+        // Skips the rest of the current entry's data
+        bool skip();
+
+        // Returns true if a malformed archive or read error was encountered
+        bool failed() const { return error; }
+    };
+
+    // Returns true if an archive entry name is safe to extract
+    // Rejects absolute paths and any ".." component that could escape the target folder
+    bool isSafeEntryName(const std::string& name);
+}
+
+#endif
@@ -0,0 +1,1145 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../Utils/Utils.hpp"
+#include "../FileHandler/FileHandler.hpp"
+#include "../FileHandler/AsyncIO.hpp"
+#include "../Encryption/Encryption.hpp"
+#include "../Encryption/XorKernel.hpp"
+#include "../Encryption/Crypto.hpp"
+#include "../Compression/Compression.hpp"
+#include "../ArchiveHandler/ArchiveHandler.hpp"
+#include "../ArchiveHandler/Tar.hpp"
+#include "../ArchiveHandler/FolderScanner.hpp"
+#include "../ArchiveHandler/FolderContainer.hpp"
+#include "../ArchiveHandler/Chunker.hpp"
+
+// FileCrypt benchmark suite
+// Micro-benchmarks for the hot primitives (keystream, XOR kernels, cipher engines, checksums, hashing,
+// metadata serialization, file I/O) and end-to-end benchmarks for file and folder encryption.
+// Results are written as JSON so runs can be compared between releases.
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// Settings collected from the command line
+struct BenchmarkOptions {
+    std::string outputPath;          // JSON destination (empty = standard output)
+    std::string scratchDirectory;    // Where end-to-end test files are created
+    uint64_t maxSize = 256ull << 20; // Largest file size used by end-to-end benchmarks
+    double minTime = 0.5;            // Minimum measured time per benchmark in seconds
+    std::string filter;              // Only run benchmarks whose name contains this
+    unsigned threads = 0;            // Threads for the parallel runs (0 = hardware threads)
+};
+
+// One measured benchmark
+struct BenchmarkResult {
+    std::string group;          // "micro", "file", "io" or "folder"
+    std::string name;           // Unique name, e.g. "encryptFile/aes-256-gcm/16M/t1"
+    uint64_t bytesPerIteration; // Payload bytes processed by one iteration (0 if not meaningful)
+    uint64_t iterations;
+    double seconds;             // Total measured time
+    double compressionRatio;    // Original size / stored size (0 when not compressing)
+    double speedup;             // Single-threaded time / this time (0 outside thread sweeps)
+};
+
+static std::vector<BenchmarkResult> results;
+static BenchmarkOptions options;
+
+// Fills a buffer with pseudo-random bytes (xorshift64) - incompressible and fast to generate
+static void fillRandom(char* data, size_t length, uint64_t seed) {
+    uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+    for (size_t i = 0; i < length; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = static_cast<char>(state >> 56);
+    }
+}
+
+// Fills a buffer with log-like text, a typical compressible input
+static void fillText(char* data, size_t length, uint64_t seed) {
+    static const char* words[] = {"INFO", "WARN", "ERROR", "request", "user", "session", "GET", "POST",
+                                  "/api/v1/items", "latency_ms=", "status=200", "status=404", "retry"};
+    uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+    std::string line;
+    size_t filled = 0;
+    for (uint64_t lineNumber = 0; filled < length; ++lineNumber) {
+        line = "2026-01-01T00:00:" + std::to_string(lineNumber % 60) + " ";
+        for (int i = 0; i < 5; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            line += words[state % 13];
+            line += ' ';
+            line += std::to_string((state >> 20) % 100000);
+            line += ' ';
+        }
+        line += '\n';
+        size_t count = std::min(line.size(), length - filled);
+        std::memcpy(data + filled, line.data(), count);
+        filled += count;
+    }
+}
+
+// Formats a byte count as a short size label (1K, 16M, 10G)
+static std::string sizeLabel(uint64_t bytes) {
+    const char* units[] = {"", "K", "M", "G", "T"};
+    int unit = 0;
+    while (bytes >= 1024 && bytes % 1024 == 0 && unit < 4) {
+        bytes /= 1024;
+        ++unit;
+    }
+    return std::to_string(bytes) + units[unit];
+}
+
+// Parses sizes such as 4096, 64K, 256M or 10G
+static bool parseSize(const std::string& text, uint64_t& bytes) {
+    try {
+        size_t used = 0;
+        double value = std::stod(text, &used);
+        std::string suffix = text.substr(used);
+        uint64_t multiplier = 1;
+        if (suffix == "K" || suffix == "k") {
+            multiplier = 1ull << 10;
+        } else if (suffix == "M" || suffix == "m") {
+            multiplier = 1ull << 20;
+        } else if (suffix == "G" || suffix == "g") {
+            multiplier = 1ull << 30;
+        } else if (!suffix.empty()) {
+            return false;
+        }
+        if (value < 0) {
+            return false;
+        }
+        bytes = static_cast<uint64_t>(value * multiplier);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+static bool selected(const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// Runs operation repeatedly until minTime has elapsed (at least once) and records the result
+// setup runs before every iteration and is not timed; returns false if the filter skipped it
+static bool measure(const std::string& group, const std::string& name, uint64_t bytesPerIteration,
+                    const std::function<void()>& operation, const std::function<void()>& setup = nullptr) {
+    if (!selected(name)) {
+        return false;
+    }
+
+    double seconds = 0;
+    uint64_t iterations = 0;
+    while (iterations == 0 || seconds < options.minTime) {
+        if (setup) {
+            setup();
+        }
+        Clock::time_point start = Clock::now();
+        operation();
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        ++iterations;
+    }
+
+    results.push_back({group, name, bytesPerIteration, iterations, seconds, 0, 0});
+
+    double perIteration = seconds / iterations;
+    std::cerr << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << perIteration * 1e3 << " ms";
+    if (bytesPerIteration > 0) {
+        std::cerr << std::setw(12) << std::setprecision(1) << (bytesPerIteration / perIteration / 1e6) << " MB/s";
+    }
+    std::cerr << std::endl;
+    return true;
+}
+
+// Attaches a compression ratio to the most recent result
+static void recordRatio(uint64_t originalSize, uint64_t storedSize) {
+    if (!results.empty() && storedSize > 0) {
+        results.back().compressionRatio = static_cast<double>(originalSize) / storedSize;
+        std::cerr << std::left << std::setw(48) << "" << std::right << std::setprecision(2)
+                  << "ratio " << results.back().compressionRatio << ":1" << std::endl;
+    }
+}
+
+// Attaches the speedup over the single-threaded result baselineName to the most recent result
+// Does nothing if the baseline did not run (e.g. excluded by the filter)
+static void recordSpeedup(const std::string& baselineName) {
+    for (const BenchmarkResult& baseline : results) {
+        if (baseline.name == baselineName) {
+            BenchmarkResult& result = results.back();
+            result.speedup = (baseline.seconds / baseline.iterations) / (result.seconds / result.iterations);
+            std::cerr << std::left << std::setw(48) << "" << std::right << std::setprecision(2)
+                      << "speedup " << result.speedup << "x" << std::endl;
+            return;
+        }
+    }
+}
+
+// Writes a test file of the given size from a repeated random block
+static void createFile(const std::string& path, uint64_t size, uint64_t seed) {
+    std::vector<char> block(1 << 20);
+    fillRandom(block.data(), block.size(), seed);
+    std::ofstream output(path, std::ios::binary);
+    for (uint64_t written = 0; written < size; ) {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(block.size(), size - written));
+        block[0] = static_cast<char>(written >> 20); // keep blocks distinct
+        output.write(block.data(), length);
+        written += length;
+    }
+    if (!output) {
+        throw std::runtime_error("Could not create benchmark file " + path);
+    }
+}
+
+// Reports the first byte where a kernel's output differs from the reference
+static bool sameBytes(const char* actual, const char* expected, size_t length, const std::string& what) {
+    for (size_t i = 0; i < length; ++i) {
+        if (actual[i] != expected[i]) {
+            std::cerr << "Error: " << what << " differs from the scalar reference at byte " << i << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checks every XOR kernel this CPU supports against the scalar reference, byte for byte
+// Covers random lengths around the vector and unroll widths, unaligned buffers, repeating keys
+// whose length is not a multiple of the vector width, and keystream periods wrapping mid-buffer
+static bool verifyXorKernels() {
+    using namespace Encryption::XorKernel;
+    const size_t maxLength = 8192;
+    const size_t maxShift = 64;
+    std::vector<char> input(maxLength + maxShift), key(maxLength + maxShift);
+    std::vector<char> output(maxLength + maxShift), expected(maxLength + maxShift);
+    fillRandom(input.data(), input.size(), 11);
+    fillRandom(key.data(), key.size(), 12);
+
+    std::mt19937_64 random(13);
+    std::vector<size_t> lengths;
+    for (size_t length = 0; length <= 520; ++length) {
+        lengths.push_back(length);
+    }
+    for (int i = 0; i < 200; ++i) {
+        lengths.push_back(random() % (maxLength + 1));
+    }
+
+    bool ok = true;
+    for (const Kernel& kernel : supportedKernels()) {
+        std::string name = std::string("xor kernel ") + kernel.name;
+
+        // Block form at independent misalignments of output, input and key
+        for (size_t length : lengths) {
+            size_t outputShift = random() % maxShift;
+            size_t inputShift = random() % maxShift;
+            size_t keyShift = random() % maxShift;
+            std::fill(output.begin(), output.end(), 0);
+            std::fill(expected.begin(), expected.end(), 0);
+            kernel.function(output.data() + outputShift, input.data() + inputShift, key.data() + keyShift, length);
+            xorBlockScalar(expected.data() + outputShift, input.data() + inputShift, key.data() + keyShift, length);
+            // The whole buffer is compared so a write past the end is caught too
+            ok &= sameBytes(output.data(), expected.data(), output.size(),
+                            name + " (length " + std::to_string(length) + ")");
+
+            // In place
+            std::copy(input.begin(), input.end(), output.begin());
+            kernel.function(output.data() + inputShift, output.data() + inputShift, key.data() + keyShift, length);
+            std::copy(input.begin(), input.end(), expected.begin());
+            xorBlockScalar(expected.data() + inputShift, key.data() + keyShift, length);
+            ok &= sameBytes(output.data(), expected.data(), output.size(),
+                            name + " in place (length " + std::to_string(length) + ")");
+            if (!ok) {
+                return false;
+            }
+        }
+
+        // Repeating keys, checked against the definition data[i] ^ key[(offset + i) % keyLength]
+        for (size_t keyLength : {1, 3, 15, 17, 31, 33, 63, 65, 127, 129, 255, 257, 1000, 4099}) {
+            for (int round = 0; round < 8; ++round) {
+                size_t length = random() % (maxLength + 1);
+                size_t keyOffset = random() % (3 * keyLength);
+                size_t shift = random() % maxShift;
+                xorRepeating(kernel.function, output.data() + shift, input.data(), length,
+                             key.data(), keyLength, keyOffset);
+                for (size_t i = 0; i < length; ++i) {
+                    expected[shift + i] = input[i] ^ key[(keyOffset + i) % keyLength];
+                }
+                ok &= sameBytes(output.data() + shift, expected.data() + shift, length,
+                                name + " repeating (key length " + std::to_string(keyLength) + ")");
+                if (!ok) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Keystream through the selected kernel, across period and table (64 KiB+) boundaries
+    // Key byte i is password[i % len] ^ (i % 256) by definition
+    for (const std::string password : {"k", "seven77", "a password of 33 characters long!"}) {
+        Encryption::Keystream keystream(password);
+        for (int round = 0; round < 16; ++round) {
+            size_t length = random() % (maxLength + 1);
+            uint64_t offset = random() % (1 << 18) + (round % 2 ? (1ull << 40) : 0);
+            keystream.apply(output.data(), input.data(), length, offset);
+            for (size_t i = 0; i < length; ++i) {
+                uint64_t position = offset + i;
+                expected[i] = input[i] ^ static_cast<char>(password[position % password.size()] ^
+                                                           static_cast<char>(position % 256));
+            }
+            ok &= sameBytes(output.data(), expected.data(), length,
+                            "keystream (password length " + std::to_string(password.size()) + ")");
+        }
+    }
+    return ok;
+}
+
+// Extracts a crafted archive that stores a symlink out of the target folder and then a file
+// below it; extraction must fail without writing anything outside the target folder
+static bool verifyArchiveExtraction() {
+    fs::path root = fs::path(options.scratchDirectory) / "slip";
+    fs::path outside = root / "outside";
+    fs::path source = root / "source";
+    fs::create_directories(outside);
+    fs::create_directories(source);
+    fs::create_symlink(outside, source / "link");
+    std::ofstream(source / "escaped.txt") << "escaped";
+
+    std::string archivePath = (root / "evil.tar").string();
+    {
+        std::ofstream archive(archivePath, std::ios::binary);
+        ArchiveHandler::TarWriter writer(archive);
+        if (!writer.addPath(source.string(), "d") ||
+            !writer.addPath((source / "link").string(), "d/link") ||
+            !writer.addPath((source / "escaped.txt").string(), "d/link/escaped.txt") || !writer.finish()) {
+            std::cerr << "Error: Could not write " << archivePath << std::endl;
+            return false;
+        }
+    }
+
+    // The refusal is expected, so its message is not shown
+    std::streambuf* errorBuffer = std::cerr.rdbuf(nullptr);
+    bool extracted = ArchiveHandler::extractArchiveToFolder(archivePath, (root / "target").string());
+    std::cerr.rdbuf(errorBuffer);
+    bool escaped = fs::exists(outside / "escaped.txt");
+    fs::remove_all(root);
+    if (extracted || escaped) {
+        std::cerr << "Error: archive extraction followed a symlink out of the target folder" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Primitive benchmarks on in-memory buffers
+static void runMicroBenchmarks() {
+    const size_t bufferSize = 16 << 20;
+    std::vector<char> data(bufferSize), key(bufferSize), output(bufferSize);
+    fillRandom(data.data(), data.size(), 1);
+    fillRandom(key.data(), key.size(), 2);
+
+    // Keystream generation and application (legacy engine)
+    Encryption::Keystream keystream("benchmark password");
+    measure("micro", "keystream/generate/1M", 1 << 20, [&]() {
+        std::vector<char> generated = keystream.generate(1 << 20, 12345);
+        (void)generated;
+    });
+    measure("micro", "keystream/apply/16M", bufferSize, [&]() {
+        keystream.apply(output.data(), data.data(), bufferSize, 777);
+    });
+
+    // XOR kernels: every one this CPU supports, down to the portable reference
+    for (const Encryption::XorKernel::Kernel& kernel : Encryption::XorKernel::supportedKernels()) {
+        measure("micro", std::string("xor_kernel/") + kernel.name + "/16M", bufferSize, [&]() {
+            kernel.function(output.data(), data.data(), key.data(), bufferSize);
+        });
+    }
+
+    // Cipher engines, one full segment at a time
+    uint8_t engineKey[32];
+    fillRandom(reinterpret_cast<char*>(engineKey), sizeof(engineKey), 3);
+    Encryption::AesGcmEngine aesEngine(engineKey);
+    Encryption::XorEngine xorEngine(keystream);
+    std::vector<char> tags(aesEngine.tagBytes(bufferSize));
+    const Encryption::CipherEngine* engines[] = {&aesEngine, &xorEngine};
+    for (const Encryption::CipherEngine* engine : engines) {
+        std::string engineName = Encryption::engineName(engine->type());
+        measure("micro", "engine/" + engineName + "/encrypt/16M", bufferSize, [&]() {
+            for (size_t offset = 0; offset < bufferSize; offset += Encryption::SEGMENT_SIZE) {
+                engine->encryptSegment(output.data() + offset, data.data() + offset, Encryption::SEGMENT_SIZE,
+                                       offset, tags.data() + offset / Encryption::SEGMENT_SIZE * engine->tagSize());
+            }
+        });
+        std::vector<char> ciphertext(bufferSize);
+        for (size_t offset = 0; offset < bufferSize; offset += Encryption::SEGMENT_SIZE) {
+            engine->encryptSegment(ciphertext.data() + offset, data.data() + offset, Encryption::SEGMENT_SIZE,
+                                   offset, tags.data() + offset / Encryption::SEGMENT_SIZE * engine->tagSize());
+        }
+        measure("micro", "engine/" + engineName + "/decrypt/16M", bufferSize, [&]() {
+            for (size_t offset = 0; offset < bufferSize; offset += Encryption::SEGMENT_SIZE) {
+                if (!engine->decryptSegment(output.data() + offset, ciphertext.data() + offset, Encryption::SEGMENT_SIZE,
+                                            offset, tags.data() + offset / Encryption::SEGMENT_SIZE * engine->tagSize())) {
+                    throw std::runtime_error("Engine benchmark failed to authenticate");
+                }
+            }
+        });
+    }
+
+    // Buffer API: the copying vector form against sealing and opening in the caller's buffer
+    // The first call pays for the password-based key derivation, so it runs before timing
+    Encryption::Encryptor bufferEncryptor("benchmark password");
+    std::vector<char> sealed = bufferEncryptor.encryptData(data);
+    measure("micro", "encryptData/copy/16M", bufferSize, [&]() {
+        sealed = bufferEncryptor.encryptData(data);
+    });
+    measure("micro", "decryptData/copy/16M", bufferSize, [&]() {
+        std::vector<char> opened = bufferEncryptor.decryptData(sealed);
+        (void)opened;
+    });
+    std::vector<char> inPlace(bufferEncryptor.dataOverhead() + bufferSize);
+    measure("micro", "encryptData/inplace/16M", bufferSize, [&]() {
+        bufferEncryptor.encryptDataInPlace(inPlace.data(), bufferSize);
+    }, [&]() {
+        std::memcpy(inPlace.data() + bufferEncryptor.dataOverhead(), data.data(), bufferSize);
+    });
+    measure("micro", "decryptData/inplace/16M", bufferSize, [&]() {
+        bufferEncryptor.decryptDataInPlace(inPlace.data(), sealed.size());
+    }, [&]() {
+        std::memcpy(inPlace.data(), sealed.data(), sealed.size());
+    });
+
+    // CRC32C checksums: the kernel selected for this CPU and the portable reference
+    measure("micro", std::string("crc32c/") + Encryption::Checksum::activeKernelName() + "/16M", bufferSize, [&]() {
+        volatile uint32_t crc = Encryption::Checksum::crc32c(data.data(), bufferSize);
+        (void)crc;
+    });
+    measure("micro", "crc32c/scalar/16M", bufferSize, [&]() {
+        volatile uint32_t crc = Encryption::Checksum::crc32cScalar(data.data(), bufferSize);
+        (void)crc;
+    });
+
+    // Hashing and key derivation
+    measure("micro", std::string("sha256/") + Encryption::Sha256::activeKernelName() + "/16M", bufferSize, [&]() {
+        Encryption::Sha256Digest digest = Encryption::Sha256::hash(data.data(), bufferSize);
+        (void)digest;
+    });
+
+    // Content-defined chunk boundaries, as found for deduplicated containers
+    measure("micro", "chunkBoundaries/16M", bufferSize, [&]() {
+        volatile size_t chunks = 0;
+        for (size_t position = 0; position < bufferSize; ++chunks) {
+            position += ArchiveHandler::findChunkBoundary(data.data() + position, bufferSize - position);
+        }
+    });
+    measure("micro", "pbkdf2_sha256/10000_iterations", 0, [&]() {
+        uint8_t derived[32];
+        const uint8_t salt[16] = {};
+        Encryption::pbkdf2Sha256("benchmark password", salt, sizeof(salt), 10000, derived, sizeof(derived));
+    });
+
+    // LZ block compression in 1 MiB blocks, as used before encryption
+    std::vector<char> text(bufferSize);
+    fillText(text.data(), text.size(), 4);
+    const size_t compressionBlock = Encryption::SEGMENT_SIZE;
+    std::vector<char> compressed(bufferSize / compressionBlock * Compression::compressBound(compressionBlock));
+    std::vector<size_t> compressedSizes(bufferSize / compressionBlock);
+    const std::vector<char>* compressionInputs[] = {&text, &data};
+    const char* compressionLabels[] = {"text", "random"};
+    for (int input = 0; input < 2; ++input) {
+        const std::vector<char>& source = *compressionInputs[input];
+        std::string label = compressionLabels[input];
+        auto compressAll = [&]() {
+            for (size_t i = 0; i < compressedSizes.size(); ++i) {
+                compressedSizes[i] = Compression::compressBlock(source.data() + i * compressionBlock, compressionBlock,
+                                                                compressed.data() + i * Compression::compressBound(compressionBlock),
+                                                                Compression::compressBound(compressionBlock));
+            }
+        };
+        compressAll();
+        uint64_t total = 0;
+        for (size_t size : compressedSizes) {
+            total += size;
+        }
+        if (measure("micro", "lz/compress/" + label + "/16M", bufferSize, compressAll)) {
+            recordRatio(bufferSize, total);
+        }
+        measure("micro", "lz/decompress/" + label + "/16M", bufferSize, [&]() {
+            for (size_t i = 0; i < compressedSizes.size(); ++i) {
+                if (!Compression::decompressBlock(compressed.data() + i * Compression::compressBound(compressionBlock),
+                                                  compressedSizes[i], output.data() + i * compressionBlock, compressionBlock)) {
+                    throw std::runtime_error("Decompression benchmark failed");
+                }
+            }
+        });
+    }
+
+    // Metadata serialization - 1000 operations per iteration
+    Encryption::FileMetadata metadata;
+    metadata.originalFilename = "quarterly-report-final-v2.xlsx";
+    metadata.extension = ".xlsx";
+    metadata.contentSize = 123456789;
+    std::vector<char> serialized = Encryption::serializeMetadata(metadata);
+    measure("micro", "serializeMetadata/x1000", 0, [&]() {
+        for (int i = 0; i < 1000; ++i) {
+            std::vector<char> result = Encryption::serializeMetadata(metadata);
+            (void)result;
+        }
+    });
+    measure("micro", "deserializeMetadata/x1000", 0, [&]() {
+        for (int i = 0; i < 1000; ++i) {
+            Encryption::FileMetadata result = Encryption::deserializeMetadata(serialized);
+            (void)result;
+        }
+    });
+}
+
+// FileHandler::readFile/writeFile at each size that fits in memory comfortably
+static void runFileHandlerBenchmarks(const std::vector<uint64_t>& sizes) {
+    std::string path = (fs::path(options.scratchDirectory) / "io.dat").string();
+    for (uint64_t size : sizes) {
+        if (size > (1ull << 30)) {
+            continue; // whole-file buffers beyond 1 GiB are not a supported use of these functions
+        }
+        std::string label = sizeLabel(size);
+        std::vector<char> data(static_cast<size_t>(size));
+        fillRandom(data.data(), data.size(), size);
+
+        measure("micro", "writeFile/" + label, size, [&]() {
+            if (!FileHandler::writeFile(path, data)) {
+                throw std::runtime_error("writeFile failed");
+            }
+        });
+        measure("micro", "readFile/" + label, size, [&]() {
+            std::vector<char> loaded;
+            if (!FileHandler::readFile(path, loaded)) {
+                throw std::runtime_error("readFile failed");
+            }
+        });
+        fs::remove(path);
+    }
+}
+
+// encryptFile/decryptFile for each engine, size and thread count, plus the integrity checks
+// (verifyChecksums, verifyFile) and the password change (rekeyFile) on the authenticated files
+static void runFileBenchmarks(const std::vector<uint64_t>& sizes) {
+    fs::path directory(options.scratchDirectory);
+    std::string plainPath = (directory / "plain.dat").string();
+    std::string encryptedPath = (directory / "plain.dat.enc").string();
+    std::string decryptedPath = (directory / "decrypted.dat").string();
+
+    // Powers of two up to the parallel thread count, which is always included
+    unsigned parallelThreads = options.threads == 0 ? Utils::getDefaultThreadCount() : options.threads;
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < parallelThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(std::max(parallelThreads, 1u));
+
+    Encryption::EngineType engineTypes[] = {Encryption::EngineType::Aes256Gcm, Encryption::EngineType::LegacyXor};
+    Encryption::Encryptor encryptor("benchmark password");
+
+    for (uint64_t size : sizes) {
+        std::string label = sizeLabel(size);
+        bool created = false;
+
+        for (Encryption::EngineType engine : engineTypes) {
+            for (unsigned threads : threadCounts) {
+                std::string prefix = std::string(Encryption::engineName(engine)) + "/" + label + "/t";
+                std::string suffix = prefix + std::to_string(threads);
+                std::string encryptName = "encryptFile/" + suffix;
+                std::string decryptName = "decryptFile/" + suffix;
+                std::string checksumsName = "verifyChecksums/" + suffix;
+                std::string verifyName = "verifyFile/" + suffix;
+                std::string rekeyName = "rekeyFile/" + label;
+                bool checksummed = engine != Encryption::EngineType::LegacyXor;
+                bool rekeyed = checksummed && threads == 1;
+                if (!selected(encryptName) && !selected(decryptName) &&
+                    !(checksummed && (selected(checksumsName) || selected(verifyName))) &&
+                    !(rekeyed && selected(rekeyName))) {
+                    continue;
+                }
+                if (!created) {
+                    createFile(plainPath, size, size);
+                    created = true;
+                }
+
+                encryptor.setEngine(engine);
+                encryptor.setThreadCount(threads);
+
+                // The first call pays for the password key derivation, which is benchmarked separately
+                if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+                    throw std::runtime_error("encryptFile failed");
+                }
+
+                // Each run of the sweep records its speedup over the t1 run of the same benchmark
+                if (measure("file", encryptName, size, [&]() {
+                    if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+                        throw std::runtime_error("encryptFile failed");
+                    }
+                })) {
+                    recordSpeedup("encryptFile/" + prefix + "1");
+                }
+                if (measure("file", decryptName, size, [&]() {
+                    if (!encryptor.decryptFile(encryptedPath, decryptedPath)) {
+                        throw std::runtime_error("decryptFile failed");
+                    }
+                })) {
+                    recordSpeedup("decryptFile/" + prefix + "1");
+                }
+                fs::remove(decryptedPath);
+
+                // Integrity checks read the encrypted file and write nothing
+                if (checksummed) {
+                    if (measure("file", checksumsName, size, [&]() {
+                        if (!Encryption::verifyChecksums(encryptedPath, threads)) {
+                            throw std::runtime_error("verifyChecksums failed");
+                        }
+                    })) {
+                        recordSpeedup("verifyChecksums/" + prefix + "1");
+                    }
+                    if (measure("file", verifyName, size, [&]() {
+                        if (!encryptor.verifyFile(encryptedPath)) {
+                            throw std::runtime_error("verifyFile failed");
+                        }
+                    })) {
+                        recordSpeedup("verifyFile/" + prefix + "1");
+                    }
+                }
+
+                // Rewrapping under the same password costs the same as under a new one once both
+                // keys are derived; the time should not grow with the file size
+                if (rekeyed) {
+                    measure("file", rekeyName, 0, [&]() {
+                        if (!encryptor.rekeyFile(encryptedPath, encryptor)) {
+                            throw std::runtime_error("rekeyFile failed");
+                        }
+                    });
+                }
+            }
+        }
+
+        fs::remove(plainPath);
+        fs::remove(encryptedPath);
+    }
+}
+
+// Drops a file's cached pages so the next read comes from the device
+// Only Linux offers this to unprivileged processes; elsewhere the file is just flushed,
+// so the io runs there measure reads from a warm cache
+static void evictFromCache(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+#ifdef __linux__
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+        fsync(fd);
+#endif
+        ::close(fd);
+    }
+}
+
+// Single-threaded encryptFile/decryptFile in every I/O mode with the input evicted from the page
+// cache before each iteration, so reads hit the device. Serial modes take disk time plus cipher
+// time per block; the asynchronous modes overlap them and approach the slower of the two
+static void runIoBenchmarks(const std::vector<uint64_t>& sizes) {
+    fs::path directory(options.scratchDirectory);
+    std::string plainPath = (directory / "io.dat").string();
+    std::string encryptedPath = (directory / "io.dat.enc").string();
+    std::string decryptedPath = (directory / "io_decrypted.dat").string();
+
+    struct IoConfiguration {
+        Encryption::IoMode mode;
+        unsigned queueDepth;
+    };
+    std::vector<IoConfiguration> configurations = {
+        {Encryption::IoMode::Stream, 0}, {Encryption::IoMode::Mapped, 0},
+        {Encryption::IoMode::Async, 2}, {Encryption::IoMode::Async, 4}, {Encryption::IoMode::Async, 8},
+        {Encryption::IoMode::AsyncThreads, 4},
+    };
+
+    Encryption::Encryptor encryptor("benchmark password");
+    encryptor.setThreadCount(1);
+
+    for (uint64_t size : sizes) {
+        if (size < (16u << 20)) {
+            continue;
+        }
+        bool created = false;
+        for (const IoConfiguration& configuration : configurations) {
+            std::string suffix = std::string(Encryption::ioModeName(configuration.mode)) +
+                                 (configuration.queueDepth != 0 ? "/qd" + std::to_string(configuration.queueDepth) : "") +
+                                 "/" + sizeLabel(size);
+            std::string encryptName = "ioEncrypt/" + suffix;
+            std::string decryptName = "ioDecrypt/" + suffix;
+            if (!selected(encryptName) && !selected(decryptName)) {
+                continue;
+            }
+            if (!created) {
+                createFile(plainPath, size, size);
+                created = true;
+            }
+
+            encryptor.setIoMode(configuration.mode);
+            if (configuration.queueDepth != 0) {
+                encryptor.setQueueDepth(configuration.queueDepth);
+            }
+            if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+                throw std::runtime_error("encryptFile failed");
+            }
+
+            measure("io", encryptName, size, [&]() {
+                if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+                    throw std::runtime_error("encryptFile failed");
+                }
+            }, [&]() {
+                evictFromCache(plainPath);
+            });
+            measure("io", decryptName, size, [&]() {
+                if (!encryptor.decryptFile(encryptedPath, decryptedPath)) {
+                    throw std::runtime_error("decryptFile failed");
+                }
+            }, [&]() {
+                evictFromCache(encryptedPath);
+            });
+            fs::remove(decryptedPath);
+        }
+        fs::remove(plainPath);
+        fs::remove(encryptedPath);
+    }
+}
+
+// encryptFile/decryptFile on compressible text with and without compression,
+// for the end-to-end speedup and the ratio achieved
+static void runCompressionBenchmarks(const std::vector<uint64_t>& sizes) {
+    fs::path directory(options.scratchDirectory);
+    std::string plainPath = (directory / "text.log").string();
+    std::string encryptedPath = (directory / "text.log.enc").string();
+    std::string decryptedPath = (directory / "decrypted.log").string();
+    unsigned threads = options.threads == 0 ? Utils::getDefaultThreadCount() : options.threads;
+
+    Encryption::Encryptor encryptor("benchmark password");
+    encryptor.setThreadCount(threads);
+
+    for (uint64_t size : sizes) {
+        if (size < (64u << 10)) {
+            continue;
+        }
+        bool created = false;
+        for (bool compress : {false, true}) {
+            std::string suffix = std::string(compress ? "aes-256-gcm+lz" : "aes-256-gcm") + "/text/" +
+                                 sizeLabel(size) + "/t" + std::to_string(threads);
+            std::string encryptName = "encryptFile/" + suffix;
+            std::string decryptName = "decryptFile/" + suffix;
+            if (!selected(encryptName) && !selected(decryptName)) {
+                continue;
+            }
+            if (!created) {
+                std::vector<char> block(1 << 20);
+                std::ofstream output(plainPath, std::ios::binary);
+                for (uint64_t written = 0; written < size; written += block.size()) {
+                    fillText(block.data(), block.size(), written);
+                    output.write(block.data(), static_cast<std::streamsize>(std::min<uint64_t>(block.size(), size - written)));
+                }
+                created = true;
+            }
+
+            encryptor.setCompression(compress);
+            if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+                throw std::runtime_error("encryptFile failed");
+            }
+
+            if (measure("file", encryptName, size, [&]() {
+                if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+                    throw std::runtime_error("encryptFile failed");
+                }
+            })) {
+                recordRatio(size, fs::file_size(encryptedPath));
+            }
+            measure("file", decryptName, size, [&]() {
+                if (!encryptor.decryptFile(encryptedPath, decryptedPath)) {
+                    throw std::runtime_error("decryptFile failed");
+                }
+            });
+            fs::remove(decryptedPath);
+        }
+        fs::remove(plainPath);
+        fs::remove(encryptedPath);
+    }
+}
+
+// encryptFile/decryptFile on a sparse file with 1 MiB of data per 16 MiB, as in a
+// thin-provisioned disk image; throughput counts the full size, holes included
+static void runSparseBenchmarks(const std::vector<uint64_t>& sizes) {
+    fs::path directory(options.scratchDirectory);
+    std::string plainPath = (directory / "sparse.img").string();
+    std::string encryptedPath = (directory / "sparse.img.enc").string();
+    std::string decryptedPath = (directory / "decrypted.img").string();
+    unsigned threads = options.threads == 0 ? Utils::getDefaultThreadCount() : options.threads;
+
+    Encryption::Encryptor encryptor("benchmark password");
+    encryptor.setThreadCount(threads);
+
+    for (uint64_t size : sizes) {
+        if (size < (16u << 20)) {
+            continue;
+        }
+        std::string suffix = "aes-256-gcm/sparse/" + sizeLabel(size) + "/t" + std::to_string(threads);
+        std::string encryptName = "encryptFile/" + suffix;
+        std::string decryptName = "decryptFile/" + suffix;
+        if (!selected(encryptName) && !selected(decryptName)) {
+            continue;
+        }
+
+        int fd = open(plainPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            throw std::runtime_error("Could not create " + plainPath);
+        }
+        std::vector<char> data(1 << 20);
+        for (uint64_t offset = 0; offset < size; offset += 16u << 20) {
+            fillRandom(data.data(), data.size(), offset + 1);
+            if (pwrite(fd, data.data(), data.size(), static_cast<off_t>(offset)) != static_cast<ssize_t>(data.size())) {
+                close(fd);
+                throw std::runtime_error("Could not write " + plainPath);
+            }
+        }
+        close(fd);
+
+        if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+            throw std::runtime_error("encryptFile failed");
+        }
+        if (measure("file", encryptName, size, [&]() {
+            if (!encryptor.encryptFile(plainPath, encryptedPath)) {
+                throw std::runtime_error("encryptFile failed");
+            }
+        })) {
+            recordRatio(size, fs::file_size(encryptedPath));
+        }
+        measure("file", decryptName, size, [&]() {
+            if (!encryptor.decryptFile(encryptedPath, decryptedPath)) {
+                throw std::runtime_error("decryptFile failed");
+            }
+        });
+        fs::remove(decryptedPath);
+        fs::remove(plainPath);
+        fs::remove(encryptedPath);
+    }
+}
+
+// File-count distribution for the folder benchmarks
+struct FolderDistribution {
+    std::string name;
+    uint64_t fileCount;
+    uint64_t fileSize;
+    uint64_t distinctContents; // Files cycle through this many contents, each copy with a small edit (0 = all distinct)
+};
+
+// Builds a folder of fileCount files spread over subdirectories of 100 files each
+static uint64_t createFolder(const fs::path& root, const FolderDistribution& distribution) {
+    fs::remove_all(root);
+    std::vector<char> data(static_cast<size_t>(distribution.fileSize));
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < distribution.fileCount; ++i) {
+        fs::path directory = root / ("dir" + std::to_string(i / 100));
+        fs::create_directories(directory);
+        if (distribution.distinctContents == 0) {
+            fillRandom(data.data(), data.size(), i + 1);
+        } else {
+            // Like versions of a few files: shared content with one 64-byte edit per file
+            fillRandom(data.data(), data.size(), i % distribution.distinctContents + 1);
+            size_t editLength = std::min<size_t>(64, data.size());
+            fillRandom(data.data() + (i * 7919 * 4096) % (data.size() - editLength + 1), editLength,
+                       distribution.fileCount + i + 1);
+        }
+        std::ofstream output(directory / ("file" + std::to_string(i) + ".bin"), std::ios::binary);
+        output.write(data.data(), data.size());
+        total += data.size();
+    }
+    return total;
+}
+
+// Folder encryption (scan and write a container), decryption (extract every entry) and
+// extraction of a single file, which reads only the index and that entry
+// Encryption and decryption also run with deduplication, which records the dedup ratio
+static void runFolderBenchmarks() {
+    fs::path directory(options.scratchDirectory);
+    fs::path folder = directory / "folder";
+    std::string encryptedPath = (directory / "folder.enc").string();
+    fs::path extractedPath = directory / "folder_extracted";
+
+    // Scaled down so the total stays within maxSize
+    std::vector<FolderDistribution> distributions = {
+        {"many-small", 5000, 4 << 10, 0},
+        {"mixed", 200, 256 << 10, 0},
+        {"few-large", 4, 64 << 20, 0},
+        {"duplicate-heavy", 64, 4 << 20, 8},
+    };
+
+    Encryption::Encryptor encryptor("benchmark password");
+    for (FolderDistribution& distribution : distributions) {
+        uint64_t maxFiles = std::max<uint64_t>(1, options.maxSize / distribution.fileSize);
+        distribution.fileCount = std::min(distribution.fileCount, maxFiles);
+        distribution.fileSize = std::min(distribution.fileSize, options.maxSize);
+        std::string suffix = distribution.name + "/" + std::to_string(distribution.fileCount) + "x" +
+                             sizeLabel(distribution.fileSize);
+        std::string encryptName = "folderEncrypt/" + suffix;
+        std::string decryptName = "folderDecrypt/" + suffix;
+        std::string extractOneName = "folderExtractOne/" + suffix;
+        std::string dedupEncryptName = "folderEncryptDedup/" + suffix;
+        std::string dedupDecryptName = "folderDecryptDedup/" + suffix;
+        std::string archiveDecryptName = "folderDecryptArchive/" + suffix;
+        if (!selected(encryptName) && !selected(decryptName) && !selected(extractOneName) &&
+            !selected(dedupEncryptName) && !selected(dedupDecryptName) && !selected(archiveDecryptName)) {
+            continue;
+        }
+
+        uint64_t total = createFolder(folder, distribution);
+        ArchiveHandler::ContainerStats stats;
+        auto encryptFolder = [&](bool deduplicate) {
+            ArchiveHandler::FolderManifest manifest;
+            if (!ArchiveHandler::scanFolder(folder.string(), manifest) ||
+                !ArchiveHandler::writeFolderContainer(manifest, encryptedPath, encryptor, nullptr, deduplicate, &stats)) {
+                throw std::runtime_error("Folder encryption failed");
+            }
+        };
+        auto decryptFolder = [&]() {
+            if (!ArchiveHandler::extractFromContainer(encryptedPath, extractedPath.string(), encryptor)) {
+                throw std::runtime_error("Folder decryption failed");
+            }
+        };
+        auto removeExtracted = [&]() {
+            fs::remove_all(extractedPath);
+        };
+
+        encryptFolder(true); // also pays for the key derivation
+        if (measure("folder", dedupEncryptName, total, [&]() { encryptFolder(true); })) {
+            recordRatio(stats.contentBytes, stats.storedBytes);
+        }
+        measure("folder", dedupDecryptName, total, decryptFolder, removeExtracted);
+
+        encryptFolder(false);
+        measure("folder", encryptName, total, [&]() { encryptFolder(false); });
+        measure("folder", decryptName, total, decryptFolder, removeExtracted);
+        std::string lastFile = "dir" + std::to_string((distribution.fileCount - 1) / 100) + "/file" +
+                               std::to_string(distribution.fileCount - 1) + ".bin";
+        measure("folder", extractOneName, distribution.fileSize, [&]() {
+            if (!ArchiveHandler::extractFromContainer(encryptedPath, extractedPath.string(), encryptor, {lastFile})) {
+                throw std::runtime_error("Single-file extraction failed");
+            }
+        }, [&]() {
+            fs::remove_all(extractedPath);
+        });
+
+        // Tar-based archives of earlier versions, streamed from decryption into the parallel extractor
+        if (selected(archiveDecryptName)) {
+            if (!encryptor.encryptStream([&](std::ostream& archive) {
+                    return ArchiveHandler::writeArchiveStream(folder.string(), archive);
+                }, "folder.tar", encryptedPath)) {
+                throw std::runtime_error("Archive encryption failed");
+            }
+            measure("folder", archiveDecryptName, total, [&]() {
+                if (!encryptor.decryptStream(encryptedPath, [&](std::istream& archive) {
+                        return ArchiveHandler::extractArchiveStream(archive, extractedPath.string());
+                    })) {
+                    throw std::runtime_error("Archive decryption failed");
+                }
+            }, removeExtracted);
+        }
+
+        fs::remove_all(extractedPath);
+        fs::remove(encryptedPath);
+        fs::remove_all(folder);
+    }
+}
+
+// Escapes a string for a JSON string literal
+static std::string jsonString(const std::string& text) {
+    std::ostringstream escaped;
+    escaped << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+        } else {
+            escaped << c;
+        }
+    }
+    escaped << '"';
+    return escaped.str();
+}
+
+// Writes all results with enough system context to compare runs
+static void writeJson(std::ostream& output) {
+    std::time_t now = std::time(nullptr);
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    output << std::setprecision(9);
+    output << "{\n";
+    output << "  \"timestamp\": " << jsonString(timestamp) << ",\n";
+    output << "  \"system\": {\n";
+    output << "    \"hardware_threads\": " << Utils::getDefaultThreadCount() << ",\n";
+    output << "    \"xor_kernel\": " << jsonString(Encryption::XorKernel::activeKernelName()) << ",\n";
+    output << "    \"crc32c_kernel\": " << jsonString(Encryption::Checksum::activeKernelName()) << ",\n";
+    output << "    \"sha256_kernel\": " << jsonString(Encryption::Sha256::activeKernelName()) << ",\n";
+    output << "    \"aes_implementation\": " << jsonString(Encryption::AesGcm::activeImplementationName()) << ",\n";
+    output << "    \"async_io_backend\": " << jsonString(FileHandler::isIoUringAvailable() ? "io_uring" : "threads") << "\n";
+    output << "  },\n";
+    output << "  \"settings\": {\n";
+    output << "    \"max_size\": " << options.maxSize << ",\n";
+    output << "    \"min_time\": " << options.minTime << ",\n";
+    output << "    \"filter\": " << jsonString(options.filter) << ",\n";
+    output << "    \"threads\": " << (options.threads == 0 ? Utils::getDefaultThreadCount() : options.threads) << "\n";
+    output << "  },\n";
+    output << "  \"peak_rss_bytes\": " << Utils::getPeakMemoryUsage() << ",\n";
+    output << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        double perIteration = result.seconds / result.iterations;
+        output << "    {\"group\": " << jsonString(result.group)
+               << ", \"name\": " << jsonString(result.name)
+               << ", \"iterations\": " << result.iterations
+               << ", \"seconds\": " << result.seconds
+               << ", \"seconds_per_iteration\": " << perIteration
+               << ", \"bytes_per_iteration\": " << result.bytesPerIteration
+               << ", \"bytes_per_second\": " << (result.bytesPerIteration / perIteration);
+        if (result.compressionRatio > 0) {
+            output << ", \"compression_ratio\": " << result.compressionRatio;
+        }
+        if (result.speedup > 0) {
+            output << ", \"speedup\": " << result.speedup;
+        }
+        output << "}"
+               << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    output << "  ]\n";
+    output << "}\n";
+}
+
+static void printUsage(const std::string& programName) {
+    std::cout << "Usage: " << programName << " [options]\n"
+              << "\n"
+              << "Options:\n"
+              << "  --output <file>      Write the JSON report to <file> (default: standard output)\n"
+              << "  --dir <dir>          Scratch directory for test files (default: system temp directory)\n"
+              << "  --max-size <size>    Largest file for end-to-end runs, e.g. 64M or 10G (default: 256M)\n"
+              << "  --min-time <sec>     Minimum measured time per benchmark (default: 0.5)\n"
+              << "  --filter <text>      Only run benchmarks whose name contains <text>\n"
+              << "  --threads <n>        Largest thread count of the file runs, which sweep 1, 2, 4, ... up to it\n"
+              << "                       (default: all cores)\n"
+              << "  -h, --help           Show this help\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string programName = fs::path(argv[0]).filename().string();
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "-h" || argument == "--help") {
+            printUsage(programName);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Error: Missing value for " << argument << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+        bool valid = true;
+        if (argument == "--output") {
+            options.outputPath = value;
+        } else if (argument == "--dir") {
+            options.scratchDirectory = value;
+        } else if (argument == "--max-size") {
+            valid = parseSize(value, options.maxSize) && options.maxSize > 0;
+        } else if (argument == "--min-time") {
+            try {
+                options.minTime = std::stod(value);
+            } catch (const std::exception&) {
+                valid = false;
+            }
+        } else if (argument == "--filter") {
+            options.filter = value;
+        } else if (argument == "--threads") {
+            try {
+                options.threads = static_cast<unsigned>(std::stoul(value));
+            } catch (const std::exception&) {
+                valid = false;
+            }
+        } else {
+            std::cerr << "Error: Unknown option " << argument << std::endl;
+            printUsage(programName);
+            return 2;
+        }
+        if (!valid) {
+            std::cerr << "Error: Invalid value '" << value << "' for " << argument << std::endl;
+            return 2;
+        }
+    }
+
+    // Private scratch directory, removed when the run ends
+    fs::path scratch = options.scratchDirectory.empty() ? fs::temp_directory_path() : fs::path(options.scratchDirectory);
+    scratch /= "filecrypt-bench-" + std::to_string(getpid());
+    fs::create_directories(scratch);
+    options.scratchDirectory = scratch.string();
+
+    // File sizes from 1 KiB to 10 GiB, limited by --max-size
+    std::vector<uint64_t> sizes;
+    for (uint64_t size : {1ull << 10, 64ull << 10, 1ull << 20, 16ull << 20, 256ull << 20, 1ull << 30, 10ull << 30}) {
+        if (size <= options.maxSize) {
+            sizes.push_back(size);
+        }
+    }
+
+    // The tool's own messages (e.g. from archive extraction) would interleave with the JSON
+    std::streambuf* consoleBuffer = std::cout.rdbuf(nullptr);
+
+    // Timings of a kernel that computes the wrong bytes are meaningless
+    if (!verifyXorKernels() || !verifyArchiveExtraction()) {
+        fs::remove_all(scratch);
+        std::cout.rdbuf(consoleBuffer);
+        return 1;
+    }
+
+    int status = 0;
+    try {
+        runMicroBenchmarks();
+        runFileHandlerBenchmarks(sizes);
+        runFileBenchmarks(sizes);
+        runIoBenchmarks(sizes);
+        runCompressionBenchmarks(sizes);
+        runSparseBenchmarks(sizes);
+        runFolderBenchmarks();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        status = 1;
+    }
+    fs::remove_all(scratch);
+    std::cout.rdbuf(consoleBuffer);
+
+    if (options.outputPath.empty()) {
+        writeJson(std::cout);
+    } else {
+        std::ofstream output(options.outputPath);
+        writeJson(output);
+        if (!output) {
+            std::cerr << "Error: Could not write " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    return status;
+}
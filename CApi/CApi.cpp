@@ -0,0 +1,412 @@
+#include "filecrypt.h"
+#include "../Encryption/Encryption.hpp"
+#include "../FileHandler/FileHandler.hpp"
+#include "../Utils/BoundedQueue.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// C API over Encryption::Encryptor (see filecrypt.h)
+// No exception crosses the API: each entry point turns them into a status and a message
+
+struct filecrypt_context {
+    Encryption::Encryptor encryptor;
+
+    explicit filecrypt_context(const std::string& password) : encryptor(password) {}
+};
+
+// A worker thread runs the encryptor's own streaming operation on the descriptor, and the caller
+// exchanges plaintext with it through a bounded queue of blocks
+struct filecrypt_stream {
+    filecrypt_context* context;
+    bool encrypting;                               // Direction: plaintext in (true) or out (false)
+    FileHandler::FdStreambuf file;                 // Encrypted output or input
+    Utils::BoundedQueue<std::vector<char>> blocks; // Plaintext between the caller and the worker
+    std::vector<char> block;                       // Block being filled (encrypting) or read (decrypting)
+    size_t position;                               // Bytes of block already read (decrypting)
+    std::thread worker;
+    bool succeeded;                                // Outcome, set by the worker before it ends
+    bool finished;                                 // final has been called
+
+    filecrypt_stream(filecrypt_context* context, bool encrypting, int fd, size_t depth)
+        : context(context), encrypting(encrypting), file(fd), blocks(depth), position(0),
+          succeeded(false), finished(false) {}
+};
+
+namespace {
+
+    // Plaintext passes between the caller and a stream's worker in blocks of this size
+    const size_t STREAM_BLOCK_SIZE = 1024 * 1024;
+
+    // Number of blocks a stream's queue may hold
+    const size_t STREAM_DEPTH = 4;
+
+    // Message of the last failed call on each thread
+    thread_local std::string lastError;
+
+    filecrypt_status fail(filecrypt_status status, const std::string& message) {
+        lastError = message;
+        return status;
+    }
+
+    // Runs the body of an entry point, turning exceptions into FILECRYPT_ERROR
+    template <typename Body>
+    filecrypt_status guarded(const Body& body) {
+        try {
+            return body();
+        } catch (const std::bad_alloc&) {
+            return fail(FILECRYPT_ERROR, "Out of memory");
+        } catch (const std::exception& e) {
+            return fail(FILECRYPT_ERROR, e.what());
+        }
+    }
+
+    // Returns true if the descriptor can be positioned, as the encrypted side of a file needs
+    bool seekable(int fd) {
+        return fd >= 0 && ::lseek(fd, 0, SEEK_CUR) >= 0;
+    }
+}
+
+extern "C" {
+
+int filecrypt_api_version(void) {
+    return FILECRYPT_API_VERSION;
+}
+
+const char* filecrypt_last_error(void) {
+    return lastError.c_str();
+}
+
+filecrypt_context* filecrypt_context_new(const char* password, size_t length) {
+    if (password == nullptr || length == 0) {
+        fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Password is empty");
+        return nullptr;
+    }
+    try {
+        return new filecrypt_context(std::string(password, length));
+    } catch (const std::bad_alloc&) {
+        fail(FILECRYPT_ERROR, "Out of memory");
+    } catch (const std::exception& e) {
+        fail(FILECRYPT_ERROR, e.what());
+    }
+    return nullptr;
+}
+
+void filecrypt_context_free(filecrypt_context* context) {
+    delete context;
+}
+
+filecrypt_status filecrypt_set_threads(filecrypt_context* context, unsigned threads) {
+    if (context == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "No context");
+    }
+    context->encryptor.setThreadCount(threads);
+    return FILECRYPT_OK;
+}
+
+filecrypt_status filecrypt_set_compression(filecrypt_context* context, int enabled) {
+    if (context == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "No context");
+    }
+    context->encryptor.setCompression(enabled != 0);
+    return FILECRYPT_OK;
+}
+
+size_t filecrypt_encrypted_buffer_size(const filecrypt_context* context, size_t length) {
+    return context == nullptr ? 0 : context->encryptor.dataOverhead() + length;
+}
+
+filecrypt_status filecrypt_encrypt_buffer(filecrypt_context* context, const void* data, size_t length,
+                                          void* output, size_t capacity, size_t* output_length) {
+    if (context == nullptr || (data == nullptr && length != 0) || (output == nullptr && capacity != 0) ||
+        output_length == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid buffer arguments");
+    }
+    return guarded([&]() {
+        *output_length = context->encryptor.dataOverhead() + length;
+        if (capacity < *output_length) {
+            return fail(FILECRYPT_ERROR_BUFFER_TOO_SMALL, "Output buffer too small");
+        }
+        const char* plaintext = length == 0 ? "" : static_cast<const char*>(data);
+        *output_length = context->encryptor.encryptData(plaintext, length, static_cast<char*>(output));
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_decrypt_buffer(filecrypt_context* context, const void* data, size_t length,
+                                          void* output, size_t capacity, size_t* output_length) {
+    if (context == nullptr || data == nullptr || (output == nullptr && capacity != 0) || output_length == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid buffer arguments");
+    }
+    return guarded([&]() {
+        const char* ciphertext = static_cast<const char*>(data);
+        *output_length = context->encryptor.decryptedDataSize(ciphertext, length);
+        if (capacity < *output_length) {
+            return fail(FILECRYPT_ERROR_BUFFER_TOO_SMALL, "Output buffer too small");
+        }
+        char empty;
+        *output_length = context->encryptor.decryptData(ciphertext, length,
+                                                        output == nullptr ? &empty : static_cast<char*>(output));
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_encrypt_file(filecrypt_context* context, const char* input_path, const char* output_path) {
+    if (context == nullptr || input_path == nullptr || output_path == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid file arguments");
+    }
+    return guarded([&]() {
+        if (!context->encryptor.encryptFile(input_path, output_path)) {
+            return fail(FILECRYPT_ERROR, std::string("Could not encrypt ") + input_path);
+        }
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_decrypt_file(filecrypt_context* context, const char* input_path, const char* output_path) {
+    if (context == nullptr || input_path == nullptr || output_path == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid file arguments");
+    }
+    return guarded([&]() {
+        if (!context->encryptor.decryptFile(input_path, output_path)) {
+            return fail(FILECRYPT_ERROR, std::string("Could not decrypt ") + input_path);
+        }
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_encrypt_fd(filecrypt_context* context, int input_fd, int output_fd,
+                                      const char* content_name) {
+    if (context == nullptr || input_fd < 0 || content_name == nullptr || content_name[0] == '\0') {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid descriptor arguments");
+    }
+    if (!seekable(output_fd)) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Output descriptor is not seekable");
+    }
+    return guarded([&]() {
+        FileHandler::FdStreambuf inputBuffer(input_fd);
+        FileHandler::FdStreambuf outputBuffer(output_fd);
+        std::istream input(&inputBuffer);
+        std::ostream output(&outputBuffer);
+
+        // Whole blocks are read straight from the descriptor into the chunk
+        bool success = context->encryptor.encryptStream([&](std::ostream& plain) {
+            std::vector<char> chunk(STREAM_BLOCK_SIZE);
+            while (input.read(chunk.data(), chunk.size()) || input.gcount() > 0) {
+                if (!plain.write(chunk.data(), input.gcount())) {
+                    return false;
+                }
+            }
+            return !inputBuffer.hasError();
+        }, content_name, output);
+        output.flush();
+        if (!success || outputBuffer.hasError()) {
+            return fail(FILECRYPT_ERROR, "Could not encrypt from descriptor");
+        }
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_decrypt_fd(filecrypt_context* context, int input_fd, int output_fd) {
+    if (context == nullptr || output_fd < 0) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid descriptor arguments");
+    }
+    if (!seekable(input_fd)) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Input descriptor is not seekable");
+    }
+    return guarded([&]() {
+        FileHandler::FdStreambuf inputBuffer(input_fd);
+        FileHandler::FdStreambuf outputBuffer(output_fd);
+        std::istream input(&inputBuffer);
+        std::ostream output(&outputBuffer);
+        bool success = context->encryptor.decryptRange(input, 0, UINT64_MAX, output);
+        output.flush();
+        if (!success || outputBuffer.hasError()) {
+            return fail(FILECRYPT_ERROR, "Could not decrypt from descriptor");
+        }
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_encrypt_begin(filecrypt_context* context, int output_fd, const char* content_name,
+                                         filecrypt_stream** stream) {
+    if (context == nullptr || content_name == nullptr || content_name[0] == '\0' || stream == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid stream arguments");
+    }
+    if (!seekable(output_fd)) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Output descriptor is not seekable");
+    }
+    return guarded([&]() {
+        std::unique_ptr<filecrypt_stream> created(new filecrypt_stream(context, true, output_fd, STREAM_DEPTH));
+        filecrypt_stream* encryption = created.get();
+        encryption->block.reserve(STREAM_BLOCK_SIZE);
+        std::string name(content_name);
+
+        // The worker feeds queued blocks to the encryption pipeline until final closes the queue
+        encryption->worker = std::thread([encryption, name]() {
+            bool success = false;
+            try {
+                std::ostream output(&encryption->file);
+                success = encryption->context->encryptor.encryptStream([encryption](std::ostream& plain) {
+                    std::vector<char> block;
+                    while (encryption->blocks.pop(block)) {
+                        if (!plain.write(block.data(), block.size())) {
+                            return false;
+                        }
+                    }
+                    return !encryption->blocks.isAborted();
+                }, name, output);
+                success = success && !encryption->file.hasError();
+            } catch (const std::exception&) {
+                success = false;
+            }
+            encryption->succeeded = success;
+            if (!success) {
+                encryption->blocks.abort();
+            }
+        });
+        *stream = created.release();
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_encrypt_update(filecrypt_stream* stream, const void* data, size_t length) {
+    if (stream == nullptr || (data == nullptr && length != 0)) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid stream arguments");
+    }
+    if (!stream->encrypting || stream->finished) {
+        return fail(FILECRYPT_ERROR_STATE, "Stream does not accept plaintext");
+    }
+    return guarded([&]() {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            size_t count = std::min(length, STREAM_BLOCK_SIZE - stream->block.size());
+            stream->block.insert(stream->block.end(), bytes, bytes + count);
+            bytes += count;
+            length -= count;
+            if (stream->block.size() == STREAM_BLOCK_SIZE) {
+                if (!stream->blocks.push(std::move(stream->block))) {
+                    return fail(FILECRYPT_ERROR, "Encryption failed");
+                }
+                stream->block.clear();
+                stream->block.reserve(STREAM_BLOCK_SIZE);
+            }
+        }
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_encrypt_final(filecrypt_stream* stream) {
+    if (stream == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "No stream");
+    }
+    if (!stream->encrypting || stream->finished) {
+        return fail(FILECRYPT_ERROR_STATE, "Stream is not encrypting");
+    }
+    stream->finished = true;
+    if (!stream->block.empty()) {
+        stream->blocks.push(std::move(stream->block));
+    }
+    stream->blocks.close();
+    stream->worker.join();
+    return stream->succeeded ? FILECRYPT_OK : fail(FILECRYPT_ERROR, "Encryption failed");
+}
+
+filecrypt_status filecrypt_decrypt_begin(filecrypt_context* context, int input_fd, filecrypt_stream** stream) {
+    if (context == nullptr || stream == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid stream arguments");
+    }
+    if (!seekable(input_fd)) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Input descriptor is not seekable");
+    }
+    return guarded([&]() {
+        std::unique_ptr<filecrypt_stream> created(new filecrypt_stream(context, false, input_fd, STREAM_DEPTH));
+        filecrypt_stream* decryption = created.get();
+
+        // The worker decrypts the whole content into the queue; the queue is closed only if
+        // every segment authenticated, so a reader never mistakes a failure for the end
+        decryption->worker = std::thread([decryption]() {
+            bool success = false;
+            try {
+                std::istream input(&decryption->file);
+                Utils::BlockQueueStreambuf buffer(decryption->blocks, STREAM_BLOCK_SIZE);
+                std::ostream plain(&buffer);
+                success = decryption->context->encryptor.decryptRange(input, 0, UINT64_MAX, plain);
+                plain.flush();
+                success = success && !plain.fail() && buffer.finish();
+            } catch (const std::exception&) {
+                success = false;
+            }
+            decryption->succeeded = success;
+            if (success) {
+                decryption->blocks.close();
+            } else {
+                decryption->blocks.abort();
+            }
+        });
+        *stream = created.release();
+        return FILECRYPT_OK;
+    });
+}
+
+filecrypt_status filecrypt_decrypt_update(filecrypt_stream* stream, void* output, size_t capacity,
+                                          size_t* output_length) {
+    // With no room for a byte, a zero length would read as the end of the stream
+    if (stream == nullptr || output == nullptr || capacity == 0 || output_length == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "Invalid stream arguments");
+    }
+    if (stream->encrypting || stream->finished) {
+        return fail(FILECRYPT_ERROR_STATE, "Stream does not produce plaintext");
+    }
+    *output_length = 0;
+    while (stream->position == stream->block.size()) {
+        if (!stream->blocks.pop(stream->block)) {
+            stream->block.clear();
+            stream->position = 0;
+            return stream->blocks.isAborted() ? fail(FILECRYPT_ERROR, "Decryption failed") : FILECRYPT_OK;
+        }
+        stream->position = 0;
+    }
+    size_t count = std::min(capacity, stream->block.size() - stream->position);
+    std::memcpy(output, stream->block.data() + stream->position, count);
+    stream->position += count;
+    *output_length = count;
+    return FILECRYPT_OK;
+}
+
+filecrypt_status filecrypt_decrypt_final(filecrypt_stream* stream) {
+    if (stream == nullptr) {
+        return fail(FILECRYPT_ERROR_INVALID_ARGUMENT, "No stream");
+    }
+    if (stream->encrypting || stream->finished) {
+        return fail(FILECRYPT_ERROR_STATE, "Stream is not decrypting");
+    }
+    stream->finished = true;
+    std::vector<char> rest;
+    while (stream->blocks.pop(rest)) {
+    }
+    stream->worker.join();
+    return stream->succeeded ? FILECRYPT_OK : fail(FILECRYPT_ERROR, "Decryption failed");
+}
+
+void filecrypt_stream_free(filecrypt_stream* stream) {
+    if (stream == nullptr) {
+        return;
+    }
+    if (stream->worker.joinable()) {
+        stream->blocks.abort();
+        stream->worker.join();
+    }
+    delete stream;
+}
+
+}
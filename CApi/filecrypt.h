@@ -0,0 +1,123 @@
+#ifndef FILECRYPT_H
+#define FILECRYPT_H
+
+#include <stddef.h>
+
+// FileCrypt C API - the encryption engine of FileEncryptionDecryptionTool for use in-process
+// Link against the filecrypt static library (and the C++ runtime and pthreads it depends on)
+// Files written here and by the tool are interchangeable: AES-256-GCM with a PBKDF2-derived key
+// Every call returns a filecrypt_status; on failure filecrypt_last_error() describes the cause,
+// and the engine's own diagnostics go to standard error as they do in the tool
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Version of this interface, raised whenever a declaration below changes incompatibly
+#define FILECRYPT_API_VERSION 1
+
+typedef enum filecrypt_status {
+    FILECRYPT_OK = 0,
+    FILECRYPT_ERROR = -1,                  // The operation failed (wrong password, corrupted data, I/O error)
+    FILECRYPT_ERROR_INVALID_ARGUMENT = -2, // A null pointer, empty password or unusable descriptor
+    FILECRYPT_ERROR_BUFFER_TOO_SMALL = -3, // The output buffer cannot hold the result; the size needed is returned
+    FILECRYPT_ERROR_STATE = -4             // The stream does not allow this call (wrong direction or finished)
+} filecrypt_status;
+
+// Holds a password and the keys derived from it; derivation runs once per context, on first use
+// Operations may run concurrently on one context; the setters may not run alongside them
+typedef struct filecrypt_context filecrypt_context;
+
+// An encryption or decryption in progress, fed or drained piece by piece
+typedef struct filecrypt_stream filecrypt_stream;
+
+// Returns FILECRYPT_API_VERSION of the library linked in
+int filecrypt_api_version(void);
+
+// Returns a description of the last failed call on this thread ("" if none)
+const char* filecrypt_last_error(void);
+
+// Creates a context for password (length bytes, which need not be null-terminated)
+// Returns NULL if the password is empty or memory runs out
+filecrypt_context* filecrypt_context_new(const char* password, size_t length);
+
+// Releases a context; streams created from it must be freed first
+void filecrypt_context_free(filecrypt_context* context);
+
+// Sets the worker threads used for large files (0 = all hardware threads, the default)
+filecrypt_status filecrypt_set_threads(filecrypt_context* context, unsigned threads);
+
+// Enables (non-zero) or disables LZ compression of content before encryption (default: off)
+// Applies to files, descriptors and streams; decryption detects compression by itself
+filecrypt_status filecrypt_set_compression(filecrypt_context* context, int enabled);
+
+// Returns the size filecrypt_encrypt_buffer produces for length bytes of plaintext
+size_t filecrypt_encrypted_buffer_size(const filecrypt_context* context, size_t length);
+
+// Encrypts length bytes of data into output as one self-contained, authenticated message
+// output must not overlap data; *output_length receives the size written, or the size needed
+// when FILECRYPT_ERROR_BUFFER_TOO_SMALL is returned
+filecrypt_status filecrypt_encrypt_buffer(filecrypt_context* context, const void* data, size_t length,
+                                          void* output, size_t capacity, size_t* output_length);
+
+// Decrypts a message produced by filecrypt_encrypt_buffer into output (which must not overlap it)
+// *output_length receives the plaintext size, or the size needed as above
+// Fails without writing anything if the password is wrong or the message was modified
+filecrypt_status filecrypt_decrypt_buffer(filecrypt_context* context, const void* data, size_t length,
+                                          void* output, size_t capacity, size_t* output_length);
+
+// Encrypts the file at input_path into output_path, storing the file name for decryption
+// Sparse files store only their data; large files are spread over the worker threads
+// input_path may also name a pipe or device, which is read to its end
+filecrypt_status filecrypt_encrypt_file(filecrypt_context* context, const char* input_path, const char* output_path);
+
+// Decrypts an encrypted file into output_path; a partial output is removed on failure
+filecrypt_status filecrypt_decrypt_file(filecrypt_context* context, const char* input_path, const char* output_path);
+
+// Encrypts everything read from input_fd (a file, pipe or socket) into output_fd, from its
+// current position; content_name is stored as the original file name
+// output_fd must be seekable, as the header is written last; descriptors are left open
+filecrypt_status filecrypt_encrypt_fd(filecrypt_context* context, int input_fd, int output_fd,
+                                      const char* content_name);
+
+// Decrypts the encrypted file open as input_fd (seekable, holding only that file) and writes
+// the plaintext to output_fd, which may be a pipe or socket; descriptors are left open
+// Every segment is authenticated before it is written, but on failure part of the plaintext may
+// already be written to output_fd
+filecrypt_status filecrypt_decrypt_fd(filecrypt_context* context, int input_fd, int output_fd);
+
+// Starts encrypting content of any length into output_fd (seekable, from its current position)
+// Feed the plaintext with filecrypt_encrypt_update and finish with filecrypt_encrypt_final;
+// encryption runs on background threads while the caller produces more
+filecrypt_status filecrypt_encrypt_begin(filecrypt_context* context, int output_fd, const char* content_name,
+                                         filecrypt_stream** stream);
+
+// Adds length bytes of plaintext; blocks while the pipeline is full
+filecrypt_status filecrypt_encrypt_update(filecrypt_stream* stream, const void* data, size_t length);
+
+// Encrypts the rest, writes the header and waits for everything to reach output_fd
+filecrypt_status filecrypt_encrypt_final(filecrypt_stream* stream);
+
+// Starts decrypting the encrypted file open as input_fd (seekable, holding only that file)
+// Read the plaintext with filecrypt_decrypt_update and finish with filecrypt_decrypt_final
+filecrypt_status filecrypt_decrypt_begin(filecrypt_context* context, int input_fd, filecrypt_stream** stream);
+
+// Copies up to capacity bytes of authenticated plaintext into output; *output_length is 0 at the end
+// capacity must be at least 1 (FILECRYPT_ERROR_INVALID_ARGUMENT otherwise), so 0 always means the end
+// Segment tags follow the content in the file format, so plaintext is produced from the
+// descriptor rather than pushed in by the caller
+filecrypt_status filecrypt_decrypt_update(filecrypt_stream* stream, void* output, size_t capacity,
+                                          size_t* output_length);
+
+// Waits for decryption to end, decrypting and discarding any plaintext not read
+// Returns FILECRYPT_OK only if the whole file authenticated
+filecrypt_status filecrypt_decrypt_final(filecrypt_stream* stream);
+
+// Releases a stream, cancelling it if it was not finished (an encryption's output is then incomplete)
+void filecrypt_stream_free(filecrypt_stream* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,751 @@
+#include "CommandLine.hpp"
+#include "../Encryption/Encryption.hpp"
+#include "../FileHandler/FileHandler.hpp"
+#include "../ArchiveHandler/IncrementalStore.hpp"
+#include "../ArchiveHandler/FolderContainer.hpp"
+#include "../Utils/Utils.hpp"
+#include "../Utils/Instrumentation.hpp"
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace CommandLine {
+
+    // Prints usage information for batch mode
+    void printUsage(const std::string& programName) {
+        std::cout << "Usage: " << programName << " <encrypt|decrypt> [options] [files...]\n"
+                  << "       " << programName << " decrypt-range <file> [--offset <n>] [--length <n>] [password option]\n"
+                  << "       " << programName << " sync <folder> [-o <store>] [options]\n"
+                  << "       " << programName << " restore <store> [-o <folder>] [password option]\n"
+                  << "       " << programName << " pack <folder> [-o <container>] [--dedup] [password option]\n"
+                  << "       " << programName << " list <container> [password option]\n"
+                  << "       " << programName << " extract <container> [patterns...] [-o <folder>] [password option]\n"
+                  << "       " << programName << " verify <files...> [password option]\n"
+                  << "       " << programName << " rekey <files...> [password option] [new password option]\n"
+                  << "\n"
+                  << "Options:\n"
+                  << "  -o, --output-dir <dir>   Write output files to <dir> (default: beside each input)\n"
+                  << "                           sync: store directory (default: <folder>.encstore)\n"
+                  << "                           restore: folder to recreate (default: <store>_restored)\n"
+                  << "                           pack: container file (default: <folder>.enc)\n"
+                  << "                           extract: folder to extract into (default: <container>_extracted)\n"
+                  << "  -l, --file-list <file>   Read input paths from <file>, one per line ('-' for stdin)\n"
+                  << "  -j, --jobs <n>           Number of files processed in parallel (default: all cores)\n"
+                  << "  --password-env <var>     Read the password from environment variable <var>\n"
+                  << "  --password-fd <fd>       Read the password from file descriptor <fd> (first line)\n"
+                  << "  --new-password-env <var> rekey: read the new password from environment variable <var>\n"
+                  << "  --new-password-fd <fd>   rekey: read the new password from file descriptor <fd>\n"
+                  << "                           (the next line, if it is also the password descriptor)\n"
+                  << "  --cipher <name>          Cipher for encryption: aes-256-gcm (default) or xor (legacy)\n"
+                  << "  --compress               Compress content before encryption (aes-256-gcm only)\n"
+                  << "  --dedup                  pack: split files into content-defined chunks and store each\n"
+                  << "                           distinct chunk once\n"
+                  << "  --io <mode>              File I/O: mapped (default), stream, async (io_uring, else threads)\n"
+                  << "                           or async-threads\n"
+                  << "  --queue-depth <n>        Blocks in flight for async I/O (default: 4, minimum 2)\n"
+                  << "  --offset <n>             decrypt-range: first content byte to decrypt (default: 0)\n"
+                  << "  --length <n>             decrypt-range: number of bytes to decrypt (default: to the end)\n"
+                  << "  --report <file>          Write per-stage timings, throughput and peak memory as JSON\n"
+                  << "  -h, --help               Show this help\n"
+                  << "\n"
+                  << "verify checks the checksums stored in each file without the password; with a password\n"
+                  << "it also authenticates every segment. No plaintext is written either way.\n"
+                  << "rekey rewraps each file's data key under the new password, rewriting only the header.\n"
+                  << "\n"
+                  << "Run without arguments for the interactive menu.\n";
+    }
+
+    // Appends every non-empty line of a file list to the inputs
+    static bool readFileList(const std::string& listPath, std::vector<std::string>& inputs) {
+        std::ifstream listFile;
+        if (listPath != "-") {
+            listFile.open(listPath);
+            if (!listFile.is_open()) {
+                std::cerr << "Error: Could not open file list " << listPath << std::endl;
+                return false;
+            }
+        }
+        std::istream& list = listPath == "-" ? std::cin : listFile;
+
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                inputs.push_back(line);
+            }
+        }
+        return true;
+    }
+
+    // Parses a positive integer option value
+    static bool parseNumber(const std::string& value, long& result) {
+        try {
+            size_t used = 0;
+            result = std::stol(value, &used);
+            return used == value.size();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Parses command, options and input paths
+    bool parseArguments(int argc, char* argv[], Options& options) {
+        if (argc < 2) {
+            return false;
+        }
+
+        std::string command = argv[1];
+        if (command == "encrypt") {
+            options.command = Command::Encrypt;
+        } else if (command == "decrypt") {
+            options.command = Command::Decrypt;
+        } else if (command == "decrypt-range") {
+            options.command = Command::DecryptRange;
+        } else if (command == "sync") {
+            options.command = Command::Sync;
+        } else if (command == "restore") {
+            options.command = Command::Restore;
+        } else if (command == "pack") {
+            options.command = Command::Pack;
+        } else if (command == "list") {
+            options.command = Command::List;
+        } else if (command == "extract") {
+            options.command = Command::Extract;
+        } else if (command == "verify") {
+            options.command = Command::Verify;
+        } else if (command == "rekey") {
+            options.command = Command::Rekey;
+        } else {
+            std::cerr << "Error: Unknown command '" << command << "'" << std::endl;
+            return false;
+        }
+
+        for (int i = 2; i < argc; ++i) {
+            std::string argument = argv[i];
+
+            // Options that take a value
+            if (argument == "-o" || argument == "--output-dir" ||
+                argument == "-l" || argument == "--file-list" ||
+                argument == "-j" || argument == "--jobs" ||
+                argument == "--password-env" || argument == "--password-fd" ||
+                argument == "--new-password-env" || argument == "--new-password-fd" ||
+                argument == "--cipher" || argument == "--offset" || argument == "--length" ||
+                argument == "--report" || argument == "--io" || argument == "--queue-depth") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: Missing value for " << argument << std::endl;
+                    return false;
+                }
+                std::string value = argv[++i];
+                long number = 0;
+
+                if (argument == "-o" || argument == "--output-dir") {
+                    options.outputDirectory = value;
+                } else if (argument == "-l" || argument == "--file-list") {
+                    if (!readFileList(value, options.inputs)) {
+                        return false;
+                    }
+                } else if (argument == "-j" || argument == "--jobs") {
+                    if (!parseNumber(value, number) || number < 1) {
+                        std::cerr << "Error: Invalid job count '" << value << "'" << std::endl;
+                        return false;
+                    }
+                    options.jobs = static_cast<unsigned>(number);
+                } else if (argument == "--password-env") {
+                    options.passwordEnv = value;
+                } else if (argument == "--new-password-env") {
+                    options.newPasswordEnv = value;
+                } else if (argument == "--report") {
+                    options.reportPath = value;
+                } else if (argument == "--io") {
+                    if (!Encryption::parseIoModeName(value, options.ioMode)) {
+                        std::cerr << "Error: Unknown I/O mode '" << value << "'" << std::endl;
+                        return false;
+                    }
+                } else if (argument == "--queue-depth") {
+                    if (!parseNumber(value, number) || number < 2) {
+                        std::cerr << "Error: Invalid queue depth '" << value << "'" << std::endl;
+                        return false;
+                    }
+                    options.queueDepth = static_cast<unsigned>(number);
+                } else if (argument == "--offset" || argument == "--length") {
+                    if (!parseNumber(value, number) || number < 0) {
+                        std::cerr << "Error: Invalid " << argument.substr(2) << " '" << value << "'" << std::endl;
+                        return false;
+                    }
+                    if (argument == "--offset") {
+                        options.rangeOffset = static_cast<uint64_t>(number);
+                    } else {
+                        options.rangeLength = static_cast<uint64_t>(number);
+                    }
+                } else if (argument == "--cipher") {
+                    if (!Encryption::parseEngineName(value, options.engine)) {
+                        std::cerr << "Error: Unknown cipher '" << value << "'" << std::endl;
+                        return false;
+                    }
+                } else {
+                    if (!parseNumber(value, number) || number < 0) {
+                        std::cerr << "Error: Invalid file descriptor '" << value << "'" << std::endl;
+                        return false;
+                    }
+                    (argument == "--new-password-fd" ? options.newPasswordFd : options.passwordFd) =
+                        static_cast<int>(number);
+                }
+            } else if (argument == "--compress") {
+                options.compress = true;
+            } else if (argument == "--dedup") {
+                options.dedup = true;
+            } else if (argument.size() > 1 && argument[0] == '-') {
+                std::cerr << "Error: Unknown option " << argument << std::endl;
+                return false;
+            } else {
+                options.inputs.push_back(argument);
+            }
+        }
+
+        if (options.inputs.empty()) {
+            std::cerr << "Error: No input files given" << std::endl;
+            return false;
+        }
+        if (options.command == Command::DecryptRange && options.inputs.size() != 1) {
+            std::cerr << "Error: decrypt-range takes exactly one input file" << std::endl;
+            return false;
+        }
+        if ((options.command == Command::Sync || options.command == Command::Restore ||
+             options.command == Command::Pack || options.command == Command::List) && options.inputs.size() != 1) {
+            std::cerr << "Error: " << command << " takes exactly one folder, store or container" << std::endl;
+            return false;
+        }
+        if ((options.command == Command::Sync || options.command == Command::Pack) &&
+            options.engine == Encryption::EngineType::LegacyXor) {
+            std::cerr << "Error: " << command << " requires the aes-256-gcm cipher" << std::endl;
+            return false;
+        }
+        if (options.dedup && options.command != Command::Pack) {
+            std::cerr << "Error: --dedup only applies to pack" << std::endl;
+            return false;
+        }
+        if (options.compress && options.engine == Encryption::EngineType::LegacyXor) {
+            std::cerr << "Error: --compress requires the aes-256-gcm cipher" << std::endl;
+            return false;
+        }
+        if (options.passwordEnv.empty() && options.passwordFd < 0 && options.command != Command::Verify) {
+            std::cerr << "Error: A password source is required (--password-env or --password-fd)" << std::endl;
+            return false;
+        }
+        if (options.command == Command::Rekey && options.newPasswordEnv.empty() && options.newPasswordFd < 0) {
+            std::cerr << "Error: rekey requires a new password source (--new-password-env or --new-password-fd)"
+                      << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Reads a password from an environment variable or, if none is named, a file descriptor
+    // Only one line is read, so two passwords can share a descriptor; the password never appears
+    // on the command line
+    static bool readPassword(const std::string& passwordEnv, int passwordFd, std::string& password) {
+        if (!passwordEnv.empty()) {
+            const char* value = std::getenv(passwordEnv.c_str());
+            if (value == nullptr) {
+                std::cerr << "Error: Environment variable " << passwordEnv << " is not set" << std::endl;
+                return false;
+            }
+            password = value;
+            return true;
+        }
+
+        char c;
+        password.clear();
+        while (true) {
+            ssize_t count = ::read(passwordFd, &c, 1);
+            if (count < 0) {
+                std::cerr << "Error: Could not read password from file descriptor " << passwordFd << std::endl;
+                return false;
+            }
+            if (count == 0 || c == '\n') {
+                break;
+            }
+            password += c;
+        }
+        if (!password.empty() && password.back() == '\r') {
+            password.pop_back();
+        }
+        return true;
+    }
+
+    // Computes where the result for an input file is written
+    static std::string outputPathFor(const Options& options, const std::string& inputPath) {
+        std::string defaultPath = FileHandler::generateOutputFileName(inputPath, options.command == Command::Encrypt);
+        if (options.outputDirectory.empty()) {
+            return defaultPath;
+        }
+        return (fs::path(options.outputDirectory) / fs::path(defaultPath).filename()).string();
+    }
+
+    // Resolves the output of every input before any work starts
+    // Inputs listed twice, or sharing a basename under -o, would have two workers writing one
+    // file at once; every input after the first to claim an output gets the index of that
+    // first input in owners, and the others their own index
+    static std::vector<std::string> resolveOutputPaths(const Options& options, std::vector<size_t>& owners) {
+        std::vector<std::string> outputPaths(options.inputs.size());
+        std::map<std::string, size_t> claimed;
+        owners.resize(options.inputs.size());
+        for (size_t i = 0; i < options.inputs.size(); ++i) {
+            outputPaths[i] = outputPathFor(options, options.inputs[i]);
+            std::error_code error;
+            fs::path key = fs::weakly_canonical(fs::absolute(outputPaths[i]), error);
+            if (error) {
+                key = fs::absolute(outputPaths[i]).lexically_normal();
+            }
+            owners[i] = claimed.emplace(key.string(), i).first->second;
+        }
+        return outputPaths;
+    }
+
+    // Writes the decrypted range to standard output, which carries nothing else
+    static int runDecryptRange(const Options& options, Encryption::Encryptor& encryptor) {
+        bool success = encryptor.decryptRange(options.inputs[0], options.rangeOffset, options.rangeLength, std::cout);
+        std::cout.flush();
+        return success && !std::cout.fail() ? 0 : 1;
+    }
+
+    // Syncs one folder into its store and prints what changed
+    // Files are hashed and encrypted by a pool of workers, as in batch mode
+    static int runSync(const Options& options, Encryption::Encryptor& encryptor, unsigned jobs) {
+        const std::string& folderPath = options.inputs[0];
+        std::string storePath = options.outputDirectory.empty() ? ArchiveHandler::defaultStorePath(folderPath)
+                                                                : options.outputDirectory;
+        ArchiveHandler::SyncStats stats;
+        auto start = std::chrono::steady_clock::now();
+        bool success = ArchiveHandler::syncFolder(folderPath, storePath, encryptor, stats, jobs);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "----------------------------------------\n";
+        std::cout << "Store: " << storePath << std::endl;
+        std::cout << "Files: " << stats.added << " added, " << stats.changed << " changed, "
+                  << stats.unchanged + stats.touched << " unchanged (" << stats.touched << " touched), "
+                  << stats.deleted << " deleted, " << stats.failed << " failed" << std::endl;
+        std::cout << "Data hashed: " << Utils::formatBytes(stats.bytesHashed) << ", encrypted: "
+                  << Utils::formatBytes(stats.bytesEncrypted) << " in "
+                  << std::fixed << std::setprecision(2) << seconds << " s" << std::endl;
+        std::cout << "Peak memory: " << Utils::formatBytes(Utils::getPeakMemoryUsage()) << std::endl;
+        return success ? 0 : 1;
+    }
+
+    // Restores a folder from its store
+    static int runRestore(const Options& options, Encryption::Encryptor& encryptor, unsigned jobs) {
+        std::string storePath = options.inputs[0];
+        std::string targetPath = options.outputDirectory;
+        if (targetPath.empty()) {
+            fs::path store(storePath);
+            if (store.filename().empty()) {
+                store = store.parent_path();
+            }
+            if (store.extension() == ".encstore") {
+                store.replace_extension();
+            }
+            targetPath = store.string() + "_restored";
+        }
+        bool success = ArchiveHandler::restoreFolder(storePath, targetPath, encryptor, jobs);
+        if (success) {
+            std::cout << "Restored folder: " << targetPath << std::endl;
+        }
+        return success ? 0 : 1;
+    }
+
+    // Scans a folder and writes it as a seekable container
+    static int runPack(const Options& options, Encryption::Encryptor& encryptor) {
+        const std::string& folderPath = options.inputs[0];
+        ArchiveHandler::FolderManifest manifest;
+        if (!ArchiveHandler::isValidFolder(folderPath) || !ArchiveHandler::scanFolder(folderPath, manifest)) {
+            std::cerr << "Error: Could not read folder " << folderPath << std::endl;
+            return 1;
+        }
+        fs::path folder(folderPath);
+        if (folder.filename().empty()) {
+            folder = folder.parent_path();
+        }
+        std::string containerPath = options.outputDirectory.empty() ? folder.string() + ".enc"
+                                                                    : options.outputDirectory;
+
+        auto start = std::chrono::steady_clock::now();
+        ArchiveHandler::ContainerStats stats;
+        bool success = ArchiveHandler::writeFolderContainer(manifest, containerPath, encryptor, nullptr,
+                                                            options.dedup, &stats);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!success) {
+            return 1;
+        }
+        std::cout << "Container: " << containerPath << " (" << manifest.fileCount << " files, "
+                  << Utils::formatBytes(manifest.totalSize) << " in " << std::fixed << std::setprecision(2)
+                  << seconds << " s)" << std::endl;
+        if (options.dedup) {
+            std::cout << "Deduplicated: " << Utils::formatBytes(stats.contentBytes) << " stored as "
+                      << Utils::formatBytes(stats.storedBytes) << " in " << stats.uniqueChunks << " of "
+                      << stats.chunkCount << " chunks (ratio " << std::setprecision(2) << stats.dedupRatio()
+                      << "x)" << std::endl;
+        }
+        return 0;
+    }
+
+    // Prints one line per container entry: type, size, modification time and path
+    static int runList(const Options& options, Encryption::Encryptor& encryptor) {
+        ArchiveHandler::ContainerIndex index;
+        try {
+            index = ArchiveHandler::readContainerIndex(options.inputs[0], encryptor);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        for (const auto& entry : index.entries) {
+            if (entry.path.empty()) {
+                continue;
+            }
+            char type = entry.isDirectory() ? 'd' : entry.isSymlink() ? 'l' : '-';
+            char modified[32] = "";
+            time_t mtime = static_cast<time_t>(entry.mtime);
+            struct tm local;
+            if (localtime_r(&mtime, &local) != nullptr) {
+                std::strftime(modified, sizeof(modified), "%Y-%m-%d %H:%M", &local);
+            }
+            std::cout << type << " " << std::setw(14) << entry.size << " " << modified << " " << entry.path;
+            if (entry.isSymlink()) {
+                std::cout << " -> " << entry.linkTarget;
+            }
+            std::cout << "\n";
+        }
+        std::cout.flush();
+        return 0;
+    }
+
+    // Extracts the entries matching the patterns given after the container (all if none)
+    static int runExtract(const Options& options, Encryption::Encryptor& encryptor, unsigned jobs) {
+        const std::string& containerPath = options.inputs[0];
+        std::vector<std::string> patterns(options.inputs.begin() + 1, options.inputs.end());
+        std::string targetPath = options.outputDirectory;
+        if (targetPath.empty()) {
+            targetPath = FileHandler::generateOutputFileName(containerPath, false) + "_extracted";
+        }
+        bool success = ArchiveHandler::extractFromContainer(containerPath, targetPath, encryptor, patterns, jobs);
+        if (success) {
+            std::cout << "Extracted to: " << targetPath << std::endl;
+        }
+        return success ? 0 : 1;
+    }
+
+    // Verifies each file in turn with all threads on its segments
+    // Checksums alone need no password; with one, every segment is also authenticated
+    static int runVerify(const Options& options, const std::string& password) {
+        unsigned threads = options.jobs == 0 ? Utils::getDefaultThreadCount() : options.jobs;
+        std::unique_ptr<Encryption::Encryptor> encryptor;
+        if (!password.empty()) {
+            encryptor.reset(new Encryption::Encryptor(password));
+            encryptor->setThreadCount(threads);
+        }
+
+        size_t verified = 0;
+        size_t failed = 0;
+        uint64_t bytesChecked = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& inputPath : options.inputs) {
+            bool success = false;
+            try {
+                if (encryptor) {
+                    success = encryptor->verifyFile(inputPath);
+                } else if (!Utils::pathExists(inputPath)) {
+                    std::cerr << "Error: Cannot access " << inputPath << std::endl;
+                } else {
+                    success = Encryption::verifyChecksums(inputPath, threads);
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+
+            if (success) {
+                ++verified;
+                std::error_code error;
+                uint64_t size = fs::file_size(inputPath, error);
+                bytesChecked += error ? 0 : size;
+                std::cout << "✅ OK: " << inputPath << std::endl;
+            } else {
+                ++failed;
+                std::cout << "❌ Failed: " << inputPath << std::endl;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rateSeconds = seconds > 0 ? seconds : 1e-9;
+
+        std::cout << "----------------------------------------\n";
+        std::cout << "Verified: " << verified << " file(s), " << failed << " failed ("
+                  << (encryptor ? "checksums and authentication" : "checksums only") << ")" << std::endl;
+        std::cout << "Data checked: " << Utils::formatBytes(bytesChecked) << " in " << std::fixed
+                  << std::setprecision(2) << seconds << " s (" << std::setprecision(1)
+                  << (bytesChecked / 1e6 / rateSeconds) << " MB/s)" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
+
+    // Rekeys each file in turn; both key derivations run once for the whole batch, since every
+    // rewrapped header gets the new encryptor's salt
+    static int runRekey(const Options& options, const std::string& password, const std::string& newPassword) {
+        Encryption::Encryptor encryptor(password);
+        Encryption::Encryptor newEncryptor(newPassword);
+
+        size_t rekeyed = 0;
+        size_t failed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& inputPath : options.inputs) {
+            bool success = false;
+            try {
+                success = encryptor.rekeyFile(inputPath, newEncryptor);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+
+            if (success) {
+                ++rekeyed;
+                std::cout << "✅ Rekeyed: " << inputPath << std::endl;
+            } else {
+                ++failed;
+                std::cout << "❌ Failed: " << inputPath << std::endl;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "----------------------------------------\n";
+        std::cout << "Rekeyed: " << rekeyed << " file(s), " << failed << " failed in " << std::fixed
+                  << std::setprecision(2) << seconds << " s" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
+
+    // Writes the per-stage timing report requested with --report
+    static bool writeReport(const std::string& reportPath) {
+        std::ofstream report(reportPath);
+        if (report.is_open()) {
+            Utils::writeInstrumentationReport(report);
+        }
+        if (!report.is_open() || report.fail()) {
+            std::cerr << "Error: Could not write report " << reportPath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Runs batch mode: files are claimed from a shared index by a pool of workers
+    int run(int argc, char* argv[]) {
+        std::string programName = fs::path(argv[0]).filename().string();
+        std::string first = argv[1];
+        if (first == "-h" || first == "--help") {
+            printUsage(programName);
+            return 0;
+        }
+
+        Options options;
+        if (!parseArguments(argc, argv, options)) {
+            printUsage(programName);
+            return 2;
+        }
+
+        // verify runs without a password unless a source is given
+        std::string password;
+        bool hasPasswordSource = !options.passwordEnv.empty() || options.passwordFd >= 0;
+        if (hasPasswordSource && !readPassword(options.passwordEnv, options.passwordFd, password)) {
+            return 2;
+        }
+        if (hasPasswordSource && password.empty()) {
+            std::cerr << "Error: Password cannot be empty" << std::endl;
+            return 2;
+        }
+
+        // Timings cover the whole job, including key derivation
+        if (!options.reportPath.empty()) {
+            Utils::enableInstrumentation();
+        }
+
+        if (options.command == Command::Verify) {
+            int status = runVerify(options, password);
+            if (!options.reportPath.empty() && !writeReport(options.reportPath)) {
+                status = 1;
+            }
+            return status;
+        }
+
+        if (options.command == Command::Rekey) {
+            std::string newPassword;
+            if (!readPassword(options.newPasswordEnv, options.newPasswordFd, newPassword)) {
+                return 2;
+            }
+            if (newPassword.empty()) {
+                std::cerr << "Error: New password cannot be empty" << std::endl;
+                return 2;
+            }
+            int status = runRekey(options, password, newPassword);
+            if (!options.reportPath.empty() && !writeReport(options.reportPath)) {
+                status = 1;
+            }
+            return status;
+        }
+
+        if (options.command == Command::DecryptRange) {
+            Encryption::Encryptor encryptor(password);
+            int status = runDecryptRange(options, encryptor);
+            if (!options.reportPath.empty() && !writeReport(options.reportPath)) {
+                status = 1;
+            }
+            return status;
+        }
+
+        // Container operations run on one file; pack and extract use all threads for its segments or entries
+        if (options.command == Command::Pack || options.command == Command::List ||
+            options.command == Command::Extract) {
+            unsigned jobs = options.jobs == 0 ? Utils::getDefaultThreadCount() : options.jobs;
+            Encryption::Encryptor encryptor(password);
+            encryptor.setThreadCount(jobs);
+            int status = options.command == Command::Pack ? runPack(options, encryptor)
+                       : options.command == Command::List ? runList(options, encryptor)
+                                                          : runExtract(options, encryptor, jobs);
+            if (!options.reportPath.empty() && !writeReport(options.reportPath)) {
+                status = 1;
+            }
+            return status;
+        }
+
+        // Sync and restore spread files over the workers and give each file one thread
+        if (options.command == Command::Sync || options.command == Command::Restore) {
+            unsigned jobs = options.jobs == 0 ? Utils::getDefaultThreadCount() : options.jobs;
+            Encryption::Encryptor encryptor(password);
+            encryptor.setCompression(options.compress);
+            encryptor.setThreadCount(1);
+            encryptor.setIoMode(options.ioMode);
+            if (options.queueDepth != 0) {
+                encryptor.setQueueDepth(options.queueDepth);
+            }
+            int status = options.command == Command::Sync ? runSync(options, encryptor, jobs)
+                                                          : runRestore(options, encryptor, jobs);
+            if (!options.reportPath.empty() && !writeReport(options.reportPath)) {
+                status = 1;
+            }
+            return status;
+        }
+
+        if (!options.outputDirectory.empty()) {
+            std::error_code error;
+            fs::create_directories(options.outputDirectory, error);
+            if (error) {
+                std::cerr << "Error: Could not create output directory " << options.outputDirectory << std::endl;
+                return 2;
+            }
+        }
+
+        // Split hardware threads between files in flight and blocks within each file
+        unsigned hardwareThreads = Utils::getDefaultThreadCount();
+        unsigned jobs = options.jobs == 0 ? hardwareThreads : options.jobs;
+        jobs = static_cast<unsigned>(std::min<size_t>(jobs, options.inputs.size()));
+
+        Encryption::Encryptor encryptor(password);
+        encryptor.setEngine(options.engine);
+        encryptor.setCompression(options.compress);
+        encryptor.setThreadCount(std::max(1u, hardwareThreads / jobs));
+        encryptor.setIoMode(options.ioMode);
+        if (options.queueDepth != 0) {
+            encryptor.setQueueDepth(options.queueDepth);
+        }
+
+        bool encrypt = options.command == Command::Encrypt;
+        std::atomic<size_t> nextFile(0);
+        std::atomic<size_t> succeeded(0);
+        std::atomic<size_t> failed(0);
+        std::atomic<uint64_t> bytesProcessed(0);
+        std::atomic<uint64_t> bytesWritten(0);
+        std::mutex outputMutex;
+
+        std::vector<size_t> outputOwners;
+        std::vector<std::string> outputPaths = resolveOutputPaths(options, outputOwners);
+
+        auto start = std::chrono::steady_clock::now();
+
+        Utils::runParallel(jobs, [&](unsigned) {
+            while (true) {
+                size_t index = nextFile.fetch_add(1);
+                if (index >= options.inputs.size()) {
+                    break;
+                }
+
+                const std::string& inputPath = options.inputs[index];
+                const std::string& outputPath = outputPaths[index];
+                std::error_code error;
+                uint64_t size = fs::file_size(inputPath, error);
+
+                bool success = false;
+                try {
+                    if (error) {
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        std::cerr << "Error: Cannot access " << inputPath << std::endl;
+                    } else if (outputPath == inputPath) {
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        std::cerr << "Error: Not an encrypted (.enc) file: " << inputPath << std::endl;
+                    } else if (outputOwners[index] != index) {
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        std::cerr << "Error: " << outputPath << " is already the output of "
+                                  << options.inputs[outputOwners[index]] << ", skipping " << inputPath << std::endl;
+                    } else {
+                        success = encrypt ? encryptor.encryptFile(inputPath, outputPath)
+                                          : encryptor.decryptFile(inputPath, outputPath);
+                    }
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+
+                // Data processed counts plaintext: the input when encrypting, the output when decrypting
+                if (success) {
+                    ++succeeded;
+                    uint64_t written = fs::file_size(outputPath, error);
+                    if (!error) {
+                        bytesWritten += written;
+                    }
+                    bytesProcessed += encrypt ? size : (error ? 0 : written);
+                } else {
+                    ++failed;
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << "❌ Failed: " << inputPath << std::endl;
+                }
+            }
+        });
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rateSeconds = seconds > 0 ? seconds : 1e-9;
+
+        // Print throughput summary
+        std::cout << "----------------------------------------\n";
+        std::cout << (encrypt ? "Encrypted: " : "Decrypted: ") << succeeded << " file(s), "
+                  << failed << " failed, using " << jobs << " worker(s)" << std::endl;
+        std::cout << "Data processed: " << Utils::formatBytes(bytesProcessed) << " in "
+                  << std::fixed << std::setprecision(2) << seconds << " s" << std::endl;
+        std::cout << "Throughput: " << std::setprecision(1) << (succeeded / rateSeconds) << " files/s, "
+                  << (bytesProcessed / 1e6 / rateSeconds) << " MB/s" << std::endl;
+        if (encrypt && options.compress && bytesWritten > 0) {
+            std::cout << "Output size: " << Utils::formatBytes(bytesWritten) << " (compression ratio "
+                      << std::setprecision(2) << (static_cast<double>(bytesProcessed) / bytesWritten) << ":1)" << std::endl;
+        }
+        std::cout << "Peak memory: " << Utils::formatBytes(Utils::getPeakMemoryUsage()) << std::endl;
+
+        if (!options.reportPath.empty() && !writeReport(options.reportPath)) {
+            return 1;
+        }
+        return failed == 0 ? 0 : 1;
+    }
+}
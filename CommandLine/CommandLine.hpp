@@ -0,0 +1,61 @@
+#ifndef COMMANDLINE_HPP
+#define COMMANDLINE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Encryption/Encryption.hpp"
+
+// CommandLine namespace - non-interactive batch mode for the encryption tool
+// Parses command-line arguments and processes many files with a pool of workers
+// sharing one encryptor, then prints a throughput summary
+namespace CommandLine {
+
+    // Operation requested on the command line
+    enum class Command {
+        Encrypt,
+        Decrypt,
+        DecryptRange, // Decrypt part of one file's content to standard output
+        Sync,         // Bring a folder's incremental store up to date
+        Restore,      // Recreate a folder from its incremental store
+        Pack,         // Encrypt a folder into a seekable container
+        List,         // List the entries of a container
+        Extract,      // Extract all or selected entries of a container
+        Verify,       // Check encrypted files for corruption without writing plaintext
+        Rekey         // Change the password of encrypted files by rewriting their headers
+    };
+
+    // Options collected from the command line
+    struct Options {
+        Command command = Command::Encrypt;
+        std::vector<std::string> inputs;  // Files given directly or through --file-list (extract: container, then patterns)
+        std::string outputDirectory;      // Empty = write outputs beside their inputs (store, target or container
+                                          // for sync/restore/pack/extract)
+        std::string passwordEnv;          // Environment variable holding the password (optional for verify)
+        int passwordFd = -1;              // File descriptor to read the password from
+        std::string newPasswordEnv;       // rekey: environment variable holding the new password
+        int newPasswordFd = -1;           // rekey: file descriptor to read the new password from
+        unsigned jobs = 0;                // Files processed in parallel (0 = hardware threads)
+        Encryption::EngineType engine = Encryption::EngineType::Aes256Gcm; // Cipher for new files
+        bool compress = false;            // Compress content before encryption
+        bool dedup = false;               // pack: store identical content-defined chunks once
+        Encryption::IoMode ioMode = Encryption::IoMode::Mapped; // How file content is read and written
+        unsigned queueDepth = 0;          // Blocks in flight for asynchronous I/O (0 = default)
+        uint64_t rangeOffset = 0;         // First content byte for decrypt-range
+        uint64_t rangeLength = UINT64_MAX; // Bytes to decrypt for decrypt-range (default: to the end)
+        std::string reportPath;           // Where to write the per-stage timing report (empty = none)
+    };
+
+    // Prints usage information for batch mode
+    void printUsage(const std::string& programName);
+
+    // Parses arguments into options
+    // Returns false (after printing an error) if the arguments are invalid
+    bool parseArguments(int argc, char* argv[], Options& options);
+
+    // Runs batch mode with the given arguments
+    // Returns the process exit code: 0 on success, 1 if any file failed, 2 on usage errors
+    int run(int argc, char* argv[]);
+}
+
+#endif
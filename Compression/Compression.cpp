@@ -0,0 +1,297 @@
+#include "Compression.hpp"
+#include <cstring>
+
+namespace Compression {
+
+    // Matches are at least this long and are referenced at most this far back
+    static const size_t MIN_MATCH = 4;
+    static const size_t MAX_OFFSET = 65535;
+
+    // The format ends every block with literals: the last match must start at least
+    // MATCH_SAFETY bytes before the end and end at least LAST_LITERALS bytes before it
+    static const size_t LAST_LITERALS = 5;
+    static const size_t MATCH_SAFETY = 12;
+
+    // Hash table of recent positions, indexed by a hash of the next four bytes
+    static const int HASH_LOG = 14;
+
+    static inline uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static inline uint64_t read64(const uint8_t* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // Returns how many leading bytes two words loaded from memory have in common (diff != 0)
+    static inline size_t commonBytes(uint64_t diff) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return static_cast<size_t>(__builtin_clzll(diff) >> 3);
+#else
+        return static_cast<size_t>(__builtin_ctzll(diff) >> 3);
+#endif
+    }
+
+    static inline uint32_t hashSequence(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_LOG);
+    }
+
+    // Writes a length that did not fit in its token nibble as a run of 255s plus a final byte
+    static inline uint8_t* writeLength(uint8_t* op, size_t length) {
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = static_cast<uint8_t>(length);
+        return op;
+    }
+
+    size_t compressBound(size_t length) {
+        return length + length / 255 + 16;
+    }
+
+    // Greedy single-pass compression: look up the hash of the current four bytes, extend any
+    // match found in both directions, and skip ahead faster the longer no match turns up
+    size_t compressBlock(const char* input, size_t length, char* output, size_t capacity) {
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(input);
+        const uint8_t* end = base + length;
+        const uint8_t* anchor = base;
+        uint8_t* op = reinterpret_cast<uint8_t*>(output);
+        uint8_t* outputEnd = op + capacity;
+
+        if (length > MATCH_SAFETY) {
+            std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_LOG, 0);
+            const uint8_t* matchLimit = end - MATCH_SAFETY;
+            const uint8_t* extendLimit = end - LAST_LITERALS;
+            const uint8_t* ip = base + 1;
+
+            while (ip < matchLimit) {
+                uint32_t sequence = read32(ip);
+                uint32_t hash = hashSequence(sequence);
+                const uint8_t* match = base + table[hash];
+                table[hash] = static_cast<uint32_t>(ip - base);
+
+                if (static_cast<size_t>(ip - match) > MAX_OFFSET || match >= ip || read32(match) != sequence) {
+                    ip += 1 + ((ip - anchor) >> 6);
+                    continue;
+                }
+
+                // Extend backwards over literals that also match
+                while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                    --ip;
+                    --match;
+                }
+
+                // Extend forwards, a word at a time
+                const uint8_t* scan = ip + MIN_MATCH;
+                const uint8_t* reference = match + MIN_MATCH;
+                while (true) {
+                    if (scan + sizeof(uint64_t) > extendLimit) {
+                        while (scan < extendLimit && *scan == *reference) {
+                            ++scan;
+                            ++reference;
+                        }
+                        break;
+                    }
+                    uint64_t diff = read64(scan) ^ read64(reference);
+                    if (diff != 0) {
+                        scan += commonBytes(diff);
+                        break;
+                    }
+                    scan += sizeof(uint64_t);
+                    reference += sizeof(uint64_t);
+                }
+                size_t matchLength = static_cast<size_t>(scan - ip);
+
+                // Emit [token][literal length][literals][offset][match length]
+                size_t literalLength = static_cast<size_t>(ip - anchor);
+                size_t needed = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+                if (needed > static_cast<size_t>(outputEnd - op)) {
+                    return 0;
+                }
+                uint8_t* token = op++;
+                if (literalLength >= 15) {
+                    *token = 15 << 4;
+                    op = writeLength(op, literalLength - 15);
+                } else {
+                    *token = static_cast<uint8_t>(literalLength << 4);
+                }
+                std::memcpy(op, anchor, literalLength);
+                op += literalLength;
+
+                uint16_t offset = static_cast<uint16_t>(ip - match);
+                *op++ = static_cast<uint8_t>(offset);
+                *op++ = static_cast<uint8_t>(offset >> 8);
+
+                size_t extraLength = matchLength - MIN_MATCH;
+                if (extraLength >= 15) {
+                    *token |= 15;
+                    op = writeLength(op, extraLength - 15);
+                } else {
+                    *token |= static_cast<uint8_t>(extraLength);
+                }
+
+                ip += matchLength;
+                anchor = ip;
+                if (ip < matchLimit) {
+                    table[hashSequence(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - base);
+                }
+            }
+        }
+
+        // Final literals
+        size_t literalLength = static_cast<size_t>(end - anchor);
+        if (1 + literalLength / 255 + 1 + literalLength > static_cast<size_t>(outputEnd - op)) {
+            return 0;
+        }
+        if (literalLength >= 15) {
+            *op++ = 15 << 4;
+            op = writeLength(op, literalLength - 15);
+        } else {
+            *op++ = static_cast<uint8_t>(literalLength << 4);
+        }
+        std::memcpy(op, anchor, literalLength);
+        op += literalLength;
+
+        return static_cast<size_t>(op - reinterpret_cast<uint8_t*>(output));
+    }
+
+    // Every length and offset is checked against the input and output bounds
+    bool decompressBlock(const char* input, size_t length, char* output, size_t outputLength) {
+        const uint8_t* ip = reinterpret_cast<const uint8_t*>(input);
+        const uint8_t* inputEnd = ip + length;
+        uint8_t* op = reinterpret_cast<uint8_t*>(output);
+        uint8_t* outputStart = op;
+        uint8_t* outputEnd = op + outputLength;
+
+        while (ip < inputEnd) {
+            uint8_t token = *ip++;
+
+            // Literals
+            size_t literalLength = token >> 4;
+
+            // Fast path: short literals followed by a match, with room to copy whole words past the end
+            if (literalLength < 15 && (token & 15) < 15 && inputEnd - ip >= 18 && outputEnd - op >= 32) {
+                std::memcpy(op, ip, 16);
+                ip += literalLength;
+                op += literalLength;
+                size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+                size_t matchLength = (token & 15) + MIN_MATCH;
+                if (offset >= 8 && offset <= static_cast<size_t>(op - outputStart)) {
+                    ip += 2;
+                    const uint8_t* match = op - offset;
+                    std::memcpy(op, match, 8);
+                    std::memcpy(op + 8, match + 8, 8);
+                    std::memcpy(op + 16, match + 16, 2);
+                    op += matchLength;
+                    continue;
+                }
+                // Otherwise take the general path for the match
+                ip -= literalLength;
+                op -= literalLength;
+            }
+            if (literalLength == 15) {
+                uint8_t next;
+                do {
+                    if (ip >= inputEnd) {
+                        return false;
+                    }
+                    next = *ip++;
+                    literalLength += next;
+                } while (next == 255);
+            }
+            if (literalLength > static_cast<size_t>(inputEnd - ip) ||
+                literalLength > static_cast<size_t>(outputEnd - op)) {
+                return false;
+            }
+            std::memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            // The last sequence has literals only
+            if (ip == inputEnd) {
+                break;
+            }
+
+            // Match
+            if (inputEnd - ip < 2) {
+                return false;
+            }
+            size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > static_cast<size_t>(op - outputStart)) {
+                return false;
+            }
+            size_t matchLength = token & 15;
+            if (matchLength == 15) {
+                uint8_t next;
+                do {
+                    if (ip >= inputEnd) {
+                        return false;
+                    }
+                    next = *ip++;
+                    matchLength += next;
+                } while (next == 255);
+            }
+            matchLength += MIN_MATCH;
+            if (matchLength > static_cast<size_t>(outputEnd - op)) {
+                return false;
+            }
+
+            // Overlapping matches repeat the last offset bytes, so they are copied forwards
+            const uint8_t* match = op - offset;
+            if (offset >= 8 && static_cast<size_t>(outputEnd - op) >= matchLength + 8) {
+                uint8_t* target = op + matchLength;
+                do {
+                    std::memcpy(op, match, 8);
+                    op += 8;
+                    match += 8;
+                } while (op < target);
+                op = target;
+            } else if (offset >= matchLength) {
+                std::memcpy(op, match, matchLength);
+                op += matchLength;
+            } else {
+                for (size_t i = 0; i < matchLength; ++i) {
+                    *op++ = *match++;
+                }
+            }
+        }
+
+        return op == outputEnd;
+    }
+
+    void encodeFrame(const char* input, size_t length, std::vector<char>& frames) {
+        size_t frameStart = frames.size();
+        frames.resize(frameStart + FRAME_HEADER_SIZE + length);
+
+        // Only a result smaller than the input is kept
+        size_t compressedSize = length > 0 ?
+                                compressBlock(input, length, frames.data() + frameStart + FRAME_HEADER_SIZE, length - 1) : 0;
+        uint32_t header;
+        if (compressedSize > 0) {
+            header = static_cast<uint32_t>(compressedSize);
+            frames.resize(frameStart + FRAME_HEADER_SIZE + compressedSize);
+        } else {
+            header = static_cast<uint32_t>(length) | FRAME_STORED_RAW;
+            std::memcpy(frames.data() + frameStart + FRAME_HEADER_SIZE, input, length);
+        }
+        std::memcpy(frames.data() + frameStart, &header, sizeof(header));
+    }
+
+    bool decodeFrame(uint32_t frameHeader, const char* payload, char* output, size_t outputLength) {
+        size_t payloadLength = frameHeader & ~FRAME_STORED_RAW;
+        if (frameHeader & FRAME_STORED_RAW) {
+            if (payloadLength != outputLength) {
+                return false;
+            }
+            std::memcpy(output, payload, outputLength);
+            return true;
+        }
+        return decompressBlock(payload, payloadLength, output, outputLength);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compression namespace - fast LZ block compression applied to content before encryption
+// Blocks use the LZ4 block format (token, literals, 16-bit offset, match length) and are
+// independent of each other, so any number of them can be compressed or decompressed in parallel
+namespace Compression {
+
+    // Compression methods that can be recorded in an encrypted file's metadata
+    enum class CompressionType : uint8_t {
+        None = 0,
+        Lz = 1    // LZ4-format blocks, each wrapped in a frame
+    };
+
+    // Frame header bit marking a block stored uncompressed because it did not shrink
+    const uint32_t FRAME_STORED_RAW = 0x80000000u;
+
+    // Size of the frame header preceding each block: [u32 payload length | FRAME_STORED_RAW]
+    const size_t FRAME_HEADER_SIZE = sizeof(uint32_t);
+
+    // Largest block accepted by the frame functions (64 MiB)
+    const size_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    // Returns the largest compressed size compressBlock can produce for length bytes
+    size_t compressBound(size_t length);
+
+    // Compresses length bytes into output (capacity bytes available)
+    // Returns the compressed size, or 0 if the result would not fit in capacity
+    size_t compressBlock(const char* input, size_t length, char* output, size_t capacity);
+
+    // Decompresses a block that must expand to exactly outputLength bytes
+    // Returns false for malformed input instead of reading or writing out of bounds
+    bool decompressBlock(const char* input, size_t length, char* output, size_t outputLength);
+
+    // Appends one frame holding length bytes to frames: compressed if that saves space,
+    // stored raw otherwise, so a frame is never more than FRAME_HEADER_SIZE bytes larger
+    void encodeFrame(const char* input, size_t length, std::vector<char>& frames);
+
+    // Decodes a frame payload (without its header) into exactly outputLength bytes
+    // Returns false if the payload is malformed or has the wrong length
+    bool decodeFrame(uint32_t frameHeader, const char* payload, char* output, size_t outputLength);
+}
+
+#endif
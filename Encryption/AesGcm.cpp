@@ -0,0 +1,478 @@
+#include "AesGcm.hpp"
+#include "Crypto.hpp"
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AESGCM_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace Encryption {
+
+    // Number of AES-256 rounds
+    static const int AES_ROUNDS = 14;
+
+    static inline uint32_t loadBigEndian32(const uint8_t* bytes) {
+        return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+    }
+
+    static inline void storeBigEndian32(uint8_t* bytes, uint32_t value) {
+        bytes[0] = static_cast<uint8_t>(value >> 24);
+        bytes[1] = static_cast<uint8_t>(value >> 16);
+        bytes[2] = static_cast<uint8_t>(value >> 8);
+        bytes[3] = static_cast<uint8_t>(value);
+    }
+
+    static inline void storeBigEndian64(uint8_t* bytes, uint64_t value) {
+        storeBigEndian32(bytes, static_cast<uint32_t>(value >> 32));
+        storeBigEndian32(bytes + 4, static_cast<uint32_t>(value));
+    }
+
+    // S-box and combined SubBytes/ShiftRows/MixColumns tables for the portable AES path
+    struct AesTables {
+        uint8_t sbox[256];
+        uint32_t round[4][256];
+    };
+
+    // Builds the tables from the field arithmetic instead of hardcoding 4 KiB of constants
+    // p walks the multiplicative group by powers of 3 while q tracks its inverse
+    static AesTables buildAesTables() {
+        AesTables tables;
+        uint8_t p = 1, q = 1;
+        do {
+            p = static_cast<uint8_t>(p ^ (p << 1) ^ ((p & 0x80) ? 0x1b : 0));
+            q = static_cast<uint8_t>(q ^ (q << 1));
+            q = static_cast<uint8_t>(q ^ (q << 2));
+            q = static_cast<uint8_t>(q ^ (q << 4));
+            if (q & 0x80) {
+                q ^= 0x09;
+            }
+            auto rotate = [](uint8_t value, int bits) {
+                return static_cast<uint8_t>((value << bits) | (value >> (8 - bits)));
+            };
+            tables.sbox[p] = static_cast<uint8_t>(q ^ rotate(q, 1) ^ rotate(q, 2) ^ rotate(q, 3) ^ rotate(q, 4) ^ 0x63);
+        } while (p != 1);
+        tables.sbox[0] = 0x63;
+
+        for (int i = 0; i < 256; ++i) {
+            uint32_t s = tables.sbox[i];
+            uint32_t s2 = ((s << 1) ^ ((s & 0x80) ? 0x1b : 0)) & 0xff;
+            uint32_t s3 = s2 ^ s;
+            uint32_t word = (s2 << 24) | (s << 16) | (s << 8) | s3;
+            for (int t = 0; t < 4; ++t) {
+                tables.round[t][i] = word;
+                word = (word >> 8) | (word << 24);
+            }
+        }
+        return tables;
+    }
+
+    static const AesTables& aesTables() {
+        static const AesTables tables = buildAesTables();
+        return tables;
+    }
+
+    // Reduction constants for the portable 4-bit GHASH multiply
+    static const uint64_t GHASH_REDUCTION[16] = {
+        0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+        0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+    };
+
+    // Multiplies x by H in GF(2^128) using the precomputed 4-bit table (Shoup's method)
+    static void ghashMultiplyPortable(uint8_t* x, const uint64_t* tableHigh, const uint64_t* tableLow) {
+        uint8_t low = x[15] & 0x0f;
+        uint64_t zh = tableHigh[low];
+        uint64_t zl = tableLow[low];
+
+        for (int i = 15; i >= 0; --i) {
+            low = x[i] & 0x0f;
+            uint8_t high = (x[i] >> 4) & 0x0f;
+
+            if (i != 15) {
+                uint8_t remainder = zl & 0x0f;
+                zl = (zh << 60) | (zl >> 4);
+                zh = (zh >> 4) ^ (GHASH_REDUCTION[remainder] << 48);
+                zh ^= tableHigh[low];
+                zl ^= tableLow[low];
+            }
+
+            uint8_t remainder = zl & 0x0f;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (GHASH_REDUCTION[remainder] << 48);
+            zh ^= tableHigh[high];
+            zl ^= tableLow[high];
+        }
+
+        storeBigEndian64(x, zh);
+        storeBigEndian64(x + 8, zl);
+    }
+
+#ifdef AESGCM_X86_DISPATCH
+    // AES-NI counter mode - eight independent blocks in flight to hide the aesenc latency
+    __attribute__((target("aes,sse4.1")))
+    static void applyCounterAesni(const uint8_t* roundKeys, uint8_t* output, const uint8_t* input,
+                                  size_t length, const uint8_t* iv) {
+        __m128i keys[AES_ROUNDS + 1];
+        for (int i = 0; i <= AES_ROUNDS; ++i) {
+            keys[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(roundKeys + 16 * i));
+        }
+
+        uint8_t baseBytes[16] = {};
+        std::memcpy(baseBytes, iv, AesGcm::IV_SIZE);
+        __m128i base = _mm_loadu_si128(reinterpret_cast<const __m128i*>(baseBytes));
+        uint32_t counter = 2;
+        size_t i = 0;
+
+        for (; i + 128 <= length; i += 128, counter += 8) {
+            __m128i blocks[8];
+            for (int b = 0; b < 8; ++b) {
+                blocks[b] = _mm_insert_epi32(base, static_cast<int>(__builtin_bswap32(counter + b)), 3);
+                blocks[b] = _mm_xor_si128(blocks[b], keys[0]);
+            }
+            for (int round = 1; round < AES_ROUNDS; ++round) {
+                for (int b = 0; b < 8; ++b) {
+                    blocks[b] = _mm_aesenc_si128(blocks[b], keys[round]);
+                }
+            }
+            for (int b = 0; b < 8; ++b) {
+                blocks[b] = _mm_aesenclast_si128(blocks[b], keys[AES_ROUNDS]);
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 16 * b));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 16 * b), _mm_xor_si128(data, blocks[b]));
+            }
+        }
+
+        for (; i < length; i += 16, ++counter) {
+            __m128i block = _mm_insert_epi32(base, static_cast<int>(__builtin_bswap32(counter)), 3);
+            block = _mm_xor_si128(block, keys[0]);
+            for (int round = 1; round < AES_ROUNDS; ++round) {
+                block = _mm_aesenc_si128(block, keys[round]);
+            }
+            block = _mm_aesenclast_si128(block, keys[AES_ROUNDS]);
+
+            if (length - i >= 16) {
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_xor_si128(data, block));
+            } else {
+                uint8_t keyBytes[16];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(keyBytes), block);
+                for (size_t j = 0; j < length - i; ++j) {
+                    output[i + j] = input[i + j] ^ keyBytes[j];
+                }
+            }
+        }
+    }
+
+    // Reverses the byte order so GHASH operands can be multiplied as little-endian integers
+    __attribute__((target("pclmul,sse4.1")))
+    static inline __m128i reverseBytes(__m128i value) {
+        return _mm_shuffle_epi8(value, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    }
+
+    // 128x128 -> 256-bit carry-less product, left unreduced so several products can be summed first
+    __attribute__((target("pclmul,sse4.1")))
+    static inline void multiplyWide(__m128i a, __m128i b, __m128i& low, __m128i& high) {
+        __m128i lowProduct = _mm_clmulepi64_si128(a, b, 0x00);
+        __m128i middle = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+        __m128i highProduct = _mm_clmulepi64_si128(a, b, 0x11);
+        low = _mm_xor_si128(lowProduct, _mm_slli_si128(middle, 8));
+        high = _mm_xor_si128(highProduct, _mm_srli_si128(middle, 8));
+    }
+
+    // Reduces a 256-bit product modulo the GCM polynomial (Intel carry-less multiplication white paper)
+    // The product is first shifted left by one bit to account for GCM's reflected bit order
+    __attribute__((target("pclmul,sse4.1")))
+    static inline __m128i reduceWide(__m128i low, __m128i high) {
+        __m128i lowCarry = _mm_srli_epi32(low, 31);
+        __m128i highCarry = _mm_srli_epi32(high, 31);
+        low = _mm_slli_epi32(low, 1);
+        high = _mm_slli_epi32(high, 1);
+        __m128i crossCarry = _mm_srli_si128(lowCarry, 12);
+        highCarry = _mm_slli_si128(highCarry, 4);
+        lowCarry = _mm_slli_si128(lowCarry, 4);
+        low = _mm_or_si128(low, lowCarry);
+        high = _mm_or_si128(_mm_or_si128(high, highCarry), crossCarry);
+
+        __m128i a = _mm_slli_epi32(low, 31);
+        __m128i b = _mm_slli_epi32(low, 30);
+        __m128i c = _mm_slli_epi32(low, 25);
+        a = _mm_xor_si128(_mm_xor_si128(a, b), c);
+        b = _mm_srli_si128(a, 4);
+        a = _mm_slli_si128(a, 12);
+        low = _mm_xor_si128(low, a);
+
+        __m128i d = _mm_srli_epi32(low, 1);
+        __m128i e = _mm_srli_epi32(low, 2);
+        __m128i f = _mm_srli_epi32(low, 7);
+        d = _mm_xor_si128(_mm_xor_si128(_mm_xor_si128(d, e), f), b);
+        low = _mm_xor_si128(low, d);
+        return _mm_xor_si128(high, low);
+    }
+
+    __attribute__((target("pclmul,sse4.1")))
+    static inline __m128i multiplyReduced(__m128i a, __m128i b) {
+        __m128i low, high;
+        multiplyWide(a, b, low, high);
+        return reduceWide(low, high);
+    }
+
+    // Computes H, H^2, H^3 and H^4 in byte-reversed form for the aggregated GHASH loop
+    __attribute__((target("pclmul,sse4.1")))
+    static void computeHashPowers(const uint8_t* hashKey, uint8_t (*powers)[16]) {
+        __m128i h = reverseBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hashKey)));
+        __m128i power = h;
+        for (int i = 0; i < 4; ++i) {
+            _mm_store_si128(reinterpret_cast<__m128i*>(powers[i]), power);
+            power = multiplyReduced(power, h);
+        }
+    }
+
+    // PCLMULQDQ GHASH - four blocks per reduction using the precomputed powers of H
+    __attribute__((target("pclmul,sse4.1")))
+    static void hashBlocksClmul(const uint8_t (*powers)[16], uint8_t* state, const uint8_t* data, size_t blocks) {
+        __m128i h1 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers[0]));
+        __m128i h2 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers[1]));
+        __m128i h3 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers[2]));
+        __m128i h4 = _mm_load_si128(reinterpret_cast<const __m128i*>(powers[3]));
+        __m128i x = reverseBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)));
+
+        for (; blocks >= 4; blocks -= 4, data += 64) {
+            __m128i d0 = reverseBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+            __m128i d1 = reverseBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)));
+            __m128i d2 = reverseBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)));
+            __m128i d3 = reverseBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)));
+
+            __m128i low, high, partLow, partHigh;
+            multiplyWide(_mm_xor_si128(x, d0), h4, low, high);
+            multiplyWide(d1, h3, partLow, partHigh);
+            low = _mm_xor_si128(low, partLow);
+            high = _mm_xor_si128(high, partHigh);
+            multiplyWide(d2, h2, partLow, partHigh);
+            low = _mm_xor_si128(low, partLow);
+            high = _mm_xor_si128(high, partHigh);
+            multiplyWide(d3, h1, partLow, partHigh);
+            low = _mm_xor_si128(low, partLow);
+            high = _mm_xor_si128(high, partHigh);
+            x = reduceWide(low, high);
+        }
+
+        for (; blocks > 0; --blocks, data += 16) {
+            __m128i d = reverseBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+            x = multiplyReduced(_mm_xor_si128(x, d), h1);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), reverseBytes(x));
+    }
+#endif
+
+    // Hardware path requires both AES-NI and PCLMULQDQ; resolved once on first use
+    static bool detectHardwareSupport() {
+#ifdef AESGCM_X86_DISPATCH
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+               __builtin_cpu_supports("sse4.1");
+#else
+        return false;
+#endif
+    }
+
+    static bool useHardware() {
+        static const bool supported = detectHardwareSupport();
+        return supported;
+    }
+
+    // Expands the key (FIPS 197 key schedule) and derives the GHASH key H = E(K, 0^128)
+    AesGcm::AesGcm(const uint8_t* key) {
+        const AesTables& tables = aesTables();
+        static const uint8_t roundConstants[7] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40};
+
+        for (int i = 0; i < 8; ++i) {
+            roundWords[i] = loadBigEndian32(key + 4 * i);
+        }
+        for (int i = 8; i < 60; ++i) {
+            uint32_t temp = roundWords[i - 1];
+            if (i % 8 == 0) {
+                temp = (temp << 8) | (temp >> 24);
+                temp = (uint32_t(tables.sbox[temp >> 24]) << 24) | (uint32_t(tables.sbox[(temp >> 16) & 0xff]) << 16) |
+                       (uint32_t(tables.sbox[(temp >> 8) & 0xff]) << 8) | uint32_t(tables.sbox[temp & 0xff]);
+                temp ^= uint32_t(roundConstants[i / 8 - 1]) << 24;
+            } else if (i % 8 == 4) {
+                temp = (uint32_t(tables.sbox[temp >> 24]) << 24) | (uint32_t(tables.sbox[(temp >> 16) & 0xff]) << 16) |
+                       (uint32_t(tables.sbox[(temp >> 8) & 0xff]) << 8) | uint32_t(tables.sbox[temp & 0xff]);
+            }
+            roundWords[i] = roundWords[i - 8] ^ temp;
+        }
+        for (int i = 0; i < 60; ++i) {
+            storeBigEndian32(roundKeys + 4 * i, roundWords[i]);
+        }
+
+        uint8_t hashKey[16] = {};
+        encryptBlock(hashKey, hashKey);
+
+        // Portable table: entry i holds i * H for every 4-bit value i
+        uint64_t high = 0, low = 0;
+        for (int i = 0; i < 8; ++i) {
+            high = (high << 8) | hashKey[i];
+            low = (low << 8) | hashKey[8 + i];
+        }
+        hashTableHigh[0] = hashTableLow[0] = 0;
+        hashTableHigh[8] = high;
+        hashTableLow[8] = low;
+        for (int i = 4; i > 0; i >>= 1) {
+            uint64_t carry = (low & 1) ? 0xe100000000000000ULL : 0;
+            low = (high << 63) | (low >> 1);
+            high = (high >> 1) ^ carry;
+            hashTableHigh[i] = high;
+            hashTableLow[i] = low;
+        }
+        for (int i = 2; i <= 8; i *= 2) {
+            for (int j = 1; j < i; ++j) {
+                hashTableHigh[i + j] = hashTableHigh[i] ^ hashTableHigh[j];
+                hashTableLow[i + j] = hashTableLow[i] ^ hashTableLow[j];
+            }
+        }
+
+        std::memset(hashPowers, 0, sizeof(hashPowers));
+#ifdef AESGCM_X86_DISPATCH
+        if (useHardware()) {
+            computeHashPowers(hashKey, hashPowers);
+        }
+#endif
+    }
+
+    // Key material is wiped so it does not linger in freed memory
+    AesGcm::~AesGcm() {
+        volatile uint8_t* bytes = roundKeys;
+        for (size_t i = 0; i < sizeof(roundKeys); ++i) {
+            bytes[i] = 0;
+        }
+        volatile uint32_t* words = roundWords;
+        for (size_t i = 0; i < 60; ++i) {
+            words[i] = 0;
+        }
+    }
+
+    // Table-driven AES block encryption, used for the portable path and for single blocks
+    // Lookups are data-dependent, so this path is only used when AES-NI is unavailable for bulk data
+    void AesGcm::encryptBlock(const uint8_t* input, uint8_t* output) const {
+        const AesTables& tables = aesTables();
+        const uint32_t* rk = roundWords;
+        const uint32_t (*te)[256] = tables.round;
+
+        uint32_t s0 = loadBigEndian32(input) ^ rk[0];
+        uint32_t s1 = loadBigEndian32(input + 4) ^ rk[1];
+        uint32_t s2 = loadBigEndian32(input + 8) ^ rk[2];
+        uint32_t s3 = loadBigEndian32(input + 12) ^ rk[3];
+
+        for (int round = 1; round < AES_ROUNDS; ++round) {
+            rk += 4;
+            uint32_t t0 = te[0][s0 >> 24] ^ te[1][(s1 >> 16) & 0xff] ^ te[2][(s2 >> 8) & 0xff] ^ te[3][s3 & 0xff] ^ rk[0];
+            uint32_t t1 = te[0][s1 >> 24] ^ te[1][(s2 >> 16) & 0xff] ^ te[2][(s3 >> 8) & 0xff] ^ te[3][s0 & 0xff] ^ rk[1];
+            uint32_t t2 = te[0][s2 >> 24] ^ te[1][(s3 >> 16) & 0xff] ^ te[2][(s0 >> 8) & 0xff] ^ te[3][s1 & 0xff] ^ rk[2];
+            uint32_t t3 = te[0][s3 >> 24] ^ te[1][(s0 >> 16) & 0xff] ^ te[2][(s1 >> 8) & 0xff] ^ te[3][s2 & 0xff] ^ rk[3];
+            s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+        }
+
+        rk += 4;
+        const uint8_t* sbox = tables.sbox;
+        auto lastRound = [sbox](uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t key) {
+            return ((uint32_t(sbox[a >> 24]) << 24) | (uint32_t(sbox[(b >> 16) & 0xff]) << 16) |
+                    (uint32_t(sbox[(c >> 8) & 0xff]) << 8) | uint32_t(sbox[d & 0xff])) ^ key;
+        };
+        storeBigEndian32(output, lastRound(s0, s1, s2, s3, rk[0]));
+        storeBigEndian32(output + 4, lastRound(s1, s2, s3, s0, rk[1]));
+        storeBigEndian32(output + 8, lastRound(s2, s3, s0, s1, rk[2]));
+        storeBigEndian32(output + 12, lastRound(s3, s0, s1, s2, rk[3]));
+    }
+
+    // Counter blocks are IV || counter (32-bit big-endian); counter 1 is reserved for the tag
+    void AesGcm::applyCounter(uint8_t* output, const uint8_t* input, size_t length, const uint8_t* iv) const {
+#ifdef AESGCM_X86_DISPATCH
+        if (useHardware()) {
+            applyCounterAesni(roundKeys, output, input, length, iv);
+            return;
+        }
+#endif
+        uint8_t counterBlock[16];
+        uint8_t keyBlock[16];
+        std::memcpy(counterBlock, iv, IV_SIZE);
+        uint32_t counter = 2;
+
+        for (size_t i = 0; i < length; i += 16, ++counter) {
+            storeBigEndian32(counterBlock + 12, counter);
+            encryptBlock(counterBlock, keyBlock);
+            size_t blockLength = length - i < 16 ? length - i : 16;
+            for (size_t j = 0; j < blockLength; ++j) {
+                output[i + j] = input[i + j] ^ keyBlock[j];
+            }
+        }
+    }
+
+    void AesGcm::hashBlocks(uint8_t* state, const uint8_t* data, size_t blocks) const {
+#ifdef AESGCM_X86_DISPATCH
+        if (useHardware()) {
+            hashBlocksClmul(hashPowers, state, data, blocks);
+            return;
+        }
+#endif
+        for (size_t b = 0; b < blocks; ++b) {
+            for (int i = 0; i < 16; ++i) {
+                state[i] ^= data[16 * b + i];
+            }
+            ghashMultiplyPortable(state, hashTableHigh, hashTableLow);
+        }
+    }
+
+    void AesGcm::hashData(uint8_t* state, const uint8_t* data, size_t length) const {
+        size_t blocks = length / 16;
+        hashBlocks(state, data, blocks);
+        if (length % 16 != 0) {
+            uint8_t last[16] = {};
+            std::memcpy(last, data + blocks * 16, length % 16);
+            hashBlocks(state, last, 1);
+        }
+    }
+
+    // Tag = E(K, IV || 1) XOR GHASH(aad || ciphertext || bit lengths)
+    void AesGcm::computeTag(const uint8_t* aad, size_t aadLength, const uint8_t* ciphertext, size_t length,
+                            const uint8_t* iv, uint8_t* tag) const {
+        uint8_t state[16] = {};
+        hashData(state, aad, aadLength);
+        hashData(state, ciphertext, length);
+
+        uint8_t lengths[16];
+        storeBigEndian64(lengths, static_cast<uint64_t>(aadLength) * 8);
+        storeBigEndian64(lengths + 8, static_cast<uint64_t>(length) * 8);
+        hashBlocks(state, lengths, 1);
+
+        uint8_t counterBlock[16];
+        std::memcpy(counterBlock, iv, IV_SIZE);
+        storeBigEndian32(counterBlock + 12, 1);
+        uint8_t mask[16];
+        encryptBlock(counterBlock, mask);
+        for (int i = 0; i < 16; ++i) {
+            tag[i] = state[i] ^ mask[i];
+        }
+    }
+
+    void AesGcm::encrypt(uint8_t* output, const uint8_t* input, size_t length, const uint8_t* iv,
+                         const uint8_t* aad, size_t aadLength, uint8_t* tag) const {
+        applyCounter(output, input, length, iv);
+        computeTag(aad, aadLength, output, length, iv, tag);
+    }
+
+    // The tag is checked before anything is decrypted, so unauthenticated plaintext is never released
+    bool AesGcm::decrypt(uint8_t* output, const uint8_t* input, size_t length, const uint8_t* iv,
+                         const uint8_t* aad, size_t aadLength, const uint8_t* tag) const {
+        uint8_t expected[TAG_SIZE];
+        computeTag(aad, aadLength, input, length, iv, expected);
+        if (!constantTimeEqual(expected, tag, TAG_SIZE)) {
+            return false;
+        }
+        applyCounter(output, input, length, iv);
+        return true;
+    }
+
+    const char* AesGcm::activeImplementationName() {
+        return useHardware() ? "aesni-pclmul" : "portable";
+    }
+}
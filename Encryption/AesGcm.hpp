@@ -0,0 +1,63 @@
+#ifndef AESGCM_HPP
+#define AESGCM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// AES-256 in Galois/Counter Mode (NIST SP 800-38D) with 96-bit IVs and 128-bit tags
+// AES-NI and PCLMULQDQ are used when the CPU supports them (selected once at runtime),
+// with portable table-driven code for AES and GHASH on other CPUs
+namespace Encryption {
+
+    class AesGcm {
+    private:
+        alignas(16) uint8_t roundKeys[240]; // Expanded key, 15 round keys in byte order
+        uint32_t roundWords[60];            // Same round keys as big-endian words for the table path
+        alignas(16) uint8_t hashPowers[4][16]; // H^1..H^4 byte-reversed for the carry-less multiply path
+        uint64_t hashTableHigh[16];         // 4-bit multiplication table for the portable GHASH
+        uint64_t hashTableLow[16];
+
+        // Encrypts a single 16-byte block
+        void encryptBlock(const uint8_t* input, uint8_t* output) const;
+
+        // Encrypts or decrypts length bytes in counter mode, starting at counter value 2
+        void applyCounter(uint8_t* output, const uint8_t* input, size_t length, const uint8_t* iv) const;
+
+        // Computes the GHASH-based tag over the additional data and ciphertext
+        void computeTag(const uint8_t* aad, size_t aadLength, const uint8_t* ciphertext, size_t length,
+                        const uint8_t* iv, uint8_t* tag) const;
+
+        // Folds whole 16-byte blocks into the GHASH state
+        void hashBlocks(uint8_t* state, const uint8_t* data, size_t blocks) const;
+
+        // Folds data into the GHASH state, zero-padding the final partial block
+        void hashData(uint8_t* state, const uint8_t* data, size_t length) const;
+
+    public:
+        static const size_t KEY_SIZE = 32;
+        static const size_t IV_SIZE = 12;
+        static const size_t TAG_SIZE = 16;
+
+        // Expands a 32-byte key and precomputes the GHASH tables
+        explicit AesGcm(const uint8_t* key);
+        ~AesGcm();
+
+        AesGcm(const AesGcm&) = delete;
+        AesGcm& operator=(const AesGcm&) = delete;
+
+        // Encrypts length bytes and writes the 16-byte authentication tag
+        // aad is authenticated but not encrypted; output may alias input
+        void encrypt(uint8_t* output, const uint8_t* input, size_t length, const uint8_t* iv,
+                     const uint8_t* aad, size_t aadLength, uint8_t* tag) const;
+
+        // Verifies the tag, then decrypts length bytes
+        // Returns false (leaving output untouched) if the data or tag was modified or the key is wrong
+        bool decrypt(uint8_t* output, const uint8_t* input, size_t length, const uint8_t* iv,
+                     const uint8_t* aad, size_t aadLength, const uint8_t* tag) const;
+
+        // Returns the implementation selected for this CPU ("aesni-pclmul" or "portable")
+        static const char* activeImplementationName();
+    };
+}
+
+#endif
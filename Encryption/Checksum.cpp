@@ -0,0 +1,185 @@
+#include "Checksum.hpp"
+#include <array>
+#include <cstring>
+
+// The kernel feeds 64-bit words to the crc32 instruction, which exists only in 64-bit mode
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CHECKSUM_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace Encryption {
+namespace Checksum {
+
+    // CRC32C polynomial in reflected (least significant bit first) form
+    static const uint32_t POLYNOMIAL = 0x82F63B78;
+
+    // Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes
+    using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+    static Tables buildTables() {
+        Tables tables;
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+            }
+            tables[0][byte] = crc;
+        }
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            for (size_t k = 1; k < tables.size(); ++k) {
+                tables[k][byte] = (tables[k - 1][byte] >> 8) ^ tables[0][tables[k - 1][byte] & 0xFF];
+            }
+        }
+        return tables;
+    }
+
+    // Portable kernel - eight table lookups per 8 bytes, then the tail byte by byte
+    uint32_t crc32cScalar(const char* data, size_t length, uint32_t crc) {
+        static const Tables tables = buildTables();
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        crc = ~crc;
+        for (; length >= 8; bytes += 8, length -= 8) {
+            uint32_t low, high;
+            std::memcpy(&low, bytes, sizeof(low));
+            std::memcpy(&high, bytes + 4, sizeof(high));
+            low ^= crc;
+            crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^
+                  tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24] ^
+                  tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^
+                  tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+        }
+        for (; length > 0; ++bytes, --length) {
+            crc = (crc >> 8) ^ tables[0][(crc ^ *bytes) & 0xFF];
+        }
+        return ~crc;
+    }
+
+    // Multiplies two polynomials modulo the CRC polynomial (bit 31 is x^0)
+    static uint32_t multiplyModP(uint32_t a, uint32_t b) {
+        uint32_t product = 0;
+        for (uint32_t mask = 1u << 31; mask != 0; mask >>= 1) {
+            if (a & mask) {
+                product ^= b;
+            }
+            b = (b & 1) ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+        }
+        return product;
+    }
+
+    // Returns x^(8 * bytes) modulo the CRC polynomial: multiplying a CRC register by it is the
+    // same as feeding it that many zero bytes
+    static uint32_t zeroBytesOperator(uint64_t bytes) {
+        uint32_t result = 1u << 31;  // x^0
+        uint32_t square = 1u << 23;  // x^8, one zero byte
+        for (; bytes != 0; bytes >>= 1) {
+            if (bytes & 1) {
+                result = multiplyModP(square, result);
+            }
+            square = multiplyModP(square, square);
+        }
+        return result;
+    }
+
+    // Feeding lengthB zero bytes shifts the first CRC past the second message; the pre- and
+    // post-inversions of the two CRCs cancel out, as in zlib's crc32_combine
+    uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t lengthB) {
+        return multiplyModP(zeroBytesOperator(lengthB), crcA) ^ crcB;
+    }
+
+#ifdef CHECKSUM_X86_DISPATCH
+    // Lane lengths for the three-stream loop; long lanes cover most of a segment and short
+    // lanes the remainder, so only a few bytes run through the single dependency chain
+    static const size_t LONG_LANE = 8192;
+    static const size_t SHORT_LANE = 256;
+
+    // Operators shifting the first two streams past the lanes that follow them
+    struct LaneShifts {
+        uint32_t longOne, longTwo, shortOne, shortTwo;
+    };
+
+    static const LaneShifts& laneShifts() {
+        static const LaneShifts shifts = {zeroBytesOperator(LONG_LANE), zeroBytesOperator(2 * LONG_LANE),
+                                          zeroBytesOperator(SHORT_LANE), zeroBytesOperator(2 * SHORT_LANE)};
+        return shifts;
+    }
+
+    // Runs three independent crc32 chains over consecutive lanes of each 3 * lane bytes and merges
+    // them; the instruction has a latency of three cycles but issues every cycle
+    __attribute__((target("sse4.2")))
+    static uint64_t crc32cLanes(uint64_t crc, const char*& data, size_t& length, size_t lane,
+                                uint32_t shiftOne, uint32_t shiftTwo) {
+        while (length >= 3 * lane) {
+            uint64_t first = crc, second = 0, third = 0;
+            for (size_t i = 0; i < lane; i += 8) {
+                uint64_t a, b, c;
+                std::memcpy(&a, data + i, sizeof(a));
+                std::memcpy(&b, data + lane + i, sizeof(b));
+                std::memcpy(&c, data + 2 * lane + i, sizeof(c));
+                first = _mm_crc32_u64(first, a);
+                second = _mm_crc32_u64(second, b);
+                third = _mm_crc32_u64(third, c);
+            }
+            crc = multiplyModP(shiftTwo, static_cast<uint32_t>(first)) ^
+                  multiplyModP(shiftOne, static_cast<uint32_t>(second)) ^ static_cast<uint32_t>(third);
+            data += 3 * lane;
+            length -= 3 * lane;
+        }
+        return crc;
+    }
+
+    // SSE4.2 kernel - 8 bytes per instruction on three streams, then the tail in one stream
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32cSse42(const char* data, size_t length, uint32_t crc) {
+        const LaneShifts& shifts = laneShifts();
+        uint64_t state = static_cast<uint32_t>(~crc);
+        state = crc32cLanes(state, data, length, LONG_LANE, shifts.longOne, shifts.longTwo);
+        state = crc32cLanes(state, data, length, SHORT_LANE, shifts.shortOne, shifts.shortTwo);
+        for (; length >= 8; data += 8, length -= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            state = _mm_crc32_u64(state, word);
+        }
+        uint32_t result = static_cast<uint32_t>(state);
+        for (; length > 0; ++data, --length) {
+            result = _mm_crc32_u8(result, static_cast<unsigned char>(*data));
+        }
+        return ~result;
+    }
+#endif
+
+    using KernelFunction = uint32_t (*)(const char*, size_t, uint32_t);
+
+    struct Kernel {
+        KernelFunction function;
+        const char* name;
+    };
+
+    // Selects the hardware kernel when the running CPU supports it (queried via cpuid)
+    static Kernel selectKernel() {
+#ifdef CHECKSUM_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2")) {
+            return {crc32cSse42, "sse4.2"};
+        }
+#endif
+        return {crc32cScalar, "scalar"};
+    }
+
+    // Kernel is resolved once on first use and shared by all callers
+    static const Kernel& activeKernel() {
+        static const Kernel kernel = selectKernel();
+        return kernel;
+    }
+
+    // Computes the checksum with the selected kernel
+    uint32_t crc32c(const char* data, size_t length, uint32_t crc) {
+        return activeKernel().function(data, length, crc);
+    }
+
+    // Returns the name of the selected kernel
+    const char* activeKernelName() {
+        return activeKernel().name;
+    }
+}
+}
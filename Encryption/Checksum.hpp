@@ -0,0 +1,30 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Checksum namespace - provides the CRC32C (Castagnoli) checksums stored in encrypted files
+// The SSE4.2 crc32 instruction is used when the CPU has it (three independent streams per
+// block to hide its latency), with a table-driven scalar fallback for other architectures
+namespace Encryption {
+namespace Checksum {
+
+    // Returns the CRC32C of length bytes of data, continuing from a previous result
+    // crc32c(b, n, crc32c(a, m)) equals the checksum of a followed by b; start with 0
+    uint32_t crc32c(const char* data, size_t length, uint32_t crc = 0);
+
+    // Returns the CRC32C of a message A followed by a message B of lengthB bytes, given only
+    // their separate checksums; it lets a stored checksum be updated without rereading the data
+    uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t lengthB);
+
+    // Portable table-driven implementation of crc32c
+    // Used as the fallback kernel and as the reference for verifying the hardware kernel
+    uint32_t crc32cScalar(const char* data, size_t length, uint32_t crc = 0);
+
+    // Returns the name of the kernel selected for this CPU ("sse4.2" or "scalar")
+    const char* activeKernelName();
+}
+}
+
+#endif
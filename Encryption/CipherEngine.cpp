@@ -0,0 +1,95 @@
+#include "CipherEngine.hpp"
+
+namespace Encryption {
+
+    // One tag per started segment
+    uint64_t CipherEngine::tagBytes(uint64_t contentLength) const {
+        return (contentLength + SEGMENT_SIZE - 1) / SEGMENT_SIZE * tagSize();
+    }
+
+    // Builds the 96-bit GCM IV for a message index (0 = metadata, k + 1 = content segment k)
+    static void makeIv(uint64_t index, uint8_t* iv) {
+        for (int i = 0; i < 4; ++i) {
+            iv[i] = 0;
+        }
+        for (int i = 0; i < 8; ++i) {
+            iv[4 + i] = static_cast<uint8_t>(index >> (56 - 8 * i));
+        }
+    }
+
+    XorEngine::XorEngine(const Keystream& keystream) : keystream(keystream) {}
+
+    void XorEngine::encryptSegment(char* output, const char* input, size_t length,
+                                   uint64_t offset, char*) const {
+        keystream.apply(output, input, length, offset);
+    }
+
+    bool XorEngine::decryptSegment(char* output, const char* input, size_t length,
+                                   uint64_t offset, const char*) const {
+        keystream.apply(output, input, length, offset);
+        return true;
+    }
+
+    // Legacy messages are keyed from position 0, matching the original metadata encryption
+    void XorEngine::sealMessage(char* output, const char* input, size_t length,
+                                const char*, size_t, char*) const {
+        keystream.apply(output, input, length, 0);
+    }
+
+    bool XorEngine::openMessage(char* output, const char* input, size_t length,
+                                const char*, size_t, const char*) const {
+        keystream.apply(output, input, length, 0);
+        return true;
+    }
+
+    AesGcmEngine::AesGcmEngine(const uint8_t* key) : cipher(key) {}
+
+    void AesGcmEngine::encryptSegment(char* output, const char* input, size_t length,
+                                      uint64_t offset, char* tag) const {
+        uint8_t iv[AesGcm::IV_SIZE];
+        makeIv(offset / SEGMENT_SIZE + 1, iv);
+        cipher.encrypt(reinterpret_cast<uint8_t*>(output), reinterpret_cast<const uint8_t*>(input), length,
+                       iv, nullptr, 0, reinterpret_cast<uint8_t*>(tag));
+    }
+
+    bool AesGcmEngine::decryptSegment(char* output, const char* input, size_t length,
+                                      uint64_t offset, const char* tag) const {
+        uint8_t iv[AesGcm::IV_SIZE];
+        makeIv(offset / SEGMENT_SIZE + 1, iv);
+        return cipher.decrypt(reinterpret_cast<uint8_t*>(output), reinterpret_cast<const uint8_t*>(input), length,
+                              iv, nullptr, 0, reinterpret_cast<const uint8_t*>(tag));
+    }
+
+    void AesGcmEngine::sealMessage(char* output, const char* input, size_t length,
+                                   const char* aad, size_t aadLength, char* tag) const {
+        uint8_t iv[AesGcm::IV_SIZE];
+        makeIv(0, iv);
+        cipher.encrypt(reinterpret_cast<uint8_t*>(output), reinterpret_cast<const uint8_t*>(input), length,
+                       iv, reinterpret_cast<const uint8_t*>(aad), aadLength, reinterpret_cast<uint8_t*>(tag));
+    }
+
+    bool AesGcmEngine::openMessage(char* output, const char* input, size_t length,
+                                   const char* aad, size_t aadLength, const char* tag) const {
+        uint8_t iv[AesGcm::IV_SIZE];
+        makeIv(0, iv);
+        return cipher.decrypt(reinterpret_cast<uint8_t*>(output), reinterpret_cast<const uint8_t*>(input), length,
+                              iv, reinterpret_cast<const uint8_t*>(aad), aadLength,
+                              reinterpret_cast<const uint8_t*>(tag));
+    }
+
+    const char* engineName(EngineType type) {
+        return type == EngineType::Aes256Gcm ? "aes-256-gcm" : "xor";
+    }
+
+    bool parseEngineName(const std::string& name, EngineType& type) {
+        if (name == "aes-256-gcm" || name == "aes") {
+            type = EngineType::Aes256Gcm;
+            return true;
+        }
+        if (name == "xor") {
+            type = EngineType::LegacyXor;
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef CIPHERENGINE_HPP
+#define CIPHERENGINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "AesGcm.hpp"
+#include "Keystream.hpp"
+
+// Cipher engines - the transforms the Encryptor applies to metadata and content
+// Content is processed in fixed-size segments so any segment can be transformed independently
+// (by worker threads, memory-mapped blocks or pipeline stages) at its absolute content offset
+namespace Encryption {
+
+    // Engines that can be stored in an encrypted file
+    enum class EngineType : uint8_t {
+        LegacyXor = 0,  // Original password-keystream XOR format (no authentication)
+        Aes256Gcm = 1   // AES-256-GCM with a password-derived key and per-segment tags
+    };
+
+    // Size of each independently authenticated content segment (1 MiB)
+    const size_t SEGMENT_SIZE = 1024 * 1024;
+
+    // Interface implemented by every cipher engine
+    // Engines are immutable once created and may be shared by worker threads
+    class CipherEngine {
+    public:
+        virtual ~CipherEngine() = default;
+
+        // Returns the engine's type as recorded in the file format
+        virtual EngineType type() const = 0;
+
+        // Returns the size of the authentication tag stored per segment (0 if unauthenticated)
+        virtual size_t tagSize() const = 0;
+
+        // Encrypts one content segment starting at content offset (a multiple of SEGMENT_SIZE)
+        // length is at most SEGMENT_SIZE; the segment's tag (tagSize() bytes) is written to tag
+        virtual void encryptSegment(char* output, const char* input, size_t length,
+                                    uint64_t offset, char* tag) const = 0;
+
+        // Verifies and decrypts one content segment; returns false if authentication fails
+        virtual bool decryptSegment(char* output, const char* input, size_t length,
+                                    uint64_t offset, const char* tag) const = 0;
+
+        // Encrypts a standalone message such as the file metadata; aad is authenticated only
+        virtual void sealMessage(char* output, const char* input, size_t length,
+                                 const char* aad, size_t aadLength, char* tag) const = 0;
+
+        // Verifies and decrypts a standalone message; returns false if authentication fails
+        virtual bool openMessage(char* output, const char* input, size_t length,
+                                 const char* aad, size_t aadLength, const char* tag) const = 0;
+
+        // Returns the total size of the segment tags for content of the given length
+        uint64_t tagBytes(uint64_t contentLength) const;
+    };
+
+    // Legacy engine - XORs with the password keystream at each byte's absolute position
+    // Segments carry no tags, so any block size and offset works
+    class XorEngine : public CipherEngine {
+    private:
+        const Keystream& keystream;
+
+    public:
+        explicit XorEngine(const Keystream& keystream);
+
+        EngineType type() const override { return EngineType::LegacyXor; }
+        size_t tagSize() const override { return 0; }
+        void encryptSegment(char* output, const char* input, size_t length,
+                            uint64_t offset, char* tag) const override;
+        bool decryptSegment(char* output, const char* input, size_t length,
+                            uint64_t offset, const char* tag) const override;
+        void sealMessage(char* output, const char* input, size_t length,
+                         const char* aad, size_t aadLength, char* tag) const override;
+        bool openMessage(char* output, const char* input, size_t length,
+                         const char* aad, size_t aadLength, const char* tag) const override;
+    };
+
+    // AES-256-GCM engine keyed with a per-file key
+    // Messages use IV 0 and content segment k uses IV k + 1, so no IV repeats under one key
+    class AesGcmEngine : public CipherEngine {
+    private:
+        AesGcm cipher;
+
+    public:
+        explicit AesGcmEngine(const uint8_t* key);
+
+        EngineType type() const override { return EngineType::Aes256Gcm; }
+        size_t tagSize() const override { return AesGcm::TAG_SIZE; }
+        void encryptSegment(char* output, const char* input, size_t length,
+                            uint64_t offset, char* tag) const override;
+        bool decryptSegment(char* output, const char* input, size_t length,
+                            uint64_t offset, const char* tag) const override;
+        void sealMessage(char* output, const char* input, size_t length,
+                         const char* aad, size_t aadLength, char* tag) const override;
+        bool openMessage(char* output, const char* input, size_t length,
+                         const char* aad, size_t aadLength, const char* tag) const override;
+    };
+
+    // Returns the display name of an engine ("xor" or "aes-256-gcm")
+    const char* engineName(EngineType type);
+
+    // Parses an engine name as accepted on the command line; returns false if unknown
+    bool parseEngineName(const std::string& name, EngineType& type);
+}
+
+#endif
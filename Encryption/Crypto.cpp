@@ -0,0 +1,308 @@
+#include "Crypto.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <sys/random.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SHA256_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace Encryption {
+
+    // SHA-256 round constants
+    static const uint32_t SHA256_K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static inline uint32_t rotateRight(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    Sha256::Sha256() : totalLength(0), bufferLength(0) {
+        static const uint32_t initial[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        std::memcpy(state, initial, sizeof(state));
+    }
+
+    // Portable kernel - the 64-round compression function, one block at a time
+    static void compressBlocksScalar(uint32_t* state, const uint8_t* block, size_t count) {
+        for (; count > 0; --count, block += 64) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; ++i) {
+                w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+                       (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+            }
+            for (int i = 16; i < 64; ++i) {
+                uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+            for (int i = 0; i < 64; ++i) {
+                uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+                uint32_t choose = (e & f) ^ (~e & g);
+                uint32_t temp1 = h + s1 + choose + SHA256_K[i] + w[i];
+                uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+                uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+                uint32_t temp2 = s0 + majority;
+
+                h = g; g = f; f = e; e = d + temp1;
+                d = c; c = b; b = a; a = temp1 + temp2;
+            }
+
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+    }
+
+#ifdef SHA256_X86_DISPATCH
+    // SHA extensions kernel - the state is kept as the ABEF/CDGH halves sha256rnds2 works on,
+    // and each group of four rounds extends the message schedule by four words
+    __attribute__((target("sha,sse4.1")))
+    static void compressBlocksShaNi(uint32_t* state, const uint8_t* block, size_t count) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+        for (; count > 0; --count, block += 64) {
+            __m128i savedAbef = abef;
+            __m128i savedCdgh = cdgh;
+            __m128i words[4];
+            for (int i = 0; i < 4; ++i) {
+                words[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16)), byteSwap);
+            }
+            for (int group = 0; group < 16; ++group) {
+                __m128i& current = words[group % 4];
+                if (group >= 4) {
+                    const __m128i& previous = words[(group + 3) % 4];
+                    __m128i shifted = _mm_alignr_epi8(previous, words[(group + 2) % 4], 4);
+                    current = _mm_sha256msg2_epu32(
+                        _mm_add_epi32(_mm_sha256msg1_epu32(current, words[(group + 1) % 4]), shifted), previous);
+                }
+                __m128i message = _mm_add_epi32(current, _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(SHA256_K + group * 4)));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+            }
+            abef = _mm_add_epi32(abef, savedAbef);
+            cdgh = _mm_add_epi32(cdgh, savedCdgh);
+        }
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+#endif
+
+    using CompressFunction = void (*)(uint32_t*, const uint8_t*, size_t);
+
+    struct Sha256Kernel {
+        CompressFunction function;
+        const char* name;
+    };
+
+    // Selects the SHA extensions kernel when the running CPU has them (queried via cpuid)
+    static Sha256Kernel selectSha256Kernel() {
+#ifdef SHA256_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+            return {compressBlocksShaNi, "sha-ni"};
+        }
+#endif
+        return {compressBlocksScalar, "scalar"};
+    }
+
+    static const Sha256Kernel& activeSha256Kernel() {
+        static const Sha256Kernel kernel = selectSha256Kernel();
+        return kernel;
+    }
+
+    void Sha256::compressBlocks(const uint8_t* blocks, size_t count) {
+        activeSha256Kernel().function(state, blocks, count);
+    }
+
+    const char* Sha256::activeKernelName() {
+        return activeSha256Kernel().name;
+    }
+
+    // Buffers partial blocks and compresses every complete one
+    void Sha256::update(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        totalLength += length;
+
+        if (bufferLength > 0) {
+            size_t take = std::min(length, sizeof(buffer) - bufferLength);
+            std::memcpy(buffer + bufferLength, bytes, take);
+            bufferLength += take;
+            bytes += take;
+            length -= take;
+            if (bufferLength == sizeof(buffer)) {
+                compressBlocks(buffer, 1);
+                bufferLength = 0;
+            }
+        }
+
+        if (length >= sizeof(buffer)) {
+            size_t count = length / sizeof(buffer);
+            compressBlocks(bytes, count);
+            bytes += count * sizeof(buffer);
+            length -= count * sizeof(buffer);
+        }
+
+        if (length > 0) {
+            std::memcpy(buffer, bytes, length);
+            bufferLength = length;
+        }
+    }
+
+    // Appends padding and the message length, then outputs the state big-endian
+    Sha256Digest Sha256::finish() {
+        uint64_t bitLength = totalLength * 8;
+        uint8_t padding[72] = {0x80};
+        size_t padLength = (bufferLength < 56) ? (56 - bufferLength) : (120 - bufferLength);
+        for (int i = 0; i < 8; ++i) {
+            padding[padLength + i] = static_cast<uint8_t>(bitLength >> (56 - 8 * i));
+        }
+        update(padding, padLength + 8);
+
+        Sha256Digest digest;
+        for (int i = 0; i < 8; ++i) {
+            digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+            digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+            digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+            digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+        }
+        return digest;
+    }
+
+    Sha256Digest Sha256::hash(const void* data, size_t length) {
+        Sha256 hasher;
+        hasher.update(data, length);
+        return hasher.finish();
+    }
+
+    // HMAC with keys longer than one block hashed first, per RFC 2104
+    Sha256Digest hmacSha256(const void* key, size_t keyLength, const void* message, size_t messageLength) {
+        uint8_t block[64] = {};
+        if (keyLength > sizeof(block)) {
+            Sha256Digest hashedKey = Sha256::hash(key, keyLength);
+            std::memcpy(block, hashedKey.data(), hashedKey.size());
+        } else {
+            std::memcpy(block, key, keyLength);
+        }
+
+        uint8_t innerPad[64], outerPad[64];
+        for (size_t i = 0; i < sizeof(block); ++i) {
+            innerPad[i] = block[i] ^ 0x36;
+            outerPad[i] = block[i] ^ 0x5c;
+        }
+
+        Sha256 inner;
+        inner.update(innerPad, sizeof(innerPad));
+        inner.update(message, messageLength);
+        Sha256Digest innerDigest = inner.finish();
+
+        Sha256 outer;
+        outer.update(outerPad, sizeof(outerPad));
+        outer.update(innerDigest.data(), innerDigest.size());
+        return outer.finish();
+    }
+
+    // PBKDF2 with the HMAC pads hashed once per block instead of once per iteration
+    void pbkdf2Sha256(const std::string& password, const uint8_t* salt, size_t saltLength,
+                      uint32_t iterations, uint8_t* output, size_t outputLength) {
+        // Precompute the HMAC inner/outer states for the password key
+        uint8_t block[64] = {};
+        if (password.size() > sizeof(block)) {
+            Sha256Digest hashedKey = Sha256::hash(password.data(), password.size());
+            std::memcpy(block, hashedKey.data(), hashedKey.size());
+        } else {
+            std::memcpy(block, password.data(), password.size());
+        }
+        uint8_t innerPad[64], outerPad[64];
+        for (size_t i = 0; i < sizeof(block); ++i) {
+            innerPad[i] = block[i] ^ 0x36;
+            outerPad[i] = block[i] ^ 0x5c;
+        }
+        Sha256 innerBase, outerBase;
+        innerBase.update(innerPad, sizeof(innerPad));
+        outerBase.update(outerPad, sizeof(outerPad));
+
+        auto hmac = [&](const uint8_t* message, size_t length) {
+            Sha256 inner = innerBase;
+            inner.update(message, length);
+            Sha256Digest innerDigest = inner.finish();
+            Sha256 outer = outerBase;
+            outer.update(innerDigest.data(), innerDigest.size());
+            return outer.finish();
+        };
+
+        std::vector<uint8_t> firstMessage(salt, salt + saltLength);
+        firstMessage.resize(saltLength + 4);
+
+        for (uint32_t blockIndex = 1; outputLength > 0; ++blockIndex) {
+            firstMessage[saltLength] = static_cast<uint8_t>(blockIndex >> 24);
+            firstMessage[saltLength + 1] = static_cast<uint8_t>(blockIndex >> 16);
+            firstMessage[saltLength + 2] = static_cast<uint8_t>(blockIndex >> 8);
+            firstMessage[saltLength + 3] = static_cast<uint8_t>(blockIndex);
+
+            Sha256Digest u = hmac(firstMessage.data(), firstMessage.size());
+            Sha256Digest result = u;
+            for (uint32_t i = 1; i < iterations; ++i) {
+                u = hmac(u.data(), u.size());
+                for (size_t j = 0; j < result.size(); ++j) {
+                    result[j] ^= u[j];
+                }
+            }
+
+            size_t take = std::min(outputLength, result.size());
+            std::memcpy(output, result.data(), take);
+            output += take;
+            outputLength -= take;
+        }
+    }
+
+    // getentropy returns at most 256 bytes per call
+    void secureRandom(void* buffer, size_t length) {
+        uint8_t* bytes = static_cast<uint8_t*>(buffer);
+        while (length > 0) {
+            size_t take = std::min<size_t>(length, 256);
+            if (getentropy(bytes, take) != 0) {
+                throw std::runtime_error("Secure random source unavailable");
+            }
+            bytes += take;
+            length -= take;
+        }
+    }
+
+    // Accumulates differences so timing does not depend on where buffers differ
+    bool constantTimeEqual(const void* a, const void* b, size_t length) {
+        const volatile uint8_t* x = static_cast<const volatile uint8_t*>(a);
+        const volatile uint8_t* y = static_cast<const volatile uint8_t*>(b);
+        uint8_t difference = 0;
+        for (size_t i = 0; i < length; ++i) {
+            difference |= x[i] ^ y[i];
+        }
+        return difference == 0;
+    }
+}
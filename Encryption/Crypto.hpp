@@ -0,0 +1,59 @@
+#ifndef CRYPTO_HPP
+#define CRYPTO_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Cryptographic building blocks shared by the cipher engines
+// SHA-256, HMAC-SHA256, PBKDF2-HMAC-SHA256 key derivation and OS-provided random bytes
+// SHA-256 uses the x86 SHA extensions when the CPU has them, with a portable fallback
+namespace Encryption {
+
+    using Sha256Digest = std::array<uint8_t, 32>;
+
+    // Incremental SHA-256 hash (FIPS 180-4)
+    class Sha256 {
+    private:
+        uint32_t state[8];
+        uint8_t buffer[64];
+        uint64_t totalLength;  // Bytes hashed so far
+        size_t bufferLength;   // Bytes waiting in buffer
+
+        // Processes count consecutive 64-byte blocks with the kernel selected for this CPU
+        void compressBlocks(const uint8_t* blocks, size_t count);
+
+    public:
+        Sha256();
+
+        // Adds data to the hash
+        void update(const void* data, size_t length);
+
+        // Completes the hash and returns the digest
+        Sha256Digest finish();
+
+        // Hashes a buffer in one call
+        static Sha256Digest hash(const void* data, size_t length);
+
+        // Returns the name of the compression kernel selected for this CPU ("sha-ni" or "scalar")
+        static const char* activeKernelName();
+    };
+
+    // Computes HMAC-SHA256 (RFC 2104) of a message
+    Sha256Digest hmacSha256(const void* key, size_t keyLength, const void* message, size_t messageLength);
+
+    // Derives a key from a password with PBKDF2-HMAC-SHA256 (RFC 8018)
+    // Writes outputLength bytes of key material to output
+    void pbkdf2Sha256(const std::string& password, const uint8_t* salt, size_t saltLength,
+                      uint32_t iterations, uint8_t* output, size_t outputLength);
+
+    // Fills buffer with cryptographically secure random bytes from the operating system
+    // Throws std::runtime_error if no randomness source is available
+    void secureRandom(void* buffer, size_t length);
+
+    // Compares two buffers in constant time, returning true if they are equal
+    bool constantTimeEqual(const void* a, const void* b, size_t length);
+}
+
+#endif
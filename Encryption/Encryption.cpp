@@ -1,62 +1,650 @@
 #include "Encryption.hpp"
+#include "Crypto.hpp"
 #include "../FileHandler/FileHandler.hpp"
+#include "../FileHandler/AsyncIO.hpp"
+#include "../Utils/Utils.hpp"
+#include "../Utils/BoundedQueue.hpp"
+#include "../Utils/Instrumentation.hpp"
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <streambuf>
 #include <cstring>
+#include <cerrno>
 #include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
 namespace Encryption {
 
+    // Size of the blocks passed between pipeline stages in encryptStream (1 MiB)
+    static const size_t PIPELINE_BLOCK_SIZE = 1024 * 1024;
+
+    // Number of blocks each pipeline queue may hold
+    static const size_t PIPELINE_DEPTH = 4;
+
+    // Writes count zero bytes to output, for the holes of sparse files
+    static bool writeZeros(std::ostream& output, uint64_t count) {
+        static const char zeros[64 * 1024] = {};
+        while (count > 0 && output) {
+            size_t length = static_cast<size_t>(std::min<uint64_t>(count, sizeof(zeros)));
+            output.write(zeros, static_cast<std::streamsize>(length));
+            count -= length;
+        }
+        return !output.fail();
+    }
+
+    // Output stream buffer that places the stored content of a sparse file at its offsets in the
+    // file, writing zeros for the holes between extents
+    // Starts inside extent index at file offset position; the caller writes any zeros before it
+    class ExtentScatterStreambuf : public std::streambuf {
+    private:
+        std::ostream& output;
+        const std::vector<FileHandler::DataExtent>& extents;
+        size_t index;
+        uint64_t position;
+        
+    protected:
+        std::streamsize xsputn(const char* data, std::streamsize count) override {
+            std::streamsize done = 0;
+            while (done < count) {
+                uint64_t extentEnd = extents[index].offset + extents[index].length;
+                if (position == extentEnd) {
+                    if (index + 1 == extents.size() || !writeZeros(output, extents[index + 1].offset - position)) {
+                        break;
+                    }
+                    position = extents[++index].offset;
+                    continue;
+                }
+                size_t length = static_cast<size_t>(std::min<uint64_t>(count - done, extentEnd - position));
+                output.write(data + done, static_cast<std::streamsize>(length));
+                if (output.fail()) {
+                    break;
+                }
+                done += length;
+                position += length;
+            }
+            return done;
+        }
+        
+        int_type overflow(int_type ch) override {
+            if (traits_type::eq_int_type(ch, traits_type::eof())) {
+                return traits_type::not_eof(ch);
+            }
+            char c = traits_type::to_char_type(ch);
+            return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+        }
+        
+    public:
+        ExtentScatterStreambuf(std::ostream& output, const std::vector<FileHandler::DataExtent>& extents,
+                               size_t index, uint64_t position)
+            : output(output), extents(extents), index(index), position(position) {}
+        
+        // File offset just past the last byte written
+        uint64_t offset() const {
+            return position;
+        }
+    };
+
+    // Labels separating the values derived from the master key
+    static const char FILE_KEY_LABEL[] = "FileCrypt file key";
+    static const char PASSWORD_CHECK_LABEL[] = "FileCrypt password check";
+    static const char KEY_WRAP_LABEL[] = "FileCrypt key wrap";
+
+    // Header flags understood by this version
+    static const uint16_t KNOWN_HEADER_FLAGS = HEADER_FLAG_PASSWORD_CHECK | HEADER_FLAG_COMPRESSED |
+                                               HEADER_FLAG_CONTAINER | HEADER_FLAG_CHECKSUMS |
+                                               HEADER_FLAG_WRAPPED_KEY | HEADER_FLAG_SPARSE |
+                                               HEADER_FLAG_FRAME_INDEX;
+
+    // Header flags of every new file: a password check and a wrapped data key
+    static const uint16_t NEW_HEADER_FLAGS = HEADER_FLAG_PASSWORD_CHECK | HEADER_FLAG_WRAPPED_KEY;
+
+    // Size of the header fields the wrapped key is bound to: [magic][version][engine][flags]
+    static const size_t KEY_WRAP_AAD_SIZE = 8;
+
+    // Size of the compression fields appended to the metadata of compressed files
+    static const size_t COMPRESSION_METADATA_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t);
+
+    // Size of each entry of the frame index at the end of compressed content
+    static const uint64_t FRAME_INDEX_ENTRY_SIZE = sizeof(uint64_t);
+
+    // Marker and fixed size of the extent map appended to the metadata of sparse files,
+    // [marker][full_size][extent_count] followed by an [offset][length] pair per extent
+    static const uint8_t SPARSE_METADATA_MARKER = 'S';
+    static const size_t SPARSE_METADATA_SIZE = sizeof(uint8_t) + sizeof(uint64_t) * 2;
+    static const size_t SPARSE_EXTENT_SIZE = sizeof(uint64_t) * 2;
+
+    // Smallest total hole size worth storing a file sparse for
+    static const uint64_t MIN_SPARSE_HOLE_BYTES = SEGMENT_SIZE;
+
+    // Transforms one block of content at the given content offset, one segment at a time
+    // tags holds one tag per segment starting at segment firstSegment (normally the whole content);
+    // unused by unauthenticated engines. When encrypting, checksums (if not null) receives each
+    // segment's CRC32C, computed while the ciphertext is still in cache
+    static bool transformBlock(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                               char* output, const char* input, size_t length, uint64_t offset,
+                               uint64_t firstSegment = 0) {
+        Utils::StageTimer timer(Utils::Stage::Cipher, length);
+        if (engine.tagSize() == 0) {
+            if (encrypt) {
+                engine.encryptSegment(output, input, length, offset, nullptr);
+                return true;
+            }
+            return engine.decryptSegment(output, input, length, offset, nullptr);
+        }
+        
+        size_t done = 0;
+        while (done < length) {
+            uint64_t position = offset + done;
+            size_t segmentLength = static_cast<size_t>(std::min<uint64_t>(SEGMENT_SIZE - position % SEGMENT_SIZE,
+                                                                          length - done));
+            uint64_t segment = position / SEGMENT_SIZE - firstSegment;
+            char* tag = tags + segment * engine.tagSize();
+            if (encrypt) {
+                engine.encryptSegment(output + done, input + done, segmentLength, position, tag);
+                if (checksums != nullptr) {
+                    checksums[segment] = Checksum::crc32c(output + done, segmentLength);
+                }
+            } else if (!engine.decryptSegment(output + done, input + done, segmentLength, position, tag)) {
+                return false;
+            }
+            done += segmentLength;
+        }
+        return true;
+    }
+
+    // Builds everything before the content: [header][metadata size][sealed metadata][metadata tag]
+    // The legacy engine has no header or tag, which reproduces the original format exactly
+    static std::vector<char> buildFilePrefix(const std::vector<char>& header, const CipherEngine& engine,
+                                             const FileMetadata& metadata) {
+        Utils::StageTimer timer(Utils::Stage::Metadata);
+        std::vector<char> plainMetadata = serializeMetadata(metadata);
+        uint32_t metadataSize = static_cast<uint32_t>(plainMetadata.size() + engine.tagSize());
+        
+        std::vector<char> prefix(header);
+        prefix.insert(prefix.end(), reinterpret_cast<const char*>(&metadataSize),
+                      reinterpret_cast<const char*>(&metadataSize) + sizeof(uint32_t));
+        size_t sealedOffset = prefix.size();
+        prefix.resize(sealedOffset + metadataSize);
+        std::vector<char> aad = authenticatedHeader(header);
+        engine.sealMessage(prefix.data() + sealedOffset, plainMetadata.data(), plainMetadata.size(),
+                           aad.data(), aad.size(), prefix.data() + sealedOffset + plainMetadata.size());
+        return prefix;
+    }
+
+    // Builds the checksum table appended after the segment tags: the segment checksums, then one
+    // checksum over the prefix, the tags and the segment checksums, so every stored byte is covered
+    static std::vector<char> buildChecksumTable(const std::vector<char>& prefix, const std::vector<char>& tags,
+                                                const std::vector<uint32_t>& checksums) {
+        size_t segmentBytes = checksums.size() * CHECKSUM_SIZE;
+        std::vector<char> table(segmentBytes + CHECKSUM_SIZE);
+        std::memcpy(table.data(), checksums.data(), segmentBytes);
+        uint32_t crc = Checksum::crc32c(prefix.data(), prefix.size());
+        crc = Checksum::crc32c(tags.data(), tags.size(), crc);
+        crc = Checksum::crc32c(table.data(), segmentBytes, crc);
+        std::memcpy(table.data() + segmentBytes, &crc, CHECKSUM_SIZE);
+        return table;
+    }
+
     // Constructor - initializes encryptor with user's password
-    Encryptor::Encryptor(const std::string& password) : password(password) {}
+    Encryptor::Encryptor(const std::string& password)
+        : password(password), keystream(password), engineType(EngineType::Aes256Gcm),
+          chunkSize(DEFAULT_CHUNK_SIZE), peakBufferBytes(0), threadCount(Utils::getDefaultThreadCount()),
+          compression(false), ioMode(IoMode::Mapped), queueDepth(DEFAULT_QUEUE_DEPTH) {
+        secureRandom(salt.data(), salt.size());
+    }
+
+    // Selects the engine for new files and buffers
+    void Encryptor::setEngine(EngineType type) {
+        engineType = type;
+    }
+
+    // Returns the engine for new files and buffers
+    EngineType Encryptor::getEngine() const {
+        return engineType;
+    }
+
+    // Sets the block size used when streaming files
+    // Clamped to a 4 KiB minimum so tiny values cannot degrade throughput
+    void Encryptor::setChunkSize(size_t size) {
+        chunkSize = std::max<size_t>(size, 4096);
+    }
+
+    // Returns the peak buffer memory used by file operations on this encryptor
+    size_t Encryptor::getPeakBufferBytes() const {
+        return peakBufferBytes;
+    }
+
+    // Sets the worker thread count, where 0 selects all hardware threads
+    void Encryptor::setThreadCount(unsigned count) {
+        threadCount = count == 0 ? Utils::getDefaultThreadCount() : count;
+    }
+
+    // Returns the worker thread count
+    unsigned Encryptor::getThreadCount() const {
+        return threadCount;
+    }
+
+    // Enables or disables compression of new files
+    void Encryptor::setCompression(bool enabled) {
+        compression = enabled;
+    }
+
+    // Returns true if new files are compressed
+    bool Encryptor::getCompression() const {
+        return compression;
+    }
+
+    // Selects how file content is read and written
+    void Encryptor::setIoMode(IoMode mode) {
+        ioMode = mode;
+    }
+
+    // Returns how file content is read and written
+    IoMode Encryptor::getIoMode() const {
+        return ioMode;
+    }
+
+    // Sets the asynchronous queue depth; fewer than two blocks could not overlap anything
+    void Encryptor::setQueueDepth(unsigned depth) {
+        queueDepth = std::max(depth, 2u);
+    }
+
+    // Returns the asynchronous queue depth
+    unsigned Encryptor::getQueueDepth() const {
+        return queueDepth;
+    }
+
+    // Replaces the random salt chosen at construction
+    void Encryptor::setSalt(const std::array<uint8_t, SALT_SIZE>& newSalt) {
+        salt = newSalt;
+    }
+
+    // Returns the salt used for new files
+    const std::array<uint8_t, SALT_SIZE>& Encryptor::getSalt() const {
+        return salt;
+    }
+
+    // Atomically raises the peak, so concurrent operations on a shared encryptor are safe
+    void Encryptor::recordBufferUsage(size_t bytes) {
+        size_t current = peakBufferBytes.load();
+        while (bytes > current && !peakBufferBytes.compare_exchange_weak(current, bytes)) {
+        }
+    }
 
-    // Generates encryption key from password with additional entropy
-    // Creates key of specified length by repeating password and applying XOR operations
-    // This ensures same password produces different keys for different data lengths
-    std::vector<char> Encryptor::generateKey(const std::string& password, size_t length) {
-        std::vector<char> key(length);
+    // Authenticated engines need blocks made of whole segments so every tag covers one full segment
+    size_t Encryptor::blockSizeFor(const CipherEngine& engine) const {
+        if (engine.tagSize() == 0) {
+            return chunkSize;
+        }
+        return (chunkSize + SEGMENT_SIZE - 1) / SEGMENT_SIZE * SEGMENT_SIZE;
+    }
+
+    // Parallelism only pays off when there is more than one block to distribute
+    bool Encryptor::useParallel(uint64_t length, size_t blockSize) const {
+        return threadCount > 1 && length > blockSize;
+    }
+
+    // PBKDF2 is deliberately slow, so each (salt, iterations) pair is derived once and cached
+    // Files encrypted by one instance share its salt, so batches pay for a single derivation
+    // The first caller for a pair derives it outside the lock and publishes it through a future:
+    // callers needing the same key wait for that derivation, other salts derive concurrently
+    std::array<uint8_t, 32> Encryptor::masterKey(const std::array<uint8_t, SALT_SIZE>& keySalt, uint32_t iterations) {
+        std::string cacheKey(reinterpret_cast<const char*>(keySalt.data()), keySalt.size());
+        cacheKey.append(reinterpret_cast<const char*>(&iterations), sizeof(iterations));
         
-        // Generate key by repeating password and adding position-based entropy
-        for (size_t i = 0; i < length; ++i) {
-            key[i] = password[i % password.length()] ^ (i % 256);
+        std::promise<std::array<uint8_t, 32>> derivation;
+        std::shared_future<std::array<uint8_t, 32>> cached;
+        {
+            std::lock_guard<std::mutex> lock(keyMutex);
+            auto found = derivedKeys.find(cacheKey);
+            if (found != derivedKeys.end()) {
+                cached = found->second;
+            } else {
+                derivedKeys.emplace(cacheKey, derivation.get_future().share());
+            }
+        }
+        if (cached.valid()) {
+            return cached.get();
         }
         
-        return key;
+        try {
+            std::array<uint8_t, 32> key;
+            Utils::StageTimer timer(Utils::Stage::KeyDerivation);
+            pbkdf2Sha256(password, keySalt.data(), keySalt.size(), iterations, key.data(), key.size());
+            derivation.set_value(key);
+            return key;
+        } catch (...) {
+            // Waiting callers see the failure; later ones start a new derivation
+            derivation.set_exception(std::current_exception());
+            std::lock_guard<std::mutex> lock(keyMutex);
+            derivedKeys.erase(cacheKey);
+            throw;
+        }
     }
 
-    // Performs XOR encryption/decryption on data
-    // XOR is symmetric - same operation encrypts and decrypts
-    // Each byte is XORed with corresponding key byte, key wraps around if shorter
-    void Encryptor::xorEncrypt(std::vector<char>& data, const std::vector<char>& key) {
-        for (size_t i = 0; i < data.size(); ++i) {
-            data[i] ^= key[i % key.size()];
+    // The check value is a truncated HMAC of a fixed label, so it reveals nothing about the file key
+    std::array<uint8_t, PASSWORD_CHECK_SIZE> Encryptor::passwordCheck(const std::array<uint8_t, 32>& master) {
+        Sha256Digest digest = hmacSha256(master.data(), master.size(),
+                                         PASSWORD_CHECK_LABEL, sizeof(PASSWORD_CHECK_LABEL) - 1);
+        std::array<uint8_t, PASSWORD_CHECK_SIZE> check;
+        std::memcpy(check.data(), digest.data(), check.size());
+        return check;
+    }
+
+    // Headers without the check (and legacy files) are accepted here and rely on the metadata tag
+    bool Encryptor::verifyPassword(const FileHeader& header) {
+        if (!(header.flags & HEADER_FLAG_PASSWORD_CHECK)) {
+            return true;
         }
+        std::array<uint8_t, PASSWORD_CHECK_SIZE> expected = passwordCheck(masterKey(header.salt, header.kdfIterations));
+        return constantTimeEqual(expected.data(), header.passwordCheck.data(), expected.size());
+    }
+
+    // The key wrapping key is HMAC(master key, label || wrap nonce); the wrap nonce is fresh for
+    // every wrap, so the fixed GCM IV of sealMessage never repeats under one key
+    static AesGcmEngine keyWrapEngine(const std::array<uint8_t, 32>& master, const uint8_t* wrapNonce) {
+        std::vector<uint8_t> context(KEY_WRAP_LABEL, KEY_WRAP_LABEL + sizeof(KEY_WRAP_LABEL) - 1);
+        context.insert(context.end(), wrapNonce, wrapNonce + NONCE_SIZE);
+        Sha256Digest wrapKey = hmacSha256(master.data(), master.size(), context.data(), context.size());
+        return AesGcmEngine(wrapKey.data());
+    }
+
+    // The wrapped key is bound to the header's format fields but not to its nonce, which folder
+    // containers vary per entry
+    void Encryptor::wrapDataKey(FileHeader& header, const std::array<uint8_t, DATA_KEY_SIZE>& dataKey) {
+        header.flags |= NEW_HEADER_FLAGS;
+        header.salt = salt;
+        header.kdfIterations = DEFAULT_KDF_ITERATIONS;
+        std::array<uint8_t, 32> master = masterKey(header.salt, header.kdfIterations);
+        header.passwordCheck = passwordCheck(master);
+        
+        uint8_t* wrapped = header.wrappedKey.data();
+        secureRandom(wrapped, NONCE_SIZE);
+        std::vector<char> aad = serializeHeader(header);
+        keyWrapEngine(master, wrapped).sealMessage(reinterpret_cast<char*>(wrapped + NONCE_SIZE),
+                                                   reinterpret_cast<const char*>(dataKey.data()), DATA_KEY_SIZE,
+                                                   aad.data(), KEY_WRAP_AAD_SIZE,
+                                                   reinterpret_cast<char*>(wrapped + NONCE_SIZE + DATA_KEY_SIZE));
+    }
+
+    bool Encryptor::unwrapDataKey(const FileHeader& header, std::array<uint8_t, DATA_KEY_SIZE>& dataKey) {
+        std::array<uint8_t, 32> master = masterKey(header.salt, header.kdfIterations);
+        const uint8_t* wrapped = header.wrappedKey.data();
+        std::vector<char> aad = serializeHeader(header);
+        return keyWrapEngine(master, wrapped).openMessage(reinterpret_cast<char*>(dataKey.data()),
+                                                          reinterpret_cast<const char*>(wrapped + NONCE_SIZE),
+                                                          DATA_KEY_SIZE, aad.data(), KEY_WRAP_AAD_SIZE,
+                                                          reinterpret_cast<const char*>(wrapped + NONCE_SIZE + DATA_KEY_SIZE));
+    }
+
+    // The file key is HMAC(root key, label || nonce), so every file gets its own AES key
+    // and GCM IVs can simply count segments without ever repeating under one key
+    static std::unique_ptr<CipherEngine> fileEngine(const uint8_t* rootKey, const std::array<uint8_t, NONCE_SIZE>& nonce) {
+        std::vector<uint8_t> context(FILE_KEY_LABEL, FILE_KEY_LABEL + sizeof(FILE_KEY_LABEL) - 1);
+        context.insert(context.end(), nonce.begin(), nonce.end());
+        Sha256Digest fileKey = hmacSha256(rootKey, 32, context.data(), context.size());
+        return std::unique_ptr<CipherEngine>(new AesGcmEngine(fileKey.data()));
+    }
+
+    // The root key is the unwrapped data key, or the master key itself for files written
+    // before data keys were wrapped
+    std::unique_ptr<CipherEngine> Encryptor::createEngine(const FileHeader& header) {
+        if (header.engine == EngineType::LegacyXor) {
+            return std::unique_ptr<CipherEngine>(new XorEngine(keystream));
+        }
+        
+        if (header.flags & HEADER_FLAG_WRAPPED_KEY) {
+            std::array<uint8_t, DATA_KEY_SIZE> dataKey;
+            if (!unwrapDataKey(header, dataKey)) {
+                return nullptr;
+            }
+            return fileEngine(dataKey.data(), header.nonce);
+        }
+        std::array<uint8_t, 32> master = masterKey(header.salt, header.kdfIterations);
+        return fileEngine(master.data(), header.nonce);
+    }
+
+    // New files get a fresh random nonce and data key; the legacy engine writes no header at all
+    std::unique_ptr<CipherEngine> Encryptor::createEncryptionEngine(std::vector<char>& header, uint16_t extraFlags) {
+        header.clear();
+        if (engineType == EngineType::LegacyXor) {
+            return std::unique_ptr<CipherEngine>(new XorEngine(keystream));
+        }
+        
+        FileHeader fileHeader;
+        fileHeader.engine = engineType;
+        fileHeader.flags = extraFlags;
+        secureRandom(fileHeader.nonce.data(), fileHeader.nonce.size());
+        std::array<uint8_t, DATA_KEY_SIZE> dataKey;
+        secureRandom(dataKey.data(), dataKey.size());
+        wrapDataKey(fileHeader, dataKey);
+        header = serializeHeader(fileHeader);
+        return fileEngine(dataKey.data(), fileHeader.nonce);
+    }
+
+    // Header and tag come first, so the plaintext can sit at its final place in the output
+    size_t Encryptor::dataOverhead() const {
+        if (engineType == EngineType::LegacyXor) {
+            return 0;
+        }
+        return serializedHeaderSize(NEW_HEADER_FLAGS) + AesGcm::TAG_SIZE;
     }
 
     // Encrypts raw binary data using password-derived key
-    // Creates copy of input data, generates key, and applies XOR encryption
+    // Legacy: the data with the keystream applied from position 0
+    // AES-256-GCM: [file header][tag][ciphertext], with the header authenticated as additional data
+    size_t Encryptor::encryptData(const char* data, size_t length, char* output) {
+        std::vector<char> header;
+        std::unique_ptr<CipherEngine> engine = createEncryptionEngine(header);
+        
+        Utils::StageTimer timer(Utils::Stage::Cipher, length);
+        size_t dataOffset = header.size() + engine->tagSize();
+        std::vector<char> aad = authenticatedHeader(header);
+        std::memcpy(output, header.data(), header.size());
+        engine->sealMessage(output + dataOffset, data, length, aad.data(), aad.size(), output + header.size());
+        return dataOffset + length;
+    }
+
+    size_t Encryptor::encryptDataInPlace(char* buffer, size_t length) {
+        return encryptData(buffer + dataOverhead(), length, buffer);
+    }
+
+    size_t Encryptor::decryptedDataSize(const char* data, size_t length) const {
+        if (engineType == EngineType::LegacyXor) {
+            return length;
+        }
+        if (length < FILE_HEADER_SIZE) {
+            throw std::runtime_error("Encrypted data too small");
+        }
+        uint16_t flags;
+        std::memcpy(&flags, data + 6, sizeof(flags));
+        size_t overhead = serializedHeaderSize(flags) + AesGcm::TAG_SIZE;
+        if (length < overhead) {
+            throw std::runtime_error("Encrypted data too small");
+        }
+        return length - overhead;
+    }
+
+    // Decrypts raw binary data using password-derived key
+    // The header's salt and nonce rebuild the key; the tag is checked before anything is written
+    size_t Encryptor::decryptData(const char* data, size_t length, char* output) {
+        if (engineType == EngineType::LegacyXor) {
+            Utils::StageTimer timer(Utils::Stage::Cipher, length);
+            keystream.apply(output, data, length, 0);
+            return length;
+        }
+        
+        size_t plainSize = decryptedDataSize(data, length);
+        size_t headerSize = length - plainSize - AesGcm::TAG_SIZE;
+        std::vector<char> header(data, data + headerSize);
+        FileHeader fileHeader = deserializeHeader(header);
+        if (!verifyPassword(fileHeader)) {
+            throw std::runtime_error("Invalid password");
+        }
+        std::unique_ptr<CipherEngine> engine = createEngine(fileHeader);
+        if (!engine) {
+            throw std::runtime_error("Invalid password or corrupted data");
+        }
+        
+        Utils::StageTimer timer(Utils::Stage::Cipher, plainSize);
+        std::vector<char> aad = authenticatedHeader(header);
+        if (!engine->openMessage(output, data + headerSize + engine->tagSize(), plainSize,
+                                 aad.data(), aad.size(), data + headerSize)) {
+            throw std::runtime_error("Invalid password or corrupted data");
+        }
+        return plainSize;
+    }
+
+    size_t Encryptor::decryptDataInPlace(char* buffer, size_t length) {
+        size_t plainSize = decryptedDataSize(buffer, length);
+        return decryptData(buffer, length, buffer + (length - plainSize));
+    }
+
     std::vector<char> Encryptor::encryptData(const std::vector<char>& data) {
-        std::vector<char> encrypted = data;
-        std::vector<char> key = generateKey(password, data.size());
-        xorEncrypt(encrypted, key);
+        std::vector<char> encrypted(dataOverhead() + data.size());
+        encryptData(data.data(), data.size(), encrypted.data());
         return encrypted;
     }
 
-    // Decrypts raw binary data using password-derived key
-    // Creates copy of encrypted data, generates key, and applies XOR decryption
     std::vector<char> Encryptor::decryptData(const std::vector<char>& encryptedData) {
-        std::vector<char> decrypted = encryptedData;
-        std::vector<char> key = generateKey(password, encryptedData.size());
-        xorEncrypt(decrypted, key);
+        std::vector<char> decrypted(decryptedDataSize(encryptedData.data(), encryptedData.size()));
+        decryptData(encryptedData.data(), encryptedData.size(), decrypted.data());
         return decrypted;
     }
 
+    const char* ioModeName(IoMode mode) {
+        switch (mode) {
+            case IoMode::Stream: return "stream";
+            case IoMode::Async: return "async";
+            case IoMode::AsyncThreads: return "async-threads";
+            default: return "mapped";
+        }
+    }
+
+    bool parseIoModeName(const std::string& name, IoMode& mode) {
+        for (IoMode candidate : {IoMode::Mapped, IoMode::Stream, IoMode::Async, IoMode::AsyncThreads}) {
+            if (name == ioModeName(candidate)) {
+                mode = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Optional fields follow the fixed part in flag order
+    size_t serializedHeaderSize(uint16_t flags) {
+        return FILE_HEADER_SIZE + ((flags & HEADER_FLAG_PASSWORD_CHECK) ? PASSWORD_CHECK_SIZE : 0) +
+               ((flags & HEADER_FLAG_WRAPPED_KEY) ? WRAPPED_KEY_SIZE : 0);
+    }
+
+    // One checksum per segment plus the one covering the rest of the file
+    uint64_t checksumTableSize(uint64_t contentLength) {
+        return ((contentLength + SEGMENT_SIZE - 1) / SEGMENT_SIZE + 1) * CHECKSUM_SIZE;
+    }
+
+    // Serializes a file header
+    // Format: [magic][version][engine][flags][kdf_iterations][salt][nonce][password_check][wrapped_key]
+    std::vector<char> serializeHeader(const FileHeader& header) {
+        std::vector<char> result(serializedHeaderSize(header.flags));
+        uint32_t magic = FILE_MAGIC;
+        std::memcpy(result.data(), &magic, sizeof(magic));
+        result[4] = static_cast<char>(FILE_FORMAT_VERSION);
+        result[5] = static_cast<char>(header.engine);
+        std::memcpy(result.data() + 6, &header.flags, sizeof(header.flags));
+        std::memcpy(result.data() + 8, &header.kdfIterations, sizeof(header.kdfIterations));
+        std::memcpy(result.data() + 12, header.salt.data(), SALT_SIZE);
+        std::memcpy(result.data() + 12 + SALT_SIZE, header.nonce.data(), NONCE_SIZE);
+        size_t offset = FILE_HEADER_SIZE;
+        if (header.flags & HEADER_FLAG_PASSWORD_CHECK) {
+            std::memcpy(result.data() + offset, header.passwordCheck.data(), PASSWORD_CHECK_SIZE);
+            offset += PASSWORD_CHECK_SIZE;
+        }
+        if (header.flags & HEADER_FLAG_WRAPPED_KEY) {
+            std::memcpy(result.data() + offset, header.wrappedKey.data(), WRAPPED_KEY_SIZE);
+        }
+        return result;
+    }
+
+    // Zeroes the key derivation parameters, salt, password check and wrapped key
+    std::vector<char> authenticatedHeader(const std::vector<char>& header) {
+        std::vector<char> result(header);
+        uint16_t flags = 0;
+        if (result.size() >= FILE_HEADER_SIZE) {
+            std::memcpy(&flags, result.data() + 6, sizeof(flags));
+        }
+        if (flags & HEADER_FLAG_WRAPPED_KEY) {
+            std::fill(result.begin() + 8, result.begin() + 12 + SALT_SIZE, 0);
+            std::fill(result.begin() + FILE_HEADER_SIZE, result.end(), 0);
+        }
+        return result;
+    }
+
+    // Deserializes a file header, rejecting anything this version cannot decrypt
+    FileHeader deserializeHeader(const std::vector<char>& data) {
+        if (data.size() < FILE_HEADER_SIZE) {
+            throw std::runtime_error("Insufficient data for file header");
+        }
+        
+        FileHeader header;
+        uint32_t magic;
+        std::memcpy(&magic, data.data(), sizeof(magic));
+        if (magic != FILE_MAGIC) {
+            throw std::runtime_error("Not a versioned encrypted file");
+        }
+        
+        uint8_t version = static_cast<uint8_t>(data[4]);
+        if (version != FILE_FORMAT_VERSION) {
+            throw std::runtime_error("Unsupported file format version " + std::to_string(version));
+        }
+        
+        uint8_t engine = static_cast<uint8_t>(data[5]);
+        if (engine != static_cast<uint8_t>(EngineType::Aes256Gcm)) {
+            throw std::runtime_error("Unsupported cipher engine " + std::to_string(engine));
+        }
+        header.engine = static_cast<EngineType>(engine);
+        
+        std::memcpy(&header.flags, data.data() + 6, sizeof(header.flags));
+        if (header.flags & ~KNOWN_HEADER_FLAGS) {
+            throw std::runtime_error("Unsupported file format features");
+        }
+        if (data.size() < serializedHeaderSize(header.flags)) {
+            throw std::runtime_error("Insufficient data for file header");
+        }
+        std::memcpy(&header.kdfIterations, data.data() + 8, sizeof(header.kdfIterations));
+        if (header.kdfIterations == 0 || header.kdfIterations > MAX_KDF_ITERATIONS) {
+            throw std::runtime_error("Invalid key derivation parameters");
+        }
+        std::memcpy(header.salt.data(), data.data() + 12, SALT_SIZE);
+        std::memcpy(header.nonce.data(), data.data() + 12 + SALT_SIZE, NONCE_SIZE);
+        size_t offset = FILE_HEADER_SIZE;
+        if (header.flags & HEADER_FLAG_PASSWORD_CHECK) {
+            std::memcpy(header.passwordCheck.data(), data.data() + offset, PASSWORD_CHECK_SIZE);
+            offset += PASSWORD_CHECK_SIZE;
+        }
+        if (header.flags & HEADER_FLAG_WRAPPED_KEY) {
+            std::memcpy(header.wrappedKey.data(), data.data() + offset, WRAPPED_KEY_SIZE);
+        }
+        return header;
+    }
+
     // Serializes metadata structure to binary format for encryption
     // Format: [filename_length][filename][extension_length][extension][content_size]
+    // followed, for compressed content, by [compression][block_size][original_size]
+    // or, for sparse files, by [marker][full_size][extent_count] and the extents
     std::vector<char> serializeMetadata(const FileMetadata& metadata) {
         std::vector<char> result;
+        result.reserve(sizeof(uint32_t) * 2 + metadata.originalFilename.length() +
+                       metadata.extension.length() + sizeof(uint64_t) + COMPRESSION_METADATA_SIZE);
         
         // Store original filename length (4 bytes)
         uint32_t filenameLength = metadata.originalFilename.length();
@@ -79,6 +667,30 @@ namespace Encryption {
         result.insert(result.end(), reinterpret_cast<char*>(&contentSize), 
                      reinterpret_cast<char*>(&contentSize) + sizeof(uint64_t));
         
+        // Store compression method, block size and original size (compressed content only)
+        if (metadata.compression != Compression::CompressionType::None) {
+            result.push_back(static_cast<char>(metadata.compression));
+            uint32_t blockSize = metadata.compressionBlockSize;
+            result.insert(result.end(), reinterpret_cast<char*>(&blockSize),
+                         reinterpret_cast<char*>(&blockSize) + sizeof(uint32_t));
+            uint64_t originalSize = metadata.originalSize;
+            result.insert(result.end(), reinterpret_cast<char*>(&originalSize),
+                         reinterpret_cast<char*>(&originalSize) + sizeof(uint64_t));
+        }
+        
+        // Store the full size and the extent map (sparse files only)
+        if (!metadata.extents.empty()) {
+            result.push_back(static_cast<char>(SPARSE_METADATA_MARKER));
+            uint64_t fields[2] = {metadata.originalSize, metadata.extents.size()};
+            result.insert(result.end(), reinterpret_cast<char*>(fields),
+                         reinterpret_cast<char*>(fields) + sizeof(fields));
+            for (const auto& extent : metadata.extents) {
+                uint64_t pair[2] = {extent.offset, extent.length};
+                result.insert(result.end(), reinterpret_cast<char*>(pair),
+                             reinterpret_cast<char*>(pair) + sizeof(pair));
+            }
+        }
+        
         return result;
     }
 
@@ -136,19 +748,639 @@ namespace Encryption {
         uint64_t contentSize;
         std::memcpy(&contentSize, data.data() + offset, sizeof(uint64_t));
         metadata.contentSize = contentSize;
+        offset += sizeof(uint64_t);
+        
+        // Read the extent map, present only for sparse files
+        if (offset < data.size() && static_cast<uint8_t>(data[offset]) == SPARSE_METADATA_MARKER) {
+            if (data.size() - offset < SPARSE_METADATA_SIZE) {
+                throw std::runtime_error("Invalid extent map");
+            }
+            uint64_t extentCount;
+            std::memcpy(&metadata.originalSize, data.data() + offset + 1, sizeof(uint64_t));
+            std::memcpy(&extentCount, data.data() + offset + 1 + sizeof(uint64_t), sizeof(uint64_t));
+            offset += SPARSE_METADATA_SIZE;
+            if (extentCount == 0 || extentCount != (data.size() - offset) / SPARSE_EXTENT_SIZE ||
+                (data.size() - offset) % SPARSE_EXTENT_SIZE != 0) {
+                throw std::runtime_error("Invalid extent map");
+            }
+            
+            // Extents must be in order, not overlap, lie inside the file and add up to the content
+            uint64_t end = 0;
+            uint64_t total = 0;
+            metadata.extents.resize(extentCount);
+            for (auto& extent : metadata.extents) {
+                std::memcpy(&extent.offset, data.data() + offset, sizeof(uint64_t));
+                std::memcpy(&extent.length, data.data() + offset + sizeof(uint64_t), sizeof(uint64_t));
+                offset += SPARSE_EXTENT_SIZE;
+                if (extent.length == 0 || extent.offset < end || extent.offset > metadata.originalSize ||
+                    extent.length > metadata.originalSize - extent.offset) {
+                    throw std::runtime_error("Invalid extent map");
+                }
+                end = extent.offset + extent.length;
+                total += extent.length;
+            }
+            if (total != metadata.contentSize) {
+                throw std::runtime_error("Extent map does not match content size");
+            }
+        } else if (offset < data.size()) {
+            // Read compression fields, present only for compressed content
+            if (data.size() - offset != COMPRESSION_METADATA_SIZE) {
+                throw std::runtime_error("Invalid compression fields");
+            }
+            uint8_t method = static_cast<uint8_t>(data[offset]);
+            if (method != static_cast<uint8_t>(Compression::CompressionType::Lz)) {
+                throw std::runtime_error("Unsupported compression method " + std::to_string(method));
+            }
+            metadata.compression = static_cast<Compression::CompressionType>(method);
+            std::memcpy(&metadata.compressionBlockSize, data.data() + offset + 1, sizeof(uint32_t));
+            std::memcpy(&metadata.originalSize, data.data() + offset + 1 + sizeof(uint32_t), sizeof(uint64_t));
+            if (metadata.compressionBlockSize == 0 || metadata.compressionBlockSize > Compression::MAX_BLOCK_SIZE) {
+                throw std::runtime_error("Invalid compression block size");
+            }
+        }
         
         return metadata;
     }
 
+
+    // Streams length bytes from input to output, transforming one block at a time
+    // Each block is transformed at its absolute content offset, so the result is identical
+    // to transforming the whole content in one call
+    bool Encryptor::transformStream(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                                    std::istream& input, std::ostream& output, uint64_t length) {
+        size_t bufferSize = static_cast<size_t>(std::min<uint64_t>(blockSizeFor(engine), length));
+        std::vector<char> buffer(bufferSize);
+        uint64_t offset = 0;
+        
+        while (offset < length) {
+            size_t blockSize = static_cast<size_t>(std::min<uint64_t>(bufferSize, length - offset));
+            buffer.resize(blockSize);
+            
+            // Read next block of content
+            {
+                Utils::StageTimer timer(Utils::Stage::Read, blockSize);
+                input.read(buffer.data(), blockSize);
+            }
+            if (input.gcount() != static_cast<std::streamsize>(blockSize)) {
+                std::cerr << "Error: Failed to read input data" << std::endl;
+                return false;
+            }
+            
+            // Transform block at its position
+            if (!transformBlock(engine, encrypt, tags, checksums, buffer.data(), buffer.data(), blockSize, offset)) {
+                std::cerr << "Error: Invalid password or corrupted file - content authentication failed" << std::endl;
+                return false;
+            }
+            recordBufferUsage(buffer.capacity());
+            
+            // Write transformed block
+            {
+                Utils::StageTimer timer(Utils::Stage::Write, blockSize);
+                output.write(buffer.data(), blockSize);
+            }
+            if (output.fail()) {
+                std::cerr << "Error: Failed to write output data" << std::endl;
+                return false;
+            }
+            
+            offset += blockSize;
+        }
+        
+        return true;
+    }
+
+    // Transforms content with several workers, each owning its own file handles and block buffer
+    // Workers claim block indices from a shared counter, so faster workers take more blocks
+    // Every block is transformed at its absolute content offset, so the result matches transformStream
+    bool Encryptor::transformParallel(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                                      const std::string& inputPath, uint64_t inputOffset,
+                                      const std::string& outputPath, uint64_t outputOffset, uint64_t length) {
+        // Extend output to its final size so every block can be written in place
+        try {
+            fs::resize_file(outputPath, outputOffset + length);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error: Could not size output file: " << e.what() << std::endl;
+            return false;
+        }
+        
+        size_t blockLength = blockSizeFor(engine);
+        uint64_t blockCount = (length + blockLength - 1) / blockLength;
+        unsigned workers = static_cast<unsigned>(std::min<uint64_t>(threadCount, blockCount));
+        std::atomic<uint64_t> nextBlock(0);
+        std::atomic<bool> failed(false);
+        std::mutex errorMutex;
+        std::string errorMessage;
+        
+        auto fail = [&](const std::string& message) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!failed.exchange(true)) {
+                errorMessage = message;
+            }
+        };
+        
+        Utils::runParallel(workers, [&](unsigned) {
+            std::ifstream input(inputPath, std::ios::binary);
+            std::fstream output(outputPath, std::ios::binary | std::ios::in | std::ios::out);
+            if (!input.is_open() || !output.is_open()) {
+                fail("Could not open files for parallel processing");
+                return;
+            }
+            
+            std::vector<char> buffer(blockLength);
+            
+            while (!failed) {
+                uint64_t block = nextBlock.fetch_add(1);
+                if (block >= blockCount) {
+                    break;
+                }
+                
+                uint64_t offset = block * blockLength;
+                size_t blockSize = static_cast<size_t>(std::min<uint64_t>(blockLength, length - offset));
+                
+                // Read block from its position in the input
+                {
+                    Utils::StageTimer timer(Utils::Stage::Read, blockSize);
+                    input.seekg(static_cast<std::streamoff>(inputOffset + offset));
+                    input.read(buffer.data(), blockSize);
+                }
+                if (input.gcount() != static_cast<std::streamsize>(blockSize)) {
+                    fail("Failed to read input data");
+                    return;
+                }
+                
+                // Transform block at its position
+                if (!transformBlock(engine, encrypt, tags, checksums, buffer.data(), buffer.data(), blockSize, offset)) {
+                    fail("Invalid password or corrupted file - content authentication failed");
+                    return;
+                }
+                
+                // Write block at its final position in the output
+                {
+                    Utils::StageTimer timer(Utils::Stage::Write, blockSize);
+                    output.seekp(static_cast<std::streamoff>(outputOffset + offset));
+                    output.write(buffer.data(), blockSize);
+                }
+                if (output.fail()) {
+                    fail("Failed to write output data");
+                    return;
+                }
+            }
+            
+            output.flush();
+            if (output.fail()) {
+                fail("Failed to write output data");
+            }
+        });
+        
+        if (failed) {
+            std::cerr << "Error: " << errorMessage << std::endl;
+            return false;
+        }
+        
+        recordBufferUsage(static_cast<size_t>(workers) * blockLength);
+        return true;
+    }
+
+    // Splits the block into one piece per worker along segment boundaries
+    bool Encryptor::transformBlockParallel(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                                           char* data, size_t length, uint64_t offset) {
+        size_t segmentCount = (length + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+        unsigned workers = static_cast<unsigned>(std::min<size_t>(threadCount, segmentCount));
+        if (workers <= 1) {
+            return transformBlock(engine, encrypt, tags, checksums, data, data, length, offset);
+        }
+        
+        size_t piece = (segmentCount + workers - 1) / workers * SEGMENT_SIZE;
+        std::atomic<bool> failed(false);
+        Utils::runParallel(workers, [&](unsigned worker) {
+            size_t start = worker * piece;
+            if (start < length &&
+                !transformBlock(engine, encrypt, tags, checksums, data + start, data + start,
+                                std::min(piece, length - start), offset + start)) {
+                failed = true;
+            }
+        });
+        return !failed;
+    }
+
+    // Each buffer cycles through read -> transform -> write; completions arrive in any order and
+    // every block is placed by its offset, so the result matches transformStream
+    // Requests are tagged with (buffer index << 1) | is-write
+    bool Encryptor::transformAsync(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                                   const std::string& inputPath, uint64_t inputOffset,
+                                   const std::string& outputPath, uint64_t outputOffset, uint64_t length) {
+        if (length == 0) {
+            return true;
+        }
+        int inputFd = ::open(inputPath.c_str(), O_RDONLY);
+        int outputFd = ::open(outputPath.c_str(), O_WRONLY);
+        if (inputFd < 0 || outputFd < 0) {
+            std::cerr << "Error: Could not open files for asynchronous I/O" << std::endl;
+            if (inputFd >= 0) {
+                ::close(inputFd);
+            }
+            if (outputFd >= 0) {
+                ::close(outputFd);
+            }
+            return false;
+        }
+        
+        size_t blockLength = blockSizeFor(engine);
+        uint64_t blockCount = (length + blockLength - 1) / blockLength;
+        unsigned bufferCount = static_cast<unsigned>(std::min<uint64_t>(queueDepth, blockCount));
+        size_t bufferLength = static_cast<size_t>(std::min<uint64_t>(blockLength, length));
+        std::vector<std::vector<char>> buffers(bufferCount, std::vector<char>(bufferLength));
+        std::vector<uint64_t> bufferBlock(bufferCount);
+        std::unique_ptr<FileHandler::AsyncIO> io = FileHandler::createAsyncIO(
+            bufferCount, ioMode == IoMode::AsyncThreads ? FileHandler::AsyncBackend::Threads
+                                                        : FileHandler::AsyncBackend::Auto);
+        
+        uint64_t nextBlock = 0;
+        uint64_t blocksWritten = 0;
+        std::string errorMessage;
+        
+        auto blockSize = [&](uint64_t block) {
+            return static_cast<size_t>(std::min<uint64_t>(blockLength, length - block * blockLength));
+        };
+        auto startRead = [&](unsigned buffer) {
+            uint64_t block = nextBlock++;
+            bufferBlock[buffer] = block;
+            if (!io->submitRead(inputFd, buffers[buffer].data(), blockSize(block),
+                                inputOffset + block * blockLength, static_cast<uint64_t>(buffer) << 1)) {
+                errorMessage = "Could not queue read";
+            }
+        };
+        
+        for (unsigned buffer = 0; buffer < bufferCount && errorMessage.empty(); ++buffer) {
+            startRead(buffer);
+        }
+        
+        // After an error nothing new is queued, but requests in flight are drained before the
+        // buffers they point into are freed
+        uint64_t tag = 0;
+        int64_t result = 0;
+        while (io->pending() > 0) {
+            auto waitStart = std::chrono::steady_clock::now();
+            if (!io->wait(tag, result)) {
+                errorMessage = "Asynchronous I/O failed";
+                break;
+            }
+            unsigned buffer = static_cast<unsigned>(tag >> 1);
+            bool isWrite = (tag & 1) != 0;
+            uint64_t block = bufferBlock[buffer];
+            size_t size = blockSize(block);
+            if (Utils::isInstrumentationEnabled()) {
+                // Time spent waiting is what the transform could not hide
+                Utils::recordStage(isWrite ? Utils::Stage::Write : Utils::Stage::Read,
+                                   static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now() - waitStart).count()),
+                                   result > 0 ? static_cast<uint64_t>(result) : 0);
+            }
+            if (!errorMessage.empty()) {
+                continue;
+            }
+            if (result != static_cast<int64_t>(size)) {
+                errorMessage = isWrite ? "Failed to write output data" : "Failed to read input data";
+                continue;
+            }
+            
+            if (!isWrite) {
+                // Transform while the other buffers' reads and writes proceed
+                if (!transformBlockParallel(engine, encrypt, tags, checksums, buffers[buffer].data(), size,
+                                            block * blockLength)) {
+                    errorMessage = "Invalid password or corrupted file - content authentication failed";
+                } else if (!io->submitWrite(outputFd, buffers[buffer].data(), size,
+                                            outputOffset + block * blockLength, (static_cast<uint64_t>(buffer) << 1) | 1)) {
+                    errorMessage = "Could not queue write";
+                }
+            } else {
+                ++blocksWritten;
+                if (nextBlock < blockCount) {
+                    startRead(buffer);
+                }
+            }
+        }
+        
+        io.reset();
+        ::close(inputFd);
+        if (::close(outputFd) != 0 && errorMessage.empty()) {
+            errorMessage = "Failed to write output data";
+        }
+        if (!errorMessage.empty() || blocksWritten != blockCount) {
+            std::cerr << "Error: " << (errorMessage.empty() ? "Asynchronous I/O failed" : errorMessage) << std::endl;
+            return false;
+        }
+        
+        recordBufferUsage(static_cast<size_t>(bufferCount) * bufferLength);
+        return true;
+    }
+
+    // Transforms content between mapped files, block by block
+    // Workers claim blocks from a shared counter as in transformParallel; processed pages are
+    // released so resident memory stays bounded by the block size even for huge files
+    bool Encryptor::transformMapped(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                                    FileHandler::MappedFile& input, uint64_t inputOffset,
+                                    FileHandler::MappedFile& output, uint64_t outputOffset, uint64_t length) {
+        size_t blockLength = blockSizeFor(engine);
+        uint64_t blockCount = (length + blockLength - 1) / blockLength;
+        unsigned workers = useParallel(length, blockLength) ?
+                           static_cast<unsigned>(std::min<uint64_t>(threadCount, blockCount)) : 1;
+        std::atomic<uint64_t> nextBlock(0);
+        std::atomic<bool> failed(false);
+        
+        Utils::runParallel(workers, [&](unsigned) {
+            while (!failed) {
+                uint64_t block = nextBlock.fetch_add(1);
+                if (block >= blockCount) {
+                    break;
+                }
+                
+                uint64_t offset = block * blockLength;
+                size_t blockSize = static_cast<size_t>(std::min<uint64_t>(blockLength, length - offset));
+                
+                if (!transformBlock(engine, encrypt, tags, checksums, output.data() + outputOffset + offset,
+                                    input.data() + inputOffset + offset, blockSize, offset)) {
+                    failed = true;
+                    break;
+                }
+                
+                input.release(inputOffset + offset, blockSize);
+                output.release(outputOffset + offset, blockSize);
+            }
+        });
+        
+        if (failed) {
+            std::cerr << "Error: Invalid password or corrupted file - content authentication failed" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Files with a frame index start decoding at the first frame the range needs; older files are
+    // decoded from the start of the content, each frame header saying where the next frame begins
+    bool Encryptor::decodeCompressed(const CipherEngine& engine, char* tags, std::istream& input,
+                                     const FileMetadata& metadata, bool frameIndex, uint64_t rangeStart,
+                                     uint64_t rangeEnd, const std::function<bool(const char*, size_t)>& sink) {
+        struct Frame {
+            uint32_t header;   // Frame header (payload length and raw flag)
+            size_t payload;    // Offset of the payload in the decrypted data
+        };
+        
+        uint64_t contentSize = metadata.contentSize;
+        uint64_t blockSize = metadata.compressionBlockSize;
+        uint64_t blockCount = (metadata.originalSize + blockSize - 1) / blockSize;
+        uint64_t framesSize = contentSize - (frameIndex ? blockCount * FRAME_INDEX_ENTRY_SIZE : 0);
+        std::streampos contentStart = input.tellg();
+        unsigned workers = std::max(1u, threadCount);
+        size_t batchLength = static_cast<size_t>(workers) * SEGMENT_SIZE;
+        size_t maxFrames = static_cast<size_t>(workers) * 2;
+        
+        std::vector<char> decrypted;   // Decrypted content not yet passed on
+        uint64_t decryptedOffset = 0;  // Stored offset of the first byte of decrypted
+        size_t consumed = 0;           // Bytes of decrypted already decoded (or skipped)
+        std::vector<char> decoded;     // Original bytes of the frames being decoded
+        uint64_t contentOffset = 0;    // Next stored byte to read and decrypt
+        uint64_t block = 0;            // Index of the next frame
+        std::vector<char> frameOffsets; // Stored offsets of the frames decoded, as in the frame index
+        
+        // Decrypts stored content read into data, which starts at a segment boundary
+        auto decryptStored = [&](char* data, size_t length, uint64_t offset) {
+            uint64_t segmentCount = (length + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+            std::atomic<uint64_t> nextSegment(0);
+            std::atomic<bool> failed(false);
+            Utils::runParallel(static_cast<unsigned>(std::min<uint64_t>(workers, segmentCount)), [&](unsigned) {
+                for (uint64_t segment = nextSegment.fetch_add(1); segment < segmentCount && !failed;
+                     segment = nextSegment.fetch_add(1)) {
+                    size_t segmentOffset = static_cast<size_t>(segment * SEGMENT_SIZE);
+                    size_t segmentLength = std::min(SEGMENT_SIZE, length - segmentOffset);
+                    char* segmentData = data + segmentOffset;
+                    if (!transformBlock(engine, false, tags, nullptr, segmentData, segmentData, segmentLength,
+                                        offset + segmentOffset)) {
+                        failed = true;
+                    }
+                }
+            });
+            if (failed) {
+                std::cerr << "Error: Invalid password or corrupted file - content authentication failed" << std::endl;
+                return false;
+            }
+            return true;
+        };
+        
+        // Reads and decrypts the next batch of segments onto the end of decrypted
+        auto decryptBatch = [&]() {
+            size_t drop = std::min(consumed, decrypted.size());
+            decrypted.erase(decrypted.begin(), decrypted.begin() + drop);
+            decryptedOffset += drop;
+            consumed -= drop;
+            size_t start = decrypted.size();
+            size_t length = static_cast<size_t>(std::min<uint64_t>(batchLength, contentSize - contentOffset));
+            decrypted.resize(start + length);
+            {
+                Utils::StageTimer timer(Utils::Stage::Read, length);
+                input.read(decrypted.data() + start, length);
+            }
+            if (input.gcount() != static_cast<std::streamsize>(length)) {
+                std::cerr << "Error: Failed to read input data" << std::endl;
+                return false;
+            }
+            if (!decryptStored(decrypted.data() + start, length, contentOffset)) {
+                return false;
+            }
+            contentOffset += length;
+            return true;
+        };
+        
+        // Look up the first frame of the range in the index and start reading at its segment
+        if (frameIndex && rangeStart < rangeEnd && rangeStart / blockSize > 0) {
+            block = rangeStart / blockSize;
+            uint64_t entry = framesSize + block * FRAME_INDEX_ENTRY_SIZE;
+            uint64_t first = entry / SEGMENT_SIZE * SEGMENT_SIZE;
+            uint64_t last = std::min(contentSize, (entry + FRAME_INDEX_ENTRY_SIZE + SEGMENT_SIZE - 1) / SEGMENT_SIZE * SEGMENT_SIZE);
+            std::vector<char> segments(static_cast<size_t>(last - first));
+            input.seekg(contentStart + static_cast<std::streamoff>(first));
+            input.read(segments.data(), segments.size());
+            if (input.gcount() != static_cast<std::streamsize>(segments.size())) {
+                std::cerr << "Error: Failed to read input data" << std::endl;
+                return false;
+            }
+            if (!decryptStored(segments.data(), segments.size(), first)) {
+                return false;
+            }
+            uint64_t frameOffset;
+            std::memcpy(&frameOffset, segments.data() + (entry - first), sizeof(frameOffset));
+            if (frameOffset >= framesSize) {
+                std::cerr << "Error: Corrupted file - invalid frame index" << std::endl;
+                return false;
+            }
+            contentOffset = frameOffset / SEGMENT_SIZE * SEGMENT_SIZE;
+            decryptedOffset = contentOffset;
+            consumed = static_cast<size_t>(frameOffset - contentOffset);
+            input.seekg(contentStart + static_cast<std::streamoff>(contentOffset));
+        }
+        uint64_t firstBlock = block;
+        
+        while (block < blockCount && block * blockSize < rangeEnd) {
+            // Collect the frames that are complete in the decrypted data
+            std::vector<Frame> frames;
+            size_t position = consumed;
+            while (frames.size() < maxFrames && block + frames.size() < blockCount &&
+                   position + Compression::FRAME_HEADER_SIZE <= decrypted.size()) {
+                uint32_t header;
+                std::memcpy(&header, decrypted.data() + position, sizeof(header));
+                size_t payloadLength = header & ~Compression::FRAME_STORED_RAW;
+                if (payloadLength > blockSize) {
+                    std::cerr << "Error: Corrupted file - invalid compression frame" << std::endl;
+                    return false;
+                }
+                if (decrypted.size() - position - Compression::FRAME_HEADER_SIZE < payloadLength) {
+                    break;
+                }
+                frames.push_back({header, position + Compression::FRAME_HEADER_SIZE});
+                position += Compression::FRAME_HEADER_SIZE + payloadLength;
+            }
+            
+            // Decrypt the next batch of segments in parallel when no frame is complete
+            if (frames.empty()) {
+                if (contentOffset >= contentSize) {
+                    std::cerr << "Error: Corrupted file - compressed content is truncated" << std::endl;
+                    return false;
+                }
+                if (!decryptBatch()) {
+                    return false;
+                }
+                continue;
+            }
+            
+            // Decompress the frames overlapping the range in parallel
+            decoded.resize(frames.size() * blockSize);
+            std::atomic<size_t> nextFrame(0);
+            std::atomic<bool> failed(false);
+            Utils::runParallel(static_cast<unsigned>(std::min<size_t>(workers, frames.size())), [&](unsigned) {
+                for (size_t i = nextFrame.fetch_add(1); i < frames.size() && !failed; i = nextFrame.fetch_add(1)) {
+                    uint64_t start = (block + i) * blockSize;
+                    size_t length = static_cast<size_t>(std::min(blockSize, metadata.originalSize - start));
+                    if (start + length <= rangeStart || start >= rangeEnd) {
+                        continue;
+                    }
+                    Utils::StageTimer timer(Utils::Stage::Decompress, length);
+                    if (!Compression::decodeFrame(frames[i].header, decrypted.data() + frames[i].payload,
+                                                  decoded.data() + i * blockSize, length)) {
+                        failed = true;
+                    }
+                }
+            });
+            if (failed) {
+                std::cerr << "Error: Corrupted file - compressed data is invalid" << std::endl;
+                return false;
+            }
+            
+            // Pass on the part inside the range, in order
+            for (size_t i = 0; i < frames.size(); ++i) {
+                uint64_t start = (block + i) * blockSize;
+                uint64_t end = std::min(start + blockSize, metadata.originalSize);
+                uint64_t copyStart = std::max(start, rangeStart);
+                uint64_t copyEnd = std::min(end, rangeEnd);
+                if (copyEnd > copyStart &&
+                    !sink(decoded.data() + i * blockSize + (copyStart - start), static_cast<size_t>(copyEnd - copyStart))) {
+                    return false;
+                }
+                if (frameIndex) {
+                    uint64_t frameOffset = decryptedOffset + frames[i].payload - Compression::FRAME_HEADER_SIZE;
+                    frameOffsets.insert(frameOffsets.end(), reinterpret_cast<char*>(&frameOffset),
+                                        reinterpret_cast<char*>(&frameOffset) + sizeof(uint64_t));
+                }
+            }
+            block += frames.size();
+            consumed = position;
+        }
+        
+        // The last frame must end where the frame index (or the content) begins
+        if (block == blockCount && decryptedOffset + consumed != framesSize) {
+            std::cerr << "Error: Corrupted file - compressed content size mismatch" << std::endl;
+            return false;
+        }
+        
+        // A full decode also reads the frame index and checks it against the frames found
+        if (block == blockCount && firstBlock == 0 && frameIndex) {
+            while (contentOffset < contentSize) {
+                if (!decryptBatch()) {
+                    return false;
+                }
+            }
+            if (decrypted.size() - consumed != frameOffsets.size() ||
+                !std::equal(frameOffsets.begin(), frameOffsets.end(), decrypted.begin() + consumed)) {
+                std::cerr << "Error: Corrupted file - frame index does not match the content" << std::endl;
+                return false;
+            }
+        }
+        
+        recordBufferUsage(decrypted.capacity() + decoded.capacity());
+        return true;
+    }
+
     // Encrypts a file and saves it with metadata
-    // Reads original file, extracts filename/extension, encrypts metadata and content
-    // Saves encrypted file with .enc extension containing all necessary data for decryption
+    // Extracts filename/extension, encrypts metadata, then streams the content in blocks
+    // Layout: [header][metadata size][encrypted metadata][metadata tag][encrypted content][segment tags]
+    // [checksum table] (the legacy engine writes no header, tags or checksums)
     bool Encryptor::encryptFile(const std::string& inputPath, const std::string& outputPath) {
-        // Read original file into memory
-        std::vector<char> fileData;
-        if (!FileHandler::readFile(inputPath, fileData)) {
+        // Open original file and determine its size
+        std::ifstream input(inputPath, std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "Error: Could not open file " << inputPath << std::endl;
             return false;
         }
+        struct stat info;
+        bool regular = stat(inputPath.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+        std::streamoff end = -1;
+        if (regular) {
+            input.seekg(0, std::ios::end);
+            end = input.tellg();
+            input.seekg(0, std::ios::beg);
+        }
+        
+        // Pipes and special files have no size to plan around, so they are read to the end
+        // through the pipeline, like any other stream
+        if (end < 0) {
+            input.clear();
+            return encryptPipeline([&input](Utils::BoundedQueue<std::vector<char>>& blocks, size_t blockSize) {
+                while (true) {
+                    std::vector<char> block(blockSize);
+                    {
+                        Utils::StageTimer timer(Utils::Stage::Read, block.size());
+                        input.read(block.data(), block.size());
+                    }
+                    block.resize(static_cast<size_t>(input.gcount()));
+                    if (block.empty()) {
+                        break;
+                    }
+                    if (!blocks.push(std::move(block))) {
+                        return false;
+                    }
+                }
+                return !input.bad();
+            }, fs::path(inputPath).filename().string(), outputPath);
+        }
+        uint64_t fileSize = static_cast<uint64_t>(end);
+        
+        // Compressed content is streamed through the pipeline, which compresses blocks in parallel
+        // ahead of encryption; its stored size is only known once everything has been compressed
+        // Blocks are read straight into the buffers handed down the pipeline
+        if (compression && engineType != EngineType::LegacyXor) {
+            return encryptPipeline([&input, fileSize](Utils::BoundedQueue<std::vector<char>>& blocks, size_t blockSize) {
+                for (uint64_t offset = 0; offset < fileSize; offset += blockSize) {
+                    std::vector<char> block(static_cast<size_t>(std::min<uint64_t>(blockSize, fileSize - offset)));
+                    {
+                        Utils::StageTimer timer(Utils::Stage::Read, block.size());
+                        input.read(block.data(), block.size());
+                    }
+                    if (input.gcount() != static_cast<std::streamsize>(block.size()) || !blocks.push(std::move(block))) {
+                        return false;
+                    }
+                }
+                return true;
+            }, fs::path(inputPath).filename().string(), outputPath);
+        }
         
         // Extract filename and extension from path
         fs::path path(inputPath);
@@ -159,118 +1391,1290 @@ namespace Encryption {
         FileMetadata metadata;
         metadata.originalFilename = originalFilename;
         metadata.extension = extension;
-        metadata.contentSize = fileData.size();
+        metadata.contentSize = fileSize;
+        
+        // Sparse files store only their data extents, so the holes are neither read nor stored
+        // Legacy files have nowhere to record the extent map
+        uint16_t extraFlags = HEADER_FLAG_CHECKSUMS;
+        std::vector<FileHandler::DataExtent> extents;
+        if (engineType != EngineType::LegacyXor && fileSize > MIN_SPARSE_HOLE_BYTES &&
+            FileHandler::findDataExtents(inputPath, fileSize, extents)) {
+            uint64_t dataBytes = 0;
+            for (const auto& extent : extents) {
+                dataBytes += extent.length;
+            }
+            if (fileSize - dataBytes >= MIN_SPARSE_HOLE_BYTES) {
+                // Content may not be empty, so a file that is one big hole keeps its last byte
+                if (extents.empty()) {
+                    extents.push_back({fileSize - 1, 1});
+                    dataBytes = 1;
+                }
+                metadata.extents = std::move(extents);
+                metadata.originalSize = fileSize;
+                metadata.contentSize = dataBytes;
+                extraFlags |= HEADER_FLAG_SPARSE;
+            }
+        }
+        uint64_t contentSize = metadata.contentSize;
+        bool sparse = !metadata.extents.empty();
         
-        // Serialize metadata to binary format
-        std::vector<char> metadataData = serializeMetadata(metadata);
+        // Create the engine with a fresh file key and encrypt the metadata
+        std::vector<char> header;
+        std::unique_ptr<CipherEngine> engine = createEncryptionEngine(header, extraFlags);
+        std::vector<char> prefix = buildFilePrefix(header, *engine, metadata);
+        uint64_t headerSize = prefix.size();
+        std::vector<char> tags(engine->tagBytes(contentSize));
         
-        // Encrypt metadata using password-derived key
-        std::vector<char> encryptedMetadata = encryptData(metadataData);
+        // Segment checksums are collected as the content is encrypted (versioned files only)
+        bool checksummed = !header.empty();
+        std::vector<uint32_t> checksums(checksummed ? (contentSize + SEGMENT_SIZE - 1) / SEGMENT_SIZE : 0);
+        uint32_t* checksumData = checksummed ? checksums.data() : nullptr;
+        uint64_t tableSize = checksummed ? checksumTableSize(contentSize) : 0;
         
-        // Encrypt file content using password-derived key
-        std::vector<char> encryptedContent = encryptData(fileData);
+        // Transform straight from the mapped input into the mapped output when both can be mapped
+        FileHandler::MappedFile mappedInput, mappedOutput;
+        if (!sparse && ioMode == IoMode::Mapped && mappedInput.openRead(inputPath) && mappedInput.size() == fileSize &&
+            mappedOutput.openWrite(outputPath, headerSize + fileSize + tags.size() + tableSize)) {
+            std::memcpy(mappedOutput.data(), prefix.data(), prefix.size());
+            bool success = transformMapped(*engine, true, tags.data(), checksumData, mappedInput, 0, mappedOutput,
+                                           headerSize, fileSize);
+            if (success) {
+                std::memcpy(mappedOutput.data() + headerSize + fileSize, tags.data(), tags.size());
+                if (checksummed) {
+                    std::vector<char> table = buildChecksumTable(prefix, tags, checksums);
+                    std::memcpy(mappedOutput.data() + headerSize + fileSize + tags.size(), table.data(), table.size());
+                }
+            }
+            if (!mappedOutput.close() && success) {
+                std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+                success = false;
+            }
+            if (!success) {
+                fs::remove(outputPath);
+            }
+            return success;
+        }
+        mappedInput.close();
         
-        // Combine encrypted metadata and content into final file format
-        std::vector<char> finalData;
+        // Create output file
+        std::ofstream output(outputPath, std::ios::binary);
+        if (!output.is_open()) {
+            std::cerr << "Error: Could not create file " << outputPath << std::endl;
+            return false;
+        }
         
-        // Store metadata size (4 bytes) - needed for decryption
-        uint32_t metadataSize = encryptedMetadata.size();
-        finalData.insert(finalData.end(), reinterpret_cast<char*>(&metadataSize), 
-                        reinterpret_cast<char*>(&metadataSize) + sizeof(uint32_t));
+        // Store header, metadata size and encrypted metadata - needed for decryption
+        output.write(prefix.data(), prefix.size());
         
-        // Store encrypted metadata
-        finalData.insert(finalData.end(), encryptedMetadata.begin(), encryptedMetadata.end());
+        // Encrypt content after the metadata, overlapped with asynchronous I/O or in parallel
+        // for multi-block files
+        bool success = !output.fail();
+        bool async = ioMode == IoMode::Async || ioMode == IoMode::AsyncThreads;
+        if (sparse) {
+            success = success && encryptExtents(*engine, tags.data(), checksumData, input, metadata.extents, output);
+        } else if (async || useParallel(fileSize, blockSizeFor(*engine))) {
+            output.close();
+            success = success && !output.fail() &&
+                      (async ? transformAsync(*engine, true, tags.data(), checksumData, inputPath, 0, outputPath,
+                                              headerSize, fileSize)
+                             : transformParallel(*engine, true, tags.data(), checksumData, inputPath, 0, outputPath,
+                                                 headerSize, fileSize));
+            if (success) {
+                output.open(outputPath, std::ios::binary | std::ios::app);
+                success = output.is_open();
+            }
+        } else {
+            success = success && transformStream(*engine, true, tags.data(), checksumData, input, output, fileSize);
+        }
         
-        // Store encrypted content
-        finalData.insert(finalData.end(), encryptedContent.begin(), encryptedContent.end());
+        // Segment tags and the checksum table follow the content
+        if (success) {
+            output.write(tags.data(), tags.size());
+            if (checksummed) {
+                std::vector<char> table = buildChecksumTable(prefix, tags, checksums);
+                output.write(table.data(), table.size());
+            }
+        }
+        output.close();
         
-        // Write encrypted file to disk
-        return FileHandler::writeFile(outputPath, finalData);
+        if (!success || output.fail()) {
+            std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+            fs::remove(outputPath);
+            return false;
+        }
+        
+        return true;
     }
 
-    // Decrypts an encrypted file and restores original file
-    // Reads encrypted file, decrypts metadata to get original filename/extension
-    // Decrypts content and saves with original filename
-    // Includes comprehensive validation to prevent crashes from invalid data
-    bool Encryptor::decryptFile(const std::string& inputPath, const std::string& outputPath) {
-        // Read encrypted file into memory
-        std::vector<char> encryptedData;
-        if (!FileHandler::readFile(inputPath, encryptedData)) {
+    // Extents are read one after another into the block buffer, so small extents share a block
+    // and large ones span several; each full block is encrypted in parallel at its content offset
+    bool Encryptor::encryptExtents(const CipherEngine& engine, char* tags, uint32_t* checksums, std::istream& input,
+                                   const std::vector<FileHandler::DataExtent>& extents, std::ostream& output) {
+        uint64_t contentSize = 0;
+        for (const auto& extent : extents) {
+            contentSize += extent.length;
+        }
+        std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(blockSizeFor(engine), contentSize)));
+        size_t filled = 0;
+        uint64_t position = 0;
+        
+        auto flush = [&]() {
+            if (!transformBlockParallel(engine, true, tags, checksums, buffer.data(), filled, position)) {
+                return false;
+            }
+            recordBufferUsage(buffer.capacity());
+            Utils::StageTimer timer(Utils::Stage::Write, filled);
+            output.write(buffer.data(), static_cast<std::streamsize>(filled));
+            position += filled;
+            filled = 0;
+            return !output.fail();
+        };
+        
+        for (const auto& extent : extents) {
+            input.seekg(static_cast<std::streamoff>(extent.offset));
+            for (uint64_t done = 0; done < extent.length; ) {
+                size_t length = static_cast<size_t>(std::min<uint64_t>(buffer.size() - filled, extent.length - done));
+                {
+                    Utils::StageTimer timer(Utils::Stage::Read, length);
+                    input.read(buffer.data() + filled, static_cast<std::streamsize>(length));
+                }
+                if (input.gcount() != static_cast<std::streamsize>(length)) {
+                    std::cerr << "Error: Failed to read input data" << std::endl;
+                    return false;
+                }
+                filled += length;
+                done += length;
+                if (filled == buffer.size() && !flush()) {
+                    return false;
+                }
+            }
+        }
+        return filled == 0 || flush();
+    }
+
+    // Adapts a producer to the pipeline: it writes into a stream whose buffer hands full blocks on
+    static std::function<bool(Utils::BoundedQueue<std::vector<char>>&, size_t)> producerFeed(
+            const std::function<bool(std::ostream&)>& producer) {
+        return [&producer](Utils::BoundedQueue<std::vector<char>>& blocks, size_t blockSize) {
+            Utils::BlockQueueStreambuf buffer(blocks, blockSize);
+            std::ostream stream(&buffer);
+            bool ok = producer(stream);
+            stream.flush();
+            return ok && !stream.fail() && buffer.finish();
+        };
+    }
+
+    bool Encryptor::encryptStream(const std::function<bool(std::ostream&)>& producer,
+                                  const std::string& contentName, const std::string& outputPath) {
+        return encryptPipeline(producerFeed(producer), contentName, outputPath);
+    }
+
+    bool Encryptor::encryptStream(const std::function<bool(std::ostream&)>& producer,
+                                  const std::string& contentName, std::ostream& output) {
+        bool success = encryptPipeline(producerFeed(producer), contentName, output);
+        if (!success && output.fail()) {
+            std::cerr << "Error: Failed to write output data" << std::endl;
+        }
+        return success;
+    }
+
+    // Encrypts content of unknown length through a three-stage pipeline:
+    // feed thread -> encryption thread -> writer (this thread), joined by bounded queues
+    // A zeroed placeholder of the header's size is written first and replaced once the content
+    // size is known; the metadata has a fixed layout, so its size does not depend on the content size
+    bool Encryptor::encryptPipeline(const std::function<bool(Utils::BoundedQueue<std::vector<char>>&, size_t)>& feed,
+                                    const std::string& contentName, const std::string& outputPath) {
+        std::fstream output(outputPath, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!output.is_open()) {
+            std::cerr << "Error: Could not create file " << outputPath << std::endl;
+            return false;
+        }
+        bool success = encryptPipeline(feed, contentName, output);
+        output.close();
+        if (!success || output.fail()) {
+            std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+            fs::remove(outputPath);
             return false;
         }
+        return true;
+    }
+
+    // The file starts at the output's current position, which the header is written back to
+    bool Encryptor::encryptPipeline(const std::function<bool(Utils::BoundedQueue<std::vector<char>>&, size_t)>& feed,
+                                    const std::string& contentName, std::ostream& output) {
+        // Create metadata structure; content size is filled in at the end
+        FileMetadata metadata;
+        metadata.originalFilename = contentName;
+        metadata.extension = fs::path(contentName).extension().string();
+        metadata.contentSize = 0;
         
+        std::vector<char> header;
+        std::unique_ptr<CipherEngine> engine = createEncryptionEngine(
+            header, HEADER_FLAG_CHECKSUMS | (compression ? HEADER_FLAG_COMPRESSED | HEADER_FLAG_FRAME_INDEX : 0));
+        const CipherEngine& cipher = *engine;
+        bool checksummed = !header.empty();
+        
+        // Compressed content is stored as frames of one segment of plaintext each
+        bool compressing = compression && cipher.type() != EngineType::LegacyXor;
+        if (compressing) {
+            metadata.compression = Compression::CompressionType::Lz;
+            metadata.compressionBlockSize = static_cast<uint32_t>(SEGMENT_SIZE);
+        }
+        uint64_t headerSize = header.size() + sizeof(uint32_t) + serializeMetadata(metadata).size() + cipher.tagSize();
+        
+        std::streampos start = output.tellp();
+        std::vector<char> placeholder(headerSize, 0);
+        output.write(placeholder.data(), placeholder.size());
+        if (start == std::streampos(-1) || output.fail()) {
+            return false;
+        }
+        
+        // Authenticated engines need whole segments per block
+        size_t blockSize = cipher.tagSize() == 0 ? std::min(chunkSize, PIPELINE_BLOCK_SIZE) : SEGMENT_SIZE;
+        Utils::BoundedQueue<std::vector<char>> plainBlocks(PIPELINE_DEPTH);
+        Utils::BoundedQueue<std::vector<char>> compressedBlocks(PIPELINE_DEPTH);
+        Utils::BoundedQueue<std::vector<char>> encryptedBlocks(PIPELINE_DEPTH);
+        Utils::BoundedQueue<std::vector<char>>& encryptInput = compressing ? compressedBlocks : plainBlocks;
+        std::atomic<bool> producerSucceeded(false);
+        std::vector<char> tags;
+        std::vector<uint32_t> checksums;
+        uint64_t originalSize = 0;
+        unsigned compressWorkers = std::max(1u, threadCount);
+        
+        // A failure in any stage cancels all of them
+        auto abortAll = [&]() {
+            plainBlocks.abort();
+            compressedBlocks.abort();
+            encryptedBlocks.abort();
+        };
+        
+        // Stage 1: the feed queues plaintext in fixed-size blocks
+        std::thread producerThread([&]() {
+            bool ok = false;
+            try {
+                ok = feed(plainBlocks, blockSize);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+            
+            if (ok) {
+                producerSucceeded = true;
+                plainBlocks.close();
+            } else {
+                abortAll();
+            }
+        });
+        
+        // Optional stage: compress batches of blocks in parallel and cut the frames back into
+        // segment-sized blocks, so every encrypted block still covers whole segments
+        // The frame index follows the last frame, inside the encrypted content
+        std::thread compressThread;
+        if (compressing) {
+            compressThread = std::thread([&]() {
+                Utils::BlockQueueStreambuf buffer(compressedBlocks, blockSize);
+                std::ostream framed(&buffer);
+                std::vector<std::vector<char>> batch(compressWorkers);
+                std::vector<std::vector<char>> frames(compressWorkers);
+                std::vector<char> frameIndex;
+                uint64_t framedSize = 0;
+                
+                while (true) {
+                    size_t count = 0;
+                    while (count < batch.size() && plainBlocks.pop(batch[count])) {
+                        ++count;
+                    }
+                    if (count == 0) {
+                        break;
+                    }
+                    
+                    std::atomic<size_t> next(0);
+                    Utils::runParallel(static_cast<unsigned>(count), [&](unsigned) {
+                        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                            Utils::StageTimer timer(Utils::Stage::Compress, batch[i].size());
+                            frames[i].clear();
+                            Compression::encodeFrame(batch[i].data(), batch[i].size(), frames[i]);
+                        }
+                    });
+                    
+                    for (size_t i = 0; i < count; ++i) {
+                        frameIndex.insert(frameIndex.end(), reinterpret_cast<char*>(&framedSize),
+                                          reinterpret_cast<char*>(&framedSize) + sizeof(uint64_t));
+                        framed.write(frames[i].data(), frames[i].size());
+                        framedSize += frames[i].size();
+                        originalSize += batch[i].size();
+                    }
+                    if (framed.fail()) {
+                        abortAll();
+                        return;
+                    }
+                }
+                
+                framed.write(frameIndex.data(), frameIndex.size());
+                framed.flush();
+                if (plainBlocks.isAborted() || framed.fail() || !buffer.finish()) {
+                    abortAll();
+                    return;
+                }
+                compressedBlocks.close();
+            });
+        }
+        
+        // Stage 2: encrypt each block at its content offset, collecting segment tags
+        std::thread encryptThread([&]() {
+            std::vector<char> block;
+            uint64_t offset = 0;
+            while (encryptInput.pop(block)) {
+                tags.resize(cipher.tagBytes(offset + block.size()));
+                if (checksummed) {
+                    checksums.resize((offset + block.size() + SEGMENT_SIZE - 1) / SEGMENT_SIZE);
+                }
+                transformBlock(cipher, true, tags.data(), checksummed ? checksums.data() : nullptr,
+                               block.data(), block.data(), block.size(), offset);
+                offset += block.size();
+                if (!encryptedBlocks.push(std::move(block))) {
+                    abortAll();
+                    return;
+                }
+            }
+            if (encryptInput.isAborted()) {
+                encryptedBlocks.abort();
+            } else {
+                encryptedBlocks.close();
+            }
+        });
+        
+        // Stage 3: write encrypted blocks after the header
+        uint64_t contentSize = 0;
+        bool writeSucceeded = true;
+        std::vector<char> block;
+        while (encryptedBlocks.pop(block)) {
+            {
+                Utils::StageTimer timer(Utils::Stage::Write, block.size());
+                output.write(block.data(), block.size());
+            }
+            if (output.fail()) {
+                writeSucceeded = false;
+                abortAll();
+                break;
+            }
+            contentSize += block.size();
+        }
+        
+        producerThread.join();
+        if (compressThread.joinable()) {
+            compressThread.join();
+        }
+        encryptThread.join();
+        
+        // Blocks in flight: two queues, one being filled, one being encrypted, one being written,
+        // plus the compression queue and a batch of blocks and frames when compressing
+        recordBufferUsage(blockSize * (2 * PIPELINE_DEPTH + 3) +
+                          (compressing ? blockSize * (PIPELINE_DEPTH + 2 * compressWorkers + 1) : 0));
+        
+        // Empty input is valid: no content, and no frames when compressing
+        bool success = writeSucceeded && producerSucceeded && !encryptedBlocks.isAborted();
+        
+        // Append the segment tags and checksum table and record the final content size in the header
+        if (success) {
+            metadata.contentSize = contentSize;
+            metadata.originalSize = compressing ? originalSize : 0;
+            std::vector<char> prefix = buildFilePrefix(header, cipher, metadata);
+            output.write(tags.data(), tags.size());
+            if (checksummed) {
+                std::vector<char> table = buildChecksumTable(prefix, tags, checksums);
+                output.write(table.data(), table.size());
+            }
+            std::streampos end = output.tellp();
+            output.seekp(start);
+            output.write(prefix.data(), prefix.size());
+            output.seekp(end);
+            output.flush();
+            success = !output.fail();
+        }
+        return success;
+    }
+
+    // Reads the header (versioned files) or metadata size (legacy files), then decrypts and
+    // validates the metadata; the content is not touched until all of this has passed
+    std::unique_ptr<CipherEngine> Encryptor::readFileHeader(std::istream& input, uint64_t fileSize,
+                                                            FileMetadata& metadata, uint64_t& contentOffset,
+                                                            uint16_t* fileFlags) {
         // Validate minimum file size (must have at least metadata size + some data)
-        if (encryptedData.size() < sizeof(uint32_t) + 1) {
+        if (fileSize < sizeof(uint32_t) + 1) {
             std::cerr << "Error: Invalid encrypted file format - file too small" << std::endl;
-            return false;
+            return nullptr;
         }
         
-        size_t offset = 0;
+        // The first word is either the format magic or a legacy metadata size
+        uint32_t firstWord;
+        input.read(reinterpret_cast<char*>(&firstWord), sizeof(uint32_t));
         
-        // Read metadata size from beginning of file
+        std::vector<char> header;
+        std::unique_ptr<CipherEngine> engine;
         uint32_t metadataSize;
-        std::memcpy(&metadataSize, encryptedData.data() + offset, sizeof(uint32_t));
-        offset += sizeof(uint32_t);
+        uint16_t headerFlags = 0;
+        if (firstWord == FILE_MAGIC) {
+            // Fixed part first; its flags say which optional fields follow
+            header.resize(FILE_HEADER_SIZE);
+            std::memcpy(header.data(), &firstWord, sizeof(uint32_t));
+            input.read(header.data() + sizeof(uint32_t), FILE_HEADER_SIZE - sizeof(uint32_t));
+            uint16_t flags = 0;
+            std::memcpy(&flags, header.data() + 6, sizeof(flags));
+            header.resize(serializedHeaderSize(flags));
+            input.read(header.data() + FILE_HEADER_SIZE, header.size() - FILE_HEADER_SIZE);
+            input.read(reinterpret_cast<char*>(&metadataSize), sizeof(uint32_t));
+            if (!input) {
+                std::cerr << "Error: Invalid encrypted file format - truncated header" << std::endl;
+                return nullptr;
+            }
+            
+            FileHeader fileHeader;
+            try {
+                fileHeader = deserializeHeader(header);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid encrypted file format - " << e.what() << std::endl;
+                return nullptr;
+            }
+            if (fileHeader.flags & HEADER_FLAG_CONTAINER) {
+                std::cerr << "Error: This is an encrypted folder container - extract it as a folder" << std::endl;
+                return nullptr;
+            }
+            
+            // Reject a wrong password from the header alone, before the metadata is read
+            if (!verifyPassword(fileHeader)) {
+                std::cerr << "Error: Invalid password" << std::endl;
+                return nullptr;
+            }
+            engine = createEngine(fileHeader);
+            if (!engine) {
+                std::cerr << "Error: Invalid password or corrupted file - data key authentication failed" << std::endl;
+                return nullptr;
+            }
+            headerFlags = fileHeader.flags;
+        } else {
+            metadataSize = firstWord;
+            engine.reset(new XorEngine(keystream));
+        }
+        uint64_t sizeFieldEnd = header.size() + sizeof(uint32_t);
         
         // Validate metadata size is reasonable
-        if (metadataSize == 0 || metadataSize > encryptedData.size() - sizeof(uint32_t)) {
+        if (metadataSize <= engine->tagSize() || metadataSize > fileSize - sizeFieldEnd) {
             std::cerr << "Error: Invalid encrypted file format - corrupted metadata size" << std::endl;
-            return false;
+            return nullptr;
         }
         
-        // Validate we have enough data for metadata
-        if (offset + metadataSize > encryptedData.size()) {
+        // Read encrypted metadata
+        std::vector<char> encryptedMetadata(metadataSize);
+        input.read(encryptedMetadata.data(), metadataSize);
+        if (input.gcount() != static_cast<std::streamsize>(metadataSize)) {
             std::cerr << "Error: Invalid encrypted file format - insufficient data for metadata" << std::endl;
-            return false;
+            return nullptr;
         }
         
-        // Extract encrypted metadata
-        std::vector<char> encryptedMetadata(encryptedData.begin() + offset, 
-                                           encryptedData.begin() + offset + metadataSize);
-        offset += metadataSize;
-        
-        // Decrypt metadata using password-derived key
-        std::vector<char> metadataData = decryptData(encryptedMetadata);
+        // Decrypt metadata; authenticated engines reject a wrong password here
+        Utils::StageTimer timer(Utils::Stage::Metadata);
+        size_t plainSize = metadataSize - engine->tagSize();
+        std::vector<char> metadataData(plainSize);
+        std::vector<char> aad = authenticatedHeader(header);
+        if (!engine->openMessage(metadataData.data(), encryptedMetadata.data(), plainSize,
+                                 aad.data(), aad.size(), encryptedMetadata.data() + plainSize)) {
+            std::cerr << "Error: Invalid password or corrupted file - metadata authentication failed" << std::endl;
+            return nullptr;
+        }
         
         // Validate decrypted metadata size
         if (metadataData.size() < sizeof(uint32_t) * 3 + sizeof(uint64_t)) {
             std::cerr << "Error: Invalid password or corrupted file - metadata too small" << std::endl;
-            return false;
+            return nullptr;
         }
         
         // Deserialize metadata with error checking
-        FileMetadata metadata;
         try {
             metadata = deserializeMetadata(metadataData);
         } catch (...) {
             std::cerr << "Error: Invalid password or corrupted file - cannot parse metadata" << std::endl;
-            return false;
+            return nullptr;
         }
         
-        // Validate metadata content
-        if (metadata.originalFilename.empty() || metadata.contentSize == 0) {
+        // Validate metadata content (an empty file has no content)
+        if (metadata.originalFilename.empty()) {
             std::cerr << "Error: Invalid password or corrupted file - invalid metadata content" << std::endl;
-            return false;
+            return nullptr;
+        }
+        
+        // The header flag and the metadata must agree on compression
+        // Compressed content is empty (zero frames) exactly when the original is
+        bool compressed = metadata.compression != Compression::CompressionType::None;
+        if (compressed != ((headerFlags & HEADER_FLAG_COMPRESSED) != 0) ||
+            (compressed && (metadata.originalSize == 0) != (metadata.contentSize == 0))) {
+            std::cerr << "Error: Invalid encrypted file format - inconsistent compression settings" << std::endl;
+            return nullptr;
         }
         
-        // Extract encrypted content
-        if (offset >= encryptedData.size()) {
+        // The frame index of compressed content takes up its tail, after a header for every frame
+        uint64_t frameCount = compressed ? (metadata.originalSize + metadata.compressionBlockSize - 1) /
+                                           metadata.compressionBlockSize : 0;
+        if ((headerFlags & HEADER_FLAG_FRAME_INDEX) &&
+            (!compressed || frameCount > metadata.contentSize / (FRAME_INDEX_ENTRY_SIZE + Compression::FRAME_HEADER_SIZE))) {
+            std::cerr << "Error: Invalid encrypted file format - inconsistent frame index" << std::endl;
+            return nullptr;
+        }
+        
+        // Likewise on the extent map of sparse files
+        if (metadata.extents.empty() != ((headerFlags & HEADER_FLAG_SPARSE) == 0) || (compressed && !metadata.extents.empty())) {
+            std::cerr << "Error: Invalid encrypted file format - inconsistent extent map" << std::endl;
+            return nullptr;
+        }
+        
+        // Remaining bytes after the header are the encrypted content (and segment tags)
+        contentOffset = sizeFieldEnd + metadataSize;
+        if (metadata.contentSize != 0 && fileSize == contentOffset) {
             std::cerr << "Error: Invalid encrypted file format - no content data" << std::endl;
+            return nullptr;
+        }
+        
+        // Verify content size matches metadata before any content is processed
+        uint64_t tableSize = (headerFlags & HEADER_FLAG_CHECKSUMS) ? checksumTableSize(metadata.contentSize) : 0;
+        if (fileSize - contentOffset != metadata.contentSize + engine->tagBytes(metadata.contentSize) + tableSize) {
+            std::cerr << "Error: Invalid password or corrupted file - content size mismatch" << std::endl;
+            return nullptr;
+        }
+        
+        if (fileFlags != nullptr) {
+            *fileFlags = headerFlags;
+        }
+        return engine;
+    }
+
+    // Decrypts an encrypted file and restores original file
+    // Reads only the header to decrypt and validate the metadata, then streams the content
+    // Authenticated content is verified segment by segment before it is written; on any failure
+    // the partial output is removed
+    bool Encryptor::decryptFile(const std::string& inputPath, const std::string& outputPath) {
+        // Open encrypted file and determine its size
+        std::ifstream input(inputPath, std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "Error: Could not open file " << inputPath << std::endl;
+            return false;
+        }
+        input.seekg(0, std::ios::end);
+        uint64_t fileSize = static_cast<uint64_t>(input.tellg());
+        input.seekg(0, std::ios::beg);
+        
+        FileMetadata metadata;
+        uint64_t headerSize = 0;
+        uint16_t flags = 0;
+        std::unique_ptr<CipherEngine> engine = readFileHeader(input, fileSize, metadata, headerSize, &flags);
+        if (!engine) {
             return false;
         }
+        uint64_t contentSize = metadata.contentSize;
         
-        std::vector<char> encryptedContent(encryptedData.begin() + offset, encryptedData.end());
+        // Segment tags are small (16 bytes per MiB), so they are loaded up front
+        std::vector<char> tags(engine->tagBytes(contentSize));
+        if (!tags.empty()) {
+            input.seekg(static_cast<std::streamoff>(headerSize + contentSize));
+            input.read(tags.data(), tags.size());
+            input.seekg(static_cast<std::streamoff>(headerSize));
+            if (!input) {
+                std::cerr << "Error: Invalid encrypted file format - insufficient data for tags" << std::endl;
+                return false;
+            }
+        }
         
-        // Decrypt content using password-derived key
-        std::vector<char> decryptedContent = decryptData(encryptedContent);
+        // Compressed content is decrypted and decompressed in batches
+        if (metadata.compression != Compression::CompressionType::None) {
+            std::ofstream output(outputPath, std::ios::binary);
+            if (!output.is_open()) {
+                std::cerr << "Error: Could not create file " << outputPath << std::endl;
+                return false;
+            }
+            bool success = decodeCompressed(*engine, tags.data(), input, metadata, (flags & HEADER_FLAG_FRAME_INDEX) != 0,
+                                            0, metadata.originalSize,
+                                            [&output](const char* data, size_t length) {
+                Utils::StageTimer timer(Utils::Stage::Write, length);
+                output.write(data, length);
+                return !output.fail();
+            });
+            output.close();
+            if (!success || output.fail()) {
+                std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+                fs::remove(outputPath);
+                return false;
+            }
+            return true;
+        }
         
-        // Verify content size matches metadata
-        if (decryptedContent.size() != metadata.contentSize) {
-            std::cerr << "Error: Invalid password or corrupted file - content size mismatch" << std::endl;
+        // Sparse files get their extents written back in place, leaving the holes unallocated
+        if (!metadata.extents.empty()) {
+            if (!decryptExtents(*engine, tags.data(), input, metadata, outputPath)) {
+                fs::remove(outputPath);
+                return false;
+            }
+            return true;
+        }
+        
+        // Transform straight from the mapped input into the mapped output when both can be mapped
+        FileHandler::MappedFile mappedInput, mappedOutput;
+        if (ioMode == IoMode::Mapped && mappedInput.openRead(inputPath) && mappedInput.size() == fileSize &&
+            mappedOutput.openWrite(outputPath, contentSize)) {
+            bool success = transformMapped(*engine, false, tags.data(), nullptr, mappedInput, headerSize,
+                                           mappedOutput, 0, contentSize);
+            if (!mappedOutput.close() && success) {
+                std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+                success = false;
+            }
+            if (!success) {
+                fs::remove(outputPath);
+            }
+            return success;
+        }
+        mappedInput.close();
+        
+        // Create output file
+        std::ofstream output(outputPath, std::ios::binary);
+        if (!output.is_open()) {
+            std::cerr << "Error: Could not create file " << outputPath << std::endl;
+            return false;
+        }
+        
+        // Decrypt content to output file, overlapped with asynchronous I/O or in parallel
+        // for multi-block files
+        bool success;
+        bool async = ioMode == IoMode::Async || ioMode == IoMode::AsyncThreads;
+        if (async || useParallel(contentSize, blockSizeFor(*engine))) {
+            output.close();
+            success = !output.fail() &&
+                      (async ? transformAsync(*engine, false, tags.data(), nullptr, inputPath, headerSize, outputPath, 0, contentSize)
+                             : transformParallel(*engine, false, tags.data(), nullptr, inputPath, headerSize, outputPath, 0, contentSize));
+        } else {
+            success = transformStream(*engine, false, tags.data(), nullptr, input, output, contentSize);
+            output.close();
+        }
+        
+        if (!success || output.fail()) {
+            std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+            fs::remove(outputPath);
+            return false;
+        }
+        
+        return true;
+    }
+
+    // The content is read in order and each decrypted block is scattered over the extents it
+    // covers with positioned writes; the file is sized first, so whatever is not written stays a hole
+    bool Encryptor::decryptExtents(const CipherEngine& engine, char* tags, std::istream& input,
+                                   const FileMetadata& metadata, const std::string& outputPath) {
+        int fd = ::open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            std::cerr << "Error: Could not create file " << outputPath << std::endl;
             return false;
         }
+        bool success = ::ftruncate(fd, static_cast<off_t>(metadata.originalSize)) == 0;
+        if (!success) {
+            std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+        }
+        
+        uint64_t contentSize = metadata.contentSize;
+        std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(blockSizeFor(engine), contentSize)));
+        size_t extent = 0;
+        uint64_t extentDone = 0;
+        for (uint64_t position = 0; success && position < contentSize; ) {
+            size_t blockSize = static_cast<size_t>(std::min<uint64_t>(buffer.size(), contentSize - position));
+            {
+                Utils::StageTimer timer(Utils::Stage::Read, blockSize);
+                input.read(buffer.data(), static_cast<std::streamsize>(blockSize));
+            }
+            if (input.gcount() != static_cast<std::streamsize>(blockSize)) {
+                std::cerr << "Error: Failed to read input data" << std::endl;
+                success = false;
+                break;
+            }
+            if (!transformBlockParallel(engine, false, tags, nullptr, buffer.data(), blockSize, position)) {
+                std::cerr << "Error: Invalid password or corrupted file - content authentication failed" << std::endl;
+                success = false;
+                break;
+            }
+            recordBufferUsage(buffer.capacity());
+            
+            Utils::StageTimer timer(Utils::Stage::Write, blockSize);
+            for (size_t used = 0; used < blockSize; ) {
+                const FileHandler::DataExtent& current = metadata.extents[extent];
+                size_t length = static_cast<size_t>(std::min<uint64_t>(blockSize - used, current.length - extentDone));
+                if (!FileHandler::writeAt(fd, buffer.data() + used, length, current.offset + extentDone)) {
+                    std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+                    success = false;
+                    break;
+                }
+                used += length;
+                extentDone += length;
+                if (extentDone == current.length) {
+                    ++extent;
+                    extentDone = 0;
+                }
+            }
+            position += blockSize;
+        }
+        
+        if (::close(fd) != 0 && success) {
+            std::cerr << "Error: Failed to write file " << outputPath << std::endl;
+            success = false;
+        }
+        return success;
+    }
+
+    // Decryption thread -> consumer (this thread), joined by a bounded queue of blocks
+    // Whatever the consumer leaves unread is drained so the decryption thread can finish
+    bool Encryptor::decryptStream(const std::string& inputPath, const std::function<bool(std::istream&)>& consumer) {
+        Utils::BoundedQueue<std::vector<char>> blocks(PIPELINE_DEPTH);
+        bool decrypted = false;
+        std::thread decryptor([&]() {
+            Utils::BlockQueueStreambuf buffer(blocks, PIPELINE_BLOCK_SIZE);
+            std::ostream stream(&buffer);
+            decrypted = decryptRange(inputPath, 0, UINT64_MAX, stream);
+            stream.flush();
+            decrypted = decrypted && !stream.fail() && buffer.finish();
+            if (decrypted) {
+                blocks.close();
+            } else {
+                blocks.abort();
+            }
+        });
         
-        // Write decrypted content to output file
-        return FileHandler::writeFile(outputPath, decryptedContent);
+        Utils::BlockQueueInputStreambuf buffer(blocks);
+        std::istream stream(&buffer);
+        bool consumed = false;
+        try {
+            consumed = consumer(stream);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        if (consumed) {
+            std::vector<char> rest;
+            while (blocks.pop(rest)) {
+            }
+        } else {
+            blocks.abort();
+        }
+        decryptor.join();
+        return consumed && decrypted;
+    }
+
+    bool Encryptor::decryptRange(const std::string& inputPath, uint64_t offset, uint64_t length,
+                                 std::ostream& output) {
+        std::ifstream input(inputPath, std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "Error: Could not open file " << inputPath << std::endl;
+            return false;
+        }
+        return decryptRange(input, offset, length, output);
+    }
+
+    // Decrypts a slice of the original file from however its content is stored
+    bool Encryptor::decryptRange(std::istream& input, uint64_t offset, uint64_t length, std::ostream& output) {
+        // Determine the size of the encrypted file
+        input.seekg(0, std::ios::end);
+        std::streamoff inputSize = input.tellg();
+        input.seekg(0, std::ios::beg);
+        if (inputSize < 0 || !input) {
+            std::cerr << "Error: Encrypted input is not seekable" << std::endl;
+            return false;
+        }
+        uint64_t fileSize = static_cast<uint64_t>(inputSize);
+        
+        FileMetadata metadata;
+        uint64_t headerSize = 0;
+        uint16_t flags = 0;
+        std::unique_ptr<CipherEngine> engine = readFileHeader(input, fileSize, metadata, headerSize, &flags);
+        if (!engine) {
+            return false;
+        }
+        uint64_t contentSize = metadata.contentSize;
+        
+        // Compressed content is decoded from the first frame of the range (see decodeCompressed)
+        if (metadata.compression != Compression::CompressionType::None) {
+            if (offset > metadata.originalSize) {
+                std::cerr << "Error: Range starts beyond the end of the content (" << metadata.originalSize
+                          << " bytes)" << std::endl;
+                return false;
+            }
+            std::vector<char> tags(engine->tagBytes(contentSize));
+            input.seekg(static_cast<std::streamoff>(headerSize + contentSize));
+            input.read(tags.data(), tags.size());
+            input.seekg(static_cast<std::streamoff>(headerSize));
+            if (!input) {
+                std::cerr << "Error: Invalid encrypted file format - insufficient data for tags" << std::endl;
+                return false;
+            }
+            uint64_t end = offset + std::min(length, metadata.originalSize - offset);
+            return decodeCompressed(*engine, tags.data(), input, metadata, (flags & HEADER_FLAG_FRAME_INDEX) != 0,
+                                    offset, end,
+                                    [&output](const char* data, size_t count) {
+                Utils::StageTimer timer(Utils::Stage::Write, count);
+                output.write(data, static_cast<std::streamsize>(count));
+                if (output.fail()) {
+                    std::cerr << "Error: Failed to write output data" << std::endl;
+                    return false;
+                }
+                return true;
+            });
+        }
+        
+        // Sparse files read back their extents and zeros for the holes between them
+        if (!metadata.extents.empty()) {
+            const std::vector<FileHandler::DataExtent>& extents = metadata.extents;
+            if (offset > metadata.originalSize) {
+                std::cerr << "Error: Range starts beyond the end of the content (" << metadata.originalSize
+                          << " bytes)" << std::endl;
+                return false;
+            }
+            uint64_t end = offset + std::min(length, metadata.originalSize - offset);
+            
+            // Stored bytes before a file offset, which is where that offset maps to in the content
+            auto storedBefore = [&extents](uint64_t fileOffset) {
+                uint64_t stored = 0;
+                for (const auto& extent : extents) {
+                    if (extent.offset >= fileOffset) {
+                        break;
+                    }
+                    stored += std::min(fileOffset, extent.offset + extent.length) - extent.offset;
+                }
+                return stored;
+            };
+            
+            // First extent ending inside the range, which is where stored data starts
+            size_t first = 0;
+            while (first < extents.size() && extents[first].offset + extents[first].length <= offset) {
+                ++first;
+            }
+            uint64_t dataStart = first < extents.size() ? std::min(std::max(offset, extents[first].offset), end) : end;
+            
+            // Zeros up to the first stored byte, the stored bytes with the holes between them
+            // filled in, then zeros up to the end of the range
+            auto fillHole = [&output](uint64_t count) {
+                Utils::StageTimer timer(Utils::Stage::Write, count);
+                if (!writeZeros(output, count)) {
+                    std::cerr << "Error: Failed to write output data" << std::endl;
+                    return false;
+                }
+                return true;
+            };
+            ExtentScatterStreambuf buffer(output, extents, first, dataStart);
+            std::ostream scattered(&buffer);
+            if (!fillHole(dataStart - offset)) {
+                return false;
+            }
+            if (dataStart < end && !decryptContentRange(*engine, input, headerSize, contentSize, storedBefore(offset),
+                                                        storedBefore(end), scattered)) {
+                return false;
+            }
+            return fillHole(end - buffer.offset());
+        }
+        
+        if (offset > contentSize) {
+            std::cerr << "Error: Range starts beyond the end of the content (" << contentSize << " bytes)" << std::endl;
+            return false;
+        }
+        uint64_t end = offset + std::min(length, contentSize - offset);
+        return decryptContentRange(*engine, input, headerSize, contentSize, offset, end, output);
+    }
+
+    // Decrypts a slice of the content by seeking straight to it
+    // The legacy keystream is addressable by byte, so exactly the range is read; authenticated
+    // engines must verify whole segments, so reading is widened to segment boundaries
+    bool Encryptor::decryptContentRange(const CipherEngine& engine, std::istream& input, uint64_t headerSize,
+                                        uint64_t contentSize, uint64_t offset, uint64_t end, std::ostream& output) {
+        // Widen to the blocks the engine can transform on its own
+        size_t unit = engine.tagSize() == 0 ? 1 : SEGMENT_SIZE;
+        uint64_t readStart = offset / unit * unit;
+        uint64_t readEnd = std::min<uint64_t>((end + unit - 1) / unit * unit, contentSize);
+        
+        // Tags for the covered segments only; indices below are relative to the first one
+        uint64_t firstSegment = readStart / SEGMENT_SIZE;
+        std::vector<char> tags;
+        if (engine.tagSize() != 0 && readEnd > readStart) {
+            uint64_t segmentCount = (readEnd - readStart + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+            tags.resize(segmentCount * engine.tagSize());
+            input.seekg(static_cast<std::streamoff>(headerSize + contentSize + firstSegment * engine.tagSize()));
+            input.read(tags.data(), tags.size());
+            if (!input) {
+                std::cerr << "Error: Invalid encrypted file format - insufficient data for tags" << std::endl;
+                return false;
+            }
+        }
+        
+        size_t bufferLength = static_cast<size_t>(std::min<uint64_t>(blockSizeFor(engine), readEnd - readStart));
+        std::vector<char> buffer(bufferLength);
+        input.seekg(static_cast<std::streamoff>(headerSize + readStart));
+        
+        for (uint64_t position = readStart; position < readEnd; ) {
+            size_t blockSize = static_cast<size_t>(std::min<uint64_t>(bufferLength, readEnd - position));
+            {
+                Utils::StageTimer timer(Utils::Stage::Read, blockSize);
+                input.read(buffer.data(), blockSize);
+            }
+            if (input.gcount() != static_cast<std::streamsize>(blockSize)) {
+                std::cerr << "Error: Failed to read input data" << std::endl;
+                return false;
+            }
+            
+            if (!transformBlock(engine, false, tags.data(), nullptr, buffer.data(), buffer.data(), blockSize, position,
+                                firstSegment)) {
+                std::cerr << "Error: Invalid password or corrupted file - content authentication failed" << std::endl;
+                return false;
+            }
+            recordBufferUsage(buffer.capacity());
+            
+            // Emit only the part of the block inside the requested range
+            uint64_t copyStart = std::max(position, offset);
+            uint64_t copyEnd = std::min<uint64_t>(position + blockSize, end);
+            if (copyEnd > copyStart) {
+                Utils::StageTimer timer(Utils::Stage::Write, copyEnd - copyStart);
+                output.write(buffer.data() + (copyStart - position), static_cast<std::streamsize>(copyEnd - copyStart));
+                if (output.fail()) {
+                    std::cerr << "Error: Failed to write output data" << std::endl;
+                    return false;
+                }
+            }
+            position += blockSize;
+        }
+        
+        return true;
+    }
+
+    // Checks every content segment of a mapped file on a pool of workers
+    // check receives the segment index, its stored bytes and a per-worker scratch buffer of one
+    // segment; the indices of segments it rejects are returned in ascending order
+    static std::vector<uint64_t> checkSegments(FileHandler::MappedFile& file, uint64_t contentOffset,
+                                               uint64_t contentSize, unsigned threadCount,
+                                               const std::function<bool(uint64_t, const char*, size_t,
+                                                                        std::vector<char>&)>& check) {
+        uint64_t segmentCount = (contentSize + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+        unsigned workers = static_cast<unsigned>(std::min<uint64_t>(std::max(1u, threadCount), segmentCount));
+        std::atomic<uint64_t> nextSegment(0);
+        std::mutex failedMutex;
+        std::vector<uint64_t> failed;
+        
+        Utils::runParallel(workers, [&](unsigned) {
+            std::vector<char> scratch;
+            for (uint64_t segment = nextSegment.fetch_add(1); segment < segmentCount;
+                 segment = nextSegment.fetch_add(1)) {
+                uint64_t offset = segment * SEGMENT_SIZE;
+                size_t length = static_cast<size_t>(std::min<uint64_t>(SEGMENT_SIZE, contentSize - offset));
+                if (!check(segment, file.data() + contentOffset + offset, length, scratch)) {
+                    std::lock_guard<std::mutex> lock(failedMutex);
+                    failed.push_back(segment);
+                }
+                file.release(contentOffset + offset, length);
+            }
+        });
+        
+        std::sort(failed.begin(), failed.end());
+        return failed;
+    }
+
+    // Lists the content byte ranges of failed segments, up to a limit
+    static void reportFailedSegments(const std::vector<uint64_t>& failed, uint64_t contentSize, const char* reason) {
+        const size_t limit = 10;
+        for (size_t i = 0; i < failed.size() && i < limit; ++i) {
+            uint64_t start = failed[i] * SEGMENT_SIZE;
+            uint64_t end = std::min<uint64_t>(start + SEGMENT_SIZE, contentSize);
+            std::cerr << "Error: Segment " << failed[i] << " (content bytes " << start << "-" << end - 1
+                      << ") " << reason << std::endl;
+        }
+        if (failed.size() > limit) {
+            std::cerr << "Error: ... and " << failed.size() - limit << " more corrupted segment(s)" << std::endl;
+        }
+    }
+
+    // Reads the checksum table after the tags and checks the checksum covering everything but
+    // the content; segmentChecksums receives one checksum per segment
+    static bool loadChecksumTable(const FileHandler::MappedFile& file, uint64_t contentOffset, uint64_t contentSize,
+                                  uint64_t tagBytes, std::vector<uint32_t>& segmentChecksums) {
+        uint64_t segmentCount = (contentSize + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+        const char* tags = file.data() + contentOffset + contentSize;
+        const char* table = tags + tagBytes;
+        segmentChecksums.resize(segmentCount);
+        std::memcpy(segmentChecksums.data(), table, segmentCount * CHECKSUM_SIZE);
+        
+        Utils::StageTimer timer(Utils::Stage::Checksum, contentOffset + tagBytes + segmentCount * CHECKSUM_SIZE);
+        uint32_t crc = Checksum::crc32c(file.data(), contentOffset);
+        crc = Checksum::crc32c(tags, tagBytes + segmentCount * CHECKSUM_SIZE, crc);
+        uint32_t stored;
+        std::memcpy(&stored, table + segmentCount * CHECKSUM_SIZE, sizeof(stored));
+        if (crc != stored) {
+            std::cerr << "Error: Corrupted file - the header, metadata or segment tags fail their checksum, or the file is truncated" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Authenticates everything in memory; the mapped input is released as it is checked, so
+    // resident memory stays at one segment per worker
+    bool Encryptor::verifyFile(const std::string& inputPath) {
+        std::ifstream input(inputPath, std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "Error: Could not open file " << inputPath << std::endl;
+            return false;
+        }
+        input.seekg(0, std::ios::end);
+        uint64_t fileSize = static_cast<uint64_t>(input.tellg());
+        input.seekg(0, std::ios::beg);
+        
+        FileMetadata metadata;
+        uint64_t contentOffset = 0;
+        uint16_t flags = 0;
+        std::unique_ptr<CipherEngine> engine = readFileHeader(input, fileSize, metadata, contentOffset, &flags);
+        if (!engine) {
+            return false;
+        }
+        uint64_t contentSize = metadata.contentSize;
+        if (engine->tagSize() == 0) {
+            std::cerr << "Warning: Legacy files carry no integrity data - only the metadata was checked: "
+                      << inputPath << std::endl;
+            return true;
+        }
+        
+        // Compressed content is checked by decoding it and discarding the result
+        if (metadata.compression != Compression::CompressionType::None) {
+            std::vector<char> tags(engine->tagBytes(contentSize));
+            input.seekg(static_cast<std::streamoff>(contentOffset + contentSize));
+            input.read(tags.data(), tags.size());
+            input.seekg(static_cast<std::streamoff>(contentOffset));
+            if (!input) {
+                std::cerr << "Error: Invalid encrypted file format - insufficient data for tags" << std::endl;
+                return false;
+            }
+            if (!decodeCompressed(*engine, tags.data(), input, metadata, (flags & HEADER_FLAG_FRAME_INDEX) != 0,
+                                  0, metadata.originalSize,
+                                  [](const char*, size_t) { return true; })) {
+                return false;
+            }
+            return !(flags & HEADER_FLAG_CHECKSUMS) || verifyChecksums(inputPath, threadCount);
+        }
+        
+        FileHandler::MappedFile mapped;
+        if (!mapped.openRead(inputPath) || mapped.size() != fileSize) {
+            std::cerr << "Error: Could not map file " << inputPath << std::endl;
+            return false;
+        }
+        uint64_t tagBytes = engine->tagBytes(contentSize);
+        std::vector<uint32_t> checksums;
+        bool checksummed = (flags & HEADER_FLAG_CHECKSUMS) != 0;
+        if (checksummed && !loadChecksumTable(mapped, contentOffset, contentSize, tagBytes, checksums)) {
+            return false;
+        }
+        
+        const char* tags = mapped.data() + contentOffset + contentSize;
+        std::vector<uint64_t> failed = checkSegments(mapped, contentOffset, contentSize, threadCount,
+                                                     [&](uint64_t segment, const char* data, size_t length,
+                                                         std::vector<char>& scratch) {
+            if (checksummed) {
+                Utils::StageTimer timer(Utils::Stage::Checksum, length);
+                if (Checksum::crc32c(data, length) != checksums[segment]) {
+                    return false;
+                }
+            }
+            scratch.resize(length);
+            Utils::StageTimer timer(Utils::Stage::Cipher, length);
+            return engine->decryptSegment(scratch.data(), data, length, segment * SEGMENT_SIZE,
+                                          tags + segment * engine->tagSize());
+        });
+        recordBufferUsage(static_cast<size_t>(std::max(1u, threadCount)) * SEGMENT_SIZE);
+        if (!failed.empty()) {
+            reportFailedSegments(failed, contentSize, "is corrupted or failed authentication");
+            return false;
+        }
+        return true;
+    }
+
+    bool hasChecksums(const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        std::vector<char> header(MAX_FILE_HEADER_SIZE);
+        input.read(header.data(), header.size());
+        header.resize(static_cast<size_t>(input.gcount()));
+        try {
+            return (deserializeHeader(header).flags & HEADER_FLAG_CHECKSUMS) != 0;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // The checksum table does not record the content size, but every stored segment costs its
+    // length plus one tag and one checksum, so the size follows from the bytes after the prefix
+    // Returns false if the file size does not fit any content size (an empty file's content has none)
+    static bool checksummedContentSize(uint64_t fileSize, uint64_t contentOffset, uint64_t& contentSize,
+                                       uint64_t& segmentCount) {
+        uint64_t perSegment = AesGcm::TAG_SIZE + CHECKSUM_SIZE;
+        contentSize = 0;
+        segmentCount = 0;
+        if (fileSize < contentOffset + CHECKSUM_SIZE) {
+            return false;
+        }
+        uint64_t stored = fileSize - contentOffset - CHECKSUM_SIZE;
+        segmentCount = (stored + SEGMENT_SIZE + perSegment - 1) / (SEGMENT_SIZE + perSegment);
+        if (stored < segmentCount * perSegment) {
+            return false;
+        }
+        contentSize = stored - segmentCount * perSegment;
+        return (contentSize + SEGMENT_SIZE - 1) / SEGMENT_SIZE == segmentCount;
+    }
+
+    bool verifyChecksums(const std::string& inputPath, unsigned threadCount) {
+        FileHandler::MappedFile mapped;
+        if (!mapped.openRead(inputPath)) {
+            std::cerr << "Error: Could not map file " << inputPath << std::endl;
+            return false;
+        }
+        uint64_t fileSize = mapped.size();
+        
+        FileHeader header;
+        try {
+            header = deserializeHeader(std::vector<char>(mapped.data(), mapped.data() + std::min<uint64_t>(
+                fileSize, MAX_FILE_HEADER_SIZE)));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid encrypted file format - " << e.what() << std::endl;
+            return false;
+        }
+        if (header.flags & HEADER_FLAG_CONTAINER) {
+            std::cerr << "Error: " << inputPath << " is a folder container, which has no checksums - "
+                      << "extract it to check it" << std::endl;
+            return false;
+        }
+        if (!(header.flags & HEADER_FLAG_CHECKSUMS)) {
+            std::cerr << "Error: " << inputPath << " has no checksums (written by an older version) - "
+                      << "verify it with the password instead" << std::endl;
+            return false;
+        }
+        
+        // Locate the content from the metadata size and the file size
+        uint64_t sizeFieldEnd = serializedHeaderSize(header.flags) + sizeof(uint32_t);
+        uint32_t metadataSize = 0;
+        if (fileSize >= sizeFieldEnd) {
+            std::memcpy(&metadataSize, mapped.data() + sizeFieldEnd - sizeof(uint32_t), sizeof(metadataSize));
+        }
+        uint64_t contentOffset = sizeFieldEnd + metadataSize;
+        uint64_t contentSize = 0;
+        uint64_t segmentCount = 0;
+        if (!checksummedContentSize(fileSize, contentOffset, contentSize, segmentCount)) {
+            std::cerr << "Error: Corrupted file - " << inputPath << " is truncated or its metadata size is damaged"
+                      << std::endl;
+            return false;
+        }
+        
+        std::vector<uint32_t> checksums;
+        if (!loadChecksumTable(mapped, contentOffset, contentSize, AesGcm::TAG_SIZE * segmentCount, checksums)) {
+            return false;
+        }
+        std::vector<uint64_t> failed = checkSegments(mapped, contentOffset, contentSize,
+                                                     threadCount == 0 ? Utils::getDefaultThreadCount() : threadCount,
+                                                     [&](uint64_t segment, const char* data, size_t length,
+                                                         std::vector<char>&) {
+            Utils::StageTimer timer(Utils::Stage::Checksum, length);
+            return Checksum::crc32c(data, length) == checksums[segment];
+        });
+        if (!failed.empty()) {
+            reportFailedSegments(failed, contentSize, "fails its checksum");
+            return false;
+        }
+        return true;
+    }
+
+    // Only the key slot changes: the data key, and with it every tag, stays the same. The final
+    // checksum covers the header, so it is updated from its old value with the change in the
+    // header's checksum; nothing else in the file is read or written
+    bool Encryptor::rekeyFile(const std::string& path, Encryptor& newPassword) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "Error: Could not open file " << path << std::endl;
+            return false;
+        }
+        input.seekg(0, std::ios::end);
+        uint64_t fileSize = static_cast<uint64_t>(input.tellg());
+        input.seekg(0, std::ios::beg);
+        
+        std::vector<char> bytes(MAX_FILE_HEADER_SIZE);
+        input.read(bytes.data(), bytes.size());
+        bytes.resize(static_cast<size_t>(input.gcount()));
+        input.clear();
+        uint32_t magic = 0;
+        if (bytes.size() >= sizeof(magic)) {
+            std::memcpy(&magic, bytes.data(), sizeof(magic));
+        }
+        if (magic != FILE_MAGIC) {
+            std::cerr << "Error: " << path << " is a legacy file without a data key - decrypt it and encrypt it "
+                      << "again to change its password" << std::endl;
+            return false;
+        }
+        FileHeader header;
+        try {
+            header = deserializeHeader(bytes);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid encrypted file format - " << e.what() << std::endl;
+            return false;
+        }
+        if (!(header.flags & HEADER_FLAG_WRAPPED_KEY)) {
+            std::cerr << "Error: " << path << " was written before data keys were wrapped - decrypt it and "
+                      << "encrypt it again once to change its password" << std::endl;
+            return false;
+        }
+        if (!verifyPassword(header)) {
+            std::cerr << "Error: Invalid password" << std::endl;
+            return false;
+        }
+        std::array<uint8_t, DATA_KEY_SIZE> dataKey;
+        if (!unwrapDataKey(header, dataKey)) {
+            std::cerr << "Error: Invalid password or corrupted file - data key authentication failed" << std::endl;
+            return false;
+        }
+        
+        std::vector<char> oldHeader = serializeHeader(header);
+        FileHeader rekeyed = header;
+        newPassword.wrapDataKey(rekeyed, dataKey);
+        std::vector<char> newHeader = serializeHeader(rekeyed);
+        
+        // The checksum covers [prefix][tags][segment checksums]: everything but the content and itself
+        bool checksummed = (header.flags & HEADER_FLAG_CHECKSUMS) != 0;
+        uint32_t finalChecksum = 0;
+        uint64_t checksumOffset = fileSize - CHECKSUM_SIZE;
+        if (checksummed) {
+            uint32_t metadataSize = 0;
+            input.seekg(static_cast<std::streamoff>(oldHeader.size()));
+            input.read(reinterpret_cast<char*>(&metadataSize), sizeof(metadataSize));
+            uint64_t contentSize = 0;
+            uint64_t segmentCount = 0;
+            bool sized = checksummedContentSize(fileSize, oldHeader.size() + sizeof(uint32_t) + metadataSize,
+                                                contentSize, segmentCount);
+            input.seekg(static_cast<std::streamoff>(checksumOffset));
+            input.read(reinterpret_cast<char*>(&finalChecksum), CHECKSUM_SIZE);
+            if (!input || !sized) {
+                std::cerr << "Error: Corrupted file - " << path << " is truncated or its metadata size is damaged"
+                          << std::endl;
+                return false;
+            }
+            uint32_t headerChange = Checksum::crc32c(oldHeader.data(), oldHeader.size()) ^
+                                    Checksum::crc32c(newHeader.data(), newHeader.size());
+            finalChecksum = Checksum::crc32cCombine(headerChange, finalChecksum,
+                                                    checksumOffset - contentSize - oldHeader.size());
+        }
+        input.close();
+        
+        // The header is written with a single call and reaches the disk before the checksum, so
+        // an interruption leaves at worst a stale checksum, which verify reports
+        int fd = ::open(path.c_str(), O_WRONLY);
+        bool success = fd >= 0 &&
+                       ::pwrite(fd, newHeader.data(), newHeader.size(), 0) == static_cast<ssize_t>(newHeader.size()) &&
+                       fdatasync(fd) == 0 &&
+                       (!checksummed ||
+                        (::pwrite(fd, &finalChecksum, CHECKSUM_SIZE, static_cast<off_t>(checksumOffset)) ==
+                             static_cast<ssize_t>(CHECKSUM_SIZE) &&
+                         fdatasync(fd) == 0));
+        if (fd >= 0 && ::close(fd) != 0) {
+            success = false;
+        }
+        if (!success) {
+            std::cerr << "Error: Could not write the new header to " << path << std::endl;
+        }
+        return success;
     }
 }
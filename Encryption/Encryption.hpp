@@ -3,53 +3,441 @@
 
 #include <string>
 #include <vector>
+#include <iosfwd>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "Keystream.hpp"
+#include "CipherEngine.hpp"
+#include "Checksum.hpp"
+#include "../FileHandler/FileHandler.hpp"
+#include "../Compression/Compression.hpp"
+
+namespace Utils {
+    template <typename T> class BoundedQueue;
+}
 
 // Encryption namespace - provides core encryption/decryption functionality
-// Uses XOR-based encryption with password-derived keys
+// Uses AES-256-GCM with password-derived keys by default; the original XOR scheme remains as a legacy engine
 // Stores encrypted files with metadata to preserve original filenames and extensions
 namespace Encryption {
 
-    // Main encryption class implementing XOR-based encryption
+    // Magic number at the start of versioned files ("FCRY" on disk)
+    // Legacy files start with their metadata size, which is always far below this value
+    const uint32_t FILE_MAGIC = 0x59524346;
+
+    // Current version of the versioned file format
+    const uint8_t FILE_FORMAT_VERSION = 2;
+
+    // Size of the fixed part of a serialized FileHeader in bytes
+    const size_t FILE_HEADER_SIZE = 44;
+
+    // Header flag: a password check value follows the fixed header
+    const uint16_t HEADER_FLAG_PASSWORD_CHECK = 0x0001;
+
+    // Header flag: the content is a sequence of compression frames (see FileMetadata::compression)
+    // Kept in the header so versions without compression support reject the file outright
+    const uint16_t HEADER_FLAG_COMPRESSED = 0x0002;
+
+    // Header flag: the file is a folder container (see ArchiveHandler/FolderContainer.hpp)
+    // rather than a single encrypted file
+    const uint16_t HEADER_FLAG_CONTAINER = 0x0004;
+
+    // Header flag: a checksum table follows the segment tags
+    // Table: [CRC32C of each stored content segment][CRC32C of the prefix, tags and segment checksums]
+    // Unlike the tags, checksums can be verified without the password (see verifyChecksums)
+    const uint16_t HEADER_FLAG_CHECKSUMS = 0x0008;
+
+    // Header flag: the content key is a random data key, stored wrapped by the password-derived
+    // key after the password check (see WRAPPED_KEY_SIZE)
+    // Changing the password only rewraps the data key, so the content is never rewritten (see rekeyFile)
+    const uint16_t HEADER_FLAG_WRAPPED_KEY = 0x0010;
+
+    // Header flag: the original file was sparse and only its data extents are stored, one after
+    // another; the extent map in the metadata says where they go (see FileMetadata::extents)
+    const uint16_t HEADER_FLAG_SPARSE = 0x0020;
+
+    // Header flag: compressed content ends with a frame index, the stored offset (u64) of each
+    // frame in order, so range decryption can start at the first frame it needs
+    const uint16_t HEADER_FLAG_FRAME_INDEX = 0x0040;
+
+    // Size of each checksum in the checksum table
+    const size_t CHECKSUM_SIZE = 4;
+
+    // Size of the password check value
+    const size_t PASSWORD_CHECK_SIZE = 16;
+
+    // Sizes of the random key-derivation salt and per-file nonce
+    const size_t SALT_SIZE = 16;
+    const size_t NONCE_SIZE = 16;
+
+    // Size of the data key and of its wrapped form: [wrap nonce][sealed data key][tag]
+    const size_t DATA_KEY_SIZE = 32;
+    const size_t WRAPPED_KEY_SIZE = NONCE_SIZE + DATA_KEY_SIZE + 16;
+
+    // Largest serialized FileHeader (every optional field present)
+    const size_t MAX_FILE_HEADER_SIZE = FILE_HEADER_SIZE + PASSWORD_CHECK_SIZE + WRAPPED_KEY_SIZE;
+
+    // PBKDF2-HMAC-SHA256 iterations used for new files, and the most accepted when decrypting
+    const uint32_t DEFAULT_KDF_ITERATIONS = 600000;
+    const uint32_t MAX_KDF_ITERATIONS = 10000000;
+
+    // Header at the start of files written by authenticated engines
+    // Format: [magic][version][engine][flags][kdf iterations][salt][nonce][password check (if flagged)]
+    //         [wrapped data key (if flagged)]
+    // With a wrapped key, the salt, iterations, password check and wrapped key form a key slot that
+    // can be replaced without touching anything the key protects (see authenticatedHeader)
+    struct FileHeader {
+        EngineType engine = EngineType::Aes256Gcm; // Cipher used for metadata and content
+        uint16_t flags = 0;                         // HEADER_FLAG_* bits for optional format features
+        uint32_t kdfIterations = DEFAULT_KDF_ITERATIONS;
+        std::array<uint8_t, SALT_SIZE> salt{};      // Salt for deriving the master key from the password
+        std::array<uint8_t, NONCE_SIZE> nonce{};    // Random value making the file key unique to this file
+        std::array<uint8_t, PASSWORD_CHECK_SIZE> passwordCheck{}; // Value derived from the master key
+        std::array<uint8_t, WRAPPED_KEY_SIZE> wrappedKey{};       // Data key sealed under the master key
+    };
+
+    // How file operations move content between disk and the cipher engine
+    enum class IoMode {
+        Mapped,      // Memory-map input and output when possible, streams otherwise (default)
+        Stream,      // Read, transform and write each block in turn through streams
+        Async,       // Keep reads and writes in flight while blocks are transformed (io_uring, else threads)
+        AsyncThreads // As Async, always using the thread-based I/O backend
+    };
+
+    // Returns the display name of an I/O mode ("mapped", "stream", "async" or "async-threads")
+    const char* ioModeName(IoMode mode);
+
+    // Parses an I/O mode name as accepted on the command line; returns false if unknown
+    bool parseIoModeName(const std::string& name, IoMode& mode);
+
+    // Structure to hold file metadata for encryption format
+    // Contains information needed to reconstruct original file during decryption
+    struct FileMetadata {
+        std::string originalFilename;  // Original filename without path
+        std::string extension;          // File extension (including dot)
+        size_t contentSize;            // Size of the stored content (the compression frames, if compressed)
+        Compression::CompressionType compression = Compression::CompressionType::None;
+        uint32_t compressionBlockSize = 0; // Uncompressed size of every frame but the last
+        uint64_t originalSize = 0;         // Size of the original content after decompression, or the
+                                           // full size of a sparse file including its holes
+        std::vector<FileHandler::DataExtent> extents; // Data runs of a sparse file (empty = stored in full)
+    };
+
+    // Main encryption class - encrypts files, streams and buffers with the selected cipher engine
     // Uses password-derived keys for symmetric encryption/decryption
+    // File operations may be called concurrently on one shared instance
     class Encryptor {
     private:
         std::string password;  // User-provided password for encryption/decryption
+        Keystream keystream;   // Precomputed keystream period derived from the password (legacy engine)
+        EngineType engineType;  // Engine used for new files and buffers
+        std::array<uint8_t, SALT_SIZE> salt; // Random salt shared by files encrypted with this instance
+        size_t chunkSize;       // Size of each block processed by the streaming engine
+        std::atomic<size_t> peakBufferBytes; // Largest buffer footprint reached by any file operation
+        unsigned threadCount;   // Number of worker threads used for large files
+        bool compression;       // Compress content before encrypting new files
+        IoMode ioMode;          // How file content is read and written
+        unsigned queueDepth;    // Blocks in flight in the asynchronous I/O modes
+        std::mutex keyMutex;    // Guards derivedKeys (not the derivations themselves)
+        std::map<std::string, std::shared_future<std::array<uint8_t, 32>>> derivedKeys; // Master keys by salt and iteration count
+        
+        // Returns the master key for a salt, running the key derivation only once per salt
+        std::array<uint8_t, 32> masterKey(const std::array<uint8_t, SALT_SIZE>& salt, uint32_t iterations);
+        
+        // Computes the password check value stored in headers for a master key
+        static std::array<uint8_t, PASSWORD_CHECK_SIZE> passwordCheck(const std::array<uint8_t, 32>& master);
+        
+        // Fills the key slot of header (salt, iterations, password check, wrapped key) so that
+        // this instance's password unwraps dataKey
+        void wrapDataKey(FileHeader& header, const std::array<uint8_t, DATA_KEY_SIZE>& dataKey);
+        
+        // Unwraps the data key of a header with a wrapped key
+        // Returns false if the wrapped key does not authenticate (wrong password or damaged header)
+        bool unwrapDataKey(const FileHeader& header, std::array<uint8_t, DATA_KEY_SIZE>& dataKey);
+        
+        // Reads and validates everything before the content of an encrypted file
+        // Returns the engine to decrypt the content, or nullptr (after printing an error) if the
+        // file is invalid or the password is wrong; contentOffset receives where the content starts
+        // and fileFlags, if given, the header flags (0 for legacy files)
+        std::unique_ptr<CipherEngine> readFileHeader(std::istream& input, uint64_t fileSize,
+                                                     FileMetadata& metadata, uint64_t& contentOffset,
+                                                     uint16_t* fileFlags = nullptr);
+        
+        // Streams length bytes from input to output in fixed-size blocks, applying the engine
+        // Memory use is bounded by chunkSize regardless of the amount of data processed
+        // checksums, if not null, receives the CRC32C of each encrypted segment (indexed like tags)
+        bool transformStream(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                             std::istream& input, std::ostream& output, uint64_t length);
+        
+        // Transforms length bytes from inputPath (at inputOffset) into outputPath (at outputOffset)
+        // Blocks are distributed across worker threads and written at their final offsets
+        // The output file must already exist; its size is extended to hold the result
+        bool transformParallel(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                               const std::string& inputPath, uint64_t inputOffset,
+                               const std::string& outputPath, uint64_t outputOffset, uint64_t length);
+        
+        // Transforms length bytes from inputPath (at inputOffset) into outputPath (at outputOffset)
+        // through an asynchronous I/O queue: up to queueDepth blocks are being read or written
+        // while others are transformed, so disk and CPU work at the same time
+        // The output file must already exist
+        bool transformAsync(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                            const std::string& inputPath, uint64_t inputOffset,
+                            const std::string& outputPath, uint64_t outputOffset, uint64_t length);
+        
+        // Transforms one block with its segments spread over the worker threads
+        bool transformBlockParallel(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                                    char* data, size_t length, uint64_t offset);
+        
+        // Transforms length bytes directly between two memory-mapped files with no heap buffers
+        // Multi-block content is spread across worker threads
+        bool transformMapped(const CipherEngine& engine, bool encrypt, char* tags, uint32_t* checksums,
+                             FileHandler::MappedFile& input, uint64_t inputOffset,
+                             FileHandler::MappedFile& output, uint64_t outputOffset, uint64_t length);
+        
+        // Decrypts compressed content from input (positioned at the content) and decompresses it,
+        // passing the original bytes in [rangeStart, rangeEnd) to sink in order
+        // Batches of segments are decrypted, and the frames they complete decompressed, in parallel;
+        // with a frame index (see HEADER_FLAG_FRAME_INDEX) reading starts at the first frame of the
+        // range, otherwise the frames before it are decrypted but not decompressed
+        bool decodeCompressed(const CipherEngine& engine, char* tags, std::istream& input,
+                              const FileMetadata& metadata, bool frameIndex, uint64_t rangeStart,
+                              uint64_t rangeEnd, const std::function<bool(const char*, size_t)>& sink);
+        
+        // Decrypts content bytes [offset, end) of an uncompressed file into output, reading and
+        // verifying only the segments that cover them
+        bool decryptContentRange(const CipherEngine& engine, std::istream& input, uint64_t headerSize,
+                                 uint64_t contentSize, uint64_t offset, uint64_t end, std::ostream& output);
+        
+        // Encrypts the data extents of a sparse file as contiguous content into output
+        // Extents are gathered into blocks, which are encrypted at their content offsets
+        bool encryptExtents(const CipherEngine& engine, char* tags, uint32_t* checksums, std::istream& input,
+                            const std::vector<FileHandler::DataExtent>& extents, std::ostream& output);
+        
+        // Decrypts the content of a sparse file and writes each extent at its place in outputPath,
+        // which is first cut to the full size so everything between the extents stays a hole
+        bool decryptExtents(const CipherEngine& engine, char* tags, std::istream& input,
+                            const FileMetadata& metadata, const std::string& outputPath);
+        
+        // Runs the encryptStream pipeline with feed filling the plaintext queue on its own thread
+        // feed pushes blocks of blockSize bytes (only the last may be shorter) and returns false on error
+        bool encryptPipeline(const std::function<bool(Utils::BoundedQueue<std::vector<char>>&, size_t)>& feed,
+                             const std::string& contentName, const std::string& outputPath);
         
-        // Generates encryption key from password with additional entropy
-        // Creates key of specified length by repeating password and applying XOR operations
-        std::vector<char> generateKey(const std::string& password, size_t length);
+        // Runs the pipeline into a seekable stream, from its current position
+        // Returns false without reporting write errors, which the caller reports for its output
+        bool encryptPipeline(const std::function<bool(Utils::BoundedQueue<std::vector<char>>&, size_t)>& feed,
+                             const std::string& contentName, std::ostream& output);
         
-        // Performs XOR encryption/decryption on data
-        // XOR is symmetric - same operation encrypts and decrypts
-        void xorEncrypt(std::vector<char>& data, const std::vector<char>& key);
+        // Raises the recorded peak buffer usage to bytes if it is higher
+        void recordBufferUsage(size_t bytes);
+        
+        // Returns the block size used with an engine (whole segments for authenticated engines)
+        size_t blockSizeFor(const CipherEngine& engine) const;
+        
+        // Returns true if content of this size should be processed by multiple threads
+        bool useParallel(uint64_t length, size_t blockSize) const;
         
     public:
+        // Default block size for streaming file operations (8 MiB)
+        static const size_t DEFAULT_CHUNK_SIZE = 8 * 1024 * 1024;
+        
+        // Default number of blocks in flight for asynchronous I/O
+        static const unsigned DEFAULT_QUEUE_DEPTH = 4;
+        
+        // Returns false if the header carries a password check that does not match this password
+        // Only the key derivation runs; nothing beyond the header needs to be read
+        bool verifyPassword(const FileHeader& header);
+        
+        // Creates the engine for a versioned file from its header (derives the per-file key)
+        // Also used by formats built on the file header, such as folder containers
+        // Returns nullptr if the header's wrapped data key does not authenticate
+        std::unique_ptr<CipherEngine> createEngine(const FileHeader& header);
+        
+        // Creates the engine for new output; header receives the serialized file header
+        // (left empty for the legacy engine, whose format has no header)
+        // extraFlags are added to the header's flags
+        std::unique_ptr<CipherEngine> createEncryptionEngine(std::vector<char>& header, uint16_t extraFlags = 0);
+        
         // Constructor - initializes encryptor with user's password
+        // Precomputes the keystream; throws std::invalid_argument if the password is empty
+        // The slow password-based key derivation runs on first use, once per salt
         Encryptor(const std::string& password);
         
+        // Selects the engine used for new files and buffers (default: AES-256-GCM)
+        // Decryption always uses the engine recorded in the file
+        void setEngine(EngineType type);
+        
+        // Returns the engine used for new files and buffers
+        EngineType getEngine() const;
+        
+        // Sets the block size used when streaming files (minimum 4 KiB)
+        // Authenticated engines round it up to whole segments
+        void setChunkSize(size_t size);
+        
+        // Returns the peak buffer memory (in bytes) used by file operations on this encryptor
+        size_t getPeakBufferBytes() const;
+        
+        // Sets the number of threads used for files larger than one block (0 = all hardware threads)
+        // Output is byte-identical for every thread count
+        void setThreadCount(unsigned count);
+        
+        // Returns the number of threads used for large files
+        unsigned getThreadCount() const;
+        
+        // Enables compression of new files before encryption (default: off)
+        // Applies to the AES-256-GCM format only; legacy files are never compressed
+        // Decryption detects compressed files and decompresses them transparently
+        void setCompression(bool enabled);
+        
+        // Returns true if new files are compressed
+        bool getCompression() const;
+        
+        // Selects how file content is read and written (default: Mapped)
+        // Output is byte-identical in every mode; compressed content always uses the pipeline
+        void setIoMode(IoMode mode);
+        
+        // Returns how file content is read and written
+        IoMode getIoMode() const;
+        
+        // Sets the number of blocks kept in flight by the asynchronous modes (minimum 2, default 4)
+        // Each costs one block of buffer memory; 2 double-buffers, 3 triple-buffers
+        void setQueueDepth(unsigned depth);
+        
+        // Returns the number of blocks kept in flight by the asynchronous modes
+        unsigned getQueueDepth() const;
+        
+        // Sets the salt used for new files (default: random per instance)
+        // Files sharing a salt share one key derivation, so a collection of files written over
+        // several runs (such as an incremental store) can keep its salt to decrypt with a single one
+        // Must not be called while file operations are running
+        void setSalt(const std::array<uint8_t, SALT_SIZE>& salt);
+        
+        // Returns the salt used for new files
+        const std::array<uint8_t, SALT_SIZE>& getSalt() const;
+        
         // Encrypts a file and saves it with metadata
-        // Reads file, extracts filename/extension, encrypts metadata and content
+        // Streams file content block by block, so memory use does not grow with file size
+        // Pipes and other non-regular inputs are read to their end through the streaming pipeline
         bool encryptFile(const std::string& inputPath, const std::string& outputPath);
         
+        // Encrypts content generated on the fly and saves it with metadata
+        // producer writes the plaintext into the stream it is given and runs on its own thread;
+        // blocks are encrypted and written as they arrive through bounded queues, so the
+        // plaintext never touches disk. contentName is stored as the original filename
+        bool encryptStream(const std::function<bool(std::ostream&)>& producer,
+                           const std::string& contentName, const std::string& outputPath);
+        
+        // Same, writing the encrypted file into output from its current position
+        // output must be seekable: the header, which records the content size, is written last
+        bool encryptStream(const std::function<bool(std::ostream&)>& producer,
+                           const std::string& contentName, std::ostream& output);
+        
         // Decrypts an encrypted file and restores original file
-        // Reads encrypted file, decrypts metadata, decrypts content, saves with original name
+        // Reads and validates the metadata header, then streams the content block by block
         bool decryptFile(const std::string& inputPath, const std::string& outputPath);
         
+        // Decrypts an encrypted file's content and passes it to consumer as a stream, the
+        // counterpart of encryptStream: decryption runs on its own thread and blocks reach the
+        // consumer through a bounded queue, so the plaintext never touches disk
+        // Returns false if decryption fails (the consumer then sees a truncated stream) or the consumer does
+        bool decryptStream(const std::string& inputPath, const std::function<bool(std::istream&)>& consumer);
+        
+        // Decrypts bytes [offset, offset + length) of an encrypted file's content into output
+        // Only the header and the part of the content covering the range are read, so the cost
+        // is proportional to the range; authenticated files read and verify the whole segments
+        // overlapping it. A range running past the end of the content is cut at the end
+        // Compressed files without a frame index (see HEADER_FLAG_FRAME_INDEX) are read from the start
+        // Returns false if offset is beyond the content, the password is wrong or the data is corrupted
+        bool decryptRange(const std::string& inputPath, uint64_t offset, uint64_t length, std::ostream& output);
+        
+        // Same, reading the encrypted file from input, which must be seekable and hold only the file
+        bool decryptRange(std::istream& input, uint64_t offset, uint64_t length, std::ostream& output);
+        
+        // Checks an encrypted file without writing any plaintext: every segment is decrypted in
+        // memory and its tag verified (compressed files are also decompressed), and the checksum
+        // table, if present, is checked in the same pass. Segments are spread over the worker threads
+        // Legacy files carry no integrity data, so only their metadata can be checked
+        // Returns false (after reporting the failing segments) if anything does not verify
+        bool verifyFile(const std::string& inputPath);
+        
+        // Changes the password of an encrypted file in place: the data key is unwrapped with this
+        // instance's password and wrapped again with newPassword's, and only the header (and the
+        // checksum covering it) is rewritten, so the cost does not depend on the file size
+        // Works on files, folder containers and encryptData output written with a wrapped key;
+        // older files have to be decrypted and encrypted again once
+        // Returns false (after printing an error) if the password is wrong or the file unsupported
+        bool rekeyFile(const std::string& path, Encryptor& newPassword);
+        
+        // Returns how many bytes encryptData places in front of the ciphertext with the current
+        // engine (header and tag for AES-256-GCM, 0 for the legacy engine)
+        size_t dataOverhead() const;
+        
+        // Encrypts length bytes of data into output, which must hold dataOverhead() + length bytes
+        // With AES-256-GCM the result is self-contained: [file header][tag][ciphertext]
+        // data may be output + dataOverhead() (see encryptDataInPlace) but must not overlap output
+        // otherwise; returns the number of bytes written
+        size_t encryptData(const char* data, size_t length, char* output);
+        
+        // Encrypts the length bytes of plaintext at buffer + dataOverhead() in place, writing the
+        // header and tag into the room left in front of it; returns dataOverhead() + length
+        size_t encryptDataInPlace(char* buffer, size_t length);
+        
+        // Returns the plaintext size of length bytes produced by encryptData
+        // Throws std::runtime_error if the data is too small to be valid
+        size_t decryptedDataSize(const char* data, size_t length) const;
+        
+        // Decrypts length bytes produced by encryptData into output, which must hold
+        // decryptedDataSize(data, length) bytes; output may be the ciphertext itself (see
+        // decryptDataInPlace) but must not overlap data otherwise. Returns the plaintext size
+        // Throws std::runtime_error as decryptData; output is untouched if authentication fails
+        size_t decryptData(const char* data, size_t length, char* output);
+        
+        // Decrypts length bytes produced by encryptData in place and returns the plaintext size;
+        // the plaintext ends where the data ended, at buffer + length - (returned size)
+        size_t decryptDataInPlace(char* buffer, size_t length);
+        
         // Encrypts raw binary data using password-derived key
+        // Copying form of encryptData for callers that do not manage their own buffers
         std::vector<char> encryptData(const std::vector<char>& data);
         
-        // Decrypts raw binary data using password-derived key
+        // Decrypts raw binary data produced by encryptData with the same engine setting
+        // Throws std::runtime_error if authenticated data is malformed, modified or the password is wrong
         std::vector<char> decryptData(const std::vector<char>& encryptedData);
     };
 
-    // Structure to hold file metadata for encryption format
-    // Contains information needed to reconstruct original file during decryption
-    struct FileMetadata {
-        std::string originalFilename;  // Original filename without path
-        std::string extension;          // File extension (including dot)
-        size_t contentSize;            // Size of original file content
-    };
+    // Returns the serialized size of a header with the given flags
+    size_t serializedHeaderSize(uint16_t flags);
+    
+    // Returns the size of the checksum table for content of the given length
+    uint64_t checksumTableSize(uint64_t contentLength);
     
+    // Returns true if path is an encrypted file with a checksum table (checks the header flag only)
+    bool hasChecksums(const std::string& path);
+    
+    // Checks an encrypted file's checksum table against its stored bytes; needs no password
+    // Segments are checked in parallel on threadCount workers (0 = all hardware threads)
+    // Returns false (after reporting the failing segments) if the file has no checksums, is
+    // truncated or any checksum does not match
+    bool verifyChecksums(const std::string& inputPath, unsigned threadCount = 0);
+    
+    // Serializes a file header to its binary form (44 bytes plus optional fields)
+    std::vector<char> serializeHeader(const FileHeader& header);
+    
+    // Returns the serialized header as authenticated alongside metadata and content: with a
+    // wrapped key, the key slot fields are zeroed so rekeying leaves every tag valid
+    // (the wrapped key carries its own tag, bound to the header's format fields)
+    std::vector<char> authenticatedHeader(const std::vector<char>& header);
+    
+    // Deserializes and validates a file header
+    // Throws exceptions for a wrong magic number, unsupported version or unknown engine
+    FileHeader deserializeHeader(const std::vector<char>& data);
+
     // Serializes metadata structure to binary format for encryption
     // Converts FileMetadata to binary data suitable for encryption and storage
     std::vector<char> serializeMetadata(const FileMetadata& metadata);
@@ -0,0 +1,47 @@
+#include "Keystream.hpp"
+#include "XorKernel.hpp"
+#include <numeric>
+#include <stdexcept>
+
+namespace Encryption {
+
+    // Precomputes whole keystream periods for the password
+    // The table is a multiple of the period, so a position maps to (position % table size)
+    Keystream::Keystream(const std::string& password) {
+        if (password.empty()) {
+            throw std::invalid_argument("Password must not be empty");
+        }
+        
+        periodLength = std::lcm(password.length(), static_cast<size_t>(256));
+        size_t periods = (MIN_TABLE_SIZE + periodLength - 1) / periodLength;
+        table.resize(periodLength * periods);
+        
+        for (size_t i = 0; i < table.size(); ++i) {
+            table[i] = password[i % password.length()] ^ (i % 256);
+        }
+    }
+
+    // XORs the keystream into data starting at the given absolute position
+    // The table is walked in long contiguous segments by the SIMD kernel
+    void Keystream::apply(char* data, size_t length, uint64_t offset) const {
+        apply(data, data, length, offset);
+    }
+
+    // Transforms input into output, e.g. straight between two memory-mapped files
+    void Keystream::apply(char* output, const char* input, size_t length, uint64_t offset) const {
+        size_t tableOffset = static_cast<size_t>(offset % table.size());
+        XorKernel::xorRepeating(output, input, length, table.data(), table.size(), tableOffset);
+    }
+
+    // Materializes a range of the keystream
+    std::vector<char> Keystream::generate(size_t length, uint64_t offset) const {
+        std::vector<char> key(length, 0);
+        apply(key.data(), length, offset);
+        return key;
+    }
+
+    // Returns the repetition period of the keystream
+    size_t Keystream::period() const {
+        return periodLength;
+    }
+}
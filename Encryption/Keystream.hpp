@@ -0,0 +1,42 @@
+#ifndef KEYSTREAM_HPP
+#define KEYSTREAM_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Encryption {
+
+    // Password-derived XOR keystream
+    // Key byte at position i is password[i % len] ^ (i % 256), which repeats with
+    // period lcm(len, 256). One period is precomputed per password, so the keystream
+    // can be applied at any offset without allocating a key as long as the data
+    class Keystream {
+    private:
+        size_t periodLength;      // lcm(password length, 256)
+        std::vector<char> table;  // Whole number of periods, long enough for efficient SIMD segments
+        
+    public:
+        // Minimum size of the precomputed table (64 KiB)
+        static const size_t MIN_TABLE_SIZE = 64 * 1024;
+        
+        // Precomputes the keystream table for a password
+        // Throws std::invalid_argument if the password is empty
+        explicit Keystream(const std::string& password);
+        
+        // XORs keystream bytes [offset, offset + length) into data
+        // Applying it twice restores the original data
+        void apply(char* data, size_t length, uint64_t offset) const;
+        
+        // Writes input XOR keystream bytes [offset, offset + length) to output
+        void apply(char* output, const char* input, size_t length, uint64_t offset) const;
+        
+        // Returns keystream bytes [offset, offset + length) as a new buffer
+        std::vector<char> generate(size_t length, uint64_t offset) const;
+        
+        // Returns the repetition period of the keystream in bytes
+        size_t period() const;
+    };
+}
+
+#endif
@@ -0,0 +1,170 @@
+#include "XorKernel.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define XORKERNEL_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace Encryption {
+namespace XorKernel {
+
+    // Portable kernel - XORs 8 bytes at a time, then finishes the tail byte by byte
+    // memcpy keeps the word accesses free of alignment and aliasing issues
+    void xorBlockScalar(char* output, const char* input, const char* key, size_t length) {
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+            uint64_t d, k;
+            std::memcpy(&d, input + i, sizeof(uint64_t));
+            std::memcpy(&k, key + i, sizeof(uint64_t));
+            d ^= k;
+            std::memcpy(output + i, &d, sizeof(uint64_t));
+        }
+        for (; i < length; ++i) {
+            output[i] = input[i] ^ key[i];
+        }
+    }
+
+    void xorBlockScalar(char* data, const char* key, size_t length) {
+        xorBlockScalar(data, data, key, length);
+    }
+
+#ifdef XORKERNEL_X86_DISPATCH
+    // SSE2 kernel - 16 bytes per instruction, 64 bytes per loop iteration
+    __attribute__((target("sse2")))
+    static void xorBlockSse2(char* output, const char* input, const char* key, size_t length) {
+        size_t i = 0;
+        for (; i + 64 <= length; i += 64) {
+            for (size_t lane = 0; lane < 64; lane += 16) {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + lane));
+                __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + i + lane));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + lane), _mm_xor_si128(d, k));
+            }
+        }
+        for (; i + 16 <= length; i += 16) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_xor_si128(d, k));
+        }
+        xorBlockScalar(output + i, input + i, key + i, length - i);
+    }
+
+    // AVX2 kernel - 32 bytes per instruction, 128 bytes per loop iteration
+    __attribute__((target("avx2")))
+    static void xorBlockAvx2(char* output, const char* input, const char* key, size_t length) {
+        size_t i = 0;
+        for (; i + 128 <= length; i += 128) {
+            for (size_t lane = 0; lane < 128; lane += 32) {
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + lane));
+                __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + i + lane));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i + lane), _mm256_xor_si256(d, k));
+            }
+        }
+        for (; i + 32 <= length; i += 32) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+            __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_xor_si256(d, k));
+        }
+        xorBlockScalar(output + i, input + i, key + i, length - i);
+    }
+
+    // AVX-512 kernel - 64 bytes per instruction, 256 bytes per loop iteration
+    __attribute__((target("avx512f")))
+    static void xorBlockAvx512(char* output, const char* input, const char* key, size_t length) {
+        size_t i = 0;
+        for (; i + 256 <= length; i += 256) {
+            for (size_t lane = 0; lane < 256; lane += 64) {
+                __m512i d = _mm512_loadu_si512(input + i + lane);
+                __m512i k = _mm512_loadu_si512(key + i + lane);
+                _mm512_storeu_si512(output + i + lane, _mm512_xor_si512(d, k));
+            }
+        }
+        for (; i + 64 <= length; i += 64) {
+            __m512i d = _mm512_loadu_si512(input + i);
+            __m512i k = _mm512_loadu_si512(key + i);
+            _mm512_storeu_si512(output + i, _mm512_xor_si512(d, k));
+        }
+        xorBlockScalar(output + i, input + i, key + i, length - i);
+    }
+#endif
+
+    // Lists the kernels supported by the running CPU (queried via cpuid), widest first
+    std::vector<Kernel> supportedKernels() {
+        std::vector<Kernel> kernels;
+#ifdef XORKERNEL_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            kernels.push_back({xorBlockAvx512, "avx512"});
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back({xorBlockAvx2, "avx2"});
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            kernels.push_back({xorBlockSse2, "sse2"});
+        }
+#endif
+        kernels.push_back({static_cast<KernelFunction>(xorBlockScalar), "scalar"});
+        return kernels;
+    }
+
+    // Selects the widest kernel supported by the running CPU
+    static Kernel selectKernel() {
+        return supportedKernels().front();
+    }
+
+    // Kernel is resolved once on first use and shared by all callers
+    static const Kernel& activeKernel() {
+        static const Kernel kernel = selectKernel();
+        return kernel;
+    }
+
+    // XORs key into data using the selected kernel
+    void xorBlock(char* data, const char* key, size_t length) {
+        activeKernel().function(data, data, key, length);
+    }
+
+    // Writes input XOR key to output using the selected kernel
+    void xorBlock(char* output, const char* input, const char* key, size_t length) {
+        activeKernel().function(output, input, key, length);
+    }
+
+    // XORs data with a repeating key in place
+    void xorRepeating(char* data, size_t length, const char* key, size_t keyLength, size_t keyOffset) {
+        xorRepeating(data, data, length, key, keyLength, keyOffset);
+    }
+
+    // XORs input with a repeating key, one contiguous key segment at a time
+    // Each segment runs through the vector kernel; wraparound only happens between segments
+    void xorRepeating(char* output, const char* input, size_t length,
+                      const char* key, size_t keyLength, size_t keyOffset) {
+        xorRepeating(activeKernel().function, output, input, length, key, keyLength, keyOffset);
+    }
+
+    // Same segmenting with the kernel given by the caller
+    void xorRepeating(KernelFunction function, char* output, const char* input, size_t length,
+                      const char* key, size_t keyLength, size_t keyOffset) {
+        if (keyLength == 0) {
+            return;
+        }
+        
+        size_t keyPosition = keyOffset % keyLength;
+        size_t processed = 0;
+        
+        while (processed < length) {
+            size_t segment = keyLength - keyPosition;
+            if (segment > length - processed) {
+                segment = length - processed;
+            }
+            function(output + processed, input + processed, key + keyPosition, segment);
+            processed += segment;
+            keyPosition = 0;
+        }
+    }
+
+    // Returns the name of the selected kernel
+    const char* activeKernelName() {
+        return activeKernel().name;
+    }
+}
+}
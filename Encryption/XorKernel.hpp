@@ -0,0 +1,55 @@
+#ifndef XORKERNEL_HPP
+#define XORKERNEL_HPP
+
+#include <cstddef>
+#include <vector>
+
+// XorKernel namespace - provides the vectorized XOR primitive used by the encryption engine
+// The widest kernel supported by the CPU (AVX-512, AVX2, SSE2) is selected once at runtime,
+// with a portable scalar fallback for other architectures
+namespace Encryption {
+namespace XorKernel {
+
+    // Signature shared by every kernel (output[i] = input[i] ^ key[i], output may alias input)
+    using KernelFunction = void (*)(char*, const char*, const char*, size_t);
+
+    struct Kernel {
+        KernelFunction function;
+        const char* name;
+    };
+
+    // XORs length bytes of key into data (data[i] ^= key[i])
+    // Dispatches to the fastest kernel available on this CPU
+    void xorBlock(char* data, const char* key, size_t length);
+
+    // Writes input XOR key to output (output[i] = input[i] ^ key[i])
+    // Output may alias input; used to transform between buffers without an extra copy
+    void xorBlock(char* output, const char* input, const char* key, size_t length);
+
+    // XORs data with a repeating key starting at keyOffset (data[i] ^= key[(keyOffset + i) % keyLength])
+    // Processes the data in key-length segments so no per-byte modulo is needed
+    void xorRepeating(char* data, size_t length, const char* key, size_t keyLength, size_t keyOffset);
+
+    // Out-of-place form of xorRepeating (output[i] = input[i] ^ key[(keyOffset + i) % keyLength])
+    void xorRepeating(char* output, const char* input, size_t length,
+                      const char* key, size_t keyLength, size_t keyOffset);
+
+    // xorRepeating through a specific kernel rather than the selected one
+    void xorRepeating(KernelFunction kernel, char* output, const char* input, size_t length,
+                      const char* key, size_t keyLength, size_t keyOffset);
+
+    // Portable scalar implementation of xorBlock
+    // Used as the fallback kernel and as the reference for verifying vector kernels
+    void xorBlockScalar(char* data, const char* key, size_t length);
+    void xorBlockScalar(char* output, const char* input, const char* key, size_t length);
+
+    // Returns the name of the kernel selected for this CPU ("avx512", "avx2", "sse2" or "scalar")
+    const char* activeKernelName();
+
+    // Returns every kernel compiled in that this CPU can run, widest first and "scalar" last
+    // Lets each vector kernel be checked against the scalar reference, not only the selected one
+    std::vector<Kernel> supportedKernels();
+}
+}
+
+#endif
@@ -0,0 +1,392 @@
+#include "AsyncIO.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define FILECRYPT_HAVE_IO_URING 1
+#endif
+
+namespace FileHandler {
+
+    // One request as tracked by a backend
+    struct AsyncRequest {
+        int fd = -1;
+        char* buffer = nullptr;
+        size_t length = 0;
+        size_t done = 0;      // Bytes transferred so far
+        uint64_t offset = 0;
+        uint64_t tag = 0;
+        bool write = false;
+        bool busy = false;
+        struct iovec iov {};  // Describes the part still to transfer (io_uring)
+    };
+
+#ifdef FILECRYPT_HAVE_IO_URING
+    // io_uring backend driven through the raw system calls (no liburing dependency)
+    // Each request owns a slot whose index is the submission's user_data; short transfers are
+    // resubmitted for the remainder before the completion is reported
+    class UringIO : public AsyncIO {
+    private:
+        int ringFd = -1;
+        std::vector<AsyncRequest> slots;
+        unsigned inFlight = 0;
+
+        void* sqRing = MAP_FAILED;
+        size_t sqRingSize = 0;
+        void* cqRing = MAP_FAILED;
+        size_t cqRingSize = 0;
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t sqesSize = 0;
+
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+
+        static int enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+        }
+
+        // Queues the untransferred part of a slot's request and submits it
+        bool queue(unsigned index) {
+            AsyncRequest& request = slots[index];
+            request.iov.iov_base = request.buffer + request.done;
+            request.iov.iov_len = request.length - request.done;
+
+            unsigned tail = *sqTail;
+            unsigned position = tail & *sqMask;
+            io_uring_sqe* sqe = &sqes[position];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe->fd = request.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(&request.iov);
+            sqe->len = 1;
+            sqe->off = request.offset + request.done;
+            sqe->user_data = index;
+            sqArray[position] = position;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+            while (true) {
+                int submitted = enter(ringFd, 1, 0, 0);
+                if (submitted >= 0) {
+                    return true;
+                }
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    return false;
+                }
+            }
+        }
+
+        bool submit(int fd, char* buffer, size_t length, uint64_t offset, uint64_t tag, bool write) {
+            if (inFlight >= slots.size()) {
+                return false;
+            }
+            unsigned index = 0;
+            while (slots[index].busy) {
+                ++index;
+            }
+            AsyncRequest& request = slots[index];
+            request.fd = fd;
+            request.buffer = buffer;
+            request.length = length;
+            request.done = 0;
+            request.offset = offset;
+            request.tag = tag;
+            request.write = write;
+            request.busy = true;
+            ++inFlight;
+            if (length == 0 || queue(index)) {
+                return true;
+            }
+            request.busy = false;
+            --inFlight;
+            return false;
+        }
+
+    public:
+        ~UringIO() override {
+            if (sqes != MAP_FAILED) {
+                munmap(sqes, sqesSize);
+            }
+            if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                munmap(cqRing, cqRingSize);
+            }
+            if (sqRing != MAP_FAILED) {
+                munmap(sqRing, sqRingSize);
+            }
+            if (ringFd >= 0) {
+                close(ringFd);
+            }
+        }
+
+        // Sets up the rings; returns false if the kernel does not allow io_uring
+        bool init(unsigned depth) {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            ringFd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+            if (ringFd < 0) {
+                return false;
+            }
+
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+            }
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ringFd, IORING_OFF_SQ_RING);
+            if (sqRing == MAP_FAILED) {
+                return false;
+            }
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                cqRing = sqRing;
+            } else {
+                cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ringFd, IORING_OFF_CQ_RING);
+                if (cqRing == MAP_FAILED) {
+                    return false;
+                }
+            }
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+            if (sqes == MAP_FAILED) {
+                return false;
+            }
+
+            char* sq = static_cast<char*>(sqRing);
+            char* cq = static_cast<char*>(cqRing);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            slots.resize(depth);
+            return true;
+        }
+
+        unsigned depth() const override { return static_cast<unsigned>(slots.size()); }
+        const char* name() const override { return "io_uring"; }
+        unsigned pending() const override { return inFlight; }
+
+        bool submitRead(int fd, char* buffer, size_t length, uint64_t offset, uint64_t tag) override {
+            return submit(fd, buffer, length, offset, tag, false);
+        }
+
+        bool submitWrite(int fd, const char* buffer, size_t length, uint64_t offset, uint64_t tag) override {
+            return submit(fd, const_cast<char*>(buffer), length, offset, tag, true);
+        }
+
+        bool wait(uint64_t& tag, int64_t& result) override {
+            // Zero-length requests never reach the kernel and complete immediately
+            for (unsigned index = 0; index < slots.size(); ++index) {
+                if (slots[index].busy && slots[index].length == 0) {
+                    slots[index].busy = false;
+                    --inFlight;
+                    tag = slots[index].tag;
+                    result = 0;
+                    return true;
+                }
+            }
+
+            while (inFlight > 0) {
+                unsigned head = *cqHead;
+                if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                    if (enter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                        return false;
+                    }
+                    continue;
+                }
+                io_uring_cqe cqe = cqes[head & *cqMask];
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+                AsyncRequest& request = slots[static_cast<unsigned>(cqe.user_data)];
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    if (queue(static_cast<unsigned>(cqe.user_data))) {
+                        continue;
+                    }
+                    result = -EIO;
+                } else if (cqe.res < 0) {
+                    result = cqe.res;
+                } else {
+                    request.done += static_cast<size_t>(cqe.res);
+                    if (cqe.res > 0 && request.done < request.length) {
+                        if (queue(static_cast<unsigned>(cqe.user_data))) {
+                            continue;
+                        }
+                        result = -EIO;
+                    } else if (cqe.res == 0 && request.write) {
+                        result = -EIO;
+                    } else {
+                        result = static_cast<int64_t>(request.done);
+                    }
+                }
+                tag = request.tag;
+                request.busy = false;
+                --inFlight;
+                return true;
+            }
+            return false;
+        }
+    };
+#endif
+
+    // Portable backend: one thread per queue slot performs blocking pread/pwrite calls
+    class ThreadIO : public AsyncIO {
+    private:
+        std::mutex mutex;
+        std::condition_variable requestReady;
+        std::condition_variable completionReady;
+        std::deque<AsyncRequest> requests;
+        std::deque<std::pair<uint64_t, int64_t>> completions;
+        std::vector<std::thread> threads;
+        unsigned inFlight = 0;
+        bool stopping = false;
+
+        // Transfers a whole request, resuming after short transfers; stops early at end of file
+        static int64_t perform(const AsyncRequest& request) {
+            size_t done = 0;
+            while (done < request.length) {
+                off_t position = static_cast<off_t>(request.offset + done);
+                ssize_t count = request.write
+                    ? pwrite(request.fd, request.buffer + done, request.length - done, position)
+                    : pread(request.fd, request.buffer + done, request.length - done, position);
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -errno;
+                }
+                if (count == 0) {
+                    if (request.write) {
+                        return -EIO;
+                    }
+                    break;
+                }
+                done += static_cast<size_t>(count);
+            }
+            return static_cast<int64_t>(done);
+        }
+
+        void worker() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                requestReady.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if (requests.empty()) {
+                    return;
+                }
+                AsyncRequest request = requests.front();
+                requests.pop_front();
+                lock.unlock();
+                int64_t result = perform(request);
+                lock.lock();
+                completions.emplace_back(request.tag, result);
+                completionReady.notify_one();
+            }
+        }
+
+        bool submit(int fd, char* buffer, size_t length, uint64_t offset, uint64_t tag, bool write) {
+            if (inFlight >= threads.size()) {
+                return false;
+            }
+            AsyncRequest request;
+            request.fd = fd;
+            request.buffer = buffer;
+            request.length = length;
+            request.offset = offset;
+            request.tag = tag;
+            request.write = write;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                requests.push_back(request);
+            }
+            ++inFlight;
+            requestReady.notify_one();
+            return true;
+        }
+
+    public:
+        explicit ThreadIO(unsigned depth) {
+            threads.reserve(depth);
+            for (unsigned i = 0; i < depth; ++i) {
+                threads.emplace_back(&ThreadIO::worker, this);
+            }
+        }
+
+        // Queued requests are finished before the threads exit, so no buffer is used afterwards
+        ~ThreadIO() override {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            requestReady.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        unsigned depth() const override { return static_cast<unsigned>(threads.size()); }
+        const char* name() const override { return "threads"; }
+        unsigned pending() const override { return inFlight; }
+
+        bool submitRead(int fd, char* buffer, size_t length, uint64_t offset, uint64_t tag) override {
+            return submit(fd, buffer, length, offset, tag, false);
+        }
+
+        bool submitWrite(int fd, const char* buffer, size_t length, uint64_t offset, uint64_t tag) override {
+            return submit(fd, const_cast<char*>(buffer), length, offset, tag, true);
+        }
+
+        bool wait(uint64_t& tag, int64_t& result) override {
+            if (inFlight == 0) {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            completionReady.wait(lock, [this]() { return !completions.empty(); });
+            tag = completions.front().first;
+            result = completions.front().second;
+            completions.pop_front();
+            --inFlight;
+            return true;
+        }
+    };
+
+    std::unique_ptr<AsyncIO> createAsyncIO(unsigned depth, AsyncBackend backend) {
+        depth = std::max(depth, 1u);
+#ifdef FILECRYPT_HAVE_IO_URING
+        if (backend != AsyncBackend::Threads) {
+            std::unique_ptr<UringIO> uring(new UringIO());
+            if (uring->init(depth)) {
+                return std::unique_ptr<AsyncIO>(uring.release());
+            }
+        }
+#endif
+        if (backend == AsyncBackend::IoUring) {
+            return nullptr;
+        }
+        return std::unique_ptr<AsyncIO>(new ThreadIO(depth));
+    }
+
+    // Probed once; containers and seccomp profiles commonly block io_uring_setup
+    bool isIoUringAvailable() {
+        static const bool available = createAsyncIO(1, AsyncBackend::IoUring) != nullptr;
+        return available;
+    }
+}
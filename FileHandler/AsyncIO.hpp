@@ -0,0 +1,59 @@
+#ifndef ASYNCIO_HPP
+#define ASYNCIO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Asynchronous positional file I/O
+// Keeps several reads and writes in flight so the disk works while the caller transforms data
+// Uses io_uring on Linux when the kernel allows it, and a pool of threads issuing pread/pwrite otherwise
+namespace FileHandler {
+
+    // Mechanism used to run requests in the background
+    enum class AsyncBackend {
+        Auto,    // io_uring when available, threads otherwise
+        IoUring, // io_uring only (creation fails if it is unavailable)
+        Threads  // Blocking pread/pwrite on one thread per queue slot
+    };
+
+    // Queue of asynchronous reads and writes on file descriptors
+    // Requests complete in any order and are identified by the caller's tag
+    // Partial transfers are resumed internally, so a completion reports the whole request
+    // Not thread-safe: one thread submits and waits; buffers must stay valid until completion
+    class AsyncIO {
+    public:
+        virtual ~AsyncIO() = default;
+
+        // Returns the maximum number of requests in flight
+        virtual unsigned depth() const = 0;
+
+        // Returns the backend's display name ("io_uring" or "threads")
+        virtual const char* name() const = 0;
+
+        // Starts reading length bytes at offset into buffer
+        // Returns false if depth() requests are already in flight or the request cannot be queued
+        virtual bool submitRead(int fd, char* buffer, size_t length, uint64_t offset, uint64_t tag) = 0;
+
+        // Starts writing length bytes from buffer at offset
+        // Returns false if depth() requests are already in flight or the request cannot be queued
+        virtual bool submitWrite(int fd, const char* buffer, size_t length, uint64_t offset, uint64_t tag) = 0;
+
+        // Waits for the next completed request; result receives the bytes transferred (less than
+        // requested only when a read reaches the end of the file) or a negative errno
+        // Returns false if no request is in flight
+        virtual bool wait(uint64_t& tag, int64_t& result) = 0;
+
+        // Returns the number of requests in flight
+        virtual unsigned pending() const = 0;
+    };
+
+    // Creates a queue allowing depth requests in flight (at least 1)
+    // Returns nullptr only if backend is IoUring and io_uring is unavailable
+    std::unique_ptr<AsyncIO> createAsyncIO(unsigned depth, AsyncBackend backend = AsyncBackend::Auto);
+
+    // Returns true if io_uring can be used in this process
+    bool isIoUringAvailable();
+}
+
+#endif
@@ -1,15 +1,342 @@
 #include "FileHandler.hpp"
+#include "../Utils/Instrumentation.hpp"
 #include <fstream>
 #include <filesystem>
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace fs = std::filesystem;
 
 namespace FileHandler {
 
+    MappedFile::MappedFile() : fd(-1), address(nullptr), length(0), writable(false) {}
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    // Maps a regular, non-empty file read-only
+    bool MappedFile::openRead(const std::string& filePath) {
+        close();
+        
+        fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        
+        // Only regular files with content can be mapped
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+            close();
+            return false;
+        }
+        
+        void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close();
+            return false;
+        }
+        
+        address = static_cast<char*>(mapping);
+        length = static_cast<uint64_t>(info.st_size);
+        madvise(address, length, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    // Creates the output file at its final size and maps it for writing
+    // Preallocation reserves the blocks up front, so running out of space is reported here
+    // instead of surfacing later as a fault while writing through the mapping
+    bool MappedFile::openWrite(const std::string& filePath, uint64_t size) {
+        close();
+        
+        if (size == 0) {
+            return false;
+        }
+        
+        fd = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            close();
+            return false;
+        }
+        
+#ifdef __linux__
+        if (posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0) {
+            close();
+            return false;
+        }
+#endif
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close();
+            return false;
+        }
+        
+        void* mapping = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close();
+            return false;
+        }
+        
+        address = static_cast<char*>(mapping);
+        length = size;
+        writable = true;
+        madvise(address, length, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    // Releases whole pages inside [offset, offset + size) from resident memory
+    void MappedFile::release(uint64_t offset, uint64_t size) {
+        if (address == nullptr) {
+            return;
+        }
+        
+        uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        uint64_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+        uint64_t end = std::min(offset + size, length) / pageSize * pageSize;
+        if (end > begin) {
+            madvise(address + begin, end - begin, MADV_DONTNEED);
+        }
+    }
+
+    // Unmaps the file and closes its descriptor
+    // Written pages are scheduled for write-back first; close reports write-back errors on
+    // filesystems that detect them then (e.g. NFS)
+    bool MappedFile::close() {
+        bool success = true;
+        if (address != nullptr) {
+            if (writable && msync(address, length, MS_ASYNC) != 0) {
+                success = false;
+            }
+            if (munmap(address, length) != 0) {
+                success = false;
+            }
+            address = nullptr;
+        }
+        if (fd >= 0) {
+            if (::close(fd) != 0) {
+                success = false;
+            }
+            fd = -1;
+        }
+        length = 0;
+        bool written = writable;
+        writable = false;
+        return success || !written;
+    }
+
+    FdStreambuf::FdStreambuf(int fd, size_t bufferSize) : fd(fd), buffer(bufferSize), failed(false) {}
+
+    FdStreambuf::~FdStreambuf() {
+        flushOutput();
+    }
+
+    // Writes the put area and leaves the buffer free for either direction
+    bool FdStreambuf::flushOutput() {
+        const char* data = pbase();
+        size_t length = static_cast<size_t>(pptr() - pbase());
+        setp(nullptr, nullptr);
+        while (length > 0) {
+            ssize_t count = ::write(fd, data, length);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                failed = true;
+                return false;
+            }
+            data += count;
+            length -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    FdStreambuf::int_type FdStreambuf::underflow() {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (!flushOutput()) {
+            return traits_type::eof();
+        }
+        ssize_t count;
+        do {
+            count = ::read(fd, buffer.data(), buffer.size());
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) {
+            failed = failed || count < 0;
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+        setg(buffer.data(), buffer.data(), buffer.data() + count);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    // Switching from reading to writing moves the descriptor back over the unread input
+    FdStreambuf::int_type FdStreambuf::overflow(int_type ch) {
+        if (pbase() == nullptr) {
+            if (gptr() < egptr() && ::lseek(fd, gptr() - egptr(), SEEK_CUR) < 0) {
+                return traits_type::eof();
+            }
+            setg(nullptr, nullptr, nullptr);
+        } else if (!flushOutput()) {
+            return traits_type::eof();
+        }
+        setp(buffer.data(), buffer.data() + buffer.size());
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize FdStreambuf::xsgetn(char* data, std::streamsize count) {
+        std::streamsize done = 0;
+        while (done < count) {
+            if (gptr() < egptr()) {
+                std::streamsize length = std::min<std::streamsize>(count - done, egptr() - gptr());
+                std::memcpy(data + done, gptr(), static_cast<size_t>(length));
+                gbump(static_cast<int>(length));
+                done += length;
+            } else if (count - done >= static_cast<std::streamsize>(buffer.size())) {
+                if (!flushOutput()) {
+                    break;
+                }
+                ssize_t length = ::read(fd, data + done, static_cast<size_t>(count - done));
+                if (length < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (length <= 0) {
+                    failed = failed || length < 0;
+                    break;
+                }
+                done += length;
+            } else if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+                break;
+            }
+        }
+        return done;
+    }
+
+    std::streamsize FdStreambuf::xsputn(const char* data, std::streamsize count) {
+        if (count < static_cast<std::streamsize>(buffer.size())) {
+            return std::streambuf::xsputn(data, count);
+        }
+        if (traits_type::eq_int_type(overflow(traits_type::eof()), traits_type::eof()) || !flushOutput()) {
+            return 0;
+        }
+        std::streamsize done = 0;
+        while (done < count) {
+            ssize_t length = ::write(fd, data + done, static_cast<size_t>(count - done));
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            if (length <= 0) {
+                failed = true;
+                break;
+            }
+            done += length;
+        }
+        return done;
+    }
+
+    int FdStreambuf::sync() {
+        return pbase() != nullptr && !flushOutput() ? -1 : 0;
+    }
+
+    // Unread input is discarded, so positions are those of the descriptor itself
+    FdStreambuf::pos_type FdStreambuf::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                               std::ios_base::openmode) {
+        if (!flushOutput()) {
+            return pos_type(off_type(-1));
+        }
+        int whence = direction == std::ios_base::beg ? SEEK_SET : direction == std::ios_base::end ? SEEK_END : SEEK_CUR;
+        if (whence == SEEK_CUR) {
+            offset -= egptr() - gptr();
+        }
+        setg(nullptr, nullptr, nullptr);
+        off_t position = ::lseek(fd, static_cast<off_t>(offset), whence);
+        return position < 0 ? pos_type(off_type(-1)) : pos_type(static_cast<off_type>(position));
+    }
+
+    FdStreambuf::pos_type FdStreambuf::seekpos(pos_type position, std::ios_base::openmode mode) {
+        return seekoff(off_type(position), std::ios_base::beg, mode);
+    }
+
+    bool writeAt(int fd, const char* data, size_t length, uint64_t offset) {
+        while (length > 0) {
+            ssize_t count = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            data += count;
+            length -= static_cast<size_t>(count);
+            offset += static_cast<uint64_t>(count);
+        }
+        return true;
+    }
+
+    // Alternates SEEK_DATA and SEEK_HOLE from the start of the file; ENXIO from SEEK_DATA means
+    // only a hole is left. Filesystems without hole tracking report the whole file as data
+    bool findDataExtents(const std::string& filePath, uint64_t size, std::vector<DataExtent>& extents) {
+        extents.clear();
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+        int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        bool success = true;
+        for (uint64_t position = 0; position < size; ) {
+            off_t data = lseek(fd, static_cast<off_t>(position), SEEK_DATA);
+            if (data < 0) {
+                success = errno == ENXIO;
+                break;
+            }
+            off_t hole = lseek(fd, data, SEEK_HOLE);
+            if (hole < 0) {
+                success = false;
+                break;
+            }
+            uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(hole), size);
+            if (static_cast<uint64_t>(data) >= end) {
+                break;
+            }
+            extents.push_back({static_cast<uint64_t>(data), end - static_cast<uint64_t>(data)});
+            position = end;
+        }
+        close(fd);
+        return success;
+#else
+        (void)filePath;
+        (void)size;
+        return false;
+#endif
+    }
+
     // Reads a file from disk into memory as binary data
     // Opens file in binary mode, determines size, and reads entire content
     bool readFile(const std::string& filePath, std::vector<char>& data) {
+        Utils::StageTimer timer(Utils::Stage::Read);
+
+        // Copy directly from a mapping of regular files
+        MappedFile mapped;
+        if (mapped.openRead(filePath)) {
+            data.assign(mapped.data(), mapped.data() + mapped.size());
+            timer.addBytes(data.size());
+            return true;
+        }
+
         // Open file in binary mode for reading
         std::ifstream file(filePath, std::ios::binary);
         if (!file.is_open()) {
@@ -35,12 +362,26 @@ namespace FileHandler {
         }
 
         file.close();
+        timer.addBytes(data.size());
         return true;
     }
 
     // Writes binary data from memory to a file on disk
     // Creates or overwrites the target file in binary mode
     bool writeFile(const std::string& filePath, const std::vector<char>& data) {
+        Utils::StageTimer timer(Utils::Stage::Write, data.size());
+
+        // Copy directly into a preallocated mapping when possible
+        MappedFile mapped;
+        if (mapped.openWrite(filePath, data.size())) {
+            std::memcpy(mapped.data(), data.data(), data.size());
+            if (!mapped.close()) {
+                std::cerr << "Error: Failed to write file " << filePath << std::endl;
+                return false;
+            }
+            return true;
+        }
+
         // Open file in binary mode for writing (creates or overwrites)
         std::ofstream file(filePath, std::ios::binary);
         if (!file.is_open()) {
@@ -3,17 +3,103 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <streambuf>
 
 // FileHandler namespace - provides file I/O operations for the encryption tool
 // All operations are performed in binary mode to handle any file type
+// Regular files are accessed through memory mappings, with a stream fallback for anything else
 namespace FileHandler {
 
+    // Memory mapping of a whole file, opened either for sequential reading or for writing
+    // Mapping fails for empty files, pipes and special files - callers then use stream I/O
+    class MappedFile {
+    private:
+        int fd;          // Open file descriptor, -1 when closed
+        char* address;   // Start of the mapping, nullptr when closed
+        uint64_t length; // Size of the mapping in bytes
+        bool writable;   // Opened by openWrite, so closing must hand the written pages back
+        
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        
+        // Maps an existing file read-only and advises the kernel of sequential access
+        // Returns false without printing anything if the file cannot be mapped
+        bool openRead(const std::string& filePath);
+        
+        // Creates or truncates a file, preallocates size bytes and maps it for writing
+        // Returns false without printing anything if the file cannot be mapped
+        bool openWrite(const std::string& filePath, uint64_t size);
+        
+        // Drops the given range from this process's resident memory once it is processed
+        // Written data stays in the page cache and is flushed to disk by the kernel
+        void release(uint64_t offset, uint64_t size);
+        
+        // Unmaps and closes the file
+        // Returns false if a written mapping could not be synced, unmapped or closed, in which case
+        // its data may not have been stored
+        bool close();
+        
+        // Accessors for the mapped bytes
+        char* data() const { return address; }
+        uint64_t size() const { return length; }
+    };
+
+    // Stream buffer over a file descriptor owned by the caller, such as one handed over by an
+    // embedding application; reading and writing share one buffer, and seeking works when the
+    // descriptor does (regular files, not pipes or sockets). Large transfers bypass the buffer
+    // Pending output is written when the stream is flushed, seeks or is destroyed
+    class FdStreambuf : public std::streambuf {
+    private:
+        int fd;                   // Descriptor read and written, never closed here
+        std::vector<char> buffer; // Holds either buffered input or pending output
+        bool failed;              // A read or write failed (streams only see end of file)
+        
+        // Writes the pending output; returns false on a write error
+        bool flushOutput();
+        
+    protected:
+        int_type underflow() override;
+        int_type overflow(int_type ch) override;
+        std::streamsize xsgetn(char* data, std::streamsize count) override;
+        std::streamsize xsputn(const char* data, std::streamsize count) override;
+        int sync() override;
+        pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode) override;
+        pos_type seekpos(pos_type position, std::ios_base::openmode mode) override;
+        
+    public:
+        explicit FdStreambuf(int fd, size_t bufferSize = 64 * 1024);
+        ~FdStreambuf() override;
+        FdStreambuf(const FdStreambuf&) = delete;
+        FdStreambuf& operator=(const FdStreambuf&) = delete;
+        
+        // Returns true if a read or write on the descriptor failed
+        bool hasError() const { return failed; }
+    };
+
+    // One run of data in a sparse file; the gaps between runs are holes that read as zeros
+    struct DataExtent {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    // Lists the data extents of the first size bytes of a file with SEEK_DATA/SEEK_HOLE, in order
+    // A file without holes yields one extent, as does any file on a filesystem that cannot report holes
+    // Returns false if the file cannot be queried (or the platform lacks SEEK_DATA)
+    bool findDataExtents(const std::string& filePath, uint64_t size, std::vector<DataExtent>& extents);
+
+    // Writes all of data at offset of a file descriptor, retrying short and interrupted writes
+    bool writeAt(int fd, const char* data, size_t length, uint64_t offset);
+
     // Reads a file from disk into memory as binary data
-    // Handles files of any type and size
+    // Copies straight from a memory mapping when possible, otherwise reads through a stream
     bool readFile(const std::string& filePath, std::vector<char>& data);
 
     // Writes binary data from memory to a file on disk
-    // Creates or overwrites the target file
+    // Creates or overwrites the target file, preallocating and mapping it when possible
     bool writeFile(const std::string& filePath, const std::vector<char>& data);
 
     // Generates appropriate output filename based on operation type
@@ -0,0 +1,153 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+namespace Utils {
+
+    // Fixed-capacity blocking queue connecting the stages of a processing pipeline
+    // Producers block while the queue is full, so memory use is bounded by the capacity
+    // close() ends the stream normally; abort() releases every waiter after an error
+    template <typename T>
+    class BoundedQueue {
+    private:
+        std::mutex mutex;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+        std::deque<T> items;
+        size_t capacity;
+        bool closed;
+        bool aborted;
+
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity(capacity), closed(false), aborted(false) {}
+
+        // Adds an item, waiting for space if the queue is full
+        // Returns false if the queue was closed or aborted
+        bool push(T item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return items.size() < capacity || closed || aborted; });
+            if (closed || aborted) {
+                return false;
+            }
+            items.push_back(std::move(item));
+            notEmpty.notify_one();
+            return true;
+        }
+
+        // Removes the oldest item, waiting if the queue is empty
+        // Returns false once the queue is closed and drained, or aborted
+        bool pop(T& item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return !items.empty() || closed || aborted; });
+            if (aborted || items.empty()) {
+                return false;
+            }
+            item = std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        // Signals that no more items will be pushed
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+        // Cancels the pipeline - pending items are dropped and all waiters return false
+        void abort() {
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+            items.clear();
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+        // Returns true if abort() was called
+        bool isAborted() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return aborted;
+        }
+    };
+
+    // Output stream buffer that hands fixed-size blocks to a pipeline queue
+    // Blocks while the queue is full, which throttles the producer to the pipeline's pace
+    // Only full blocks are pushed until finish(), so block offsets stay aligned to segments
+    class BlockQueueStreambuf : public std::streambuf {
+    private:
+        BoundedQueue<std::vector<char>>& queue;
+        std::vector<char> block;
+        size_t blockSize;
+        
+        // Pushes the buffered bytes as one block and starts a new one
+        bool pushBlock() {
+            size_t used = static_cast<size_t>(pptr() - pbase());
+            if (used == 0) {
+                return true;
+            }
+            block.resize(used);
+            if (!queue.push(std::move(block))) {
+                return false;
+            }
+            block.assign(blockSize, 0);
+            setp(block.data(), block.data() + blockSize);
+            return true;
+        }
+        
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!pushBlock()) {
+                return traits_type::eof();
+            }
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+        
+    public:
+        BlockQueueStreambuf(BoundedQueue<std::vector<char>>& queue, size_t blockSize)
+            : queue(queue), block(blockSize), blockSize(blockSize) {
+            setp(block.data(), block.data() + blockSize);
+        }
+        
+        // Pushes the final, possibly partial, block
+        bool finish() {
+            return pushBlock();
+        }
+    };
+
+    // Input stream buffer that reads the blocks of a pipeline queue in order
+    // Reaches end of file once the queue is closed and drained, or aborted
+    class BlockQueueInputStreambuf : public std::streambuf {
+    private:
+        BoundedQueue<std::vector<char>>& queue;
+        std::vector<char> block;
+        
+    protected:
+        int_type underflow() override {
+            while (gptr() == egptr()) {
+                if (!queue.pop(block)) {
+                    return traits_type::eof();
+                }
+                setg(block.data(), block.data(), block.data() + block.size());
+            }
+            return traits_type::to_int_type(*gptr());
+        }
+        
+    public:
+        explicit BlockQueueInputStreambuf(BoundedQueue<std::vector<char>>& queue) : queue(queue) {}
+    };
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "Instrumentation.hpp"
+#include "Utils.hpp"
+#include <iomanip>
+
+namespace Utils {
+
+    // Counters of one stage, on their own cache line so stages do not contend
+    struct alignas(64) StageCounters {
+        std::atomic<uint64_t> operations{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> nanoseconds{0};
+    };
+
+    static StageCounters counters[static_cast<size_t>(Stage::Count)];
+    static std::chrono::steady_clock::time_point runStart;
+
+    void enableInstrumentation() {
+        for (StageCounters& stage : counters) {
+            stage.operations = 0;
+            stage.bytes = 0;
+            stage.nanoseconds = 0;
+        }
+        runStart = std::chrono::steady_clock::now();
+        instrumentationFlag.store(true, std::memory_order_relaxed);
+    }
+
+    void recordStage(Stage stage, uint64_t nanoseconds, uint64_t bytes) {
+        StageCounters& target = counters[static_cast<size_t>(stage)];
+        target.operations.fetch_add(1, std::memory_order_relaxed);
+        target.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        target.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    const char* stageName(Stage stage) {
+        switch (stage) {
+            case Stage::KeyDerivation: return "key_derivation";
+            case Stage::Metadata:      return "metadata";
+            case Stage::Read:          return "read";
+            case Stage::Cipher:        return "cipher";
+            case Stage::Compress:      return "compress";
+            case Stage::Decompress:    return "decompress";
+            case Stage::Hash:          return "hash";
+            case Stage::Chunk:         return "chunk";
+            case Stage::Checksum:      return "checksum";
+            case Stage::Write:         return "write";
+            case Stage::Scan:          return "scan";
+            case Stage::Archive:       return "archive";
+            case Stage::Extract:       return "extract";
+            default:                   return "unknown";
+        }
+    }
+
+    void writeInstrumentationReport(std::ostream& output) {
+        double runSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+        output << std::setprecision(9);
+        output << "{\n";
+        output << "  \"run_seconds\": " << runSeconds << ",\n";
+        output << "  \"peak_rss_bytes\": " << getPeakMemoryUsage() << ",\n";
+        output << "  \"stages\": [\n";
+        bool first = true;
+        for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i) {
+            const StageCounters& stage = counters[i];
+            uint64_t operations = stage.operations.load();
+            if (operations == 0) {
+                continue;
+            }
+            uint64_t bytes = stage.bytes.load();
+            double seconds = stage.nanoseconds.load() / 1e9;
+            output << (first ? "" : ",\n")
+                   << "    {\"stage\": \"" << stageName(static_cast<Stage>(i)) << "\""
+                   << ", \"operations\": " << operations
+                   << ", \"bytes\": " << bytes
+                   << ", \"seconds\": " << seconds
+                   << ", \"bytes_per_second\": " << (seconds > 0 ? bytes / seconds : 0.0) << "}";
+            first = false;
+        }
+        output << "\n  ]\n";
+        output << "}\n";
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Per-stage timing and throughput counters for the encryption tool
+// Disabled by default; when disabled a StageTimer only tests one relaxed atomic flag
+namespace Utils {
+
+    // Stages of a job that are timed separately
+    enum class Stage {
+        KeyDerivation, // Password-based key derivation (PBKDF2)
+        Metadata,      // Header and metadata serialization, encryption and validation
+        Read,          // Reading content from disk
+        Cipher,        // Encrypting or decrypting content (includes page faults on mapped files)
+        Compress,      // Compressing content blocks before encryption
+        Decompress,    // Decompressing content blocks after decryption
+        Hash,          // Hashing file content to detect changes (incremental stores) or identify chunks
+        Chunk,         // Finding content-defined chunk boundaries (deduplicated containers)
+        Checksum,      // Verifying stored CRC32C checksums (computing them is part of cipher)
+        Write,         // Writing content to disk
+        Scan,          // Walking a folder tree
+        Archive,       // Reading folder files into the tar stream
+        Extract,       // Writing files out of a tar stream
+        Count
+    };
+
+    // Set once before work starts; read on every timed operation
+    inline std::atomic<bool> instrumentationFlag(false);
+
+    // Returns true if stage timings are being collected
+    inline bool isInstrumentationEnabled() {
+        return instrumentationFlag.load(std::memory_order_relaxed);
+    }
+
+    // Starts collecting stage timings and resets the counters and the run clock
+    void enableInstrumentation();
+
+    // Adds one timed operation to a stage's counters (thread-safe)
+    void recordStage(Stage stage, uint64_t nanoseconds, uint64_t bytes);
+
+    // Returns the report name of a stage (e.g. "key_derivation")
+    const char* stageName(Stage stage);
+
+    // Writes the collected counters as JSON: run time, peak RSS, and per stage the number of
+    // operations, bytes, time and bytes/s
+    // Stage time is summed over threads, so parallel stages can exceed the run time
+    void writeInstrumentationReport(std::ostream& output);
+
+    // Times the enclosing scope and charges it to a stage
+    class StageTimer {
+    private:
+        Stage stage;
+        uint64_t bytes;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit StageTimer(Stage stage, uint64_t bytes = 0)
+            : stage(stage), bytes(bytes), active(isInstrumentationEnabled()) {
+            if (active) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~StageTimer() {
+            if (active) {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                recordStage(stage, static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()), bytes);
+            }
+        }
+
+        StageTimer(const StageTimer&) = delete;
+        StageTimer& operator=(const StageTimer&) = delete;
+
+        // Adds bytes processed within the scope, for when the amount is only known afterwards
+        void addBytes(uint64_t count) {
+            bytes += count;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SERIALIZATION_HPP
+#define SERIALIZATION_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Helpers for the tool's binary formats (manifests, indexes)
+// Values are stored in native byte order, as in the file header and metadata
+namespace Utils {
+
+    // Appends the bytes of a trivially copyable value
+    template <typename T>
+    void appendValue(std::vector<char>& output, T value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        output.insert(output.end(), bytes, bytes + sizeof(T));
+    }
+
+    // Appends a string as [u32 length][bytes]
+    inline void appendString(std::vector<char>& output, const std::string& value) {
+        appendValue(output, static_cast<uint32_t>(value.size()));
+        output.insert(output.end(), value.begin(), value.end());
+    }
+
+    // Sequential reader over serialized data that throws std::runtime_error instead of reading
+    // past the end; what names the format in error messages (e.g. "store manifest")
+    class ByteReader {
+    private:
+        const std::vector<char>& data;
+        std::string what;
+        size_t offset;
+
+    public:
+        ByteReader(const std::vector<char>& data, const std::string& what) : data(data), what(what), offset(0) {}
+
+        // Copies the next length bytes to target
+        void read(void* target, size_t length) {
+            if (length > data.size() - offset) {
+                throw std::runtime_error("Truncated " + what);
+            }
+            std::memcpy(target, data.data() + offset, length);
+            offset += length;
+        }
+
+        // Reads the next value of type T
+        template <typename T>
+        T value() {
+            T result;
+            read(&result, sizeof(T));
+            return result;
+        }
+
+        // Reads a string written by appendString, rejecting lengths above maxLength
+        std::string string(uint32_t maxLength) {
+            uint32_t length = value<uint32_t>();
+            if (length > maxLength || length > data.size() - offset) {
+                throw std::runtime_error("Invalid string length in " + what);
+            }
+            std::string result(data.data() + offset, length);
+            offset += length;
+            return result;
+        }
+
+        // Returns the number of bytes not read yet
+        size_t remaining() const { return data.size() - offset; }
+
+        // Returns true once every byte has been read
+        bool atEnd() const { return offset == data.size(); }
+    };
+}
+
+#endif
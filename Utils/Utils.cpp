@@ -1,5 +1,10 @@
 #include "Utils.hpp"
 #include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
 
 namespace fs = std::filesystem;
 
@@ -10,4 +15,63 @@ namespace Utils {
     bool pathExists(const std::string& path) {
         return fs::exists(path);
     }
+
+    // Returns the peak resident set size reported by getrusage
+    // ru_maxrss is in kilobytes on Linux and in bytes on macOS
+    size_t getPeakMemoryUsage() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    // Formats a byte count using binary units with one decimal place
+    std::string formatBytes(size_t bytes) {
+        const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+        double value = static_cast<double>(bytes);
+        int unit = 0;
+        while (value >= 1024.0 && unit < 4) {
+            value /= 1024.0;
+            ++unit;
+        }
+        
+        std::ostringstream ss;
+        if (unit == 0) {
+            ss << bytes << " " << units[unit];
+        } else {
+            ss << std::fixed << std::setprecision(1) << value << " " << units[unit];
+        }
+        return ss.str();
+    }
+
+    // Returns hardware concurrency, falling back to 1 when it cannot be determined
+    unsigned getDefaultThreadCount() {
+        unsigned count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    // Starts threadCount - 1 helper threads, runs worker 0 inline, then joins the helpers
+    void runParallel(unsigned threadCount, const std::function<void(unsigned)>& worker) {
+        if (threadCount <= 1) {
+            worker(0);
+            return;
+        }
+        
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (unsigned i = 1; i < threadCount; ++i) {
+            threads.emplace_back(worker, i);
+        }
+        
+        worker(0);
+        
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
 }
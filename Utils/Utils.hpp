@@ -2,14 +2,31 @@
 #define UTILS_HPP
 
 #include <string>
+#include <cstddef>
+#include <functional>
 
 // Utils namespace - provides lightweight utility functions for the encryption tool
-// Currently includes filesystem path validation functionality
+// Includes filesystem path validation, process resource reporting and a simple worker runner
 namespace Utils {
     // Checks if a given file or directory path exists on the filesystem
     // Works with both absolute and relative paths, handles files and directories
     // No permission checks are performed - only existence check
     bool pathExists(const std::string& path);
+
+    // Returns the peak resident memory (in bytes) used by this process so far
+    // Returns 0 if the platform does not report it
+    size_t getPeakMemoryUsage();
+
+    // Formats a byte count for display (e.g. "12.5 MiB")
+    std::string formatBytes(size_t bytes);
+
+    // Returns the number of hardware threads available (at least 1)
+    unsigned getDefaultThreadCount();
+
+    // Runs worker(0) .. worker(threadCount - 1) concurrently and waits for all of them
+    // Worker 0 runs on the calling thread; workers share work through their own atomic counters
+    // Workers must not throw - errors should be reported through shared state
+    void runParallel(unsigned threadCount, const std::function<void(unsigned)>& worker);
 }
 
 #endif
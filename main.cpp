@@ -5,19 +5,23 @@
 #include "FileHandler/FileHandler.hpp"
 #include "Encryption/Encryption.hpp"
 #include "ArchiveHandler/ArchiveHandler.hpp"
+#include "ArchiveHandler/FolderContainer.hpp"
+#include "CommandLine/CommandLine.hpp"
 
 // FileCrypt - File Encryption/Decryption Tool
 // This is the main entry point for a command-line tool that encrypts and decrypts files and folders.
-// The tool uses XOR-based encryption with password-derived keys and stores encrypted
+// The tool uses AES-256-GCM with password-derived keys (legacy XOR files still decrypt) and stores encrypted
 // files with metadata to preserve original filenames and extensions.
-// For folders, it creates temporary archives and encrypts them using the same process.
+// Folders are written as seekable containers with one encrypted entry per file (see FolderContainer).
+// Given command-line arguments, it runs non-interactively in batch mode (see CommandLine).
+// The engine is the filecrypt library this tool links against, also usable from C (see CApi/filecrypt.h).
 
 using namespace std;
 namespace fs = std::filesystem;
 
 // Displays the main menu with available operations
 // Options 1-2: File encryption/decryption (implemented)
-// Options 3-4: Folder encryption/decryption (implemented using archive creation)
+// Options 3-4: Folder encryption/decryption (implemented using folder containers)
 void displayMenu() {
     cout << "=============================\n";
     cout << "   FileCrypt - Encryption Tool\n";
@@ -31,8 +35,20 @@ void displayMenu() {
     cout << "Enter your choice: ";
 }
 
+// Displays memory usage after an operation so container limits can be sized
+// Peak memory is the process high-water mark; stream buffers are the encryptor's block buffers
+void displayMemoryReport(const Encryption::Encryptor& encryptor) {
+    cout << "📊 Peak memory: " << Utils::formatBytes(Utils::getPeakMemoryUsage())
+         << " (stream buffers: " << Utils::formatBytes(encryptor.getPeakBufferBytes()) << ")" << endl;
+}
+
 // Main application loop - handles user input and performs encryption/decryption operations
-int main() {
+// Any command-line arguments switch to non-interactive batch mode
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return CommandLine::run(argc, argv);
+    }
+
     int choice;        // User's menu selection
     string path;       // File/folder path from user
     string password;   // Encryption password
@@ -83,11 +99,22 @@ int main() {
         cout << "Enter your password: ";
         getline(cin, password);
 
+        // Keys are derived from the password, so it cannot be empty
+        if (password.empty()) {
+            cout << "❌ Error: Password cannot be empty.\n\n";
+            continue;
+        }
+
         // Display operation summary to user
         cout << "\n----------------------------------------\n";
         cout << "Processing operation: " << choice << endl;
         cout << "Target path: " << path << endl;
         cout << "Password: " << string(password.size(), '*') << endl; // Mask password for display
+        if (choice == 1 || choice == 3) {
+            // Decryption uses whichever cipher the file was written with
+            cout << "Cipher: " << Encryption::engineName(Encryption::EngineType::Aes256Gcm)
+                 << " (" << Encryption::AesGcm::activeImplementationName() << ")" << endl;
+        }
         cout << "----------------------------------------\n\n";
 
         // Create encryption engine with user's password
@@ -131,40 +158,43 @@ int main() {
                         break;
                     }
                 
-                    // Check if folder is empty
-                    if (ArchiveHandler::isFolderEmpty(path)) {
-                        cout << "❌ Error: Cannot encrypt empty folder." << endl;
+                    // Scan the folder once - the manifest drives sizing, the empty check and archiving
+                    ArchiveHandler::FolderManifest manifest;
+                    if (!ArchiveHandler::scanFolder(path, manifest)) {
+                        cout << "❌ Error: Could not read folder contents." << endl;
                         break;
                     }
                 
-                    // Get folder size for user info
-                    size_t folderSize = ArchiveHandler::getFolderSize(path);
-                    cout << "📁 Folder size: " << folderSize << " bytes" << endl;
-                
-                    // Create temporary archive
-                    cout << "📦 Creating archive from folder..." << endl;
-                    string archivePath = ArchiveHandler::createArchiveFromFolder(path);
-                    if (archivePath.empty()) {
-                        cout << "❌ Failed to create archive from folder." << endl;
+                    // Check if folder is empty
+                    if (manifest.isEmpty()) {
+                        cout << "❌ Error: Cannot encrypt empty folder." << endl;
                         break;
                     }
                 
+                    // Show folder size for user info
+                    cout << "📁 Folder size: " << manifest.totalSize << " bytes ("
+                         << manifest.fileCount << " files, " << manifest.directoryCount << " folders)" << endl;
+                
                     // 🟢 Create clean output path beside the original folder
                     fs::path folderPath(path);
                     fs::path parentDir = folderPath.parent_path();
-                    std::string folderName = folderPath.filename().string();
+                    std::string folderName = manifest.folderName;
                 
                     // The encrypted file will have the same name with .enc extension
                     outputPath = (parentDir / (folderName + ".enc")).string();
                 
+                    // Encrypt every file into its own container entry - no temporary archive is written
                     cout << "🔒 Encrypting folder..." << endl;
-                    success = encryptor.encryptFile(archivePath, outputPath);
-                
-                    // Clean up temp archive
-                    if (fs::exists(archivePath)) {
-                        fs::remove(archivePath);
-                        cout << "🧹 Cleaned up temporary archive file." << endl;
-                    }
+                    int lastPercent = -1;
+                    success = ArchiveHandler::writeFolderContainer(manifest, outputPath, encryptor,
+                        [&lastPercent](uint64_t done, uint64_t total) {
+                            int percent = total == 0 ? 100 : static_cast<int>(done * 100 / total);
+                            if (percent != lastPercent) {
+                                lastPercent = percent;
+                                cout << "\r⏳ Progress: " << percent << "%" << flush;
+                            }
+                        });
+                    cout << endl;
                 
                     if (success) {
                         cout << "✅ Folder encrypted successfully!" << endl;
@@ -182,25 +212,33 @@ int main() {
                     // Generate output filename by removing .enc extension
                     outputPath = FileHandler::generateOutputFileName(path, false);
                     
-                    // Decrypt the archive file
-                    cout << "🔓 Decrypting archive..." << endl;
-                    success = encryptor.decryptFile(path, outputPath);
-                    
-                    if (!success) {
-                        cout << "❌ Failed to decrypt folder." << endl;
+                    // Containers extract directly into <name>_extracted/<folder>, the layout of older archives
+                    if (ArchiveHandler::isFolderContainer(path)) {
+                        string extractPath = outputPath + "_extracted";
+                        try {
+                            ArchiveHandler::ContainerIndex index = ArchiveHandler::readContainerIndex(path, encryptor);
+                            cout << "📦 Extracting " << index.entries.size() << " entries..." << endl;
+                            success = ArchiveHandler::extractFromContainer(
+                                path, (fs::path(extractPath) / index.folderName).string(), encryptor);
+                        } catch (const std::exception& e) {
+                            cout << "❌ Error: " << e.what() << endl;
+                        }
+                        if (success) {
+                            cout << "✅ Folder decrypted successfully!" << endl;
+                            cout << "Decrypted folder saved as: " << extractPath << endl;
+                        } else {
+                            cout << "❌ Failed to decrypt folder." << endl;
+                        }
                         break;
                     }
                     
-                    // Extract archive to folder
-                    cout << "📦 Extracting archive to folder..." << endl;
+                    // Archives written by earlier versions are decrypted straight into the tar reader,
+                    // which hands file writes to a pool of threads - no temporary archive is written
+                    cout << "🔓 Decrypting and extracting archive..." << endl;
                     string extractPath = outputPath + "_extracted";
-                    success = ArchiveHandler::extractArchiveToFolder(outputPath, extractPath);
-                    
-                    // Clean up temporary archive file
-                    if (fs::exists(outputPath)) {
-                        fs::remove(outputPath);
-                        cout << "🧹 Cleaned up temporary archive file." << endl;
-                    }
+                    success = encryptor.decryptStream(path, [&extractPath](std::istream& archive) {
+                        return ArchiveHandler::extractArchiveStream(archive, extractPath);
+                    });
                     
                     if (success) {
                         cout << "✅ Folder decrypted successfully!" << endl;
@@ -218,6 +256,11 @@ int main() {
                 break;
         }
         
+        // Report memory usage for successful operations
+        if (success) {
+            displayMemoryReport(encryptor);
+        }
+        
         cout << endl;
         
     }